@@ -0,0 +1,180 @@
+/*
+ * bitrow.c: rows of binary cells packed into machine words. See
+ * bitrow.h for the interface.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "puzzles.h"
+#include "bitrow.h"
+
+#if defined __GNUC__
+#define popcount(w) __builtin_popcountl(w)
+#define lowbit(w) __builtin_ctzl(w)
+#define highbit(w) (BITROW_BITS - 1 - __builtin_clzl(w))
+#else
+static int popcount(bitword w)
+{
+    int count = 0;
+    while (w) {
+        w &= w - 1;
+        count++;
+    }
+    return count;
+}
+static int lowbit(bitword w)
+{
+    int i = 0;
+    while (!(w & 1)) {
+        w >>= 1;
+        i++;
+    }
+    return i;
+}
+static int highbit(bitword w)
+{
+    int i = 0;
+    while (w >>= 1)
+        i++;
+    return i;
+}
+#endif
+
+/* The bits of the last word of a row which correspond to real cells. */
+static bitword lastmask(int n)
+{
+    return n % BITROW_BITS ?
+        ((bitword)1 << (n % BITROW_BITS)) - 1 : ~(bitword)0;
+}
+
+bitword *bitrow_new(int nrows, int n)
+{
+    bitword *rows = snewn(nrows * bitrow_words(n), bitword);
+    bitrow_zero(rows, nrows, n);
+    return rows;
+}
+
+void bitrow_zero(bitword *rows, int nrows, int n)
+{
+    memset(rows, 0, nrows * bitrow_words(n) * sizeof(bitword));
+}
+
+int bitrow_count(const bitword *row, int n)
+{
+    int i, nw = bitrow_words(n), count = 0;
+
+    for (i = 0; i < nw; i++)
+        count += popcount(row[i]);
+    return count;
+}
+
+int bitrow_count_and(const bitword *a, const bitword *b, int n)
+{
+    int i, nw = bitrow_words(n), count = 0;
+
+    for (i = 0; i < nw; i++)
+        count += popcount(a[i] & b[i]);
+    return count;
+}
+
+int bitrow_count_andnot(const bitword *a, const bitword *b, int n)
+{
+    int i, nw = bitrow_words(n), count = 0;
+
+    for (i = 0; i < nw; i++)
+        count += popcount(a[i] & ~b[i]);
+    return count;
+}
+
+int bitrow_highest_andnot(const bitword *a, const bitword *b, int n)
+{
+    int i;
+
+    for (i = bitrow_words(n); i-- > 0;) {
+        bitword w = a[i] & ~b[i];
+        if (w)
+            return i * BITROW_BITS + highbit(w);
+    }
+    return -1;
+}
+
+int bitrow_next(const bitword *row, int n, int x)
+{
+    int i, nw = bitrow_words(n);
+    bitword w;
+
+    if (x >= n)
+        return -1;
+    i = x / BITROW_BITS;
+    w = row[i] & (~(bitword)0 << (x % BITROW_BITS));
+    while (!w) {
+        if (++i == nw)
+            return -1;
+        w = row[i];
+    }
+    return i * BITROW_BITS + lowbit(w);
+}
+
+void bitrow_threes(bitword *out, const bitword *row, int n)
+{
+    int i, nw = bitrow_words(n);
+
+    assert(out != row);
+
+    for (i = 0; i < nw; i++) {
+        /*
+         * up1 and up2 hold, at each bit x, the cells x-1 and x-2;
+         * down1 and down2 hold x+1 and x+2. Carry bits in from the
+         * neighbouring words as we go.
+         */
+        bitword up1 = row[i] << 1, up2 = row[i] << 2;
+        bitword down1 = row[i] >> 1, down2 = row[i] >> 2;
+
+        if (i > 0) {
+            up1 |= row[i-1] >> (BITROW_BITS - 1);
+            up2 |= row[i-1] >> (BITROW_BITS - 2);
+        }
+        if (i+1 < nw) {
+            down1 |= row[i+1] << (BITROW_BITS - 1);
+            down2 |= row[i+1] << (BITROW_BITS - 2);
+        }
+
+        out[i] = (up1 & (up2 | down1)) | (down1 & down2);
+    }
+    out[nw-1] &= lastmask(n);
+}
+
+void bitrow_threes_across(bitword *out, const bitword *const r[4], int n)
+{
+    int i, nw = bitrow_words(n);
+
+    for (i = 0; i < nw; i++) {
+        bitword w0 = r[0] ? r[0][i] : 0, w1 = r[1] ? r[1][i] : 0;
+        bitword w2 = r[2] ? r[2][i] : 0, w3 = r[3] ? r[3][i] : 0;
+
+        out[i] = (w1 & (w0 | w2)) | (w2 & w3);
+    }
+}
+
+int bitrow_count_around(const bitword *grid, int w, int h, int x, int y)
+{
+    /* Counting at most three bits, a table beats any popcount. */
+    static const unsigned char count3[8] = { 0, 1, 1, 2, 1, 2, 2, 3 };
+    int nw = bitrow_words(w);
+    int lo = max(x-1, 0), hi = min(x+1, w-1);
+    int i = lo / BITROW_BITS, shift = lo % BITROW_BITS;
+    bool straddle = shift + (hi - lo) >= BITROW_BITS;
+    unsigned mask = (1U << (hi - lo + 1)) - 1;
+    int yy, count = 0;
+
+    for (yy = max(y-1, 0); yy <= min(y+1, h-1); yy++) {
+        const bitword *row = grid + yy * nw + i;
+        bitword bits = row[0] >> shift;
+
+        if (straddle)
+            bits |= row[1] << (BITROW_BITS - shift);
+        count += count3[bits & mask];
+    }
+    return count;
+}
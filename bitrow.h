@@ -0,0 +1,86 @@
+/*
+ * bitrow.h: rows of binary cells packed into machine words, so that
+ * solvers for puzzles played on grids of two-coloured cells (Unruly,
+ * Mosaic) can look for patterns along a whole row at once.
+ */
+
+#ifndef PUZZLES_BITROW_H
+#define PUZZLES_BITROW_H
+
+/*
+ * A row of n cells takes bitrow_words(n) words, with cell x held in
+ * bit x % BITROW_BITS of word x / BITROW_BITS. Bits at positions n
+ * and beyond are always zero, and all the functions below rely on
+ * that and preserve it.
+ *
+ * A grid of h rows of n cells is just h rows laid end to end, so
+ * that row y starts at word y * bitrow_words(n). The same grid can
+ * of course be kept a second time by columns, when a solver wants to
+ * look down columns as well as along rows.
+ */
+typedef unsigned long bitword;
+
+#define BITROW_BITS ((int)(sizeof(bitword) * CHAR_BIT))
+#define bitrow_words(n) (((n) + BITROW_BITS - 1) / BITROW_BITS)
+
+#define bitrow_test(row, x) \
+    ((bool)(((row)[(x) / BITROW_BITS] >> ((x) % BITROW_BITS)) & 1))
+#define bitrow_set(row, x) \
+    ((row)[(x) / BITROW_BITS] |= (bitword)1 << ((x) % BITROW_BITS))
+#define bitrow_clear(row, x) \
+    ((row)[(x) / BITROW_BITS] &= ~((bitword)1 << ((x) % BITROW_BITS)))
+
+/* Allocate 'nrows' rows of n cells each, all clear. */
+bitword *bitrow_new(int nrows, int n);
+
+/* Clear 'nrows' rows of n cells each. */
+void bitrow_zero(bitword *rows, int nrows, int n);
+
+/*
+ * Count the cells set in a row, or set in both of two rows, or set
+ * in the first of two rows and clear in the second.
+ */
+int bitrow_count(const bitword *row, int n);
+int bitrow_count_and(const bitword *a, const bitword *b, int n);
+int bitrow_count_andnot(const bitword *a, const bitword *b, int n);
+
+/*
+ * Return the highest-numbered cell set in the first of two rows and
+ * clear in the second, or -1 if there isn't one.
+ */
+int bitrow_highest_andnot(const bitword *a, const bitword *b, int n);
+
+/*
+ * Return the lowest-numbered cell at position x or beyond which is
+ * set in a row, or -1 if there isn't one. Hence the usual way to
+ * visit every set cell:
+ *
+ *   for (x = bitrow_next(row, n, 0); x >= 0; x = bitrow_next(row, n, x+1))
+ */
+int bitrow_next(const bitword *row, int n, int x);
+
+/*
+ * Three-in-a-row detection. Given a row of cells all of one colour,
+ * bitrow_threes sets 'out' to every cell which would complete a line
+ * of three of them along the row: that is, every x for which x-2 and
+ * x-1, or x-1 and x+1, or x+1 and x+2 are both set.
+ *
+ * bitrow_threes_across does the same thing looking across a stack of
+ * rows rather than along one: it marks the cells of row y which would
+ * complete a line of three with rows y-2, y-1, y+1 and y+2, given as
+ * r[0], r[1], r[2] and r[3]. Any of those may be NULL, meaning a row
+ * beyond the edge of the grid.
+ *
+ * 'out' may not be the same as any of the inputs.
+ */
+void bitrow_threes(bitword *out, const bitword *row, int n);
+void bitrow_threes_across(bitword *out, const bitword *const r[4], int n);
+
+/*
+ * Neighbourhood counts. Given a grid of h rows of w cells, return
+ * the number of cells set in the 3x3 block centred on (x,y), which
+ * is clipped at the edges of the grid.
+ */
+int bitrow_count_around(const bitword *grid, int w, int h, int x, int y);
+
+#endif /* PUZZLES_BITROW_H */
@@ -135,7 +135,7 @@ typedef unsigned int grid_type; /* change me later if we invent > 16 bits of fla
 
 struct solver_state {
     int *dsf, *comptspaces;
-    int *tmpdsf, *tmpcompspaces;
+    int *tmpcompspaces;
     int refcount;
 };
 
@@ -924,100 +924,138 @@ static char *game_state_diff(const game_state *src, const game_state *dest)
 /* This function is optimised; a Quantify showed that lots of grid-generation time
  * (>50%) was spent in here. Hence the IDX() stuff. */
 
-static void map_update_possibles(game_state *state)
+static void map_update_possv(game_state *state, int x)
 {
-    int x, y, s, e, i, np, maxb, w = state->w, idx;
+    int y, s, e, i, np, maxb, w = state->w, idx;
     bool bl;
     struct island *is_s = NULL, *is_f = NULL;
 
-    /* Run down vertical stripes [un]setting possv... */
-    for (x = 0; x < state->w; x++) {
-        idx = x;
-        s = e = -1;
-        bl = false;
-        maxb = state->params.maxb;     /* placate optimiser */
-        /* Unset possible flags until we find an island. */
-        for (y = 0; y < state->h; y++) {
-            is_s = IDX(state, gridi, idx);
-            if (is_s) {
-                maxb = is_s->count;
-                break;
-            }
-
-            IDX(state, possv, idx) = 0;
-            idx += w;
+    /* Run down a vertical stripe [un]setting possv... */
+    idx = x;
+    s = e = -1;
+    bl = false;
+    maxb = state->params.maxb;     /* placate optimiser */
+    /* Unset possible flags until we find an island. */
+    for (y = 0; y < state->h; y++) {
+        is_s = IDX(state, gridi, idx);
+        if (is_s) {
+            maxb = is_s->count;
+            break;
         }
-        for (; y < state->h; y++) {
-            maxb = min(maxb, IDX(state, maxv, idx));
-            is_f = IDX(state, gridi, idx);
-            if (is_f) {
-                assert(is_s);
-                np = min(maxb, is_f->count);
 
-                if (s != -1) {
-                    for (i = s; i <= e; i++) {
-                        INDEX(state, possv, x, i) = bl ? 0 : np;
-                    }
+        IDX(state, possv, idx) = 0;
+        idx += w;
+    }
+    for (; y < state->h; y++) {
+        maxb = min(maxb, IDX(state, maxv, idx));
+        is_f = IDX(state, gridi, idx);
+        if (is_f) {
+            assert(is_s);
+            np = min(maxb, is_f->count);
+
+            if (s != -1) {
+                for (i = s; i <= e; i++) {
+                    INDEX(state, possv, x, i) = bl ? 0 : np;
                 }
-                s = y+1;
-                bl = false;
-                is_s = is_f;
-                maxb = is_s->count;
-            } else {
-                e = y;
-                if (IDX(state,grid,idx) & (G_LINEH|G_NOLINEV)) bl = true;
             }
-            idx += w;
-        }
-        if (s != -1) {
-            for (i = s; i <= e; i++)
-                INDEX(state, possv, x, i) = 0;
+            s = y+1;
+            bl = false;
+            is_s = is_f;
+            maxb = is_s->count;
+        } else {
+            e = y;
+            if (IDX(state,grid,idx) & (G_LINEH|G_NOLINEV)) bl = true;
         }
+        idx += w;
     }
+    if (s != -1) {
+        for (i = s; i <= e; i++)
+            INDEX(state, possv, x, i) = 0;
+    }
+}
 
-    /* ...and now do horizontal stripes [un]setting possh. */
-    /* can we lose this clone'n'hack? */
-    for (y = 0; y < state->h; y++) {
-        idx = y*w;
-        s = e = -1;
-        bl = false;
-        maxb = state->params.maxb;     /* placate optimiser */
-        for (x = 0; x < state->w; x++) {
-            is_s = IDX(state, gridi, idx);
-            if (is_s) {
-                maxb = is_s->count;
-                break;
-            }
+/* ...and the same for a horizontal stripe and possh. */
+/* can we lose this clone'n'hack? */
+static void map_update_possh(game_state *state, int y)
+{
+    int x, s, e, i, np, maxb, w = state->w, idx;
+    bool bl;
+    struct island *is_s = NULL, *is_f = NULL;
 
-            IDX(state, possh, idx) = 0;
-            idx += 1;
+    idx = y*w;
+    s = e = -1;
+    bl = false;
+    maxb = state->params.maxb;     /* placate optimiser */
+    for (x = 0; x < state->w; x++) {
+        is_s = IDX(state, gridi, idx);
+        if (is_s) {
+            maxb = is_s->count;
+            break;
         }
-        for (; x < state->w; x++) {
-            maxb = min(maxb, IDX(state, maxh, idx));
-            is_f = IDX(state, gridi, idx);
-            if (is_f) {
-                assert(is_s);
-                np = min(maxb, is_f->count);
 
-                if (s != -1) {
-                    for (i = s; i <= e; i++) {
-                        INDEX(state, possh, i, y) = bl ? 0 : np;
-                    }
+        IDX(state, possh, idx) = 0;
+        idx += 1;
+    }
+    for (; x < state->w; x++) {
+        maxb = min(maxb, IDX(state, maxh, idx));
+        is_f = IDX(state, gridi, idx);
+        if (is_f) {
+            assert(is_s);
+            np = min(maxb, is_f->count);
+
+            if (s != -1) {
+                for (i = s; i <= e; i++) {
+                    INDEX(state, possh, i, y) = bl ? 0 : np;
                 }
-                s = x+1;
-                bl = false;
-                is_s = is_f;
-                maxb = is_s->count;
-            } else {
-                e = x;
-                if (IDX(state,grid,idx) & (G_LINEV|G_NOLINEH)) bl = true;
             }
-            idx += 1;
-        }
-        if (s != -1) {
-            for (i = s; i <= e; i++)
-                INDEX(state, possh, i, y) = 0;
+            s = x+1;
+            bl = false;
+            is_s = is_f;
+            maxb = is_s->count;
+        } else {
+            e = x;
+            if (IDX(state,grid,idx) & (G_LINEV|G_NOLINEH)) bl = true;
         }
+        idx += 1;
+    }
+    if (s != -1) {
+        for (i = s; i <= e; i++)
+            INDEX(state, possh, i, y) = 0;
+    }
+}
+
+static void map_update_possibles(game_state *state)
+{
+    int x, y;
+
+    for (x = 0; x < state->w; x++)
+        map_update_possv(state, x);
+    for (y = 0; y < state->h; y++)
+        map_update_possh(state, y);
+}
+
+/*
+ * Cheaper version of map_update_possibles, for use when the
+ * possibles were up to date before the only change since, which was
+ * to the bridge(s) in one direction from one island. That can only
+ * affect the stripe along those bridges, and the stripes crossing
+ * them.
+ */
+static void map_update_possibles_join(struct island *is, int direction)
+{
+    int x = is->adj.points[direction].x, y = is->adj.points[direction].y;
+    int dx = is->adj.points[direction].dx, dy = is->adj.points[direction].dy;
+    int o;
+
+    if (dx)
+        map_update_possh(is->state, y);
+    else
+        map_update_possv(is->state, x);
+    for (o = 1; o < is->adj.points[direction].off; o++) {
+        if (dx)
+            map_update_possv(is->state, is->x + dx*o);
+        else
+            map_update_possh(is->state, is->y + dy*o);
     }
 }
 
@@ -1177,8 +1215,20 @@ static void map_group(game_state *state)
     }
 }
 
-static bool map_group_check(game_state *state, int canon, bool warn,
-                            int *nislands_r)
+/* Is a dsf class one of those listed in canons[]? */
+static bool map_group_member(int *dsf, int d, const int *canons, int ncanons)
+{
+    int i, canon = dsf_canonify(dsf, d);
+
+    for (i = 0; i < ncanons; i++)
+        if (canons[i] == canon) return true;
+    return false;
+}
+
+/* Checks the group consisting of all the dsf classes in canons[],
+ * which will normally be just one. */
+static bool map_group_check(game_state *state, const int *canons, int ncanons,
+                            bool warn, int *nislands_r)
 {
     int *dsf = state->solver->dsf, nislands = 0;
     int x, y, i;
@@ -1187,7 +1237,8 @@ static bool map_group_check(game_state *state, int canon, bool warn,
 
     for (i = 0; i < state->n_islands; i++) {
         is = &state->islands[i];
-        if (dsf_canonify(dsf, DINDEX(is->x,is->y)) != canon) continue;
+        if (!map_group_member(dsf, DINDEX(is->x,is->y), canons, ncanons))
+            continue;
 
         GRID(state, is->x, is->y) |= G_SWEEP;
         nislands++;
@@ -1199,7 +1250,7 @@ static bool map_group_check(game_state *state, int canon, bool warn,
          * Mark all squares with this dsf canon as ERR. */
         for (x = 0; x < state->w; x++) {
             for (y = 0; y < state->h; y++) {
-                if (dsf_canonify(dsf, DINDEX(x,y)) == canon) {
+                if (map_group_member(dsf, DINDEX(x,y), canons, ncanons)) {
                     GRID(state,x,y) |= G_WARN;
                 }
             }
@@ -1213,7 +1264,7 @@ static bool map_group_check(game_state *state, int canon, bool warn,
 static bool map_group_full(game_state *state, int *ngroups_r)
 {
     int *dsf = state->solver->dsf, ngroups = 0;
-    int i;
+    int i, canon;
     bool anyfull = false;
     struct island *is;
 
@@ -1224,8 +1275,8 @@ static bool map_group_full(game_state *state, int *ngroups_r)
         if (GRID(state,is->x,is->y) & G_SWEEP) continue;
 
         ngroups++;
-        if (map_group_check(state, dsf_canonify(dsf, DINDEX(is->x,is->y)),
-                            true, NULL))
+        canon = dsf_canonify(dsf, DINDEX(is->x,is->y));
+        if (map_group_check(state, &canon, 1, true, NULL))
             anyfull = true;
     }
 
@@ -1286,6 +1337,20 @@ static void solve_join(struct island *is, int direction, int n, bool is_max)
     }
 }
 
+/* Like solve_join, but for bridges we're only trying out and will
+ * take away again. The dsf is left alone (it can't be un-merged),
+ * so solve_island_subgroup has to be told about the join instead. */
+static void solve_join_tentative(struct island *is, int direction, int n)
+{
+    struct island *is_orth;
+
+    is_orth = INDEX(is->state, gridi,
+                    ISLAND_ORTHX(is, direction),
+                    ISLAND_ORTHY(is, direction));
+    assert(is_orth);
+    island_join(is, is_orth, n, false);
+}
+
 static int solve_fillone(struct island *is)
 {
     int i, nadded = 0;
@@ -1454,10 +1519,13 @@ static bool solve_island_stage2(struct island *is, bool *didsth_r)
     return true;
 }
 
-static bool solve_island_subgroup(struct island *is, int direction)
+/* 'joined' is a bitmap of directions in which we've tentatively
+ * connected 'is' to its neighbours with solve_join_tentative. */
+static bool solve_island_subgroup(struct island *is, int direction,
+                                  unsigned joined)
 {
     struct island *is_join;
-    int nislands, *dsf = is->state->solver->dsf;
+    int nislands, *dsf = is->state->solver->dsf, canons[5], ncanons, i;
     game_state *state = is->state;
 
     debug(("..checking subgroups.\n"));
@@ -1482,9 +1550,18 @@ static bool solve_island_subgroup(struct island *is, int direction)
         }
     }
 
-    /* Check group membership for is->dsf; if it's full return 1. */
-    if (map_group_check(state, dsf_canonify(dsf, DINDEX(is->x,is->y)),
-                        false, &nislands)) {
+    /* Check group membership for is->dsf, plus whatever we've
+     * joined it to; if it's full return 1. */
+    ncanons = 0;
+    canons[ncanons++] = dsf_canonify(dsf, DINDEX(is->x,is->y));
+    for (i = 0; i < is->adj.npoints; i++) {
+        if (!(joined & (1 << i))) continue;
+        is_join = INDEX(state, gridi,
+                        ISLAND_ORTHX(is, i), ISLAND_ORTHY(is, i));
+        assert(is_join);
+        canons[ncanons++] = dsf_canonify(dsf, DINDEX(is_join->x,is_join->y));
+    }
+    if (map_group_check(state, canons, ncanons, false, &nislands)) {
         if (nislands < state->n_islands) {
             /* we have a full subgroup that isn't the whole set.
              * This isn't allowed. */
@@ -1498,30 +1575,79 @@ static bool solve_island_subgroup(struct island *is, int direction)
     return false;
 }
 
-static bool solve_island_impossible(game_state *state)
+static bool solve_island_impossible_one(struct island *is)
 {
-    struct island *is;
+    if (island_impossible(is, false)) {
+        debug(("island at (%d,%d) has become impossible, disallowing.\n",
+               is->x, is->y));
+        return true;
+    }
+    return false;
+}
+
+/* Checks an island and all its neighbours with island_impossible. */
+static bool solve_island_impossible_around(struct island *is)
+{
+    struct island *is_orth;
     int i;
 
-    /* If any islands are impossible, return 1. */
-    for (i = 0; i < state->n_islands; i++) {
-        is = &state->islands[i];
-        if (island_impossible(is, false)) {
-            debug(("island at (%d,%d) has become impossible, disallowing.\n",
-                   is->x, is->y));
+    if (solve_island_impossible_one(is))
+        return true;
+    for (i = 0; i < is->adj.npoints; i++) {
+        if (!is->adj.points[i].off) continue;
+        is_orth = INDEX(is->state, gridi,
+                        ISLAND_ORTHX(is, i), ISLAND_ORTHY(is, i));
+        if (solve_island_impossible_one(is_orth))
             return true;
+    }
+    return false;
+}
+
+/*
+ * Returns true if any island has become impossible as a result of
+ * changing the bridges in one direction from 'is' (and updating the
+ * possibles to match with map_update_possibles_join). We assume no
+ * island was impossible before, so we only need to recheck the
+ * islands that could have been affected: the two ends of the changed
+ * bridges and their neighbours (whose bridge counts have changed,
+ * or those of their neighbours), and the islands at the ends of
+ * every stripe crossing the bridges (whose possibles have changed).
+ */
+static bool solve_island_impossible_join(struct island *is, int direction)
+{
+    game_state *state = is->state;
+    int dx = is->adj.points[direction].dx, dy = is->adj.points[direction].dy;
+    int o, k, x, y;
+
+    if (solve_island_impossible_around(is) ||
+        solve_island_impossible_around(INDEX(state, gridi,
+                                             ISLAND_ORTHX(is, direction),
+                                             ISLAND_ORTHY(is, direction))))
+        return true;
+
+    for (o = 1; o < is->adj.points[direction].off; o++) {
+        for (k = -1; k <= +1; k += 2) {
+            /* walk along the crossing stripe to the island at its end */
+            x = is->x + dx*o + dy*k;
+            y = is->y + dy*o + dx*k;
+            while (INGRID(state, x, y) && !INDEX(state, gridi, x, y)) {
+                x += dy*k;
+                y += dx*k;
+            }
+            if (INGRID(state, x, y) &&
+                solve_island_impossible_one(INDEX(state, gridi, x, y)))
+                return true;
         }
     }
     return false;
 }
 
-/* Bear in mind that this function is really rather inefficient. */
+/* Bear in mind that this function is really rather inefficient.
+ * It expects the possibles to be up to date, and keeps them so. */
 static bool solve_island_stage3(struct island *is, bool *didsth_r)
 {
     int i, n, x, y, missing, spc, curr, maxb;
     bool didsth = false;
-    int wh = is->state->w * is->state->h;
-    struct solver_state *ss = is->state->solver;
 
     assert(didsth_r);
 
@@ -1542,15 +1668,12 @@ static bool solve_island_stage3(struct island *is, bool *didsth_r)
         /* Now we know that this island could have more bridges,
          * to bring the total from curr+1 to curr+spc. */
         maxb = -1;
-        /* We have to squirrel the dsf away and restore it afterwards;
-         * it is additive only, and can't be removed from. */
-        memcpy(ss->tmpdsf, ss->dsf, wh*sizeof(int));
         for (n = curr+1; n <= curr+spc; n++) {
-            solve_join(is, i, n, false);
-            map_update_possibles(is->state);
+            solve_join_tentative(is, i, n);
+            map_update_possibles_join(is, i);
 
-            if (solve_island_subgroup(is, i) ||
-                solve_island_impossible(is->state)) {
+            if (solve_island_subgroup(is, i, 1 << i) ||
+                solve_island_impossible_join(is, i)) {
                 maxb = n-1;
                 debug(("island at (%d,%d) d(%d,%d) new max of %d bridges:\n",
                        is->x, is->y,
@@ -1559,8 +1682,7 @@ static bool solve_island_stage3(struct island *is, bool *didsth_r)
                 break;
             }
         }
-        solve_join(is, i, curr, false); /* put back to before. */
-        memcpy(ss->dsf, ss->tmpdsf, wh*sizeof(int));
+        solve_join_tentative(is, i, curr); /* put back to before. */
 
         if (maxb != -1) {
             /*debug_state(is->state);*/
@@ -1573,7 +1695,7 @@ static bool solve_island_stage3(struct island *is, bool *didsth_r)
             }
             didsth = true;
         }
-        map_update_possibles(is->state);
+        map_update_possibles_join(is, i);
     }
 
     for (i = 0; i < is->adj.npoints; i++) {
@@ -1616,7 +1738,8 @@ static bool solve_island_stage3(struct island *is, bool *didsth_r)
          * a bridge.
          */
         bool got = false;
-        int before[4];
+        int before[4] = {0, 0, 0, 0};
+        unsigned joined = 0;
         int j;
 
         spc = island_adjspace(is, true, missing, i);
@@ -1629,32 +1752,31 @@ static bool solve_island_stage3(struct island *is, bool *didsth_r)
                                   is->adj.points[j].dx ? G_LINEH : G_LINEV);
         if (before[i] != 0) continue;  /* this idea is pointless otherwise */
 
-        memcpy(ss->tmpdsf, ss->dsf, wh*sizeof(int));
-
         for (j = 0; j < is->adj.npoints; j++) {
             spc = island_adjspace(is, true, missing, j);
             if (spc == 0) continue;
             if (j == i) continue;
-            solve_join(is, j, before[j] + spc, false);
+            solve_join_tentative(is, j, before[j] + spc);
+            joined |= 1 << j;
         }
-        map_update_possibles(is->state);
 
-        if (solve_island_subgroup(is, -1))
+        /* (The possibles don't matter to solve_island_subgroup, so
+         * there's no need to update them for this brief change.) */
+        if (solve_island_subgroup(is, -1, joined))
             got = true;
 
         for (j = 0; j < is->adj.npoints; j++)
-            solve_join(is, j, before[j], false);
-        memcpy(ss->dsf, ss->tmpdsf, wh*sizeof(int));
+            if (joined & (1 << j))
+                solve_join_tentative(is, j, before[j]);
 
         if (got) {
             debug(("island at (%d,%d) must connect in direction (%d,%d) to"
                    " avoid full subgroup.\n",
                    is->x, is->y, is->adj.points[i].dx, is->adj.points[i].dy));
             solve_join(is, i, 1, false);
+            map_update_possibles_join(is, i);
             didsth = true;
         }
-
-        map_update_possibles(is->state);
     }
 
     if (didsth) *didsth_r = didsth;
@@ -1764,7 +1886,6 @@ static game_state *new_state(const game_params *params)
 
     ret->solver = snew(struct solver_state);
     ret->solver->dsf = snew_dsf(wh);
-    ret->solver->tmpdsf = snewn(wh, int);
 
     ret->solver->refcount = 1;
 
@@ -1814,7 +1935,6 @@ static void free_game(game_state *state)
 {
     if (--state->solver->refcount <= 0) {
         sfree(state->solver->dsf);
-        sfree(state->solver->tmpdsf);
         sfree(state->solver);
     }
 
@@ -132,10 +132,15 @@ function(guiprogram NAME)
 endfunction()
 
 # A small wrapper around cliprogram, taking advantage of the common
-# formula that puzzle 'foo' often comes with 'foosolver'.
+# formula that puzzle 'foo' often comes with 'foosolver'. Any puzzle
+# with a solver also gets 'foobench', which times it (see
+# solverbench.c).
 function(solver NAME)
   cliprogram(${NAME}solver ${puzzle_src_prefix}${NAME}.c ${ARGN}
     COMPILE_DEFINITIONS STANDALONE_SOLVER)
+  cliprogram(${NAME}bench ${CMAKE_SOURCE_DIR}/solverbench.c
+    ${puzzle_src_prefix}${NAME}.c ${ARGN}
+    COMPILE_DEFINITIONS STANDALONE_SOLVERBENCH)
 endfunction()
 
 function(write_generated_games_header)
@@ -249,6 +249,227 @@ static bool addremcommon(int w, int h, int x, int y, int *own, int val)
     return (count == 2);
 }
 
+/*
+ * Working state for divvy_internal.
+ *
+ * own[] gives the omino owning each square, or -1 if it's unclaimed.
+ * Each omino's squares are also listed in squares[], with omino i
+ * using the k+1 slots starting at squares[i*stride] (an omino can
+ * briefly have k+1 squares, while we pass squares along a chain of
+ * ominoes), and where[] gives each square's index in its omino's
+ * list.
+ *
+ * removable[] and addable[] cache, for the current ownership, the
+ * results of addremcommon for each square: whether it can be removed
+ * from its omino, and (for each of its four neighbours) which omino
+ * it could be added to. Since addremcommon only looks at a square's
+ * 8-neighbourhood, these only need recomputing around squares that
+ * change hands.
+ */
+struct divvy_ctx {
+    int w, h, n, stride;
+    int *own, *sizes, *squares, *where;
+    int *addable;
+    bool *removable;
+};
+
+/*
+ * Move square yx into omino val (or out of all ominoes, if val < 0),
+ * keeping the omino square lists and sizes up to date.
+ */
+static void divvy_set_owner(struct divvy_ctx *ctx, int yx, int val)
+{
+    int old = ctx->own[yx];
+
+    if (old >= 0) {
+        int last = ctx->squares[old*ctx->stride + --ctx->sizes[old]];
+        ctx->squares[old*ctx->stride + ctx->where[yx]] = last;
+        ctx->where[last] = ctx->where[yx];
+    }
+    ctx->own[yx] = val;
+    if (val >= 0) {
+        assert(ctx->sizes[val] < ctx->stride);
+        ctx->where[yx] = ctx->sizes[val];
+        ctx->squares[val*ctx->stride + ctx->sizes[val]++] = yx;
+    }
+}
+
+/*
+ * Figure out which ominoes square yx can safely be added to or
+ * removed from. We don't take account of other ominoes in this
+ * process, so we will often end up knowing that a square can be
+ * poached from one omino by another.
+ *
+ * For each square, there may be up to four ominoes to which it can
+ * be added (those to which it is 4-adjacent).
+ */
+static void divvy_update_square(struct divvy_ctx *ctx, int yx)
+{
+    int w = ctx->w, h = ctx->h;
+    int x = yx % w, y = yx / w;
+    int curr = ctx->own[yx];
+    int dir;
+
+    if (curr < 0) {
+        ctx->removable[yx] = false; /* can't remove if not owned! */
+    } else if (ctx->sizes[curr] == 1) {
+        ctx->removable[yx] = true; /* can always remove a singleton */
+    } else {
+        /*
+         * See if this square can be removed from its omino
+         * without disconnecting it.
+         */
+        ctx->removable[yx] = addremcommon(w, h, x, y, ctx->own, curr);
+    }
+
+    for (dir = 0; dir < 4; dir++) {
+        int dx = (dir == 0 ? -1 : dir == 1 ? +1 : 0);
+        int dy = (dir == 2 ? -1 : dir == 3 ? +1 : 0);
+        int sx = x + dx, sy = y + dy;
+        int syx = sy*w+sx;
+
+        ctx->addable[yx*4+dir] = -1;
+
+        if (sx < 0 || sx >= w || sy < 0 || sy >= h)
+            continue;                  /* no omino here! */
+        if (ctx->own[syx] < 0)
+            continue;                  /* also no omino here */
+        if (ctx->own[syx] == curr)
+            continue;                  /* we already got one */
+        if (!addremcommon(w, h, x, y, ctx->own, ctx->own[syx]))
+            continue;            /* would non-simply connect the omino */
+
+        ctx->addable[yx*4+dir] = ctx->own[syx];
+    }
+}
+
+/*
+ * Update the cached flags for every square whose 8-neighbourhood
+ * contains square yx.
+ */
+static void divvy_update_around(struct divvy_ctx *ctx, int yx)
+{
+    int w = ctx->w, h = ctx->h;
+    int x = yx % w, y = yx / w;
+    int x0 = max(x-1, 0), x1 = min(x+1, w-1);
+    int y0 = max(y-1, 0), y1 = min(y+1, h-1);
+
+    for (y = y0; y <= y1; y++)
+        for (x = x0; x <= x1; x++)
+            divvy_update_square(ctx, y*w+x);
+}
+
+static int divvy_rankcmp(const void *av, const void *bv, void *vrank)
+{
+    const int *rank = (const int *)vrank;
+    int a = rank[*(const int *)av], b = rank[*(const int *)bv];
+
+    return a < b ? -1 : a > b ? +1 : 0;
+}
+
+/*
+ * List the squares 4-adjacent to omino j, in the random order given
+ * by rank[]. These are the only squares whose addable[] entries can
+ * mention j, so searching them is equivalent to searching the whole
+ * grid in that order for a square j can take.
+ */
+static int divvy_frontier(struct divvy_ctx *ctx, int j, int *rank,
+                          int *stamp, int stampval, int *out)
+{
+    int w = ctx->w, h = ctx->h;
+    int i, dir, nout = 0;
+
+    for (i = 0; i < ctx->sizes[j]; i++) {
+        int yx = ctx->squares[j*ctx->stride + i];
+        int x = yx % w, y = yx / w;
+
+        for (dir = 0; dir < 4; dir++) {
+            int sx = x + (dir == 0 ? -1 : dir == 1 ? +1 : 0);
+            int sy = y + (dir == 2 ? -1 : dir == 3 ? +1 : 0);
+            int syx = sy*w+sx;
+
+            if (sx < 0 || sx >= w || sy < 0 || sy >= h)
+                continue;
+            if (stamp[syx] == stampval)
+                continue;
+            stamp[syx] = stampval;
+            out[nout++] = syx;
+        }
+    }
+
+    arraysort(out, nout, divvy_rankcmp, rank);
+    return nout;
+}
+
+/*
+ * Test whether square yx can be added to omino j, given that it was
+ * addable at the last update and that j may since have temporarily
+ * lost a square. To check the latter, it's only necessary to re-check
+ * addremcommon.
+ */
+static bool divvy_can_add(struct divvy_ctx *ctx, int yx, int j)
+{
+    int dir;
+
+    for (dir = 0; dir < 4; dir++)
+        if (ctx->addable[yx*4+dir] == j)
+            return addremcommon(ctx->w, ctx->h, yx % ctx->w, yx / ctx->w,
+                                ctx->own, j);
+    return false;
+}
+
+/*
+ * Local repair, used when omino j can't be expanded at all: break up
+ * j and every omino adjacent to it into a single random square each,
+ * freeing the rest of their squares to be handed out again. Ominoes
+ * further away keep their shape, so this is far cheaper than
+ * starting the whole division again.
+ */
+static void divvy_repair(struct divvy_ctx *ctx, int j, random_state *rs,
+                         int *tmp)
+{
+    int w = ctx->w, h = ctx->h, k = ctx->stride;
+    int i, yx, dir, keep;
+
+    for (i = 0; i < ctx->n; i++)
+        tmp[i] = 0;
+
+    tmp[j] = 1;
+    for (i = 0; i < ctx->sizes[j]; i++) {
+        yx = ctx->squares[j*k + i];
+        for (dir = 0; dir < 4; dir++) {
+            int sx = yx % w + (dir == 0 ? -1 : dir == 1 ? +1 : 0);
+            int sy = yx / w + (dir == 2 ? -1 : dir == 3 ? +1 : 0);
+            if (sx >= 0 && sx < w && sy >= 0 && sy < h &&
+                ctx->own[sy*w+sx] >= 0)
+                tmp[ctx->own[sy*w+sx]] = 1;
+        }
+    }
+
+    for (i = 0; i < ctx->n; i++) {
+        if (!tmp[i])
+            continue;
+        keep = ctx->squares[i*k + random_upto(rs, ctx->sizes[i])];
+        while (ctx->sizes[i] > 1) {
+            yx = ctx->squares[i*k];
+            if (yx == keep)
+                yx = ctx->squares[i*k + 1];
+            divvy_set_owner(ctx, yx, -1);
+        }
+    }
+
+    /*
+     * This can change a lot of squares at once, so just recompute
+     * everything.
+     */
+    for (yx = 0; yx < w*h; yx++)
+        divvy_update_square(ctx, yx);
+}
+
+#ifdef TESTMODE
+static int fail_counter = 0, repair_counter = 0;
+#endif
+
 /*
  * w and h are the dimensions of the rectangle.
  * 
@@ -260,23 +481,42 @@ static bool addremcommon(int w, int h, int x, int y, int *own, int val)
  * In both of the above suggested use cases, the user would
  * probably want w==h==k, but that isn't a requirement.
  */
-static int *divvy_internal(int w, int h, int k, random_state *rs)
+static int *divvy_internal(int w, int h, int k, random_state *rs,
+                           bool repair)
 {
-    int *order, *queue, *tmp, *own, *sizes, *addable, *retdsf;
+    struct divvy_ctx ctx[1];
+    int *order, *rank, *queue, *tmp, *own, *sizes, *addable, *retdsf;
+    int *frontier, *stamp, *changed;
     bool *removable;
     int wh = w*h;
-    int i, j, n, x, y, qhead, qtail;
+    int i, j, n, x, y, qhead, qtail, nfrontier, nchanged, stampval;
+    int repairs;
 
     n = wh / k;
     assert(wh == k*n);
 
     order = snewn(wh, int);
+    rank = snewn(wh, int);
     tmp = snewn(wh, int);
     own = snewn(wh, int);
     sizes = snewn(n, int);
     queue = snewn(n, int);
     addable = snewn(wh*4, int);
     removable = snewn(wh, bool);
+    frontier = snewn(4*k, int);
+    stamp = snewn(wh, int);
+    changed = snewn(n+1, int);
+
+    ctx->w = w;
+    ctx->h = h;
+    ctx->n = n;
+    ctx->stride = k+1;
+    ctx->own = own;
+    ctx->sizes = sizes;
+    ctx->squares = snewn(n*(k+1), int);
+    ctx->where = snewn(wh, int);
+    ctx->addable = addable;
+    ctx->removable = removable;
 
     /*
      * Permute the grid squares into a random order, which will be
@@ -287,6 +527,11 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
     for (i = 0; i < wh; i++)
 	order[i] = i;
     shuffle(order, wh, sizeof(*order), rs);
+    for (i = 0; i < wh; i++) {
+	rank[order[i]] = i;
+        stamp[i] = 0;
+    }
+    stampval = 0;
 
     /*
      * Begin by choosing a starting square at random for each
@@ -295,10 +540,12 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
     for (i = 0; i < wh; i++) {
 	own[i] = -1;
     }
-    for (i = 0; i < n; i++) {
-	own[order[i]] = i;
-	sizes[i] = 1;
-    }
+    for (i = 0; i < n; i++)
+	sizes[i] = 0;
+    for (i = 0; i < n; i++)
+        divvy_set_owner(ctx, order[i], i);
+    for (i = 0; i < wh; i++)
+        divvy_update_square(ctx, i);
 
     /*
      * Now repeatedly pick a random omino which isn't already at
@@ -309,7 +556,14 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
      * square. Hence every successful iteration around this loop
      * causes the number of unclaimed squares to drop by one, and
      * so the process is bounded in duration.
+     *
+     * If we find an omino we can't expand at all, we give up and
+     * let our caller start again from scratch. Or, if asked to, we
+     * first repair the area around it (see divvy_repair). That puts
+     * some squares back into play, so we only allow so many repairs
+     * before giving up after all.
      */
+    repairs = 0;
     while (1) {
 
 #ifdef DIVVY_DIAGNOSTICS
@@ -324,57 +578,6 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
 	}
 #endif
 
-	/*
-	 * Go over the grid and figure out which squares can
-	 * safely be added to, or removed from, each omino. We
-	 * don't take account of other ominoes in this process, so
-	 * we will often end up knowing that a square can be
-	 * poached from one omino by another.
-	 * 
-	 * For each square, there may be up to four ominoes to
-	 * which it can be added (those to which it is
-	 * 4-adjacent).
-	 */
-	for (y = 0; y < h; y++) {
-	    for (x = 0; x < w; x++) {
-		int yx = y*w+x;
-		int curr = own[yx];
-		int dir;
-
-		if (curr < 0) {
-		    removable[yx] = false; /* can't remove if not owned! */
-		} else if (sizes[curr] == 1) {
-		    removable[yx] = true; /* can always remove a singleton */
-		} else {
-		    /*
-		     * See if this square can be removed from its
-		     * omino without disconnecting it.
-		     */
-		    removable[yx] = addremcommon(w, h, x, y, own, curr);
-		}
-
-		for (dir = 0; dir < 4; dir++) {
-		    int dx = (dir == 0 ? -1 : dir == 1 ? +1 : 0);
-		    int dy = (dir == 2 ? -1 : dir == 3 ? +1 : 0);
-		    int sx = x + dx, sy = y + dy;
-		    int syx = sy*w+sx;
-
-		    addable[yx*4+dir] = -1;
-
-		    if (sx < 0 || sx >= w || sy < 0 || sy >= h)
-			continue;      /* no omino here! */
-		    if (own[syx] < 0)
-			continue;      /* also no omino here */
-		    if (own[syx] == own[yx])
-			continue;      /* we already got one */
-		    if (!addremcommon(w, h, x, y, own, own[syx]))
-			continue;      /* would non-simply connect the omino */
-		    
-		    addable[yx*4+dir] = own[syx];
-		}
-	    }
-	}
-
 	for (i = j = 0; i < n; i++)
 	    if (sizes[i] < k)
 		tmp[j++] = i;
@@ -426,54 +629,41 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
 		own[tmpsq] = -3;
 	    }
 
+            /*
+             * The only squares we can give to j are those next to
+             * it, so we search those in the order they appear in
+             * order[].
+             */
+            nfrontier = divvy_frontier(ctx, j, rank, stamp, ++stampval,
+                                       frontier);
+
 	    /*
 	     * OK. Now begin by seeing if we can find any
 	     * unclaimed square into which we can expand omino j.
 	     * If we find one, the entire bfs terminates.
+	     *
+	     * Special case: if our current omino was size 1 and
+	     * then had a square stolen from it, it's now size
+	     * zero, which means it's valid to `expand' it into
+	     * _any_ unclaimed square, so we have to search the
+	     * whole grid.
 	     */
-	    for (i = 0; i < wh; i++) {
-		int dir;
-
-		if (own[order[i]] != -1)
-		    continue;	       /* this square is claimed */
-
-		/*
-		 * Special case: if our current omino was size 1
-		 * and then had a square stolen from it, it's now
-		 * size zero, which means it's valid to `expand'
-		 * it into _any_ unclaimed square.
-		 */
-		if (sizes[j] == 1 && tmpsq >= 0)
-		    break;	       /* got one */
-
-		/*
-		 * Failing that, we must do the full test for
-		 * addability.
-		 */
-		for (dir = 0; dir < 4; dir++)
-		    if (addable[order[i]*4+dir] == j) {
-			/*
-			 * We know this square is addable to this
-			 * omino with the grid in the state it had
-			 * at the top of the loop. However, we
-			 * must now check that it's _still_
-			 * addable to this omino when the omino is
-			 * missing a square. To do this it's only
-			 * necessary to re-check addremcommon.
-			 */
-			if (!addremcommon(w, h, order[i]%w, order[i]/w,
-					  own, j))
-			    continue;
-			break;
-		    }
-		if (dir == 4)
-		    continue;	       /* we can't add this square to j */
-
-		break;		       /* got one! */
-	    }
-	    if (i < wh) {
-		i = order[i];
-
+            i = -1;
+	    if (sizes[j] == 1 && tmpsq >= 0) {
+                for (x = 0; x < wh; x++)
+                    if (own[order[x]] == -1) {
+                        i = order[x];
+                        break;
+                    }
+            } else {
+                for (x = 0; x < nfrontier; x++)
+                    if (own[frontier[x]] == -1 &&
+                        divvy_can_add(ctx, frontier[x], j)) {
+                        i = frontier[x];
+                        break;
+                    }
+            }
+	    if (i >= 0) {
 		/*
 		 * Restore the temporarily removed square _before_
 		 * we start shifting ownerships about.
@@ -490,8 +680,10 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
 #ifdef DIVVY_DIAGNOSTICS
 		printf("(%d,%d)", i%w, i/w);
 #endif
+                nchanged = 0;
 		while (1) {
-		    own[i] = j;
+		    divvy_set_owner(ctx, i, j);
+                    changed[nchanged++] = i;
 #ifdef DIVVY_DIAGNOSTICS
 		    printf(" -> %d", j);
 #endif
@@ -507,10 +699,12 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
 		printf("\n");
 #endif
 
-		/*
-		 * Increment the size of the starting omino.
-		 */
-		sizes[j]++;
+                /*
+                 * Now bring the cached addability information up
+                 * to date around the squares that changed hands.
+                 */
+                for (i = 0; i < nchanged; i++)
+                    divvy_update_around(ctx, changed[i]);
 
 		/*
 		 * Terminate the bfs loop.
@@ -524,42 +718,27 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
 	     * to investigate expanding it into squares which are
 	     * claimed by ominoes the bfs has not yet visited.
 	     */
-	    for (i = 0; i < wh; i++) {
-		int dir, nj;
+	    for (x = 0; x < nfrontier; x++) {
+		int nj;
 
-		nj = own[order[i]];
+                i = frontier[x];
+		nj = own[i];
 		if (nj < 0 || tmp[2*nj] != -1)
 		    continue;	       /* unclaimed, or owned by wrong omino */
-		if (!removable[order[i]])
+		if (!removable[i])
 		    continue;	       /* its omino won't let it go */
-
-		for (dir = 0; dir < 4; dir++)
-		    if (addable[order[i]*4+dir] == j) {
-			/*
-			 * As above, re-check addremcommon.
-			 */
-			if (!addremcommon(w, h, order[i]%w, order[i]/w,
-					  own, j))
-			    continue;
-
-			/*
-			 * We have found a square we can use to
-			 * expand omino j, at the expense of the
-			 * as-yet unvisited omino nj. So add this
-			 * to the bfs queue.
-			 */
-			assert(qtail < n);
-			queue[qtail++] = nj;
-			tmp[2*nj] = j;
-			tmp[2*nj+1] = order[i];
-
-			/*
-			 * Now terminate the loop over dir, to
-			 * ensure we don't accidentally add the
-			 * same omino twice to the queue.
-			 */
-			break;
-		    }
+                if (!divvy_can_add(ctx, i, j))
+                    continue;
+
+                /*
+                 * We have found a square we can use to expand
+                 * omino j, at the expense of the as-yet unvisited
+                 * omino nj. So add this to the bfs queue.
+                 */
+                assert(qtail < n);
+                queue[qtail++] = nj;
+                tmp[2*nj] = j;
+                tmp[2*nj+1] = i;
 	    }
 
 	    /*
@@ -577,16 +756,21 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
 	if (qhead == qtail) {
 	    /*
 	     * We have finished the bfs and not found any way to
-	     * expand omino j. Panic, and return failure.
-	     * 
-	     * FIXME: or should we loop over all ominoes before we
-	     * give up?
+	     * expand omino j. Repair the area around it, unless
+	     * we're not repairing or have already done that too
+	     * often, in which case return failure.
 	     */
 #ifdef DIVVY_DIAGNOSTICS
 	    printf("FAIL!\n");
 #endif
-	    retdsf = NULL;
-	    goto cleanup;
+            if (!repair || ++repairs > n) {
+                retdsf = NULL;
+                goto cleanup;
+            }
+            divvy_repair(ctx, queue[0], rs, tmp);
+#ifdef TESTMODE
+            repair_counter++;
+#endif
 	}
     }
 
@@ -645,6 +829,12 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
     sfree(queue);
     sfree(addable);
     sfree(removable);
+    sfree(frontier);
+    sfree(stamp);
+    sfree(changed);
+    sfree(rank);
+    sfree(ctx->squares);
+    sfree(ctx->where);
 
     /*
      * And we're done.
@@ -652,16 +842,13 @@ static int *divvy_internal(int w, int h, int k, random_state *rs)
     return retdsf;
 }
 
-#ifdef TESTMODE
-static int fail_counter = 0;
-#endif
-
-int *divvy_rectangle(int w, int h, int k, random_state *rs)
+static int *divvy_rectangle_internal(int w, int h, int k, random_state *rs,
+                                     bool repair)
 {
     int *ret;
 
     do {
-	ret = divvy_internal(w, h, k, rs);
+	ret = divvy_internal(w, h, k, rs, repair);
 
 #ifdef TESTMODE
 	if (!ret)
@@ -673,14 +860,33 @@ int *divvy_rectangle(int w, int h, int k, random_state *rs)
     return ret;
 }
 
+int *divvy_rectangle(int w, int h, int k, random_state *rs)
+{
+    return divvy_rectangle_internal(w, h, k, rs, false);
+}
+
+int *divvy_rectangle_repairing(int w, int h, int k, random_state *rs)
+{
+    return divvy_rectangle_internal(w, h, k, rs, true);
+}
+
 #ifdef TESTMODE
 
+#include <string.h>
+#include <time.h>
+
 /*
- * gcc -g -O0 -DTESTMODE -I.. -o divvy divvy.c ../random.c ../malloc.c ../dsf.c ../misc.c ../nullfe.c
+ * gcc -g -O0 -DTESTMODE -I.. -o divvy divvy.c ../random.c ../malloc.c ../dsf.c ../misc.c ../sort.c ../nullfe.c
  * 
  * or to debug
  * 
- * gcc -g -O0 -DDIVVY_DIAGNOSTICS -DTESTMODE -I.. -o divvy divvy.c ../random.c ../malloc.c ../dsf.c ../misc.c ../nullfe.c
+ * gcc -g -O0 -DDIVVY_DIAGNOSTICS -DTESTMODE -I.. -o divvy divvy.c ../random.c ../malloc.c ../dsf.c ../misc.c ../sort.c ../nullfe.c
+ *
+ * With -b, we print no grids, but instead time how long the divisions
+ * took. With -r, we use divvy_rectangle_repairing instead of
+ * divvy_rectangle:
+ *
+ *   divvy -b -r 36 36 36 10
  */
 
 int main(int argc, char **argv)
@@ -688,10 +894,21 @@ int main(int argc, char **argv)
     int *dsf;
     int i;
     int w = 9, h = 4, k = 6, tries = 100;
+    bool bench = false, repair = false;
+    clock_t start;
     random_state *rs;
 
     rs = random_new("123456", 6);
 
+    while (argc > 1 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-b"))
+            bench = true;
+        else if (!strcmp(argv[1], "-r"))
+            repair = true;
+        argc--;
+        argv++;
+    }
+
     if (argc > 1)
 	w = atoi(argv[1]);
     if (argc > 2)
@@ -701,12 +918,19 @@ int main(int argc, char **argv)
     if (argc > 4)
 	tries = atoi(argv[4]);
 
+    start = clock();
     for (i = 0; i < tries; i++) {
 	int x, y;
 
-	dsf = divvy_rectangle(w, h, k, rs);
+	dsf = (repair ? divvy_rectangle_repairing : divvy_rectangle)
+            (w, h, k, rs);
 	assert(dsf);
 
+        if (bench) {
+            sfree(dsf);
+            continue;
+        }
+
 	for (y = 0; y <= 2*h; y++) {
 	    for (x = 0; x <= 2*w; x++) {
 		int miny = y/2 - 1 /*, maxy = y/2 */;
@@ -774,7 +998,13 @@ int main(int argc, char **argv)
 	sfree(dsf);
     }
 
+    if (bench) {
+        double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+        printf("%d divisions of %dx%d into %d-ominoes in %.3fs"
+               " (%.3fms each)\n", tries, w, h, k, secs, 1000 * secs / tries);
+    }
     printf("%d retries needed for %d successes\n", fail_counter, tries);
+    printf("%d local repairs made\n", repair_counter);
 
     return 0;
 }
@@ -331,6 +331,33 @@ struct solver_square {
 #endif
 };
 
+/*
+ * Most deduction rules look at one domino, square, placement or
+ * number at a time, and can only find something new there once a
+ * placement near it has been ruled out. So for each of those we keep
+ * flags saying which rules need to look at it again; rule_out_placement
+ * sets them, and run_solver skips anything whose flag is clear.
+ */
+enum {
+    /* Flags in sc->domino_dirty */
+    DIRTY_DOMINO_SINGLE_PLACEMENT = 1,
+    DIRTY_DOMINO_MUST_OVERLAP = 2,
+
+    /* Flags in sc->square_dirty */
+    DIRTY_SQUARE_SINGLE_PLACEMENT = 1,
+    DIRTY_SQUARE_SINGLE_DOMINO = 2,
+
+    /* Flags in sc->placement_dirty */
+    DIRTY_LOCAL_DUPLICATE = 1,
+    DIRTY_LOCAL_DUPLICATE_2 = 2,
+
+    /* Flags in sc->number_dirty */
+    DIRTY_SET = 1,
+    DIRTY_SET_DOUBLES = 2,
+
+    DIRTY_ALL = 3
+};
+
 struct solver_scratch {
     int n, dc, pc, w, h, wh;
     int max_diff_used;
@@ -342,6 +369,9 @@ struct solver_scratch {
     struct findloopstate *fls;
     bool squares_by_number_initialised;
     int *wh_scratch, *pc_scratch, *pc_scratch2, *dc_scratch;
+    unsigned long *set_dominoes, *set_adjacent;
+    unsigned char *domino_dirty, *square_dirty, *placement_dirty;
+    unsigned char *number_dirty;
 };
 
 static struct solver_scratch *solver_make_scratch(int n)
@@ -363,6 +393,10 @@ static struct solver_scratch *solver_make_scratch(int n)
     sc->squares = snewn(wh, struct solver_square);
     sc->domino_placement_lists = snewn(pc, struct solver_placement *);
     sc->fls = findloop_new_state(wh);
+    sc->domino_dirty = snewn(dc, unsigned char);
+    sc->square_dirty = snewn(wh, unsigned char);
+    sc->placement_dirty = snewn(pc, unsigned char);
+    sc->number_dirty = snewn(n+1, unsigned char);
 
     for (di = hi = 0; hi <= n; hi++) {
         for (lo = 0; lo <= hi; lo++) {
@@ -473,6 +507,7 @@ static struct solver_scratch *solver_make_scratch(int n)
     sc->wh_scratch = NULL;
     sc->pc_scratch = sc->pc_scratch2 = NULL;
     sc->dc_scratch = NULL;
+    sc->set_dominoes = sc->set_adjacent = NULL;
 
     return sc;
 }
@@ -500,6 +535,12 @@ static void solver_free_scratch(struct solver_scratch *sc)
     sfree(sc->pc_scratch);
     sfree(sc->pc_scratch2);
     sfree(sc->dc_scratch);
+    sfree(sc->set_dominoes);
+    sfree(sc->set_adjacent);
+    sfree(sc->domino_dirty);
+    sfree(sc->square_dirty);
+    sfree(sc->placement_dirty);
+    sfree(sc->number_dirty);
     sfree(sc);
 }
 
@@ -545,6 +586,11 @@ static void solver_setup_grid(struct solver_scratch *sc, const int *numbers)
         }
     }
 
+    memset(sc->domino_dirty, DIRTY_ALL, sc->dc);
+    memset(sc->square_dirty, DIRTY_ALL, sc->wh);
+    memset(sc->placement_dirty, DIRTY_ALL, sc->pc);
+    memset(sc->number_dirty, DIRTY_ALL, sc->n + 1);
+
     sc->max_diff_used = DIFF_TRIVIAL;
     sc->squares_by_number_initialised = false;
 }
@@ -580,6 +626,24 @@ static void rule_out_placement(
 
     p->active = false;
 
+    /*
+     * The dominoes and squares whose placement lists this changes,
+     * and the numbers in those squares, need looking at again. So do
+     * all the placements for which a square two away from them (via
+     * an overlapping placement) has changed, which the local
+     * duplicate rules depend on.
+     */
+    sc->domino_dirty[d->index] = DIRTY_ALL;
+    for (si = 0; si < 2; si++) {
+        sc->square_dirty[p->squares[si]->index] = DIRTY_ALL;
+        sc->number_dirty[p->squares[si]->number] = DIRTY_ALL;
+    }
+    for (i = -1; i < p->noverlaps; i++) {
+        struct solver_placement *q = i < 0 ? p : p->overlaps[i];
+        for (j = 0; j < q->noverlaps; j++)
+            sc->placement_dirty[q->overlaps[j]->index] = DIRTY_ALL;
+    }
+
     i = p->dpi;
     assert(d->placements[i] == p);
     if (--d->nplacements != i) {
@@ -599,6 +663,17 @@ static void rule_out_placement(
     }
 }
 
+/*
+ * Test and clear a flag in one of the dirty arrays.
+ */
+static bool check_dirty(unsigned char *flags, unsigned char flag)
+{
+    if (!(*flags & flag))
+        return false;
+    *flags &= ~flag;
+    return true;
+}
+
 /*
  * If a domino has only one placement remaining, rule out all other
  * placements that overlap it.
@@ -1013,6 +1088,15 @@ static bool deduce_parity(struct solver_scratch *sc)
  * is small enough to let us rule out placements of those dominoes
  * elsewhere.
  */
+static int bitcount16(unsigned long word)
+{
+    word = ((word & 0xAAAA) >> 1) + (word & 0x5555);
+    word = ((word & 0xCCCC) >> 2) + (word & 0x3333);
+    word = ((word & 0xF0F0) >> 4) + (word & 0x0F0F);
+    word = ((word & 0xFF00) >> 8) + (word & 0x00FF);
+    return word;
+}
+
 static bool deduce_set(struct solver_scratch *sc, bool doubles)
 {
     struct solver_square **sqs, **sqp, **sqe;
@@ -1025,6 +1109,15 @@ static bool deduce_set(struct solver_scratch *sc, bool doubles)
         sc->squares_by_number = snewn(sc->wh, struct solver_square *);
     if (!sc->wh_scratch)
         sc->wh_scratch = snewn(sc->wh, int);
+    if (!sc->set_dominoes && sc->n + 2 <= lenof(domino_sets)) {
+        /*
+         * Unions of domino_sets[] and adjacent[] over each subset of
+         * the squares, which we fill in as we go through the subsets
+         * in order, each from a smaller one.
+         */
+        sc->set_dominoes = snewn(1UL << (sc->n + 2), unsigned long);
+        sc->set_adjacent = snewn(1UL << (sc->n + 2), unsigned long);
+    }
 
     if (!sc->squares_by_number_initialised) {
         /*
@@ -1036,6 +1129,7 @@ static bool deduce_set(struct solver_scratch *sc, bool doubles)
             sc->squares_by_number[i] = &sc->squares[i];
         qsort(sc->squares_by_number, sc->wh, sizeof(*sc->squares_by_number),
               squares_by_number_cmpfn);
+        sc->squares_by_number_initialised = true;
     }
 
     sqp = sc->squares_by_number;
@@ -1053,9 +1147,15 @@ static bool deduce_set(struct solver_scratch *sc, bool doubles)
 
         /*
          * Now sqs[0], ..., sqs[nsq-1] are the squares containing 'num'.
+         *
+         * If none of them has lost a placement since we last looked
+         * at this number, we won't find anything new.
          */
+        if (!check_dirty(&sc->number_dirty[num],
+                         doubles ? DIRTY_SET_DOUBLES : DIRTY_SET))
+            continue;
 
-        if (nsq > lenof(domino_sets)) {
+        if (nsq > lenof(domino_sets) || nsq > sc->n + 2) {
             /*
              * Abort this analysis if we're trying to enumerate all
              * the subsets of a too-large base set.
@@ -1068,7 +1168,8 @@ static bool deduce_set(struct solver_scratch *sc, bool doubles)
              * weird test input makes its way to this function, or the
              * puzzle sizes are expanded later, it's easy enough to
              * just rule out doing this analysis for overlarge sets of
-             * numbers.
+             * numbers. (The second condition is another such check,
+             * protecting the size of set_dominoes.)
              */
             continue;
         }
@@ -1122,11 +1223,12 @@ static bool deduce_set(struct solver_scratch *sc, bool doubles)
         }
 
         squares_done = 0;
+        sc->set_dominoes[0] = sc->set_adjacent[0] = 0;
 
         for (squares = 0; squares < (1UL << nsq); squares++) {
-            unsigned long dominoes = 0;
+            unsigned long dominoes;
             int bitpos, nsquares, ndominoes;
-            bool got_adj_squares = false;
+            bool got_adj_squares;
             bool reported = false;
             bool rule_out_nondoubles;
             int min_nused_for_double;
@@ -1148,27 +1250,26 @@ static bool deduce_set(struct solver_scratch *sc, bool doubles)
              * {X,Y,Z}!' You'd prefer to give 'now C has to be Z' as a
              * separate deduction later, more simply phrased.
              */
+            if (squares) {
+                /* Make the set of dominoes that these squares can
+                 * inhabit, from the set for all but the lowest square. */
+                unsigned long rest = squares & (squares - 1);
+                for (bitpos = 0; !(1 & (squares >> bitpos)); bitpos++);
+                sc->set_dominoes[squares] =
+                    sc->set_dominoes[rest] | domino_sets[bitpos];
+                sc->set_adjacent[squares] =
+                    sc->set_adjacent[rest] | adjacent[bitpos];
+            }
+
             if (squares & squares_done)
                 continue;
 
-            nsquares = 0;
-
-            /* Make the set of dominoes that these squares can inhabit. */
-            for (bitpos = 0; bitpos < nsq; bitpos++) {
-                if (!(1 & (squares >> bitpos)))
-                    continue;          /* this bit isn't set in the mask */
-
-                if (adjacent[bitpos] & squares)
-                    got_adj_squares = true;
-
-                dominoes |= domino_sets[bitpos];
-                nsquares++;
-            }
+            dominoes = sc->set_dominoes[squares];
+            got_adj_squares = (sc->set_adjacent[squares] & squares) != 0;
 
             /* Count them. */
-            ndominoes = 0;
-            for (bitpos = 0; bitpos < nsq; bitpos++)
-                ndominoes += 1 & (dominoes >> bitpos);
+            nsquares = bitcount16(squares);
+            ndominoes = bitcount16(dominoes);
 
             /*
              * Do the two sets have the right relative size?
@@ -1703,17 +1804,26 @@ static int run_solver(struct solver_scratch *sc, int max_diff_allowed)
     do {
         done_something = false;
 
+        SOLVER_TIER("trivial: single placements");
         for (di = 0; di < sc->dc; di++)
-            if (deduce_domino_single_placement(sc, di))
+            if (check_dirty(&sc->domino_dirty[di],
+                            DIRTY_DOMINO_SINGLE_PLACEMENT) &&
+                deduce_domino_single_placement(sc, di)) {
+                SOLVER_RULE("domino has one placement");
                 done_something = true;
+            }
         if (done_something) {
             sc->max_diff_used = max(sc->max_diff_used, DIFF_TRIVIAL);
             continue;
         }
 
         for (si = 0; si < sc->wh; si++)
-            if (deduce_square_single_placement(sc, si))
+            if (check_dirty(&sc->square_dirty[si],
+                            DIRTY_SQUARE_SINGLE_PLACEMENT) &&
+                deduce_square_single_placement(sc, si)) {
+                SOLVER_RULE("square has one placement");
                 done_something = true;
+            }
         if (done_something) {
             sc->max_diff_used = max(sc->max_diff_used, DIFF_TRIVIAL);
             continue;
@@ -1722,40 +1832,59 @@ static int run_solver(struct solver_scratch *sc, int max_diff_allowed)
         if (max_diff_allowed <= DIFF_TRIVIAL)
             continue;
 
+        SOLVER_TIER("basic: local deductions");
         for (si = 0; si < sc->wh; si++)
-            if (deduce_square_single_domino(sc, si))
+            if (check_dirty(&sc->square_dirty[si],
+                            DIRTY_SQUARE_SINGLE_DOMINO) &&
+                deduce_square_single_domino(sc, si)) {
+                SOLVER_RULE("square has one domino");
                 done_something = true;
+            }
         if (done_something) {
             sc->max_diff_used = max(sc->max_diff_used, DIFF_BASIC);
             continue;
         }
 
         for (di = 0; di < sc->dc; di++)
-            if (deduce_domino_must_overlap(sc, di))
+            if (check_dirty(&sc->domino_dirty[di],
+                            DIRTY_DOMINO_MUST_OVERLAP) &&
+                deduce_domino_must_overlap(sc, di)) {
+                SOLVER_RULE("domino must overlap");
                 done_something = true;
+            }
         if (done_something) {
             sc->max_diff_used = max(sc->max_diff_used, DIFF_BASIC);
             continue;
         }
 
         for (pi = 0; pi < sc->pc; pi++)
-            if (deduce_local_duplicate(sc, pi))
+            if (check_dirty(&sc->placement_dirty[pi],
+                            DIRTY_LOCAL_DUPLICATE) &&
+                deduce_local_duplicate(sc, pi)) {
+                SOLVER_RULE("local duplicate");
                 done_something = true;
+            }
         if (done_something) {
             sc->max_diff_used = max(sc->max_diff_used, DIFF_BASIC);
             continue;
         }
 
         for (pi = 0; pi < sc->pc; pi++)
-            if (deduce_local_duplicate_2(sc, pi))
+            if (check_dirty(&sc->placement_dirty[pi],
+                            DIRTY_LOCAL_DUPLICATE_2) &&
+                deduce_local_duplicate_2(sc, pi)) {
+                SOLVER_RULE("local duplicate pair");
                 done_something = true;
+            }
         if (done_something) {
             sc->max_diff_used = max(sc->max_diff_used, DIFF_BASIC);
             continue;
         }
 
-        if (deduce_parity(sc))
+        if (deduce_parity(sc)) {
+            SOLVER_RULE("parity");
             done_something = true;
+        }
         if (done_something) {
             sc->max_diff_used = max(sc->max_diff_used, DIFF_BASIC);
             continue;
@@ -1764,8 +1893,11 @@ static int run_solver(struct solver_scratch *sc, int max_diff_allowed)
         if (max_diff_allowed <= DIFF_BASIC)
             continue;
 
-        if (deduce_set(sc, false))
+        SOLVER_TIER("hard: sets");
+        if (deduce_set(sc, false)) {
+            SOLVER_RULE("set");
             done_something = true;
+        }
         if (done_something) {
             sc->max_diff_used = max(sc->max_diff_used, DIFF_HARD);
             continue;
@@ -1774,15 +1906,20 @@ static int run_solver(struct solver_scratch *sc, int max_diff_allowed)
         if (max_diff_allowed <= DIFF_HARD)
             continue;
 
-        if (deduce_set(sc, true))
+        SOLVER_TIER("extreme: sets and chains");
+        if (deduce_set(sc, true)) {
+            SOLVER_RULE("set with doubles");
             done_something = true;
+        }
         if (done_something) {
             sc->max_diff_used = max(sc->max_diff_used, DIFF_EXTREME);
             continue;
         }
 
-        if (deduce_forcing_chain(sc))
+        if (deduce_forcing_chain(sc)) {
+            SOLVER_RULE("forcing chain");
             done_something = true;
+        }
         if (done_something) {
             sc->max_diff_used = max(sc->max_diff_used, DIFF_EXTREME);
             continue;
@@ -190,3 +190,222 @@ void edsf_merge(int *dsf, int v1, int v2, bool inverse)
 
 /*    fprintf(stderr, "dsf[%2d] = %2d\n", v2, dsf[v2]); */
 }
+
+/*
+ * The undoable variant. There's no path compression, because that
+ * would rewrite parent pointers all over the tree and make the
+ * merges hard to take back; instead we keep the trees shallow by
+ * always hanging the smaller tree under the root of the larger, so
+ * that no element is more than log2(size) steps from its root. Then
+ * undoing a merge is just a matter of detaching the root that was
+ * hung under the other one, and the trail records those in order.
+ */
+
+struct udsf {
+    int size;
+    int *parent;                       /* parent[i] == i at a root */
+    int *setsize;                      /* only meaningful at a root */
+    int *trail, ntrail;                /* roots we've hung elsewhere */
+};
+
+udsf *udsf_new(int size)
+{
+    udsf *u = snew(udsf);
+
+    u->size = size;
+    u->parent = snewn(size, int);
+    u->setsize = snewn(size, int);
+    u->trail = snewn(size, int);
+    udsf_init(u);
+
+    return u;
+}
+
+void udsf_free(udsf *u)
+{
+    sfree(u->parent);
+    sfree(u->setsize);
+    sfree(u->trail);
+    sfree(u);
+}
+
+void udsf_init(udsf *u)
+{
+    int i;
+
+    for (i = 0; i < u->size; i++) {
+        u->parent[i] = i;
+        u->setsize[i] = 1;
+    }
+    u->ntrail = 0;
+}
+
+int udsf_canonify(udsf *u, int index)
+{
+    assert(index >= 0 && index < u->size);
+
+    while (u->parent[index] != index)
+        index = u->parent[index];
+    return index;
+}
+
+int udsf_size(udsf *u, int index)
+{
+    return u->setsize[udsf_canonify(u, index)];
+}
+
+void udsf_merge(udsf *u, int v1, int v2)
+{
+    v1 = udsf_canonify(u, v1);
+    v2 = udsf_canonify(u, v2);
+    if (v1 == v2)
+        return;
+
+    /* Make v1 the root which stays a root: the larger tree's, or the
+     * lower-numbered one if they're the same size. */
+    if (u->setsize[v1] < u->setsize[v2] ||
+        (u->setsize[v1] == u->setsize[v2] && v1 > v2)) {
+        int v3 = v1;
+        v1 = v2;
+        v2 = v3;
+    }
+
+    u->parent[v2] = v1;
+    u->setsize[v1] += u->setsize[v2];
+    assert(u->ntrail < u->size);
+    u->trail[u->ntrail++] = v2;
+}
+
+int dsf_checkpoint(udsf *u)
+{
+    return u->ntrail;
+}
+
+void dsf_rollback(udsf *u, int checkpoint)
+{
+    assert(checkpoint >= 0 && checkpoint <= u->ntrail);
+
+    while (u->ntrail > checkpoint) {
+        int v2 = u->trail[--u->ntrail], v1 = u->parent[v2];
+        u->setsize[v1] -= u->setsize[v2];
+        u->parent[v2] = v2;
+    }
+}
+
+#ifdef STANDALONE_DSF_TEST
+
+/*
+ * Standalone test of the undoable dsf. We make random sequences of
+ * merges, checkpoints and rollbacks, doing the same to an ordinary
+ * dsf which we copy at each checkpoint and restore from the copy at
+ * each rollback, and check after every step that the two agree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TEST_SIZE 40
+#define TEST_DEPTH 10
+
+/*
+ * Check that u and dsf divide the elements into the same classes.
+ * Every element's udsf class must map to a single dsf class, and the
+ * sizes must agree, which together rule out either one splitting a
+ * class the other has whole.
+ */
+static const char *compare(udsf *u, int *dsf, int n)
+{
+    int *map = snewn(n, int);
+    const char *fail = NULL;
+    int i;
+
+    for (i = 0; i < n; i++)
+        map[i] = -1;
+
+    for (i = 0; i < n && !fail; i++) {
+        int uroot = udsf_canonify(u, i), root = dsf_canonify(dsf, i);
+
+        if (u->parent[uroot] != uroot)
+            fail = "udsf_canonify didn't return a root";
+        else if (map[uroot] == -1)
+            map[uroot] = root;
+        else if (map[uroot] != root)
+            fail = "udsf has merged two classes which the dsf hasn't";
+        else if (udsf_size(u, i) != dsf_size(dsf, i))
+            fail = "class sizes differ";
+    }
+
+    sfree(map);
+    return fail;
+}
+
+int main(int argc, char **argv)
+{
+    udsf *u = udsf_new(TEST_SIZE);
+    int *dsf = snew_dsf(TEST_SIZE);
+    int *saved[TEST_DEPTH], marks[TEST_DEPTH];
+    int iteration, step, depth, n, i;
+    unsigned seed;
+
+    seed = (argc > 1 ? strtoul(argv[1], NULL, 0) : time(NULL));
+    printf("Random seed = %u\n", seed);
+    srand(seed);
+
+    for (i = 0; i < TEST_DEPTH; i++)
+        saved[i] = snewn(TEST_SIZE, int);
+
+    for (iteration = 0; iteration < 10000; iteration++) {
+        const char *fail = NULL;
+
+        /*
+         * Use only some of the elements, so that the classes don't
+         * all run together in the same few steps every time.
+         */
+        n = 2 + rand() % (TEST_SIZE - 1);
+        udsf_init(u);
+        dsf_init(dsf, TEST_SIZE);
+        depth = 0;
+
+        for (step = 0; step < 4 * n && !fail; step++) {
+            int r = rand() % 4;
+
+            if (r < 2) {
+                int v1 = rand() % n, v2 = rand() % n;
+                udsf_merge(u, v1, v2);
+                dsf_merge(dsf, v1, v2);
+            } else if (r == 2 && depth < TEST_DEPTH) {
+                memcpy(saved[depth], dsf, TEST_SIZE * sizeof(int));
+                marks[depth++] = dsf_checkpoint(u);
+            } else if (depth > 0) {
+                /*
+                 * Go back to any of the live markers, not just the
+                 * latest. The one we go back to stays live, so we may
+                 * come back to it again.
+                 */
+                int d = rand() % depth;
+                dsf_rollback(u, marks[d]);
+                memcpy(dsf, saved[d], TEST_SIZE * sizeof(int));
+                depth = d + 1;
+            }
+
+            fail = compare(u, dsf, TEST_SIZE);
+        }
+
+        if (fail) {
+            printf("Failed at iteration %d, step %d: %s\n",
+                   iteration, step, fail);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < TEST_DEPTH; i++)
+        sfree(saved[i]);
+    sfree(dsf);
+    udsf_free(u);
+
+    printf("OK\n");
+    return 0;
+}
+
+#endif /* STANDALONE_DSF_TEST */
@@ -8,6 +8,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <math.h>
+#include <limits.h>
 
 #include "puzzles.h"
 
@@ -379,10 +380,33 @@ static void free_game(game_state *state)
     sfree(state);
 }
 
+static int *solve_moves(const game_state *state, int *nmoves);
+
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *aux, const char **error)
 {
-    return dupstr("S");
+    int *moves, nmoves, i;
+    char *ret, *p;
+
+    /*
+     * Give the actual moves to solve the puzzle from where the
+     * player is, if we can find them. Failing that, just replace
+     * the grid with a solved one (see execute_move).
+     */
+    moves = solve_moves(currstate, &nmoves);
+    if (!moves)
+        return dupstr("S");
+
+    ret = snewn(2 + 30 * nmoves, char);
+    p = ret;
+    *p++ = 'S';
+    for (i = 0; i < nmoves; i++)
+        p += sprintf(p, ";M%d,%d", X(currstate, moves[i]),
+                     Y(currstate, moves[i]));
+    *p = '\0';
+    sfree(moves);
+
+    return ret;
 }
 
 static bool game_can_format_as_text_now(const game_params *params)
@@ -609,33 +633,23 @@ static void next_move(int nx, int ny, int ox, int oy, int gx, int gy,
         *dx = to_tile_x;
 }
 
-static bool compute_hint(const game_state *state, int *out_x, int *out_y)
+/*
+ * Find the next piece to be put in its place:
+ * if (there are no more unfinished columns than rows) {
+ *     fill the top-most row, left to right
+ * } else { fill the left-most column, top to bottom }
+ *
+ * Returns the number of that piece, or n if the grid is solved, and
+ * sets *solr and *solc to the number of rows at the top and columns
+ * at the left which are already finished.
+ */
+static int find_next_piece(const game_state *state, int *solr_out,
+                           int *solc_out)
 {
-    /* The overall solving process is this:
-     * 1. Find the next piece to be put in its place
-     * 2. Move it diagonally towards its place
-     * 3. Move it horizontally or vertically towards its place
-     * (Modulo the last two tiles at the end of each row/column)
-     */
-
-    int gx = X(state, state->gap_pos);
-    int gy = Y(state, state->gap_pos);
-
-    int tx, ty, nx, ny, ox, oy, /* {target,next,next2}_{x,y} */ i;
-    int dx = 0, dy = 0;
-
-    /* 1. Find the next piece
-     * if (there are no more unfinished columns than rows) {
-     *     fill the top-most row, left to right
-     * } else { fill the left-most column, top to bottom }
-     */
     const int w = state->w, h = state->h, n = w*h;
-    int next_piece = 0, next_piece_2 = 0, solr = 0, solc = 0;
+    int next_piece = n, solr = 0, solc = 0, i;
     int unsolved_rows = h, unsolved_cols = w;
 
-    assert(out_x);
-    assert(out_y);
-
     while (solr < h && solc < w) {
         int start, step, stop;
         if (unsolved_cols <= unsolved_rows)
@@ -646,7 +660,6 @@ static bool compute_hint(const game_state *state, int *out_x, int *out_y)
             const int j = start + i*step;
             if (state->tiles[j] != j + 1) {
                 next_piece = j + 1;
-                next_piece_2 = next_piece + step;
                 break;
             }
         }
@@ -657,8 +670,40 @@ static bool compute_hint(const game_state *state, int *out_x, int *out_y)
             : (++solc, --unsolved_cols);
     }
 
+    *solr_out = solr;
+    *solc_out = solc;
+    return next_piece;
+}
+
+static bool compute_hint(const game_state *state, int *out_x, int *out_y)
+{
+    /* The overall solving process is this:
+     * 1. Find the next piece to be put in its place
+     * 2. Move it diagonally towards its place
+     * 3. Move it horizontally or vertically towards its place
+     * (Modulo the last two tiles at the end of each row/column)
+     */
+
+    int gx = X(state, state->gap_pos);
+    int gy = Y(state, state->gap_pos);
+
+    int tx, ty, nx, ny, ox, oy, /* {target,next,next2}_{x,y} */ i;
+    int dx = 0, dy = 0;
+
+    const int w = state->w, h = state->h, n = w*h;
+    int next_piece, next_piece_2, solr, solc;
+    int unsolved_rows, unsolved_cols;
+
+    assert(out_x);
+    assert(out_y);
+
+    /* 1. Find the next piece */
+    next_piece = find_next_piece(state, &solr, &solc);
     if (next_piece == n)
         return false;
+    unsolved_rows = h - solr;
+    unsolved_cols = w - solc;
+    next_piece_2 = next_piece + (unsolved_cols <= unsolved_rows ? 1 : w);
 
     /* 2, 3. Move the next piece towards its place */
 
@@ -684,6 +729,527 @@ static bool compute_hint(const game_state *state, int *out_x, int *out_y)
     return true;
 }
 
+/* ----------------------------------------------------------------------
+ * Optimal solver.
+ *
+ * Boards of up to PDB_MAXAREA squares are solved exactly by IDA*,
+ * using additive disjoint pattern databases as the heuristic. The
+ * tiles are divided into groups of at most PDB_GROUP, and for each
+ * group we tabulate, for every placement of that group's tiles, the
+ * least number of moves _of those tiles_ needed to get them all home
+ * if every other tile is treated as interchangeable. Each move
+ * shifts exactly one tile, so the sum over all groups is still a
+ * lower bound on the length of a solution.
+ *
+ * The databases depend only on the board size. Each solve builds
+ * its own and frees them afterwards; for a 4x4 board that takes most
+ * of a second, which is usually more than the search itself.
+ *
+ * Larger boards are first whittled down by compute_hint() until the
+ * unsolved part is small enough, and that part is finished off
+ * optimally. (Or nearly so: if the search goes on too long, we
+ * trade optimality for speed; see solve_small().)
+ */
+
+#define PDB_MAXAREA 16
+#define PDB_GROUP 5
+#define PDB_BITS 4                     /* enough for a square's index */
+#define PDB_MASK ((1 << PDB_BITS) - 1)
+#define PDB_UNSEEN 255
+
+#define SOLVE_MAXDEPTH 256
+#define SOLVE_MAXNODES 5000000L
+
+struct pdb {
+    int w, h, n, ngroups;
+    int group[PDB_MAXAREA];            /* which group each tile is in */
+    int weight[PDB_MAXAREA];           /* its place value in the index */
+    unsigned char *dist[PDB_MAXAREA];  /* one table per group */
+};
+
+/*
+ * Squares of the board as bits, for working out which squares the
+ * gap can reach. Since a board has at most PDB_MAXAREA squares,
+ * these fit comfortably in an unsigned int.
+ */
+struct pdb_masks {
+    int w;
+    unsigned all, notleft, notright;
+};
+
+/*
+ * Return the set of squares reachable from 'from' without passing
+ * through any square outside 'open'.
+ */
+static unsigned pdb_spread(const struct pdb_masks *pm, unsigned from,
+                           unsigned open)
+{
+    unsigned prev;
+
+    do {
+        prev = from;
+        from |= ((from << 1) & pm->notleft) | ((from >> 1) & pm->notright) |
+            ((from << pm->w) & pm->all) | (from >> pm->w);
+        from &= open;
+    } while (from != prev);
+
+    return from;
+}
+
+/*
+ * Build the database for a group of k tiles, by breadth-first search
+ * backwards from the solved position. A search state is a placement
+ * of the group's tiles together with the region of the remaining
+ * squares which holds the gap, since the gap moves freely within
+ * that at no cost. For each placement we keep the set of squares
+ * from which the gap has been seen, so a whole region is marked at
+ * once.
+ *
+ * A placement is indexed by the squares of its tiles, PDB_BITS bits
+ * apiece, so that it can be taken apart with shifts; a queue entry
+ * adds the square of the gap below that.
+ */
+static unsigned char *pdb_build(int w, int h, const int *tiles, int k)
+{
+    int n = w*h, size = 1 << (PDB_BITS*k), i, j, d;
+    int pos[PDB_GROUP], nbrs[PDB_MAXAREA][4], nnbrs[PDB_MAXAREA];
+    struct pdb_masks pm;
+    unsigned char *dist;
+    unsigned short *seen;              /* a bit per square, so n <= 16 */
+    int *queue, qsize, head, tail, config;
+    unsigned tilemask, region;
+
+    pm.w = w;
+    pm.all = (n < 32 ? (1U << n) : 0U) - 1;
+    pm.notleft = pm.notright = pm.all;
+    for (j = 0; j < h; j++) {
+        pm.notleft &= ~(1U << (j*w));
+        pm.notright &= ~(1U << (j*w + w-1));
+    }
+
+    for (i = 0; i < n; i++) {
+        int x = i % w, y = i / w;
+
+        nnbrs[i] = 0;
+        if (x > 0) nbrs[i][nnbrs[i]++] = i - 1;
+        if (x+1 < w) nbrs[i][nnbrs[i]++] = i + 1;
+        if (y > 0) nbrs[i][nnbrs[i]++] = i - w;
+        if (y+1 < h) nbrs[i][nnbrs[i]++] = i + w;
+    }
+
+    dist = snewn(size, unsigned char);
+    memset(dist, PDB_UNSEEN, size);
+    seen = snewn(size, unsigned short);
+    memset(seen, 0, size * sizeof(unsigned short));
+    qsize = 1024;
+    queue = snewn(qsize, int);
+    head = tail = 0;
+
+    config = 0;
+    tilemask = 0;
+    for (i = 0; i < k; i++) {
+        config += (tiles[i] - 1) << (PDB_BITS*i);
+        tilemask |= 1U << (tiles[i] - 1);
+    }
+    dist[config] = 0;
+    seen[config] = pdb_spread(&pm, 1U << (n-1), pm.all & ~tilemask);
+    queue[tail++] = (config << PDB_BITS) + n-1;
+
+    for (d = 0; head < tail; d++) {
+        int end = tail;
+
+        while (head < end) {
+            int s = queue[head++];
+
+            config = s >> PDB_BITS;
+            tilemask = 0;
+            for (i = 0; i < k; i++) {
+                pos[i] = (config >> (PDB_BITS*i)) & PDB_MASK;
+                tilemask |= 1U << pos[i];
+            }
+            region = pdb_spread(&pm, 1U << (s & PDB_MASK),
+                                pm.all & ~tilemask);
+
+            /*
+             * Try moving each of our tiles which borders the gap's
+             * region into it, from each side it can be reached.
+             */
+            for (i = 0; i < k; i++) {
+                int q = pos[i];
+
+                for (j = 0; j < nnbrs[q]; j++) {
+                    int p = nbrs[q][j], nconfig;
+
+                    if (!(region & (1U << p)))
+                        continue;
+                    nconfig = config + (p - q) * (1 << (PDB_BITS*i));
+                    if (seen[nconfig] & (1U << q))
+                        continue;
+
+                    seen[nconfig] |= pdb_spread(
+                        &pm, 1U << q, pm.all & ~((tilemask & ~(1U << q))
+                                                 | (1U << p)));
+                    if (dist[nconfig] == PDB_UNSEEN)
+                        dist[nconfig] = d + 1;
+
+                    if (tail >= qsize) {
+                        /*
+                         * Slide the live part of the queue down
+                         * before resorting to growing it.
+                         */
+                        if (head > qsize / 2) {
+                            memmove(queue, queue + head,
+                                    (tail - head) * sizeof(int));
+                            end -= head;
+                            tail -= head;
+                            head = 0;
+                        } else {
+                            qsize = qsize * 3 / 2;
+                            queue = sresize(queue, qsize, int);
+                        }
+                    }
+                    queue[tail++] = (nconfig << PDB_BITS) + q;
+                }
+            }
+        }
+    }
+
+    sfree(queue);
+    sfree(seen);
+    return dist;
+}
+
+static void pdb_free(struct pdb *pdb)
+{
+    int i;
+
+    for (i = 0; i < pdb->ngroups; i++)
+        sfree(pdb->dist[i]);
+    sfree(pdb);
+}
+
+static struct pdb *pdb_new(int w, int h)
+{
+    struct pdb *pdb;
+    int n = w*h, i, g;
+
+    assert(n <= PDB_MAXAREA);
+
+    pdb = snew(struct pdb);
+    pdb->w = w;
+    pdb->h = h;
+    pdb->n = n;
+    pdb->ngroups = (n - 1 + PDB_GROUP - 1) / PDB_GROUP;
+
+    /*
+     * Split the tiles into groups of consecutive numbers, as evenly
+     * as possible.
+     */
+    pdb->group[0] = -1;
+    for (g = 0; g < pdb->ngroups; g++) {
+        int tiles[PDB_GROUP], k = 0;
+
+        for (i = 1; i < n; i++)
+            if ((i - 1) * pdb->ngroups / (n - 1) == g) {
+                pdb->group[i] = g;
+                pdb->weight[i] = 1 << (PDB_BITS*k);
+                tiles[k++] = i;
+            }
+        assert(k <= PDB_GROUP);
+        pdb->dist[g] = pdb_build(w, h, tiles, k);
+    }
+
+    return pdb;
+}
+
+struct ida_ctx {
+    const struct pdb *pdb;
+    int n, *tiles, gap;
+    int nbrs[PDB_MAXAREA][4], nnbrs[PDB_MAXAREA];
+
+    /*
+     * On a square board the transpose of the position, with the
+     * tiles renumbered to suit, needs exactly as many moves to
+     * solve, so looking that up in the same databases gives a
+     * second lower bound. tmap[] and pmap[] map tiles and squares
+     * to their transposes; idx[1] is only used if 'reflect'.
+     */
+    bool reflect;
+    int tmap[PDB_MAXAREA], pmap[PDB_MAXAREA];
+    int idx[2][PDB_MAXAREA];
+
+    /*
+     * Costs are scaled so that a move costs WEIGHT_UNIT, and the
+     * heuristic is scaled by 'weight'. If that's more than
+     * WEIGHT_UNIT, the search is no longer guaranteed to find the
+     * shortest solution but is typically much faster.
+     */
+    int weight;
+
+    int path[SOLVE_MAXDEPTH], len;
+    long nodes;
+};
+
+#define WEIGHT_UNIT 4
+
+#define IDA_FOUND (-1)
+#define IDA_ABORT (-2)
+
+/*
+ * One iteration of IDA* below the current node, whose database
+ * lookups (direct and transposed) sum to h0 and h1. Returns
+ * IDA_FOUND with the moves in ctx->path and ctx->len, IDA_ABORT if we hit a
+ * resource limit, or the least cost that exceeded 'bound'.
+ */
+static int ida_search(struct ida_ctx *ctx, int g, int bound, int h0, int h1,
+                      int prev)
+{
+    const struct pdb *pdb = ctx->pdb;
+    int gap = ctx->gap, hval = max(h0, h1);
+    int f = g * WEIGHT_UNIT + hval * ctx->weight, i, best = INT_MAX;
+
+    if (f > bound)
+        return f;
+    if (hval == 0) {
+        ctx->len = g;                  /* all tiles home */
+        return IDA_FOUND;
+    }
+    if (g >= SOLVE_MAXDEPTH || ++ctx->nodes > SOLVE_MAXNODES)
+        return IDA_ABORT;
+
+    for (i = 0; i < ctx->nnbrs[gap]; i++) {
+        int q = ctx->nbrs[gap][i], t, grp, old0, new0, old1 = 0, new1 = 0;
+        int nh0, nh1 = 0, ret;
+
+        if (q == prev)
+            continue;                  /* don't just undo the last move */
+
+        t = ctx->tiles[q];
+        grp = pdb->group[t];
+        old0 = ctx->idx[0][grp];
+        new0 = old0 + (gap - q) * pdb->weight[t];
+        nh0 = h0 - pdb->dist[grp][old0] + pdb->dist[grp][new0];
+        ctx->idx[0][grp] = new0;
+
+        if (ctx->reflect) {
+            int tt = ctx->tmap[t], tgrp = pdb->group[tt];
+
+            old1 = ctx->idx[1][tgrp];
+            new1 = old1 + (ctx->pmap[gap] - ctx->pmap[q]) * pdb->weight[tt];
+            nh1 = h1 - pdb->dist[tgrp][old1] + pdb->dist[tgrp][new1];
+            ctx->idx[1][tgrp] = new1;
+        }
+
+        ctx->tiles[gap] = t;
+        ctx->tiles[q] = 0;
+        ctx->gap = q;
+        ctx->path[g] = q;
+
+        ret = ida_search(ctx, g + 1, bound, nh0, nh1, gap);
+
+        ctx->gap = gap;
+        ctx->tiles[q] = t;
+        ctx->tiles[gap] = 0;
+        ctx->idx[0][grp] = old0;
+        if (ctx->reflect)
+            ctx->idx[1][pdb->group[ctx->tmap[t]]] = old1;
+
+        if (ret == IDA_FOUND || ret == IDA_ABORT)
+            return ret;
+        if (ret < best)
+            best = ret;
+    }
+
+    return best;
+}
+
+/*
+ * Solve a board of the size 'pdb' was built for, given as a
+ * solvable array of tile numbers. On success, writes the successive
+ * positions of the gap into path[] (which must have room for
+ * SOLVE_MAXDEPTH of them) and returns the number of moves; else
+ * returns -1.
+ *
+ * We look for an optimal solution first. If that takes too long,
+ * we settle for a short one instead by inflating the heuristic.
+ */
+static int solve_small(const struct pdb *pdb, const int *tiles, int *path)
+{
+    static const int weights[] = { 4, 6, 8, 12 };
+    struct ida_ctx ctx;
+    int w = pdb->w, h = pdb->h, n = pdb->n, i, k, bound, h0, h1, ret;
+    int len = -1;
+
+    ctx.pdb = pdb;
+    ctx.n = n;
+    ctx.tiles = snewn(n, int);
+    memcpy(ctx.tiles, tiles, n * sizeof(int));
+    ctx.gap = -1;
+    for (i = 0; i < n; i++) {
+        int x = i % w, y = i / w;
+
+        ctx.nnbrs[i] = 0;
+        if (x > 0) ctx.nbrs[i][ctx.nnbrs[i]++] = i - 1;
+        if (x+1 < w) ctx.nbrs[i][ctx.nnbrs[i]++] = i + 1;
+        if (y > 0) ctx.nbrs[i][ctx.nnbrs[i]++] = i - w;
+        if (y+1 < h) ctx.nbrs[i][ctx.nnbrs[i]++] = i + w;
+
+        ctx.pmap[i] = x * w + y;
+        ctx.tmap[(i+1) % n] = (ctx.pmap[i]+1) % n;
+        if (!tiles[i])
+            ctx.gap = i;
+    }
+    assert(ctx.gap >= 0);
+    ctx.reflect = (w == h);
+
+    memset(ctx.idx, 0, sizeof(ctx.idx));
+    for (i = 0; i < n; i++) {
+        int t = tiles[i];
+
+        if (!t)
+            continue;
+        ctx.idx[0][ctx.pdb->group[t]] += i * ctx.pdb->weight[t];
+        if (ctx.reflect)
+            ctx.idx[1][ctx.pdb->group[ctx.tmap[t]]] +=
+                ctx.pmap[i] * ctx.pdb->weight[ctx.tmap[t]];
+    }
+
+    h0 = h1 = 0;
+    for (i = 0; i < ctx.pdb->ngroups; i++) {
+        assert(ctx.pdb->dist[i][ctx.idx[0][i]] != PDB_UNSEEN);
+        h0 += ctx.pdb->dist[i][ctx.idx[0][i]];
+        if (ctx.reflect)
+            h1 += ctx.pdb->dist[i][ctx.idx[1][i]];
+    }
+
+    for (k = 0; k < lenof(weights); k++) {
+        ctx.weight = weights[k];
+        ctx.nodes = 0;
+
+        /*
+         * With every tile home the gap must be too, so a zero
+         * heuristic means we're finished.
+         */
+        bound = max(h0, h1) * ctx.weight;
+        while (1) {
+            ret = ida_search(&ctx, 0, bound, h0, h1, -1);
+            if (ret == IDA_FOUND || ret == IDA_ABORT || ret == INT_MAX)
+                break;
+            bound = ret;
+        }
+
+        if (ret == IDA_FOUND) {
+            len = ctx.len;
+            break;
+        }
+    }
+
+    sfree(ctx.tiles);
+    if (len < 0)
+        return -1;
+    memcpy(path, ctx.path, len * sizeof(int));
+    return len;
+}
+
+/*
+ * Find a sequence of single-square moves which solves the given
+ * state. Returns a dynamically allocated array of successive gap
+ * positions and sets *nmoves, or returns NULL if we can't.
+ */
+static int *solve_moves(const game_state *state, int *nmoves)
+{
+    const int w = state->w, h = state->h, n = w*h;
+    int *moves, size, len, limit, solr, solc, sw, sh, sn, k, i;
+    int *subtiles, *path;
+    struct pdb *pdb;
+    game_state *st;
+
+    if (PARITY_S(state) != perm_parity(state->tiles, n))
+        return NULL;
+
+    st = dup_game(state);
+    size = 64;
+    moves = snewn(size, int);
+    len = 0;
+
+    /*
+     * Use the heuristic solver to fill in rows and columns until
+     * what's left is small enough to be solved exactly.
+     */
+    for (limit = 5 * n * n * n; limit; --limit) {
+        int x, y, gx, gy, ux, uy;
+
+        if (find_next_piece(st, &solr, &solc) == n ||
+            (h - solr) * (w - solc) <= PDB_MAXAREA)
+            break;
+        if (!compute_hint(st, &x, &y))
+            break;
+
+        gx = X(st, st->gap_pos);
+        gy = Y(st, st->gap_pos);
+        ux = (x < gx ? -1 : x > gx ? +1 : 0);
+        uy = (y < gy ? -1 : y > gy ? +1 : 0);
+        while (gx != x || gy != y) {
+            int p = C(st, gx + ux, gy + uy);
+
+            st->tiles[st->gap_pos] = st->tiles[p];
+            st->tiles[p] = 0;
+            st->gap_pos = p;
+            gx += ux;
+            gy += uy;
+
+            if (len >= size) {
+                size = size * 3 / 2;
+                moves = sresize(moves, size, int);
+            }
+            moves[len++] = p;
+        }
+    }
+    if (!limit)
+        goto fail;
+
+    /*
+     * Renumber the tiles of the unsolved part as if it were a board
+     * in its own right, and solve that.
+     */
+    sw = w - solc;
+    sh = h - solr;
+    sn = sw * sh;
+    subtiles = snewn(sn, int);
+    path = snewn(SOLVE_MAXDEPTH, int);
+    for (i = 0; i < sn; i++) {
+        int t = st->tiles[C(st, solc + i % sw, solr + i / sw)];
+
+        if (t) {
+            assert(X(st, t-1) >= solc && Y(st, t-1) >= solr);
+            t = (Y(st, t-1) - solr) * sw + (X(st, t-1) - solc) + 1;
+        }
+        subtiles[i] = t;
+    }
+    pdb = pdb_new(sw, sh);
+    k = solve_small(pdb, subtiles, path);
+    pdb_free(pdb);
+    sfree(subtiles);
+    if (k < 0) {
+        sfree(path);
+        goto fail;
+    }
+
+    moves = sresize(moves, len + k + 1, int);
+    for (i = 0; i < k; i++)
+        moves[len++] = C(st, solc + path[i] % sw, solr + path[i] / sw);
+    sfree(path);
+
+    free_game(st);
+    *nmoves = len;
+    return moves;
+
+  fail:
+    free_game(st);
+    sfree(moves);
+    return NULL;
+}
+
 static char *interpret_move(const game_state *state, game_ui *ui,
                             const game_drawstate *ds,
                             int x, int y, int button)
@@ -732,6 +1298,14 @@ static game_state *execute_move(const game_state *from, const char *move)
     int gx, gy, dx, dy, ux, uy, up, p;
     game_state *ret;
 
+    if (move[0] == 'S' && move[1] == ';') {
+        /* A solution from solve_game(), as a sequence of moves. */
+        ret = execute_move_sequence(from, move, execute_move, free_game);
+        if (ret)
+            ret->used_solve = true;
+        return ret;
+    }
+
     if (!strcmp(move, "S")) {
 	int i;
 
@@ -1139,7 +1713,7 @@ int main(int argc, char **argv)
     char *progname = argv[0];
 
     char buf[80];
-    int limit, x, y;
+    int limit, x, y, *moves, nmoves, i;
     bool solvable;
 
     while (--argc > 0) {
@@ -1188,6 +1762,29 @@ int main(int argc, char **argv)
         return !grade;
     }
 
+    moves = solve_moves(state, &nmoves);
+    if (moves) {
+        for (i = 0; i < nmoves; i++) {
+            game_state *next_state;
+            x = X(state, moves[i]);
+            y = Y(state, moves[i]);
+            printf("Move the space to (%d, %d), moving %d into the space\n",
+                   x + 1, y + 1, state->tiles[moves[i]]);
+            sprintf(buf, "M%d,%d", x, y);
+            next_state = execute_move(state, buf);
+            free_game(state);
+            if (!next_state) {
+                fprintf(stderr, "invalid move when solving %s:%s\n",
+                        id, desc);
+                return 1;
+            }
+            state = next_state;
+        }
+        sfree(moves);
+        free_game(state);
+        return 0;
+    }
+
     for (limit = 5 * state->n * state->n * state->n; limit; --limit) {
         game_state *next_state;
         if (!compute_hint(state, &x, &y)) {
@@ -31,6 +31,7 @@
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
+#include <limits.h>
 #include <math.h>
 
 #include "puzzles.h"
@@ -246,11 +247,53 @@ void check_recursion_depth(void)
 #define check_recursion_depth() (void)0
 #endif
 
+/*
+ * Number of positions, per region of the grid, that the region-graph
+ * search in solve_regions may look at before it gives up and settles
+ * for the best it's found. A position costs time in proportion to
+ * the number of regions, and bigger grids need more positions to
+ * make the same headway, so scaling by region count keeps the
+ * search useful on them. Generation runs it on every new grid, so
+ * gets a smaller budget than the Solve command, which runs it once.
+ */
+#define GEN_SEARCH_NODES 20
+#define SOLVE_SEARCH_NODES 100
+
+/* Size of solve_regions' transposition table; must be a power of 2. */
+#define TT_SIZE 65536
+
+struct tt_entry {
+    uint32 check;
+    int g, iteration;
+};
+
 struct solver_scratch {
     int *queue[2];
     int *dist;
     char *grid, *grid2;
     char *rgrids;
+
+    /*
+     * The grid contracted to a graph of its regions (connected
+     * single-colour areas), for solve_regions. The squares of region
+     * r are squares[regstart[r]] to squares[regstart[r+1]-1], and
+     * its neighbours are adj[adjstart[r]] to adj[adjstart[r+1]-1].
+     */
+    int nregions;
+    int *region, *squares, *regstart, *adj, *adjstart;
+    char *rcolour;
+    uint32 *zobrist;                   /* two random words per region */
+
+    /* Search state. */
+    bool *controlled;
+    int *nctrl;                        /* controlled neighbours per region */
+    int colleft[10];                   /* uncontrolled regions per colour */
+    int *trail, ntrail;                /* controlled regions, in order */
+    uint32 hash[2];
+    struct tt_entry *tt;
+    int iteration;
+    long nodes, maxnodes;
+    char *path, *best;
 };
 
 static struct solver_scratch *new_scratch(int w, int h)
@@ -264,6 +307,19 @@ static struct solver_scratch *new_scratch(int w, int h)
     scratch->grid = snewn(wh, char);
     scratch->grid2 = snewn(wh, char);
     scratch->rgrids = snewn(wh * RECURSION_DEPTH, char);
+    scratch->region = snewn(wh, int);
+    scratch->squares = snewn(wh, int);
+    scratch->regstart = snewn(wh+1, int);
+    scratch->adj = snewn(4*wh, int);
+    scratch->adjstart = snewn(wh+1, int);
+    scratch->rcolour = snewn(wh, char);
+    scratch->zobrist = snewn(2*wh, uint32);
+    scratch->controlled = snewn(wh, bool);
+    scratch->nctrl = snewn(wh, int);
+    scratch->trail = snewn(wh, int);
+    scratch->tt = snewn(TT_SIZE, struct tt_entry);
+    scratch->path = snewn(wh, char);
+    scratch->best = snewn(wh, char);
     return scratch;
 }
 
@@ -275,6 +331,19 @@ static void free_scratch(struct solver_scratch *scratch)
     sfree(scratch->grid);
     sfree(scratch->grid2);
     sfree(scratch->rgrids);
+    sfree(scratch->region);
+    sfree(scratch->squares);
+    sfree(scratch->regstart);
+    sfree(scratch->adj);
+    sfree(scratch->adjstart);
+    sfree(scratch->rcolour);
+    sfree(scratch->zobrist);
+    sfree(scratch->controlled);
+    sfree(scratch->nctrl);
+    sfree(scratch->trail);
+    sfree(scratch->tt);
+    sfree(scratch->path);
+    sfree(scratch->best);
     sfree(scratch);
 }
 
@@ -539,15 +608,344 @@ static char choosemove(int w, int h, char *grid, int x0, int y0,
                               0, &tmp0, &tmp1, &tmp2);
 }
 
+/*
+ * A proper search for short solutions, as an improvement on the
+ * lookahead above.
+ *
+ * The grid is first contracted to a graph with one vertex per
+ * region, since the flood fill always takes in whole regions. A
+ * position is then just the set of regions controlled so far, and a
+ * move in colour c adds every region of that colour adjacent to the
+ * set.
+ *
+ * We search that depth-first for anything shorter than the best
+ * solution known so far, and tighten the bound each time we find
+ * one. The first line we try is that best solution itself, so that
+ * the search begins by looking for changes to the last few of its
+ * moves and works its way back from there; away from it, we try the
+ * moves that take in the most squares first. (Trying those first all
+ * the way down leads somewhere a good deal worse than the lookahead
+ * does, and on a big grid the search never gets back out.) Branches
+ * are cut off using as a lower bound on the number of moves still
+ * needed the larger of two admissible estimates: the number of
+ * colours not yet entirely controlled (each needs at least one more
+ * move), and the distance in the region graph from the controlled
+ * set to the furthest region (each move advances the boundary by at
+ * most one step). A transposition table, indexed by
+ * a Zobrist hash of the controlled set, stops us exploring the same
+ * set twice when different move orders lead to it.
+ *
+ * One further pruning rule: if some colour's remaining regions are
+ * all adjacent to the controlled set, then a move in that colour
+ * removes the colour altogether, and it's never worse to do that
+ * immediately, so we consider no other move.
+ */
+static void build_regions(int w, int h, const char *grid,
+                          struct solver_scratch *scratch)
+{
+    int wh = w*h;
+    int i, r, k, nadj, qhead, qtail;
+    uint32 seed = 12345;
+
+    for (i = 0; i < wh; i++)
+        scratch->region[i] = -1;
+
+    r = 0;
+    qhead = 0;
+    for (i = 0; i < wh; i++) {
+        if (scratch->region[i] >= 0)
+            continue;
+        scratch->region[i] = r;
+        scratch->rcolour[r] = grid[i];
+        scratch->regstart[r] = qtail = qhead;
+        scratch->squares[qhead++] = i;
+        while (qtail < qhead) {
+            int pos = scratch->squares[qtail++];
+            int y = pos / w;
+            int x = pos % w;
+            int dir;
+            for (dir = 0; dir < 4; dir++) {
+                int y1 = y + (dir == 1 ? 1 : dir == 3 ? -1 : 0);
+                int x1 = x + (dir == 0 ? 1 : dir == 2 ? -1 : 0);
+                if (0 <= x1 && x1 < w && 0 <= y1 && y1 < h) {
+                    int pos1 = y1*w+x1;
+                    if (scratch->region[pos1] < 0 && grid[pos1] == grid[i]) {
+                        scratch->region[pos1] = r;
+                        scratch->squares[qhead++] = pos1;
+                    }
+                }
+            }
+        }
+        r++;
+    }
+    scratch->nregions = r;
+    scratch->regstart[r] = qhead;
+
+    /*
+     * Now find each region's neighbours, using the nctrl array
+     * temporarily to remember which region last listed each one.
+     */
+    for (r = 0; r < scratch->nregions; r++)
+        scratch->nctrl[r] = -1;
+    nadj = 0;
+    for (r = 0; r < scratch->nregions; r++) {
+        scratch->adjstart[r] = nadj;
+        for (k = scratch->regstart[r]; k < scratch->regstart[r+1]; k++) {
+            int pos = scratch->squares[k];
+            int y = pos / w;
+            int x = pos % w;
+            int dir;
+            for (dir = 0; dir < 4; dir++) {
+                int y1 = y + (dir == 1 ? 1 : dir == 3 ? -1 : 0);
+                int x1 = x + (dir == 0 ? 1 : dir == 2 ? -1 : 0);
+                if (0 <= x1 && x1 < w && 0 <= y1 && y1 < h) {
+                    int r1 = scratch->region[y1*w+x1];
+                    if (r1 != r && scratch->nctrl[r1] != r) {
+                        scratch->nctrl[r1] = r;
+                        scratch->adj[nadj++] = r1;
+                    }
+                }
+            }
+        }
+    }
+    scratch->adjstart[scratch->nregions] = nadj;
+
+    /*
+     * The Zobrist keys needn't be unpredictable, only well mixed, so
+     * a simple xorshift generator will do, and keeps the search
+     * independent of any random_state.
+     */
+    for (i = 0; i < 2 * scratch->nregions; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        scratch->zobrist[i] = seed;
+    }
+}
+
+static void control_region(struct solver_scratch *scratch, int r)
+{
+    int k;
+
+    scratch->controlled[r] = true;
+    scratch->colleft[(int)scratch->rcolour[r]]--;
+    for (k = scratch->adjstart[r]; k < scratch->adjstart[r+1]; k++)
+        scratch->nctrl[scratch->adj[k]]++;
+    scratch->hash[0] ^= scratch->zobrist[2*r];
+    scratch->hash[1] ^= scratch->zobrist[2*r+1];
+    scratch->trail[scratch->ntrail++] = r;
+}
+
+static void uncontrol_regions(struct solver_scratch *scratch, int ntrail)
+{
+    int k;
+
+    while (scratch->ntrail > ntrail) {
+        int r = scratch->trail[--scratch->ntrail];
+        scratch->controlled[r] = false;
+        scratch->colleft[(int)scratch->rcolour[r]]++;
+        for (k = scratch->adjstart[r]; k < scratch->adjstart[r+1]; k++)
+            scratch->nctrl[scratch->adj[k]]--;
+        scratch->hash[0] ^= scratch->zobrist[2*r];
+        scratch->hash[1] ^= scratch->zobrist[2*r+1];
+    }
+}
+
+/*
+ * Lower bound on the number of moves needed to finish from the
+ * current position. Uses scratch->dist and scratch->queue[0], indexed
+ * by region rather than by square.
+ */
+static int regions_lower_bound(struct solver_scratch *scratch, int colours)
+{
+    int *dist = scratch->dist, *queue = scratch->queue[0];
+    int r, k, c, qhead, qtail, ncols, maxdist;
+
+    ncols = 0;
+    for (c = 0; c < colours; c++)
+        if (scratch->colleft[c] > 0)
+            ncols++;
+
+    for (r = 0; r < scratch->nregions; r++)
+        dist[r] = -1;
+    qhead = qtail = 0;
+    for (k = 0; k < scratch->ntrail; k++) {
+        r = scratch->trail[k];
+        dist[r] = 0;
+        queue[qhead++] = r;
+    }
+    maxdist = 0;
+    while (qtail < qhead) {
+        r = queue[qtail++];
+        maxdist = dist[r];
+        for (k = scratch->adjstart[r]; k < scratch->adjstart[r+1]; k++) {
+            int r1 = scratch->adj[k];
+            if (dist[r1] < 0) {
+                dist[r1] = dist[r] + 1;
+                queue[qhead++] = r1;
+            }
+        }
+    }
+
+    return max(ncols, maxdist);
+}
+
+/*
+ * Look for a solution of at most 'bound' moves, given that 'g' have
+ * been made so far and the controlled area is now colour 'curr'.
+ * 'onpath' is true if those were the first g moves of scratch->best.
+ * Returns the solution's length if one was found (leaving it in
+ * scratch->path), 0 if not, or -1 if we ran out of nodes.
+ */
+static int solve_regions_recurse(struct solver_scratch *scratch, int colours,
+                                 int g, int bound, int curr, bool onpath)
+{
+    int count[10], gain[10], order[10];
+    struct tt_entry *tte;
+    int r, c, i, j, n, only, ret, ntrail;
+
+    if (scratch->ntrail == scratch->nregions)
+        return g;
+    if (++scratch->nodes > scratch->maxnodes)
+        return -1;
+
+    /*
+     * Look in the transposition table before working out the lower
+     * bound, which is the expensive part of a node.
+     */
+    tte = &scratch->tt[scratch->hash[0] & (TT_SIZE-1)];
+    if (tte->iteration == scratch->iteration &&
+        tte->check == scratch->hash[1] && tte->g <= g)
+        return 0;                      /* been here at least as quickly */
+    tte->iteration = scratch->iteration;
+    tte->check = scratch->hash[1];
+    tte->g = g;
+
+    if (g + regions_lower_bound(scratch, colours) > bound)
+        return 0;
+
+    for (c = 0; c < colours; c++)
+        count[c] = gain[c] = 0;
+    for (r = 0; r < scratch->nregions; r++)
+        if (!scratch->controlled[r] && scratch->nctrl[r] > 0) {
+            count[(int)scratch->rcolour[r]]++;
+            gain[(int)scratch->rcolour[r]] +=
+                scratch->regstart[r+1] - scratch->regstart[r];
+        }
+
+    only = -1;
+    for (c = 0; c < colours; c++)
+        if (count[c] > 0 && count[c] == scratch->colleft[c]) {
+            only = c;
+            break;
+        }
+
+    /*
+     * List the moves worth trying, biggest gain first, except that
+     * the best solution's next move goes before all of them.
+     */
+    if (onpath)
+        gain[(int)scratch->best[g]] = INT_MAX;
+    n = 0;
+    for (c = 0; c < colours; c++) {
+        if (c == curr || count[c] == 0 || (only >= 0 && c != only))
+            continue;
+        for (i = n++; i > 0 && gain[order[i-1]] < gain[c]; i--)
+            order[i] = order[i-1];
+        order[i] = c;
+    }
+
+    for (j = 0; j < n; j++) {
+        c = order[j];
+        ntrail = scratch->ntrail;
+        for (r = 0; r < scratch->nregions; r++)
+            if (!scratch->controlled[r] && scratch->nctrl[r] > 0 &&
+                scratch->rcolour[r] == c)
+                control_region(scratch, r);
+        scratch->path[g] = c;
+        ret = solve_regions_recurse(scratch, colours, g+1, bound, c,
+                                    onpath && c == scratch->best[g]);
+        uncontrol_regions(scratch, ntrail);
+        if (ret)
+            return ret;
+    }
+
+    return 0;
+}
+
+/*
+ * Try to find a shorter solution than the 'nmoves' moves in 'moves',
+ * looking at no more than 'nodes' positions per region of the grid.
+ * Returns the length of the shortest one found, with the moves left
+ * in scratch->best, or -1 if we didn't find one.
+ */
+static int solve_regions(int w, int h, const char *grid, int x0, int y0,
+                         int colours, const char *moves, int nmoves,
+                         int nodes, struct solver_scratch *scratch)
+{
+    int c, r, ret, nbest, lower, maxmoves = nmoves;
+
+    build_regions(w, h, grid, scratch);
+
+    for (r = 0; r < scratch->nregions; r++) {
+        scratch->controlled[r] = false;
+        scratch->nctrl[r] = 0;
+    }
+    for (c = 0; c < colours; c++)
+        scratch->colleft[c] = 0;
+    for (r = 0; r < scratch->nregions; r++)
+        scratch->colleft[(int)scratch->rcolour[r]]++;
+    scratch->ntrail = 0;
+    scratch->hash[0] = scratch->hash[1] = 0;
+    control_region(scratch, scratch->region[y0*w+x0]);
+
+    /*
+     * If the lower bound says we can't beat the solution we've got,
+     * there's no point looking.
+     */
+    lower = regions_lower_bound(scratch, colours);
+    if (lower >= maxmoves)
+        return -1;
+
+    for (r = 0; r < TT_SIZE; r++)
+        scratch->tt[r].iteration = -1;
+    memcpy(scratch->best, moves, nmoves);
+    scratch->nodes = 0;
+    scratch->maxnodes = (long)nodes * scratch->nregions;
+
+    /*
+     * Each time we find a solution, start again looking for a
+     * shorter one. The transposition table has to be invalidated
+     * when we do, since it may remember positions from which the
+     * solution just found was not the shortest.
+     */
+    nbest = -1;
+    scratch->iteration = 0;
+    while (1) {
+        ret = solve_regions_recurse(scratch, colours, 0, maxmoves - 1,
+                                    grid[y0*w+x0], true);
+        if (ret <= 0)
+            break;
+        nbest = maxmoves = ret;
+        memcpy(scratch->best, scratch->path, nbest);
+        if (nbest == lower)
+            break;                     /* can't do any better */
+        scratch->iteration++;
+    }
+
+    return nbest;
+}
+
 static char *new_game_desc(const game_params *params, random_state *rs,
 			   char **aux, bool interactive)
 {
     int w = params->w, h = params->h, wh = w*h;
     int i, moves;
-    char *desc;
+    char *desc, *movelist;
     struct solver_scratch *scratch;
 
     scratch = new_scratch(w, h);
+    movelist = snewn(wh, char);        /* sure to be enough */
 
     /*
      * Invent a random grid.
@@ -565,9 +963,19 @@ static char *new_game_desc(const game_params *params, random_state *rs,
         char move = choosemove(w, h, scratch->grid2, FILLX, FILLY,
                                params->colours, scratch);
         fill(w, h, scratch->grid2, FILLX, FILLY, move, scratch->queue[0]);
-        moves++;
+        assert(moves < wh);
+        movelist[moves++] = move;
     }
 
+    /*
+     * See if a proper search can do better than that.
+     */
+    i = solve_regions(w, h, scratch->grid, FILLX, FILLY, params->colours,
+                      movelist, moves, GEN_SEARCH_NODES, scratch);
+    if (i >= 0)
+        moves = i;
+    sfree(movelist);
+
     /*
      * Adjust for difficulty.
      */
@@ -711,6 +1119,13 @@ static char *solve_game(const game_state *state, const game_state *currstate,
         assert(nmoves < wh);
         moves[nmoves++] = move;
     }
+    i = solve_regions(w, h, currstate->grid, FILLX, FILLY,
+                      currstate->colours, moves, nmoves, SOLVE_SEARCH_NODES,
+                      scratch);
+    if (i >= 0) {
+        nmoves = i;
+        memcpy(moves, scratch->best, nmoves);
+    }
     free_scratch(scratch);
 
     /*
@@ -528,6 +528,7 @@ static int foreach_tile(game_state *state, space_cb cb, unsigned int f,
     return foreach_sub(state, cb, f, ctx, 1, 1);
 }
 
+#if 0
 static int foreach_edge(game_state *state, space_cb cb, unsigned int f,
                         void *ctx)
 {
@@ -539,6 +540,7 @@ static int foreach_edge(game_state *state, space_cb cb, unsigned int f,
     if (ret1 == -1 || ret2 == -1) return -1;
     return (ret1 || ret2) ? 1 : 0;
 }
+#endif
 
 #if 0
 static int foreach_vertex(game_state *state, space_cb cb, unsigned int f,
@@ -1670,20 +1672,91 @@ typedef struct solver_ctx {
     game_state *state;
     int sz;             /* state->sx * state->sy */
     space **scratch;    /* size sz */
+    space **marked;     /* size sz; tiles given F_MARK by an expansion */
+    int nmarked;
+
+    /* Edges and tiles which might have new deductions to offer, because
+     * something next to them has changed, and all the spaces which have
+     * changed since the last expansion from the dots (see
+     * solver_changed). */
+    tdq *edgetodo, *tiletodo, *changed;
 
+    /*
+     * Memo of the last expansion from each dot (see
+     * solver_expand_dots): the tiles it reached, their bounding box
+     * and whether anything near that box has changed since.
+     */
+    bool expanded;      /* false until the memo has been filled in */
+    space ***reach;     /* size ndots, each allocated to nreach[i] */
+    int *nreach;
+    int *bbox;          /* 4 per dot: x0, y0, x1, y1 */
+    bool *dirty;
 } solver_ctx;
 
-static solver_ctx *new_solver(game_state *state)
+static int solver_state_from(game_state *state, int maxdiff,
+                             solver_ctx *parent);
+static void solver_flush_changes(solver_ctx *sctx);
+
+/* If 'parent' is given, it's the context of a solver run on the same
+ * state that is recursing into us, having made a guess; everything it
+ * knew is still true, so we can start from its memo of the dot
+ * expansions. */
+static solver_ctx *new_solver(game_state *state, solver_ctx *parent)
 {
     solver_ctx *sctx = snew(solver_ctx);
+    int i;
+
     sctx->state = state;
     sctx->sz = state->sx*state->sy;
     sctx->scratch = snewn(sctx->sz, space *);
+    sctx->marked = snewn(sctx->sz, space *);
+    sctx->nmarked = 0;
+    sctx->edgetodo = tdq_new(sctx->sz);
+    sctx->tiletodo = tdq_new(sctx->sz);
+    sctx->changed = tdq_new(sctx->sz);
+    tdq_fill(sctx->edgetodo);
+    tdq_fill(sctx->tiletodo);
+    sctx->reach = snewn(state->ndots, space **);
+    sctx->nreach = snewn(state->ndots, int);
+    sctx->bbox = snewn(state->ndots * 4, int);
+    sctx->dirty = snewn(state->ndots, bool);
+    for (i = 0; i < state->ndots; i++) {
+        sctx->reach[i] = NULL;
+        sctx->nreach[i] = 0;
+        sctx->dirty[i] = true;
+    }
+    sctx->expanded = false;
+
+    if (parent && parent->expanded) {
+        assert(parent->state == state);
+        solver_flush_changes(parent);
+        for (i = 0; i < state->ndots; i++) {
+            int n = parent->nreach[i];
+            sctx->reach[i] = snewn(n, space *);
+            memcpy(sctx->reach[i], parent->reach[i], n * sizeof(space *));
+            sctx->nreach[i] = n;
+            sctx->dirty[i] = parent->dirty[i];
+        }
+        memcpy(sctx->bbox, parent->bbox, state->ndots * 4 * sizeof(int));
+        sctx->expanded = true;
+    }
     return sctx;
 }
 
 static void free_solver(solver_ctx *sctx)
 {
+    int i;
+
+    for (i = 0; i < sctx->state->ndots; i++)
+        sfree(sctx->reach[i]);
+    sfree(sctx->reach);
+    sfree(sctx->nreach);
+    sfree(sctx->bbox);
+    sfree(sctx->dirty);
+    tdq_free(sctx->changed);
+    tdq_free(sctx->edgetodo);
+    tdq_free(sctx->tiletodo);
+    sfree(sctx->marked);
     sfree(sctx->scratch);
     sfree(sctx);
 }
@@ -1710,8 +1783,37 @@ static void free_solver(solver_ctx *sctx)
    * one possible dot for a given tile based on line-of-sight
  */
 
-static int solver_add_assoc(game_state *state, space *tile, int dx, int dy,
-                            const char *why)
+/* Queue up the edges and tiles whose deductions might be affected by a
+ * change to sp (a newly set edge, or a newly associated tile). */
+static void solver_changed(solver_ctx *sctx, space *sp)
+{
+    game_state *state;
+    int d;
+
+    if (!sctx) return;
+    state = sctx->state;
+    tdq_add(sctx->changed, sp->y * state->sx + sp->x);
+
+    for (d = 0; d < 4; d++) {
+        int dx = (d == 0) - (d == 1), dy = (d == 2) - (d == 3);
+        int x = sp->x + dx, y = sp->y + dy;
+
+        if (sp->type == s_edge) {
+            tdq_add(sctx->edgetodo, sp->y * state->sx + sp->x);
+            if (INGRID(state, x, y) && SPACE(state, x, y).type == s_tile)
+                tdq_add(sctx->tiletodo, y * state->sx + x);
+        } else {
+            if (INGRID(state, x, y))
+                tdq_add(sctx->edgetodo, y * state->sx + x);
+            x += dx; y += dy;
+            if (INGRID(state, x, y))
+                tdq_add(sctx->tiletodo, y * state->sx + x);
+        }
+    }
+}
+
+static int solver_add_assoc(game_state *state, solver_ctx *sctx, space *tile,
+                            int dx, int dy, const char *why)
 {
     space *dot, *tile_opp;
 
@@ -1747,6 +1849,8 @@ static int solver_add_assoc(game_state *state, space *tile, int dx, int dy,
 
     add_assoc(state, tile, dot);
     add_assoc(state, tile_opp, dot);
+    solver_changed(sctx, tile);
+    solver_changed(sctx, tile_opp);
     solvep(("%*sSetting %d,%d --> %d,%d (%s).\n",
             solver_recurse_depth*4, "",
             tile->x, tile->y,dx, dy, why));
@@ -1771,7 +1875,7 @@ static int solver_obvious_dot(game_state *state, space *dot)
 
             tile = &SPACE(state, dot->x+dx, dot->y+dy);
             if (tile->type == s_tile) {
-                ret = solver_add_assoc(state, tile, dot->x, dot->y,
+                ret = solver_add_assoc(state, NULL, tile, dot->x, dot->y,
                                        "next to dot");
                 if (ret < 0) return -1;
                 if (ret > 0) didsth = 1;
@@ -1818,6 +1922,7 @@ static int solver_lines_opposite_cb(game_state *state, space *edge, void *ctx)
         solvep(("%*sSetting edge %d,%d - tiles different dots.\n",
                solver_recurse_depth*4, "", edge->x, edge->y));
         edge->flags |= F_EDGE_SET;
+        solver_changed((solver_ctx *)ctx, edge);
         didsth = 1;
     }
 
@@ -1847,6 +1952,7 @@ static int solver_lines_opposite_cb(game_state *state, space *edge, void *ctx)
                    solver_recurse_depth*4, "",
                    tile_opp->x-dx, tile_opp->y-dy, edge->x, edge->y));
             edge_opp->flags |= F_EDGE_SET;
+            solver_changed((solver_ctx *)ctx, edge_opp);
             didsth = 1;
         }
     }
@@ -1899,7 +2005,8 @@ static int solver_spaces_oneposs_cb(game_state *state, space *tile, void *ctx)
     }
     assert(dotx != -1 && doty != -1);
 
-    ret = solver_add_assoc(state, tile, dotx, doty, "rest are edges");
+    ret = solver_add_assoc(state, (solver_ctx *)ctx, tile, dotx, doty,
+                           "rest are edges");
     if (ret == -1) return -1;
     assert(ret != 0); /* really should have done something. */
 
@@ -1991,21 +2098,16 @@ static bool solver_expand_checkdot(space *tile, space *dot)
     return false;
 }
 
-static void solver_expand_fromdot(game_state *state, space *dot, solver_ctx *sctx)
-{
-    int i, j, x, y, start, end, next;
-    space *sp;
-
-    /* Clear the grid of the (space) flags we'll use. */
+#define MARK(sctx, sp) do {                     \
+    (sp)->flags |= F_MARK;                      \
+    (sctx)->marked[(sctx)->nmarked++] = (sp);   \
+} while (0)
 
-    /* This is well optimised; analysis showed that:
-        for (i = 0; i < sctx->sz; i++) state->grid[i].flags &= ~F_MARK;
-       took up ~85% of the total function time! */
-    for (y = 1; y < state->sy; y += 2) {
-        sp = &SPACE(state, 1, y);
-        for (x = 1; x < state->sx; x += 2, sp += 2)
-            sp->flags &= ~F_MARK;
-    }
+/* Expands from one dot, leaving the list of tiles it reached in
+ * sctx->scratch, and returns their number. */
+static int solver_expand_fromdot(game_state *state, space *dot, solver_ctx *sctx)
+{
+    int i, j, start, end, next;
 
     /* Seed the list of marked squares with two that must be associated
      * with our dot (possibly the same space) */
@@ -2021,8 +2123,10 @@ static void solver_expand_fromdot(game_state *state, space *dot, solver_ctx *sct
     assert(sctx->scratch[0]->flags & F_TILE_ASSOC);
     assert(sctx->scratch[1]->flags & F_TILE_ASSOC);
 
-    sctx->scratch[0]->flags |= F_MARK;
-    sctx->scratch[1]->flags |= F_MARK;
+    sctx->nmarked = 0;
+    MARK(sctx, sctx->scratch[0]);
+    if (sctx->scratch[1] != sctx->scratch[0])
+        MARK(sctx, sctx->scratch[1]);
 
     debug(("%*sexpand from dot %d,%d seeded with %d,%d and %d,%d.\n",
            solver_recurse_depth*4, "", dot->x, dot->y,
@@ -2053,7 +2157,7 @@ expand:
                 debug(("%*sMarking %d,%d, no opposite.\n",
                        solver_recurse_depth*4, "",
                        tileadj[j]->x, tileadj[j]->y));
-                tileadj[j]->flags |= F_MARK;
+                MARK(sctx, tileadj[j]);
                 continue; /* no opposite, so mark for next time. */
             }
             /* If the tile had an opposite we should have either seen both of
@@ -2074,8 +2178,9 @@ expand:
             debug(("%*sMarking %d,%d and %d,%d.\n",
                    solver_recurse_depth*4, "",
                        tileadj[j]->x, tileadj[j]->y, tileadj2->x, tileadj2->y));
-            tileadj[j]->flags |= F_MARK;
-            tileadj2->flags |= F_MARK;
+            MARK(sctx, tileadj[j]);
+            if (tileadj2 != tileadj[j])
+                MARK(sctx, tileadj2);
         }
     }
     if (next > end) {
@@ -2083,29 +2188,42 @@ expand:
         start = end; end = next; goto expand;
     }
 
-    /* We've expanded as far as we can go. Now we update the main flags
-     * on all tiles we've expanded into -- if they were empty, we have
-     * found possible associations for this dot. */
-    for (i = 0; i < end; i++) {
-        if (sctx->scratch[i]->flags & F_TILE_ASSOC) continue;
-        if (sctx->scratch[i]->flags & F_REACHABLE) {
+    /* Clear the marks again, touching only the tiles we set them on
+     * (clearing the whole grid for every dot used to dominate the
+     * solver's running time on large grids). */
+    for (i = 0; i < sctx->nmarked; i++)
+        sctx->marked[i]->flags &= ~F_MARK;
+
+    return end;
+}
+
+/* We've expanded from a dot as far as we can go. Now we update the main
+ * flags on all tiles we've expanded into -- if they were empty, we have
+ * found possible associations for this dot. */
+static void solver_expand_mark(game_state *state, space *dot,
+                               space **tiles, int ntiles)
+{
+    int i;
+
+    for (i = 0; i < ntiles; i++) {
+        if (tiles[i]->flags & F_TILE_ASSOC) continue;
+        if (tiles[i]->flags & F_REACHABLE) {
             /* This is (at least) the second dot this tile could
              * associate with. */
             debug(("%*sempty tile %d,%d could assoc. other dot %d,%d\n",
                    solver_recurse_depth*4, "",
-                   sctx->scratch[i]->x, sctx->scratch[i]->y, dot->x, dot->y));
-            sctx->scratch[i]->flags |= F_MULTIPLE;
+                   tiles[i]->x, tiles[i]->y, dot->x, dot->y));
+            tiles[i]->flags |= F_MULTIPLE;
         } else {
             /* This is the first (possibly only) dot. */
             debug(("%*sempty tile %d,%d could assoc. 1st dot %d,%d\n",
                    solver_recurse_depth*4, "",
-                   sctx->scratch[i]->x, sctx->scratch[i]->y, dot->x, dot->y));
-            sctx->scratch[i]->flags |= F_REACHABLE;
-            sctx->scratch[i]->dotx = dot->x;
-            sctx->scratch[i]->doty = dot->y;
+                   tiles[i]->x, tiles[i]->y, dot->x, dot->y));
+            tiles[i]->flags |= F_REACHABLE;
+            tiles[i]->dotx = dot->x;
+            tiles[i]->doty = dot->y;
         }
     }
-    dbg_state(state);
 }
 
 static int solver_expand_postcb(game_state *state, space *tile, void *ctx)
@@ -2121,23 +2239,90 @@ static int solver_expand_postcb(game_state *state, space *tile, void *ctx)
     }
     if (tile->flags & F_MULTIPLE) return 0;
 
-    return solver_add_assoc(state, tile, tile->dotx, tile->doty,
+    return solver_add_assoc(state, (solver_ctx *)ctx, tile,
+                            tile->dotx, tile->doty,
                             "single possible dot after expansion");
 }
 
+/*
+ * Within one run of solver_state, edges and associations are only ever
+ * added, and an expansion from a dot only looks at spaces within one
+ * tile of those it reaches. So we remember each dot's expansion, and
+ * only redo it if something in or next to its bounding box has changed
+ * since.
+ */
+static void solver_flush_changes(solver_ctx *sctx)
+{
+    game_state *state = sctx->state;
+    int i, j;
+
+    while ((i = tdq_remove(sctx->changed)) >= 0) {
+        space *sp = &state->grid[i];
+
+        for (j = 0; j < state->ndots; j++) {
+            int *bb = sctx->bbox + j*4;
+            if (sp->x >= bb[0] - 2 && sp->y >= bb[1] - 2 &&
+                sp->x <= bb[2] + 2 && sp->y <= bb[3] + 2)
+                sctx->dirty[j] = true;
+        }
+    }
+}
+
 static int solver_expand_dots(game_state *state, solver_ctx *sctx)
 {
-    int i;
+    int i, j;
+
+    solver_flush_changes(sctx);
 
     for (i = 0; i < sctx->sz; i++)
         state->grid[i].flags &= ~(F_REACHABLE|F_MULTIPLE);
 
-    for (i = 0; i < state->ndots; i++)
-        solver_expand_fromdot(state, state->dots[i], sctx);
+    for (i = 0; i < state->ndots; i++) {
+        space *dot = state->dots[i];
+
+        if (sctx->dirty[i]) {
+            int n = solver_expand_fromdot(state, dot, sctx), *bb;
+
+            sctx->reach[i] = sresize(sctx->reach[i], n, space *);
+            memcpy(sctx->reach[i], sctx->scratch, n * sizeof(space *));
+            sctx->nreach[i] = n;
+
+            bb = sctx->bbox + i*4;
+            bb[0] = bb[2] = dot->x;
+            bb[1] = bb[3] = dot->y;
+            for (j = 0; j < n; j++) {
+                bb[0] = min(bb[0], sctx->scratch[j]->x);
+                bb[1] = min(bb[1], sctx->scratch[j]->y);
+                bb[2] = max(bb[2], sctx->scratch[j]->x);
+                bb[3] = max(bb[3], sctx->scratch[j]->y);
+            }
+            sctx->dirty[i] = false;
+        }
+        solver_expand_mark(state, dot, sctx->reach[i], sctx->nreach[i]);
+    }
+    sctx->expanded = true;
+    dbg_state(state);
 
     return foreach_tile(state, solver_expand_postcb, IMPOSSIBLE_QUITS, sctx);
 }
 
+/* Like foreach_edge or foreach_tile with IMPOSSIBLE_QUITS, but only
+ * visiting the spaces of the right type on a to-do list. */
+static int solver_foreach_todo(game_state *state, tdq *todo, int type,
+                               space_cb cb, solver_ctx *sctx)
+{
+    int i, ret;
+    bool progress = false;
+
+    while ((i = tdq_remove(todo)) >= 0) {
+        if (state->grid[i].type != type) continue;
+        ret = cb(state, &state->grid[i], sctx);
+        if (ret == -1) return -1;
+        if (ret == 1) progress = true;
+    }
+    return progress ? 1 : 0;
+}
+
 struct recurse_ctx {
     space *best;
     int bestn;
@@ -2165,7 +2350,8 @@ static int solver_recurse_cb(game_state *state, space *tile, void *ctx)
 
 #define MAXRECURSE 5
 
-static int solver_recurse(game_state *state, int maxdiff)
+static int solver_recurse(game_state *state, int maxdiff,
+                          solver_ctx *sctx)
 {
     int diff = DIFF_IMPOSSIBLE, ret, n, gsz = state->sx * state->sy;
     space *ingrid, *outgrid = NULL, *bestopp;
@@ -2202,12 +2388,15 @@ static int solver_recurse(game_state *state, int maxdiff)
 
         if (!dotfortile(state, rctx.best, state->dots[n])) continue;
 
+        SOLVER_TIER("unreasonable: recursion");
+        SOLVER_RULE("guess");
+
         /* set cell (temporarily) pointing to that dot. */
-        solver_add_assoc(state, rctx.best,
+        solver_add_assoc(state, sctx, rctx.best,
                          state->dots[n]->x, state->dots[n]->y,
                          "Attempting for recursion");
 
-        ret = solver_state(state, maxdiff);
+        ret = solver_state_from(state, maxdiff, sctx);
 
         if (diff == DIFF_IMPOSSIBLE && ret != DIFF_IMPOSSIBLE) {
             /* we found our first solved grid; copy it away. */
@@ -2252,9 +2441,10 @@ static int solver_recurse(game_state *state, int maxdiff)
     return diff;
 }
 
-static int solver_state(game_state *state, int maxdiff)
+static int solver_state_from(game_state *state, int maxdiff,
+                             solver_ctx *parent)
 {
-    solver_ctx *sctx = new_solver(state);
+    solver_ctx *sctx = new_solver(state, parent);
     int ret, diff = DIFF_NORMAL;
 
 #ifdef STANDALONE_PICTURE_GENERATOR
@@ -2264,29 +2454,34 @@ static int solver_state(game_state *state, int maxdiff)
     picture = NULL;
 #endif
 
+    SOLVER_TIER("normal: lines, tiles and dots");
     ret = solver_obvious(state);
     if (ret < 0) {
         diff = DIFF_IMPOSSIBLE;
         goto got_result;
     }
 
-#define CHECKRET(d) do {                                        \
+#define CHECKRET(d, rule) do {                                  \
     if (ret < 0) { diff = DIFF_IMPOSSIBLE; goto got_result; }   \
-    if (ret > 0) { diff = max(diff, (d)); goto cont; }          \
+    if (ret > 0) {                                              \
+        SOLVER_RULE(rule);                                      \
+        diff = max(diff, (d));                                  \
+        goto cont;                                              \
+    }                                                           \
 } while(0)
 
     while (1) {
 cont:
-        ret = foreach_edge(state, solver_lines_opposite_cb,
-                           IMPOSSIBLE_QUITS, sctx);
-        CHECKRET(DIFF_NORMAL);
+        ret = solver_foreach_todo(state, sctx->edgetodo, s_edge,
+                                  solver_lines_opposite_cb, sctx);
+        CHECKRET(DIFF_NORMAL, "line mirrored across dot");
 
-        ret = foreach_tile(state, solver_spaces_oneposs_cb,
-                           IMPOSSIBLE_QUITS, sctx);
-        CHECKRET(DIFF_NORMAL);
+        ret = solver_foreach_todo(state, sctx->tiletodo, s_tile,
+                                  solver_spaces_oneposs_cb, sctx);
+        CHECKRET(DIFF_NORMAL, "tile has one dot");
 
         ret = solver_expand_dots(state, sctx);
-        CHECKRET(DIFF_NORMAL);
+        CHECKRET(DIFF_NORMAL, "dot expands");
 
         if (maxdiff <= DIFF_NORMAL)
             break;
@@ -2300,7 +2495,7 @@ cont:
     if (check_complete(state, NULL, NULL)) goto got_result;
 
     diff = (maxdiff >= DIFF_UNREASONABLE) ?
-        solver_recurse(state, maxdiff) : DIFF_UNFINISHED;
+        solver_recurse(state, maxdiff, sctx) : DIFF_UNFINISHED;
 
 got_result:
     free_solver(sctx);
@@ -2316,6 +2511,11 @@ got_result:
     return diff;
 }
 
+static int solver_state(game_state *state, int maxdiff)
+{
+    return solver_state_from(state, maxdiff, NULL);
+}
+
 #ifndef EDITOR
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *aux, const char **error)
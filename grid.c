@@ -46,10 +46,119 @@ void grid_free(grid *g)
         sfree(g->faces);
         sfree(g->edges);
         sfree(g->dots);
+        sfree(g->face_start);
+        sfree(g->face_edges);
+        sfree(g->face_dots);
+        sfree(g->dot_start);
+        sfree(g->dot_edges);
+        sfree(g->dot_faces);
+        sfree(g->edge_dots);
+        sfree(g->edge_faces);
         sfree(g);
     }
 }
 
+/* ----------------------------------------------------------------------
+ * Caches of recently made grids.
+ *
+ * Generating a puzzle can ask for the same grid more than once (a
+ * Penrose grid is test-generated to make its description, and then
+ * wanted again properly), and for some types of grid making one is
+ * slow. A caller expecting to do that can make a grid_cache for the
+ * job, pass it to grid_new_desc and grid_new, and free it afterwards.
+ * Since a grid is immutable once made, the cache holds a reference to
+ * each grid it keeps and hands out extra references to them.
+ */
+
+#define GRID_CACHE_SIZE 4
+
+struct grid_cache {
+    struct grid_cache_entry {
+        grid_type type;
+        int width, height;
+        char *desc;                    /* NULL if the grid type has none */
+        grid *g;                       /* NULL if the entry is unused */
+    } entries[GRID_CACHE_SIZE];
+};
+
+grid_cache *grid_cache_new(void)
+{
+    grid_cache *gc = snew(grid_cache);
+    int i;
+
+    for (i = 0; i < GRID_CACHE_SIZE; i++) {
+        gc->entries[i].desc = NULL;
+        gc->entries[i].g = NULL;
+    }
+    return gc;
+}
+
+void grid_cache_free(grid_cache *gc)
+{
+    int i;
+
+    for (i = 0; i < GRID_CACHE_SIZE && gc->entries[i].g; i++) {
+        grid_free(gc->entries[i].g);
+        sfree(gc->entries[i].desc);
+    }
+    sfree(gc);
+}
+
+/* Returns a new reference to a cached grid, or NULL if there isn't one
+ * (or no cache). */
+static grid *grid_cache_find(grid_cache *gc, grid_type type,
+                             int width, int height, const char *desc)
+{
+    struct grid_cache_entry e;
+    int i;
+
+    if (!gc)
+        return NULL;
+
+    for (i = 0; i < GRID_CACHE_SIZE && gc->entries[i].g; i++) {
+        if (gc->entries[i].type != type || gc->entries[i].width != width ||
+            gc->entries[i].height != height)
+            continue;
+        if (desc ? !gc->entries[i].desc || strcmp(gc->entries[i].desc, desc) :
+            gc->entries[i].desc != NULL)
+            continue;
+
+        /* Move it to the front, to be the last one thrown out. */
+        e = gc->entries[i];
+        memmove(gc->entries + 1, gc->entries, i * sizeof(*gc->entries));
+        gc->entries[0] = e;
+
+        e.g->refcount++;
+        return e.g;
+    }
+
+    return NULL;
+}
+
+static void grid_cache_add(grid_cache *gc, grid_type type,
+                           int width, int height, const char *desc, grid *g)
+{
+    struct grid_cache_entry *last;
+
+    if (!gc)
+        return;
+
+    last = &gc->entries[GRID_CACHE_SIZE-1];
+    if (last->g) {
+        grid_free(last->g);
+        sfree(last->desc);
+    }
+    memmove(gc->entries + 1, gc->entries,
+            (GRID_CACHE_SIZE-1) * sizeof(*gc->entries));
+
+    gc->entries[0].type = type;
+    gc->entries[0].width = width;
+    gc->entries[0].height = height;
+    gc->entries[0].desc = desc ? dupstr(desc) : NULL;
+    gc->entries[0].g = g;
+    g->refcount++;
+}
+
 /* Used by the other grid generators.  Create a brand new grid with nothing
  * initialised (all lists are NULL) */
 static grid *grid_empty(void)
@@ -59,6 +168,9 @@ static grid *grid_empty(void)
     g->edges = NULL;
     g->dots = NULL;
     g->num_faces = g->num_edges = g->num_dots = 0;
+    g->face_start = g->face_edges = g->face_dots = NULL;
+    g->dot_start = g->dot_edges = g->dot_faces = NULL;
+    g->edge_dots = g->edge_faces = NULL;
     g->refcount = 1;
     g->lowest_x = g->lowest_y = g->highest_x = g->highest_y = 0;
     return g;
@@ -786,6 +898,50 @@ static void grid_make_consistent(grid *g)
         }
     }
 
+    /* ====== Stage 5 ======
+     * Build the index lists, now that the pointer lists are complete
+     */
+
+    g->face_start = snewn(g->num_faces + 1, int);
+    g->face_start[0] = 0;
+    for (i = 0; i < g->num_faces; i++)
+        g->face_start[i+1] = g->face_start[i] + g->faces[i].order;
+    g->face_edges = snewn(g->face_start[g->num_faces], int);
+    g->face_dots = snewn(g->face_start[g->num_faces], int);
+    for (i = 0; i < g->num_faces; i++) {
+        grid_face *f = g->faces + i;
+        int j, k = g->face_start[i];
+        for (j = 0; j < f->order; j++) {
+            g->face_edges[k+j] = f->edges[j] - g->edges;
+            g->face_dots[k+j] = f->dots[j] - g->dots;
+        }
+    }
+
+    g->dot_start = snewn(g->num_dots + 1, int);
+    g->dot_start[0] = 0;
+    for (i = 0; i < g->num_dots; i++)
+        g->dot_start[i+1] = g->dot_start[i] + g->dots[i].order;
+    g->dot_edges = snewn(g->dot_start[g->num_dots], int);
+    g->dot_faces = snewn(g->dot_start[g->num_dots], int);
+    for (i = 0; i < g->num_dots; i++) {
+        grid_dot *d = g->dots + i;
+        int j, k = g->dot_start[i];
+        for (j = 0; j < d->order; j++) {
+            g->dot_edges[k+j] = d->edges[j] - g->edges;
+            g->dot_faces[k+j] = d->faces[j] ? d->faces[j] - g->faces : -1;
+        }
+    }
+
+    g->edge_dots = snewn(2 * g->num_edges, int);
+    g->edge_faces = snewn(2 * g->num_edges, int);
+    for (i = 0; i < g->num_edges; i++) {
+        grid_edge *e = g->edges + i;
+        g->edge_dots[2*i] = e->dot1 - g->dots;
+        g->edge_dots[2*i+1] = e->dot2 - g->dots;
+        g->edge_faces[2*i] = e->face1 ? e->face1 - g->faces : -1;
+        g->edge_faces[2*i+1] = e->face2 ? e->face2 - g->faces : -1;
+    }
+
     grid_debug_derived(g);
 }
 
@@ -2997,7 +3153,8 @@ static void grid_size_penrose(int width, int height,
 
 static grid *grid_new_penrose(int width, int height, int which, const char *desc); /* forward reference */
 
-static char *grid_new_desc_penrose(grid_type type, int width, int height, random_state *rs)
+static char *grid_new_desc_penrose(grid_type type, int width, int height,
+                                   random_state *rs, grid_cache *gc)
 {
     int tilesize = PENROSE_TILESIZE, startsz, depth, xoff, yoff, aoff;
     double outer_radius;
@@ -3040,6 +3197,8 @@ static char *grid_new_desc_penrose(grid_type type, int width, int height, random
          */
         g = grid_new_penrose(width, height, which, gd);
         if (g) {
+            /* Keep it for when we're asked for it properly. */
+            grid_cache_add(gc, type, width, height, gd, g);
             grid_free(g);
             break;
         }
@@ -3052,7 +3211,8 @@ static char *grid_new_desc_penrose(grid_type type, int width, int height, random
 
 static const char *grid_validate_desc_penrose(grid_type type,
                                               int width, int height,
-                                              const char *desc)
+                                              const char *desc,
+                                              grid_cache *gc)
 {
     int tilesize = PENROSE_TILESIZE, startsz, depth, xoff, yoff, aoff, inner_radius;
     double outer_radius;
@@ -3076,11 +3236,15 @@ static const char *grid_validate_desc_penrose(grid_type type,
 
     /*
      * Test-generate to ensure these parameters don't end us up with
-     * no grid at all.
+     * no grid at all, unless we've already got the grid to hand.
      */
-    g = grid_new_penrose(width, height, which, desc);
-    if (!g)
-        return "Patch coordinates do not identify a usable grid fragment";
+    g = grid_cache_find(gc, type, width, height, desc);
+    if (!g) {
+        g = grid_new_penrose(width, height, which, desc);
+        if (!g)
+            return "Patch coordinates do not identify a usable grid fragment";
+        grid_cache_add(gc, type, width, height, desc, g);
+    }
     grid_free(g);
 
     return NULL;
@@ -3217,10 +3381,11 @@ static grid *grid_new_penrose_p3_thick(int width, int height, const char *desc)
 static grid *(*(grid_news[]))(int, int, const char*) = { GRIDGEN_LIST(FNNEW) };
 static void(*(grid_sizes[]))(int, int, int*, int*, int*) = { GRIDGEN_LIST(FNSZ) };
 
-char *grid_new_desc(grid_type type, int width, int height, random_state *rs)
+char *grid_new_desc(grid_type type, int width, int height, random_state *rs,
+                    grid_cache *gc)
 {
     if (type == GRID_PENROSE_P2 || type == GRID_PENROSE_P3) {
-        return grid_new_desc_penrose(type, width, height, rs);
+        return grid_new_desc_penrose(type, width, height, rs, gc);
     } else if (type == GRID_TRIANGULAR) {
         return dupstr("0"); /* up-to-date version of triangular grid */
     } else {
@@ -3229,10 +3394,10 @@ char *grid_new_desc(grid_type type, int width, int height, random_state *rs)
 }
 
 const char *grid_validate_desc(grid_type type, int width, int height,
-                               const char *desc)
+                               const char *desc, grid_cache *gc)
 {
     if (type == GRID_PENROSE_P2 || type == GRID_PENROSE_P3) {
-        return grid_validate_desc_penrose(type, width, height, desc);
+        return grid_validate_desc_penrose(type, width, height, desc, gc);
     } else if (type == GRID_TRIANGULAR) {
         return grid_validate_desc_triangular(type, width, height, desc);
     } else {
@@ -3242,12 +3407,28 @@ const char *grid_validate_desc(grid_type type, int width, int height,
     }
 }
 
-grid *grid_new(grid_type type, int width, int height, const char *desc)
+grid *grid_new(grid_type type, int width, int height, const char *desc,
+              grid_cache *gc)
 {
-    const char *err = grid_validate_desc(type, width, height, desc);
+    const char *err;
+    grid *g;
+
+    /* Anything in the cache was valid when it went in. */
+    g = grid_cache_find(gc, type, width, height, desc);
+    if (g)
+        return g;
+
+    err = grid_validate_desc(type, width, height, desc, gc);
     if (err) assert(!"Invalid grid description.");
 
-    return grid_news[type](width, height, desc);
+    /* Validating a Penrose grid makes it, so look again. */
+    g = grid_cache_find(gc, type, width, height, desc);
+    if (g)
+        return g;
+
+    g = grid_news[type](width, height, desc);
+    grid_cache_add(gc, type, width, height, desc, g);
+    return g;
 }
 
 void grid_compute_size(grid_type type, int width, int height,
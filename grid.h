@@ -85,6 +85,20 @@ typedef struct grid {
    * of a square cell. */
   int tilesize;
 
+  /* The same relationships as the pointer lists above, in a compact
+   * form using indices, for code which wants to walk around the grid
+   * quickly. The edges and dots of face i are at face_edges[k] and
+   * face_dots[k] for k from face_start[i] to face_start[i+1]-1, in
+   * the same order as faces[i].edges and faces[i].dots; likewise the
+   * edges and faces of dot i are at dot_edges and dot_faces from
+   * dot_start[i]. The dots of edge i are edge_dots[2*i] and
+   * edge_dots[2*i+1] (dot1 and dot2), and its faces are edge_faces[2*i]
+   * and edge_faces[2*i+1]. A face which is NULL in the pointer lists
+   * (the infinite exterior face) is -1 here. */
+  int *face_start, *face_edges, *face_dots;
+  int *dot_start, *dot_edges, *dot_faces;
+  int *edge_dots, *edge_faces;
+
   /* We really don't want to copy this monstrosity!
    * A grid is immutable once generated.
    */
@@ -115,13 +129,26 @@ typedef struct grid {
 typedef enum grid_type { GRIDGEN_LIST(ENUM) GRID_TYPE_MAX } grid_type;
 #undef ENUM
 
+/* A cache of grids, for a caller which will ask for the same grid more
+ * than once in the course of one job. Pass NULL wherever a grid_cache is
+ * taken for no caching. Freeing the cache releases its own references
+ * to the grids, not the ones it has handed out. */
+typedef struct grid_cache grid_cache;
+grid_cache *grid_cache_new(void);
+void grid_cache_free(grid_cache *gc);
+
 /* Free directly after use if non-NULL. Will never contain an underscore
- * (so clients can safely use that as a separator). */
-char *grid_new_desc(grid_type type, int width, int height, random_state *rs);
+ * (so clients can safely use that as a separator). If making or
+ * checking a description means making the grid, it is kept in 'gc'. */
+char *grid_new_desc(grid_type type, int width, int height, random_state *rs,
+                    grid_cache *gc);
 const char *grid_validate_desc(grid_type type, int width, int height,
-                               const char *desc);
+                               const char *desc, grid_cache *gc);
 
-grid *grid_new(grid_type type, int width, int height, const char *desc);
+/* The grid returned may be shared with other callers of the same
+ * grid_cache, so it mustn't be modified. Release it with grid_free. */
+grid *grid_new(grid_type type, int width, int height, const char *desc,
+               grid_cache *gc);
 
 void grid_free(grid *g);
 
@@ -64,6 +64,7 @@ enum {
 struct game_params {
     int w, diff;
     bool multiplication_only;
+    bool uniform;
 };
 
 struct clues {
@@ -88,6 +89,7 @@ static game_params *default_params(void)
     ret->w = 6;
     ret->diff = DIFF_NORMAL;
     ret->multiplication_only = false;
+    ret->uniform = false;
 
     return ret;
 }
@@ -160,6 +162,11 @@ static void decode_params(game_params *params, char const *string)
 	p++;
 	params->multiplication_only = true;
     }
+
+    if (*p == 'u') {
+	p++;
+	params->uniform = true;
+    }
 }
 
 static char *encode_params(const game_params *params, bool full)
@@ -168,8 +175,9 @@ static char *encode_params(const game_params *params, bool full)
 
     sprintf(ret, "%d", params->w);
     if (full)
-        sprintf(ret + strlen(ret), "d%c%s", keen_diffchars[params->diff],
-		params->multiplication_only ? "m" : "");
+        sprintf(ret + strlen(ret), "d%c%s%s", keen_diffchars[params->diff],
+		params->multiplication_only ? "m" : "",
+		params->uniform ? "u" : "");
 
     return dupstr(ret);
 }
@@ -179,7 +187,7 @@ static config_item *game_configure(const game_params *params)
     config_item *ret;
     char buf[80];
 
-    ret = snewn(4, config_item);
+    ret = snewn(5, config_item);
 
     ret[0].name = "Grid size";
     ret[0].type = C_STRING;
@@ -195,8 +203,12 @@ static config_item *game_configure(const game_params *params)
     ret[2].type = C_BOOLEAN;
     ret[2].u.boolean.bval = params->multiplication_only;
 
-    ret[3].name = NULL;
-    ret[3].type = C_END;
+    ret[3].name = "Uniformly random solution";
+    ret[3].type = C_BOOLEAN;
+    ret[3].u.boolean.bval = params->uniform;
+
+    ret[4].name = NULL;
+    ret[4].type = C_END;
 
     return ret;
 }
@@ -208,6 +220,7 @@ static game_params *custom_params(const config_item *cfg)
     ret->w = atoi(cfg[0].u.string.sval);
     ret->diff = cfg[1].u.choices.selected;
     ret->multiplication_only = cfg[2].u.boolean.bval;
+    ret->uniform = cfg[3].u.boolean.bval;
 
     return ret;
 }
@@ -230,11 +243,166 @@ struct solver_ctx {
     int nboxes;
     int *boxes, *boxlist, *whichbox;
     long *clues;
-    digit *soln;
     digit *dscratch;
     int *iscratch;
+
+    /*
+     * Every layout of digits in each clue box which satisfies the
+     * clue and doesn't repeat a digit in a row or column, worked
+     * out the first time the box is examined (candnum[box] is -1
+     * until then) and kept for the lifetime of the context. Box b
+     * has candnum[b] layouts, each of n = boxes[b+1]-boxes[b]
+     * digits, stored in lexicographic order from
+     * cands[candstart[b]] on.
+     *
+     * candskip runs parallel to cands, and makes it cheap to skip
+     * layouts that the current state of the Latin cube rules out:
+     * for digit i of layout k, it gives the index of the next
+     * layout which differs from k somewhere in its first i+1
+     * digits.
+     */
+    digit *cands;
+    int *candskip;
+    int *candstart, *candnum;
+    int candlen, candsize;
+    unsigned *masks;
 };
 
+static void solver_add_candidate(struct solver_ctx *ctx, int box)
+{
+    int n = ctx->boxes[box+1] - ctx->boxes[box];
+
+    if (ctx->candlen + n > ctx->candsize) {
+	ctx->candsize = (ctx->candlen + n) * 3 / 2 + 64;
+	ctx->cands = sresize(ctx->cands, ctx->candsize, digit);
+	ctx->candskip = sresize(ctx->candskip, ctx->candsize, int);
+    }
+    memcpy(ctx->cands + ctx->candlen, ctx->dscratch, n * sizeof(digit));
+    ctx->candlen += n;
+    ctx->candnum[box]++;
+}
+
+static void solver_find_candidates(struct solver_ctx *ctx, int box)
+{
+    int w = ctx->w;
+    int *sq = ctx->boxlist + ctx->boxes[box];
+    int n = ctx->boxes[box+1] - ctx->boxes[box];
+    long value = ctx->clues[box] & ~CMASK;
+    long op = ctx->clues[box] & CMASK;
+    digit *cands;
+    int *skip;
+    int i, j, k, total;
+
+    ctx->candstart[box] = ctx->candlen;
+    ctx->candnum[box] = 0;
+
+    switch (op) {
+      case C_SUB:
+      case C_DIV:
+	/*
+	 * These two clue types must always apply to a box of area
+	 * 2. Also, the two digits in these boxes can never be the
+	 * same (because any domino must have its two squares in
+	 * either the same row or the same column). So we simply
+	 * list every ordered pair of digits satisfying the clue.
+	 */
+	assert(n == 2);
+
+	for (i = 1; i <= w; i++)
+	    for (j = 1; j <= w; j++)
+		if (op == C_SUB ? (i + value == j || j + value == i) :
+		    (i * value == j || j * value == i)) {
+		    ctx->dscratch[0] = i;
+		    ctx->dscratch[1] = j;
+		    solver_add_candidate(ctx, box);
+		}
+
+	break;
+
+      case C_ADD:
+      case C_MUL:
+	/*
+	 * For these clue types, I have no alternative but to go
+	 * through all possible number combinations.
+	 *
+	 * Instead of a tedious physical recursion, I iterate in the
+	 * scratch array through all possibilities. At any given
+	 * moment, i indexes the element of the box that will next
+	 * be incremented.
+	 */
+	i = 0;
+	ctx->dscratch[i] = 0;
+	total = value;		       /* start with the identity */
+	while (1) {
+	    if (i < n) {
+		/*
+		 * Find the next valid value for cell i.
+		 */
+		for (j = ctx->dscratch[i] + 1; j <= w; j++) {
+		    if (op == C_ADD ? (total < j) : (total % j != 0))
+			continue;      /* this one won't fit */
+		    for (k = 0; k < i; k++)
+			if (ctx->dscratch[k] == j &&
+			    (sq[k] % w == sq[i] % w ||
+			     sq[k] / w == sq[i] / w))
+			    break;     /* clashes with another row/col */
+		    if (k < i)
+			continue;
+
+		    /* Found one. */
+		    break;
+		}
+
+		if (j > w) {
+		    /* No valid values left; drop back. */
+		    i--;
+		    if (i < 0)
+			break;	       /* overall iteration is finished */
+		    if (op == C_ADD)
+			total += ctx->dscratch[i];
+		    else
+			total *= ctx->dscratch[i];
+		} else {
+		    /* Got a valid value; store it and move on. */
+		    ctx->dscratch[i++] = j;
+		    if (op == C_ADD)
+			total -= j;
+		    else
+			total /= j;
+		    ctx->dscratch[i] = 0;
+		}
+	    } else {
+		if (total == (op == C_ADD ? 0 : 1))
+		    solver_add_candidate(ctx, box);
+		i--;
+		if (op == C_ADD)
+		    total += ctx->dscratch[i];
+		else
+		    total *= ctx->dscratch[i];
+	    }
+	}
+
+	break;
+    }
+
+    /*
+     * Fill in the skip links, working backwards. Where layouts k
+     * and k+1 share their first m digits, k can skip as far as k+1
+     * does when it fails in one of those, and otherwise only to
+     * k+1.
+     */
+    cands = ctx->cands + ctx->candstart[box];
+    skip = ctx->candskip + ctx->candstart[box];
+    for (k = ctx->candnum[box] - 1; k >= 0; k--) {
+	int m = 0;
+	if (k+1 < ctx->candnum[box])
+	    while (m < n && cands[k*n+m] == cands[(k+1)*n+m])
+		m++;
+	for (i = 0; i < n; i++)
+	    skip[k*n+i] = (i < m ? skip[(k+1)*n+i] : k+1);
+    }
+}
+
 static void solver_clue_candidate(struct solver_ctx *ctx, int diff, int box)
 {
     int w = ctx->w;
@@ -325,7 +493,10 @@ static int solver_common(struct latin_solver *solver, void *vctx, int diff)
     struct solver_ctx *ctx = (struct solver_ctx *)vctx;
     int w = ctx->w;
     int box, i, j, k;
-    int ret = 0, total;
+    int ret = 0;
+    unsigned *masks = ctx->masks;
+    const digit *cands;
+    const int *skip;
 
     /*
      * Iterate over each clue box and deduce what we can.
@@ -333,8 +504,6 @@ static int solver_common(struct latin_solver *solver, void *vctx, int diff)
     for (box = 0; box < ctx->nboxes; box++) {
 	int *sq = ctx->boxlist + ctx->boxes[box];
 	int n = ctx->boxes[box+1] - ctx->boxes[box];
-	long value = ctx->clues[box] & ~CMASK;
-	long op = ctx->clues[box] & CMASK;
 
         /*
          * Initialise ctx->iscratch for this clue box. At different
@@ -350,111 +519,36 @@ static int solver_common(struct latin_solver *solver, void *vctx, int diff)
 		ctx->iscratch[i] = 0;
 	}
 
-	switch (op) {
-	  case C_SUB:
-	  case C_DIV:
-	    /*
-	     * These two clue types must always apply to a box of
-	     * area 2. Also, the two digits in these boxes can never
-	     * be the same (because any domino must have its two
-	     * squares in either the same row or the same column).
-	     * So we simply iterate over all possibilities for the
-	     * two squares (both ways round), rule out any which are
-	     * inconsistent with the digit constraints we already
-	     * have, and update the digit constraints with any new
-	     * information thus garnered.
-	     */
-	    assert(n == 2);
-
-	    for (i = 1; i <= w; i++) {
-		j = (op == C_SUB ? i + value : i * value);
-		if (j > w) break;
-
-		/* (i,j) is a valid digit pair. Try it both ways round. */
-
-		if (solver->cube[sq[0]*w+i-1] &&
-		    solver->cube[sq[1]*w+j-1]) {
-		    ctx->dscratch[0] = i;
-		    ctx->dscratch[1] = j;
-		    solver_clue_candidate(ctx, diff, box);
-		}
-
-		if (solver->cube[sq[0]*w+j-1] &&
-		    solver->cube[sq[1]*w+i-1]) {
-		    ctx->dscratch[0] = j;
-		    ctx->dscratch[1] = i;
-		    solver_clue_candidate(ctx, diff, box);
-		}
-	    }
-
-	    break;
-
-	  case C_ADD:
-	  case C_MUL:
-	    /*
-	     * For these clue types, I have no alternative but to go
-	     * through all possible number combinations.
-	     *
-	     * Instead of a tedious physical recursion, I iterate in
-	     * the scratch array through all possibilities. At any
-	     * given moment, i indexes the element of the box that
-	     * will next be incremented.
-	     */
-	    i = 0;
-	    ctx->dscratch[i] = 0;
-	    total = value;	       /* start with the identity */
-	    while (1) {
-		if (i < n) {
-		    /*
-		     * Find the next valid value for cell i.
-		     */
-		    for (j = ctx->dscratch[i] + 1; j <= w; j++) {
-			if (op == C_ADD ? (total < j) : (total % j != 0))
-			    continue;  /* this one won't fit */
-			if (!solver->cube[sq[i]*w+j-1])
-			    continue;  /* this one is ruled out already */
-			for (k = 0; k < i; k++)
-			    if (ctx->dscratch[k] == j &&
-				(sq[k] % w == sq[i] % w ||
-				 sq[k] / w == sq[i] / w))
-				break; /* clashes with another row/col */
-			if (k < i)
-			    continue;
-
-			/* Found one. */
-			break;
-		    }
-
-		    if (j > w) {
-			/* No valid values left; drop back. */
-			i--;
-			if (i < 0)
-			    break;     /* overall iteration is finished */
-			if (op == C_ADD)
-			    total += ctx->dscratch[i];
-			else
-			    total *= ctx->dscratch[i];
-		    } else {
-			/* Got a valid value; store it and move on. */
-			ctx->dscratch[i++] = j;
-			if (op == C_ADD)
-			    total -= j;
-			else
-			    total /= j;
-			ctx->dscratch[i] = 0;
-		    }
-		} else {
-		    if (total == (op == C_ADD ? 0 : 1))
-			solver_clue_candidate(ctx, diff, box);
-		    i--;
-		    if (op == C_ADD)
-			total += ctx->dscratch[i];
-		    else
-			total *= ctx->dscratch[i];
-		}
+	/*
+	 * Go through the candidate layouts for the box, and pass
+	 * each one still consistent with the cube to
+	 * solver_clue_candidate. We keep a bitmap of the digits still
+	 * possible in each square, so each layout can be checked with
+	 * a mask per digit; a layout failing at digit i lets us jump
+	 * past every other layout sharing its first i+1 digits.
+	 */
+	if (ctx->candnum[box] < 0)
+	    solver_find_candidates(ctx, box);
+	for (i = 0; i < n; i++) {
+	    masks[i] = 0;
+	    for (j = 1; j <= w; j++)
+		if (solver->cube[sq[i]*w+j-1])
+		    masks[i] |= 1 << j;
+	}
+	cands = ctx->cands + ctx->candstart[box];
+	skip = ctx->candskip + ctx->candstart[box];
+	k = 0;
+	while (k < ctx->candnum[box]) {
+	    for (i = 0; i < n; i++)
+		if (!(masks[i] & (1 << cands[k*n+i])))
+		    break;
+	    if (i < n) {
+		k = skip[k*n+i];
+	    } else {
+		memcpy(ctx->dscratch, cands + k*n, n * sizeof(digit));
+		solver_clue_candidate(ctx, diff, box);
+		k++;
 	    }
-
-	    break;
 	}
 
         /*
@@ -677,16 +771,19 @@ static bool keen_valid(struct latin_solver *solver, void *vctx)
     return true;
 }
 
-static int solver(int w, int *dsf, long *clues, digit *soln, int maxdiff)
+/*
+ * Set up a solver context for a given clue layout. The same context
+ * can be used for several runs of solver_run, e.g. at different
+ * difficulty levels, so that they share the work of listing each
+ * clue's possible layouts.
+ */
+static void solver_ctx_init(struct solver_ctx *ctx, int w, int *dsf,
+                            long *clues)
 {
     int a = w*w;
-    struct solver_ctx ctx;
-    int ret;
     int i, j, n, m;
-    
-    ctx.w = w;
-    ctx.soln = soln;
-    ctx.diff = maxdiff;
+
+    ctx->w = w;
 
     /*
      * Transform the dsf-formatted clue list into one over which we
@@ -696,42 +793,73 @@ static int solver(int w, int *dsf, long *clues, digit *soln, int maxdiff)
      * because the 'cube' array in the general Latin square solver
      * puts x first (oops).
      */
-    for (ctx.nboxes = i = 0; i < a; i++)
+    for (ctx->nboxes = i = 0; i < a; i++)
 	if (dsf_canonify(dsf, i) == i)
-	    ctx.nboxes++;
-    ctx.boxlist = snewn(a, int);
-    ctx.boxes = snewn(ctx.nboxes+1, int);
-    ctx.clues = snewn(ctx.nboxes, long);
-    ctx.whichbox = snewn(a, int);
+	    ctx->nboxes++;
+    ctx->boxlist = snewn(a, int);
+    ctx->boxes = snewn(ctx->nboxes+1, int);
+    ctx->clues = snewn(ctx->nboxes, long);
+    ctx->whichbox = snewn(a, int);
     for (n = m = i = 0; i < a; i++)
 	if (dsf_canonify(dsf, i) == i) {
-	    ctx.clues[n] = clues[i];
-	    ctx.boxes[n] = m;
+	    ctx->clues[n] = clues[i];
+	    ctx->boxes[n] = m;
 	    for (j = 0; j < a; j++)
 		if (dsf_canonify(dsf, j) == i) {
-		    ctx.boxlist[m++] = (j % w) * w + (j / w);   /* transpose */
-		    ctx.whichbox[ctx.boxlist[m-1]] = n;
+		    ctx->boxlist[m++] = (j % w) * w + (j / w);   /* transpose */
+		    ctx->whichbox[ctx->boxlist[m-1]] = n;
 		}
 	    n++;
 	}
-    assert(n == ctx.nboxes);
+    assert(n == ctx->nboxes);
     assert(m == a);
-    ctx.boxes[n] = m;
+    ctx->boxes[n] = m;
+
+    ctx->dscratch = snewn(a+1, digit);
+    ctx->iscratch = snewn(max(a+1, 4*w), int);
+
+    ctx->cands = NULL;
+    ctx->candskip = NULL;
+    ctx->candlen = ctx->candsize = 0;
+    ctx->candstart = snewn(ctx->nboxes, int);
+    ctx->candnum = snewn(ctx->nboxes, int);
+    for (i = 0; i < ctx->nboxes; i++)
+	ctx->candnum[i] = -1;
+    ctx->masks = snewn(a, unsigned);
+}
 
-    ctx.dscratch = snewn(a+1, digit);
-    ctx.iscratch = snewn(max(a+1, 4*w), int);
+static void solver_ctx_cleanup(struct solver_ctx *ctx)
+{
+    sfree(ctx->dscratch);
+    sfree(ctx->iscratch);
+    sfree(ctx->whichbox);
+    sfree(ctx->boxlist);
+    sfree(ctx->boxes);
+    sfree(ctx->clues);
+    sfree(ctx->cands);
+    sfree(ctx->candskip);
+    sfree(ctx->candstart);
+    sfree(ctx->candnum);
+    sfree(ctx->masks);
+}
+
+static int solver_run(struct solver_ctx *ctx, digit *soln, int maxdiff)
+{
+    ctx->diff = maxdiff;
+    return latin_solver(soln, ctx->w, maxdiff,
+			DIFF_EASY, DIFF_HARD, DIFF_EXTREME,
+			DIFF_EXTREME, DIFF_UNREASONABLE,
+			keen_solvers, keen_valid, ctx, NULL, NULL);
+}
 
-    ret = latin_solver(soln, w, maxdiff,
-		       DIFF_EASY, DIFF_HARD, DIFF_EXTREME,
-		       DIFF_EXTREME, DIFF_UNREASONABLE,
-		       keen_solvers, keen_valid, &ctx, NULL, NULL);
+static int solver(int w, int *dsf, long *clues, digit *soln, int maxdiff)
+{
+    struct solver_ctx ctx;
+    int ret;
 
-    sfree(ctx.dscratch);
-    sfree(ctx.iscratch);
-    sfree(ctx.whichbox);
-    sfree(ctx.boxlist);
-    sfree(ctx.boxes);
-    sfree(ctx.clues);
+    solver_ctx_init(&ctx, w, dsf, clues);
+    ret = solver_run(&ctx, soln, maxdiff);
+    solver_ctx_cleanup(&ctx);
 
     return ret;
 }
@@ -894,6 +1022,8 @@ static char *new_game_desc(const game_params *params, random_state *rs,
     long *clues, *cluevals;
     int i, j, k, n, x, y, ret;
     int diff = params->diff;
+    struct solver_ctx sctx;
+    bool ok;
     char *desc, *p;
 
     /*
@@ -937,7 +1067,8 @@ done
 	 * First construct a latin square to be the solution.
 	 */
 	sfree(grid);
-	grid = latin_generate(w, rs);
+	grid = params->uniform ? latin_generate_jm(w, rs) :
+	    latin_generate(w, rs);
 
 	/*
 	 * Divide the grid into arbitrarily sized blocks, but so as
@@ -1216,15 +1347,22 @@ done
 	 * See if the game can be solved at the specified difficulty
 	 * level, but not at the one below.
 	 */
+	solver_ctx_init(&sctx, w, dsf, clues);
+	ok = true;
 	if (diff > 0) {
 	    memset(soln, 0, a);
-	    ret = solver(w, dsf, clues, soln, diff-1);
+	    ret = solver_run(&sctx, soln, diff-1);
 	    if (ret <= diff-1)
-		continue;
+		ok = false;
+	}
+	if (ok) {
+	    memset(soln, 0, a);
+	    ret = solver_run(&sctx, soln, diff);
+	    if (ret != diff)
+		ok = false;
 	}
-	memset(soln, 0, a);
-	ret = solver(w, dsf, clues, soln, diff);
-	if (ret != diff)
+	solver_ctx_cleanup(&sctx);
+	if (!ok)
 	    continue;		       /* go round again */
 
 	/*
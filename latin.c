@@ -523,6 +523,7 @@ int latin_solver_forcing(struct latin_solver *solver,
                                 }
 #endif
                                 cube(xt, yt, orign) = false;
+                                SOLVER_RULE("forcing chain");
                                 return 1;
                             }
                         }
@@ -614,6 +615,7 @@ int latin_solver_diff_simple(struct latin_solver *solver)
 					y+1
 #endif
 					);
+                if (ret > 0) SOLVER_RULE("positional elimination");
                 if (ret != 0) return ret;
             }
     /*
@@ -628,6 +630,7 @@ int latin_solver_diff_simple(struct latin_solver *solver)
 					" %s in column %d", names[n-1], x+1
 #endif
 					);
+                if (ret > 0) SOLVER_RULE("positional elimination");
                 if (ret != 0) return ret;
             }
 
@@ -643,6 +646,7 @@ int latin_solver_diff_simple(struct latin_solver *solver)
 					x+1, y+1
 #endif
 					);
+                if (ret > 0) SOLVER_RULE("numeric elimination");
                 if (ret != 0) return ret;
             }
     return 0;
@@ -667,6 +671,7 @@ int latin_solver_diff_set(struct latin_solver *solver,
                                    , "set elimination, row %d", y+1
 #endif
                                   );
+            if (ret > 0) SOLVER_RULE("set elimination");
             if (ret != 0) return ret;
         }
         /*
@@ -678,6 +683,7 @@ int latin_solver_diff_set(struct latin_solver *solver,
                                    , "set elimination, column %d", x+1
 #endif
                                   );
+            if (ret > 0) SOLVER_RULE("set elimination");
             if (ret != 0) return ret;
         }
     } else {
@@ -692,12 +698,29 @@ int latin_solver_diff_set(struct latin_solver *solver,
 				   names[n-1]
 #endif
                                   );
+            if (ret > 0) SOLVER_RULE("positional set elimination");
             if (ret != 0) return ret;
         }
     }
     return 0;
 }
 
+#ifdef STANDALONE_SOLVERBENCH
+/*
+ * Names for solverbench's tiers. The games' own names for their
+ * difficulty levels aren't visible from here, so we just number the
+ * levels from the easiest up, in the order of each game's menu.
+ */
+static const char *latin_tier_name(int diff)
+{
+    static const char *const names[] = {
+        "difficulty 0", "difficulty 1", "difficulty 2", "difficulty 3",
+        "difficulty 4", "difficulty 5", "difficulty 6", "difficulty 7",
+    };
+    return names[min(diff, (int)lenof(names) - 1)];
+}
+#endif
+
 /*
  * Returns:
  * 0 for 'didn't do anything' implying it was already solved.
@@ -797,6 +820,8 @@ static int latin_solver_recurse
 
             memcpy(outgrid, ingrid, o*o);
             outgrid[y*o+x] = list[i];
+            SOLVER_TIER(latin_tier_name(diff_recursive));
+            SOLVER_RULE("guess");
 
 #ifdef STANDALONE_SOLVER
             if (solver_show_working)
@@ -902,9 +927,11 @@ static int latin_solver_top(struct latin_solver *solver, int maxdiff,
         latin_solver_debug(solver->cube, solver->o);
 
 	for (i = 0; i <= maxdiff; i++) {
-	    if (usersolvers[i])
+	    SOLVER_TIER(latin_tier_name(i));
+	    if (usersolvers[i]) {
 		ret = usersolvers[i](solver, ctx);
-	    else
+		if (ret > 0) SOLVER_RULE("game-specific deduction");
+	    } else
 		ret = 0;
 	    if (ret == 0 && i == diff_simple)
 		ret = latin_solver_diff_simple(solver);
@@ -1236,6 +1263,200 @@ digit *latin_generate_rect(int w, int h, random_state *rs)
     return latin_rect;
 }
 
+/*
+ * Alternative generator: the Jacobson-Matthews random walk.
+ *
+ * We view a latin square as a 0/1 incidence cube with exactly one 1
+ * on every line (fixed row and column, row and symbol, or column and
+ * symbol). A move picks a 0 cell (r,c,s) and adds +1/-1 around a
+ * 2x2x2 subcube with corners at (r,c,s) and (r',c',s'), where the
+ * other coordinates are chosen so that all the line sums stay at 1.
+ * That can leave a single -1 at (r',c',s'), giving an 'improper'
+ * square, whose three lines through the -1 each hold two 1s; the
+ * next move then starts from the -1 cell, choosing one of each pair
+ * at random. Jacobson and Matthews showed that this walk converges
+ * to the uniform distribution over latin squares of order o.
+ *
+ * Each move costs O(1), but an improper square typically takes about
+ * o moves to become proper again. We stop after landing on a proper
+ * square o^2 times (see below), so a square costs about o^3 moves.
+ * That's a heuristic for how long the walk takes to mix, and it's
+ * slower than latin_generate in practice; what we get for it is an
+ * unbiased choice of square, which latin_generate doesn't promise.
+ *
+ * We don't store the cube itself. For each line we record the
+ * positions of its 1s in two slots (the second is only ever used
+ * for the lines through the -1 cell), and the -1 cell separately.
+ */
+struct jmwalk {
+    int o;
+    int *sym;                          /* (row,col) -> symbols */
+    int *col;                          /* (row,symbol) -> columns */
+    int *row;                          /* (col,symbol) -> rows */
+    int ir, ic, is;                    /* the -1 cell, if ir >= 0 */
+};
+
+#define JMSYM(w,r,c) ((w)->sym + 2*((r)*(w)->o+(c)))
+#define JMCOL(w,r,s) ((w)->col + 2*((r)*(w)->o+(s)))
+#define JMROW(w,c,s) ((w)->row + 2*((c)*(w)->o+(s)))
+
+static void jm_slot_add(int *slots, int v)
+{
+    if (slots[0] < 0) {
+        slots[0] = v;
+    } else {
+        assert(slots[1] < 0);
+        slots[1] = v;
+    }
+}
+
+static void jm_slot_remove(int *slots, int v)
+{
+    if (slots[0] == v) {
+        slots[0] = slots[1];
+    } else {
+        assert(slots[1] == v);
+    }
+    slots[1] = -1;
+}
+
+static void jm_inc(struct jmwalk *w, int r, int c, int s)
+{
+    if (r == w->ir && c == w->ic && s == w->is) {
+        w->ir = -1;                    /* -1 becomes 0 */
+        return;
+    }
+    jm_slot_add(JMSYM(w,r,c), s);
+    jm_slot_add(JMCOL(w,r,s), c);
+    jm_slot_add(JMROW(w,c,s), r);
+}
+
+static void jm_dec(struct jmwalk *w, int r, int c, int s)
+{
+    int *syms = JMSYM(w,r,c);
+
+    if (syms[0] == s || syms[1] == s) {
+        jm_slot_remove(syms, s);
+        jm_slot_remove(JMCOL(w,r,s), c);
+        jm_slot_remove(JMROW(w,c,s), r);
+    } else {
+        assert(w->ir < 0);             /* 0 becomes -1 */
+        w->ir = r;
+        w->ic = c;
+        w->is = s;
+    }
+}
+
+static void jm_move(struct jmwalk *w, random_state *rs)
+{
+    int o = w->o;
+    int r, c, s, r2, c2, s2;
+
+    /*
+     * Random numbers are most of the cost of a move, so we draw only
+     * one for each: in a proper square, an index into its o^2(o-1)
+     * 0 cells, and in an improper one, a bit for each of the choices.
+     */
+    if (w->ir < 0) {
+        /* Proper square: pick any 0 cell, and the 1s on its lines. */
+        unsigned long n = random_upto(rs, (unsigned long)o*o*(o-1));
+        s = n % (o-1);
+        n /= o-1;
+        c = n % o;
+        r = n / o;
+        s2 = JMSYM(w,r,c)[0];
+        if (s >= s2)
+            s++;
+        c2 = JMCOL(w,r,s)[0];
+        r2 = JMROW(w,c,s)[0];
+    } else {
+        /* Improper square: start from the -1 cell, choosing 1s freely. */
+        unsigned long bits = random_bits(rs, 3);
+        r = w->ir;
+        c = w->ic;
+        s = w->is;
+        s2 = JMSYM(w,r,c)[bits & 1];
+        c2 = JMCOL(w,r,s)[(bits >> 1) & 1];
+        r2 = JMROW(w,c,s)[bits >> 2];
+    }
+
+    /*
+     * Increment the starting cell first, so that any old -1 has gone
+     * before (r2,c2,s2) can become a new one; then do the remaining
+     * decrements before the increments, so that no line ever needs
+     * more than two slots.
+     */
+    jm_inc(w, r, c, s);
+    jm_dec(w, r, c, s2);
+    jm_dec(w, r, c2, s);
+    jm_dec(w, r2, c, s);
+    jm_dec(w, r2, c2, s2);
+    jm_inc(w, r, c2, s2);
+    jm_inc(w, r2, c, s2);
+    jm_inc(w, r2, c2, s);
+}
+
+digit *latin_generate_jm(int o, random_state *rs)
+{
+    struct jmwalk w;
+    digit *sq;
+    int *rowperm, *colperm, *symperm;
+    int i, r, c;
+    long landings;
+
+    w.o = o;
+    w.sym = snewn(2*o*o, int);
+    w.col = snewn(2*o*o, int);
+    w.row = snewn(2*o*o, int);
+    w.ir = -1;
+    for (i = 0; i < 2*o*o; i++)
+        w.sym[i] = w.col[i] = w.row[i] = -1;
+
+    /*
+     * Start from a cyclic square with its rows, columns and symbols
+     * shuffled, which gets the walk off to a reasonable start.
+     */
+    rowperm = snewn(o, int);
+    colperm = snewn(o, int);
+    symperm = snewn(o, int);
+    for (i = 0; i < o; i++)
+        rowperm[i] = colperm[i] = symperm[i] = i;
+    shuffle(rowperm, o, sizeof(*rowperm), rs);
+    shuffle(colperm, o, sizeof(*colperm), rs);
+    shuffle(symperm, o, sizeof(*symperm), rs);
+    for (r = 0; r < o; r++)
+        for (c = 0; c < o; c++)
+            jm_inc(&w, rowperm[r], colperm[c], symperm[(r+c) % o]);
+    sfree(rowperm);
+    sfree(colperm);
+    sfree(symperm);
+
+    /*
+     * Walk until we've landed on a proper square o^2 times. Counting
+     * only the proper squares (rather than making a fixed number of
+     * moves and then stopping at the next proper square, which turns
+     * out to favour some squares over others) means that we follow
+     * the walk restricted to proper squares, which is itself uniform
+     * in the limit. There are no 0 cells to move from below order 2.
+     */
+    if (o > 1) {
+        for (landings = (long)o*o; landings > 0; ) {
+            jm_move(&w, rs);
+            if (w.ir < 0)
+                landings--;
+        }
+    }
+
+    sq = snewn(o*o, digit);
+    for (i = 0; i < o*o; i++)
+        sq[i] = w.sym[2*i] + 1;
+
+    sfree(w.sym);
+    sfree(w.col);
+    sfree(w.row);
+    return sq;
+}
+
 /* --------------------------------------------------------
  * Checking.
  */
@@ -1309,6 +1530,12 @@ bool latin_check(digit *sq, int order)
 #include <time.h>
 
 const char *quis;
+static bool use_jm = false;
+
+static digit *generate(int order, random_state *rs)
+{
+    return use_jm ? latin_generate_jm(order, rs) : latin_generate(order, rs);
+}
 
 static void latin_print(digit *sq, int order)
 {
@@ -1329,7 +1556,7 @@ static void gen(int order, random_state *rs, int debug)
 
     solver_show_working = debug;
 
-    sq = latin_generate(order, rs);
+    sq = generate(order, rs);
     latin_print(sq, order);
     if (latin_check(sq, order)) {
 	fprintf(stderr, "Square is not a latin square!");
@@ -1349,7 +1576,7 @@ void test_soak(int order, random_state *rs)
     tt_now = tt_start = time(NULL);
 
     while(1) {
-        sq = latin_generate(order, rs);
+        sq = generate(order, rs);
         sfree(sq);
         n++;
 
@@ -1366,7 +1593,7 @@ void usage_exit(const char *msg)
 {
     if (msg)
         fprintf(stderr, "%s: %s\n", quis, msg);
-    fprintf(stderr, "Usage: %s [--seed SEED] --soak <params> | [game_id [game_id ...]]\n", quis);
+    fprintf(stderr, "Usage: %s [--seed SEED] [--jm] --soak <params> | [game_id [game_id ...]]\n", quis);
     exit(1);
 }
 
@@ -1381,6 +1608,8 @@ int main(int argc, char *argv[])
 	const char *p = *++argv;
 	if (!strcmp(p, "--soak"))
 	    soak = 1;
+	else if (!strcmp(p, "--jm"))
+	    use_jm = true;
 	else if (!strcmp(p, "--seed")) {
 	    if (argc == 0)
 		usage_exit("--seed needs an argument");
@@ -113,6 +113,14 @@ void latin_solver_debug(unsigned char *cube, int o);
 
 digit *latin_generate(int o, random_state *rs);
 
+/*
+ * As latin_generate, but by a Jacobson-Matthews random walk, which
+ * chooses (near enough) uniformly among all latin squares of order o.
+ * It's slower than latin_generate, and its output for a given
+ * random_state differs.
+ */
+digit *latin_generate_jm(int o, random_state *rs);
+
 /* The order of the latin rectangle is max(w,h). */
 digit *latin_generate_rect(int w, int h, random_state *rs);
 
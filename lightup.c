@@ -796,6 +796,195 @@ static void place_numbers(game_state *state)
 
 /* --- Actual solver, with helper subroutines. --- */
 
+#define MAXRECURSE 5
+
+/*
+ * Nothing the solver does can change which squares are black, so
+ * we work out once per grid which squares a light at each square
+ * would light, instead of walking the grid every time.
+ *
+ * Also, when the solver makes a guess, it doesn't take a copy of
+ * the game_state to try the other possibility in. Instead, every
+ * change to a square goes through solver_save(), which records what
+ * the square held beforehand on a trail, and solver_undo() puts
+ * things back as they were. If the first possibility found a
+ * solution which we later want to go back to, we keep a copy of
+ * just the solved flags and lights, one per recursion depth.
+ */
+struct trail_entry {
+    int i;                 /* square index, or -1 for state->nlights */
+    unsigned int flags;
+    int lights;
+};
+
+struct solver_ctx {
+    int w, h;
+    ll_data *lld;
+    int *clues;                      /* 4 per square: adjacent clues, or -1 */
+    int *setpos, *setstamp, stamp;   /* see discount_set */
+    struct trail_entry *trail;
+    int ntrail, trailsize;
+    unsigned int *savedflags;        /* MAXRECURSE copies of flags */
+    int *savedlights;                /* ... and of lights */
+    int savednlights[MAXRECURSE];
+};
+
+static struct solver_ctx *new_solver_ctx(game_state *state)
+{
+    struct solver_ctx *sc = snew(struct solver_ctx);
+    int w = state->w, h = state->h, x, y;
+
+    sc->w = w;
+    sc->h = h;
+    sc->lld = snewn(w*h, ll_data);
+    sc->clues = snewn(4*w*h, int);
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            surrounds s;
+            int i, n = 0;
+
+            list_lights(state, x, y, false, &sc->lld[y*w+x]);
+
+            get_surrounds(state, x, y, &s);
+            for (i = 0; i < s.npoints; i++)
+                if (GRID(state,flags,s.points[i].x,s.points[i].y) & F_NUMBERED)
+                    sc->clues[4*(y*w+x) + n++] = s.points[i].y*w+s.points[i].x;
+            while (n < 4)
+                sc->clues[4*(y*w+x) + n++] = -1;
+        }
+    }
+    sc->setpos = snewn(w*h, int);
+    sc->setstamp = snewn(w*h, int);
+    for (x = 0; x < w*h; x++)
+        sc->setstamp[x] = 0;
+    sc->stamp = 0;
+    sc->trail = NULL;
+    sc->ntrail = sc->trailsize = 0;
+    sc->savedflags = NULL;
+    sc->savedlights = NULL;
+
+    return sc;
+}
+
+static void free_solver_ctx(struct solver_ctx *sc)
+{
+    sfree(sc->lld);
+    sfree(sc->clues);
+    sfree(sc->setpos);
+    sfree(sc->setstamp);
+    sfree(sc->trail);
+    sfree(sc->savedflags);
+    sfree(sc->savedlights);
+    sfree(sc);
+}
+
+/* As list_lights, from the precomputed copy. */
+static void solver_lights(struct solver_ctx *sc, int ox, int oy, bool origin,
+                          ll_data *lld)
+{
+    *lld = sc->lld[oy*sc->w+ox];
+    lld->include_origin = origin;
+}
+
+static void solver_save(struct solver_ctx *sc, game_state *state, int i)
+{
+    struct trail_entry *t;
+
+    if (sc->ntrail >= sc->trailsize) {
+        sc->trailsize = sc->trailsize * 3 / 2 + 64;
+        sc->trail = sresize(sc->trail, sc->trailsize, struct trail_entry);
+    }
+    t = &sc->trail[sc->ntrail++];
+    t->i = i;
+    if (i < 0) {
+        t->lights = state->nlights;
+    } else {
+        t->flags = state->flags[i];
+        t->lights = state->lights[i];
+    }
+}
+
+static void solver_undo(struct solver_ctx *sc, game_state *state, int mark)
+{
+    while (sc->ntrail > mark) {
+        struct trail_entry *t = &sc->trail[--sc->ntrail];
+        if (t->i < 0) {
+            state->nlights = t->lights;
+        } else {
+            state->flags[t->i] = t->flags;
+            state->lights[t->i] = t->lights;
+        }
+    }
+}
+
+/* Set flag bits on a square, recording its old flags on the trail. */
+static void solver_set_flags(struct solver_ctx *sc, game_state *state,
+                             int x, int y, unsigned int flags)
+{
+    int i = y*state->w+x;
+
+    if ((state->flags[i] & flags) == flags) return;
+    solver_save(sc, state, i);
+    state->flags[i] |= flags;
+}
+
+/* As set_light(state, x, y, true), recording everything it changes. */
+static void solver_place_light(struct solver_ctx *sc, game_state *state,
+                               int x, int y)
+{
+    ll_data lld;
+
+    assert(!(GRID(state,flags,x,y) & F_BLACK));
+    if (GRID(state,flags,x,y) & F_LIGHT) return;
+
+    solver_save(sc, state, -1);
+    solver_lights(sc, x, y, true, &lld);
+    FOREACHLIT(&lld, {
+        solver_save(sc, state, ly*state->w+lx);
+        GRID(state,lights,lx,ly)++;
+    });
+    GRID(state,flags,x,y) |= F_LIGHT;
+    state->nlights++;
+}
+
+/* Keep a copy of the current solution, found at the given depth. */
+static void solver_keep(struct solver_ctx *sc, game_state *state, int depth)
+{
+    int wh = sc->w*sc->h;
+
+    if (!sc->savedflags) {
+        sc->savedflags = snewn(MAXRECURSE*wh, unsigned int);
+        sc->savedlights = snewn(MAXRECURSE*wh, int);
+    }
+    memcpy(sc->savedflags + depth*wh, state->flags, wh*sizeof(unsigned int));
+    memcpy(sc->savedlights + depth*wh, state->lights, wh*sizeof(int));
+    sc->savednlights[depth] = state->nlights;
+}
+
+/*
+ * Undo back to the given mark, and then put back the solution kept
+ * at the given depth, through the trail so that our caller can
+ * still undo it in turn.
+ */
+static void solver_restore(struct solver_ctx *sc, game_state *state,
+                           int mark, int depth)
+{
+    int wh = sc->w*sc->h, i;
+    unsigned int *flags = sc->savedflags + depth*wh;
+    int *lights = sc->savedlights + depth*wh;
+
+    solver_undo(sc, state, mark);
+    for (i = 0; i < wh; i++) {
+        if (state->flags[i] != flags[i] || state->lights[i] != lights[i]) {
+            solver_save(sc, state, i);
+            state->flags[i] = flags[i];
+            state->lights[i] = lights[i];
+        }
+    }
+    solver_save(sc, state, -1);
+    state->nlights = sc->savednlights[depth];
+}
+
 static void tsl_callback(game_state *state,
                          int lx, int ly, int *x, int *y, int *n)
 {
@@ -804,8 +993,8 @@ static void tsl_callback(game_state *state,
     *x = lx; *y = ly; (*n)++;
 }
 
-static bool try_solve_light(game_state *state, int ox, int oy,
-                            unsigned int flags, int lights)
+static bool try_solve_light(struct solver_ctx *sc, game_state *state,
+                            int ox, int oy, unsigned int flags, int lights)
 {
     ll_data lld;
     int sx = 0, sy = 0, n = 0;
@@ -817,10 +1006,10 @@ static bool try_solve_light(game_state *state, int ox, int oy,
      * place a light that lights us (including this square); if only
      * one, we must put a light there. Squares that could light us
      * are, of course, the same as the squares we would light... */
-    list_lights(state, ox, oy, true, &lld);
+    solver_lights(sc, ox, oy, true, &lld);
     FOREACHLIT(&lld, { tsl_callback(state, lx, ly, &sx, &sy, &n); });
     if (n == 1) {
-        set_light(state, sx, sy, true);
+        solver_place_light(sc, state, sx, sy);
 #ifdef SOLVER_DIAGNOSTICS
         debug(("(%d,%d) can only be lit from (%d,%d); setting to LIGHT\n",
                 ox,oy,sx,sy));
@@ -847,8 +1036,8 @@ static bool could_place_light_xy(game_state *state, int x, int y)
 
 /* For a given number square, determine whether we have enough info
  * to unambiguously place its lights. */
-static bool try_solve_number(game_state *state, int nx, int ny,
-                             unsigned int nflags, int nlights)
+static bool try_solve_number(struct solver_ctx *sc, game_state *state,
+                             int nx, int ny, unsigned int nflags, int nlights)
 {
     surrounds s;
     int x, y, nl, ns, i, lights;
@@ -880,10 +1069,11 @@ static bool try_solve_number(game_state *state, int nx, int ny,
     if (nl == 0) {
         /* we have placed all lights we need to around here; all remaining
          * surrounds are therefore IMPOSSIBLE. */
-        GRID(state,flags,nx,ny) |= F_NUMBERUSED;
+        solver_set_flags(sc, state, nx, ny, F_NUMBERUSED);
         for (i = 0; i < s.npoints; i++) {
             if (!(s.points[i].f & F_MARK)) {
-                GRID(state,flags,s.points[i].x,s.points[i].y) |= F_IMPOSSIBLE;
+                solver_set_flags(sc, state, s.points[i].x, s.points[i].y,
+                                 F_IMPOSSIBLE);
                 ret = true;
             }
         }
@@ -894,10 +1084,10 @@ static bool try_solve_number(game_state *state, int nx, int ny,
 #endif
     } else if (nl == ns) {
         /* we have as many lights to place as spaces; fill them all. */
-        GRID(state,flags,nx,ny) |= F_NUMBERUSED;
+        solver_set_flags(sc, state, nx, ny, F_NUMBERUSED);
         for (i = 0; i < s.npoints; i++) {
             if (!(s.points[i].f & F_MARK)) {
-                set_light(state, s.points[i].x,s.points[i].y, true);
+                solver_place_light(sc, state, s.points[i].x,s.points[i].y);
                 ret = true;
             }
         }
@@ -968,32 +1158,31 @@ struct setscratch {
  *
  */
 
-typedef void (*trl_cb)(game_state *state, int dx, int dy,
-                       struct setscratch *scratch, int n, void *ctx);
+typedef void (*trl_cb)(struct solver_ctx *sc, game_state *state,
+                       int dx, int dy, struct setscratch *scratch, int n,
+                       void *ctx);
 
-static void try_rule_out(game_state *state, int x, int y,
-                         struct setscratch *scratch, int n,
+static void try_rule_out(struct solver_ctx *sc, game_state *state,
+                         int x, int y, struct setscratch *scratch, int n,
                          trl_cb cb, void *ctx);
 
-static void trl_callback_search(game_state *state, int dx, int dy,
-                       struct setscratch *scratch, int n, void *ignored)
+static void trl_callback_search(struct solver_ctx *sc, game_state *state,
+                       int dx, int dy, struct setscratch *scratch, int n,
+                       void *ignored)
 {
-    int i;
+    int i = dy*sc->w+dx;
 
 #ifdef SOLVER_DIAGNOSTICS
     if (verbose) debug(("discount cb: light at (%d,%d)\n", dx, dy));
 #endif
 
-    for (i = 0; i < n; i++) {
-        if (dx == scratch[i].x && dy == scratch[i].y) {
-            scratch[i].n = 1;
-            return;
-        }
-    }
+    if (sc->setstamp[i] == sc->stamp)
+        scratch[sc->setpos[i]].n = 1;
 }
 
-static void trl_callback_discount(game_state *state, int dx, int dy,
-                       struct setscratch *scratch, int n, void *ctx)
+static void trl_callback_discount(struct solver_ctx *sc, game_state *state,
+                       int dx, int dy, struct setscratch *scratch, int n,
+                       void *ctx)
 {
     bool *didsth = (bool *)ctx;
     int i;
@@ -1017,12 +1206,12 @@ static void trl_callback_discount(game_state *state, int dx, int dy,
 
     for (i = 0; i < n; i++)
         scratch[i].n = 0;
-    try_rule_out(state, dx, dy, scratch, n, trl_callback_search, NULL);
+    try_rule_out(sc, state, dx, dy, scratch, n, trl_callback_search, NULL);
     for (i = 0; i < n; i++) {
         if (scratch[i].n == 0) return;
     }
     /* The light ruled out everything in scratch. Yay. */
-    GRID(state,flags,dx,dy) |= F_IMPOSSIBLE;
+    solver_set_flags(sc, state, dx, dy, F_IMPOSSIBLE);
 #ifdef SOLVER_DIAGNOSTICS
     debug(("Set reduction discounted square at (%d,%d):\n", dx,dy));
     if (verbose) debug_state(state);
@@ -1031,15 +1220,16 @@ static void trl_callback_discount(game_state *state, int dx, int dy,
     *didsth = true;
 }
 
-static void trl_callback_incn(game_state *state, int dx, int dy,
-                       struct setscratch *scratch, int n, void *ctx)
+static void trl_callback_incn(struct solver_ctx *sc, game_state *state,
+                       int dx, int dy, struct setscratch *scratch, int n,
+                       void *ctx)
 {
     struct setscratch *s = (struct setscratch *)ctx;
     s->n++;
 }
 
-static void try_rule_out(game_state *state, int x, int y,
-                         struct setscratch *scratch, int n,
+static void try_rule_out(struct solver_ctx *sc, game_state *state,
+                         int x, int y, struct setscratch *scratch, int n,
                          trl_cb cb, void *ctx)
 {
     /* XXX Find all the squares which would rule out (x,y); anything
@@ -1047,31 +1237,31 @@ static void try_rule_out(game_state *state, int x, int y,
      * as X assuming that clue only has one remaining light.
      * Call the callback with each square. */
     ll_data lld;
-    surrounds s, ss;
-    int i, j, curr_lights, tot_lights;
+    surrounds ss;
+    int i, j, c, curr_lights, tot_lights;
 
     /* Find all squares that would rule out a light at (x,y) and call trl_cb
      * with them: anything that would light (x,y)... */
 
-    list_lights(state, x, y, false, &lld);
-    FOREACHLIT(&lld, { if (could_place_light_xy(state, lx, ly)) { cb(state, lx, ly, scratch, n, ctx); } });
+    solver_lights(sc, x, y, false, &lld);
+    FOREACHLIT(&lld, { if (could_place_light_xy(state, lx, ly)) { cb(sc, state, lx, ly, scratch, n, ctx); } });
 
     /* ... as well as any empty space (that isn't x,y) next to any clue square
      * next to (x,y) that only has one light left to place. */
 
-    get_surrounds(state, x, y, &s);
-    for (i = 0; i < s.npoints; i++) {
-        if (!(GRID(state,flags,s.points[i].x,s.points[i].y) & F_NUMBERED))
-            continue;
+    for (i = 0; i < 4; i++) {
+        c = sc->clues[4*(y*sc->w+x) + i];
+        if (c < 0)
+            break;
         /* we have an adjacent clue square; find /its/ surrounds
          * and count the remaining lights it needs. */
-        get_surrounds(state,s.points[i].x,s.points[i].y,&ss);
+        get_surrounds(state, c % sc->w, c / sc->w, &ss);
         curr_lights = 0;
         for (j = 0; j < ss.npoints; j++) {
             if (GRID(state,flags,ss.points[j].x,ss.points[j].y) & F_LIGHT)
                 curr_lights++;
         }
-        tot_lights = GRID(state, lights, s.points[i].x, s.points[i].y);
+        tot_lights = state->lights[c];
         /* We have a clue with tot_lights to fill, and curr_lights currently
          * around it. If adding a light at (x,y) fills up the clue (i.e.
          * curr_lights + 1 = tot_lights) then we need to discount all other
@@ -1081,7 +1271,7 @@ static void try_rule_out(game_state *state, int x, int y,
                 int lx = ss.points[j].x, ly = ss.points[j].y;
                 if (lx == x && ly == y) continue;
                 if (could_place_light_xy(state, lx, ly))
-                    cb(state, lx, ly, scratch, n, ctx);
+                    cb(sc, state, lx, ly, scratch, n, ctx);
             }
         }
     }
@@ -1098,7 +1288,7 @@ static void debug_scratch(const char *msg, struct setscratch *scratch, int n)
 }
 #endif
 
-static bool discount_set(game_state *state,
+static bool discount_set(struct solver_ctx *sc, game_state *state,
                          struct setscratch *scratch, int n)
 {
     int i, besti, bestn;
@@ -1109,8 +1299,16 @@ static bool discount_set(game_state *state,
 #endif
     if (n == 0) return false;
 
+    /* Note where each square of the set is, for trl_callback_search. */
+    sc->stamp++;
     for (i = 0; i < n; i++) {
-        try_rule_out(state, scratch[i].x, scratch[i].y, scratch, n,
+        int yx = scratch[i].y*sc->w + scratch[i].x;
+        sc->setpos[yx] = i;
+        sc->setstamp[yx] = sc->stamp;
+    }
+
+    for (i = 0; i < n; i++) {
+        try_rule_out(sc, state, scratch[i].x, scratch[i].y, scratch, n,
                      trl_callback_incn, (void*)&(scratch[i]));
     }
 #ifdef SOLVER_DIAGNOSTICS
@@ -1128,7 +1326,7 @@ static bool discount_set(game_state *state,
     if (verbose > 1) debug(("best square (%d,%d) with n%d.\n",
            scratch[besti].x, scratch[besti].y, scratch[besti].n));
 #endif
-    try_rule_out(state, scratch[besti].x, scratch[besti].y, scratch, n,
+    try_rule_out(sc, state, scratch[besti].x, scratch[besti].y, scratch, n,
                  trl_callback_discount, (void*)&didsth);
 #ifdef SOLVER_DIAGNOSTICS
     if (didsth) debug((" [from square (%d,%d)]\n",
@@ -1153,8 +1351,8 @@ static void unlit_cb(game_state *state, int lx, int ly,
 }
 
 /* Construct a MAKESLIGHT set from an unlit square. */
-static bool discount_unlit(game_state *state, int x, int y,
-                           struct setscratch *scratch)
+static bool discount_unlit(struct solver_ctx *sc, game_state *state,
+                           int x, int y, struct setscratch *scratch)
 {
     ll_data lld;
     int n;
@@ -1167,9 +1365,9 @@ static bool discount_unlit(game_state *state, int x, int y,
 
     discount_clear(state, scratch, &n);
 
-    list_lights(state, x, y, true, &lld);
+    solver_lights(sc, x, y, true, &lld);
     FOREACHLIT(&lld, { unlit_cb(state, lx, ly, scratch, &n); });
-    didsth = discount_set(state, scratch, n);
+    didsth = discount_set(sc, state, scratch, n);
 #ifdef SOLVER_DIAGNOSTICS
     if (didsth) debug(("  [from unlit square at (%d,%d)].\n", x, y));
 #endif
@@ -1180,16 +1378,19 @@ static bool discount_unlit(game_state *state, int x, int y,
 /* Construct a series of MAKESLIGHT sets from a clue square.
  *  for a clue square with N remaining spaces that must contain M lights, every
  *  subset of size N-M+1 of those N spaces forms such a set.
+ *
+ *  N is at most 4, so we run through the subsets as bitmasks. Space i
+ *  is bit N-1-i, so that counting down gives the subsets in the same
+ *  (lexicographic) order as combi.c would.
  */
 
-static bool discount_clue(game_state *state, int x, int y,
-                          struct setscratch *scratch)
+static bool discount_clue(struct solver_ctx *sc, game_state *state,
+                          int x, int y, struct setscratch *scratch)
 {
-    int slen, m = GRID(state, lights, x, y), n, i, lights;
+    int slen, m = GRID(state, lights, x, y), n, i, r, lights, mask, bits;
     bool didsth = false;
     unsigned int flags;
     surrounds s, sempty;
-    combi_ctx *combi;
 
     if (m == 0) return false;
 
@@ -1223,17 +1424,20 @@ static bool discount_clue(game_state *state, int x, int y,
 
     if (m < 0 || m > n) return false; /* become impossible. */
 
-    combi = new_combi(n - m + 1, n);
-    while (next_combi(combi)) {
+    r = n - m + 1;
+    for (mask = (1 << n) - 1; mask > 0; mask--) {
+        for (bits = 0, i = mask; i; i &= i-1) bits++;
+        if (bits != r) continue;
+
         discount_clear(state, scratch, &slen);
-        for (i = 0; i < combi->r; i++) {
-            scratch[slen].x = sempty.points[combi->a[i]].x;
-            scratch[slen].y = sempty.points[combi->a[i]].y;
+        for (i = 0; i < n; i++) {
+            if (!(mask & (1 << (n-1-i)))) continue;
+            scratch[slen].x = sempty.points[i].x;
+            scratch[slen].y = sempty.points[i].y;
             slen++;
         }
-        if (discount_set(state, scratch, slen)) didsth = true;
+        if (discount_set(sc, state, scratch, slen)) didsth = true;
     }
-    free_combi(combi);
 #ifdef SOLVER_DIAGNOSTICS
     if (didsth) debug(("  [from clue at (%d,%d)].\n", x, y));
 #endif
@@ -1253,9 +1457,7 @@ static unsigned int flags_from_difficulty(int difficulty)
     return sflags;
 }
 
-#define MAXRECURSE 5
-
-static int solve_sub(game_state *state,
+static int solve_sub(struct solver_ctx *sc, game_state *state,
                      unsigned int solve_flags, int depth,
                      int *maxdepth)
 {
@@ -1263,7 +1465,7 @@ static int solve_sub(game_state *state,
     int x, y, ncanplace, lights;
     bool didstuff;
     int bestx, besty, n, bestn, copy_soluble, self_soluble, ret, maxrecurse = 0;
-    game_state *scopy;
+    int mark;
     ll_data lld;
     struct setscratch *sscratch = NULL;
 
@@ -1294,9 +1496,9 @@ static int solve_sub(game_state *state,
                 lights = GRID(state,lights,x,y);
                 ncanplace += could_place_light(flags, lights);
 
-                if (try_solve_light(state, x, y, flags, lights))
+                if (try_solve_light(sc, state, x, y, flags, lights))
                     didstuff = true;
-                if (try_solve_number(state, x, y, flags, lights))
+                if (try_solve_number(sc, state, x, y, flags, lights))
                     didstuff = true;
             }
         }
@@ -1315,12 +1517,12 @@ static int solve_sub(game_state *state,
                     lights = GRID(state,lights,x,y);
 
                     if (!(flags & F_BLACK) && lights == 0) {
-                        if (discount_unlit(state, x, y, sscratch)) {
+                        if (discount_unlit(sc, state, x, y, sscratch)) {
                             didstuff = true;
                             goto reduction_success;
                         }
                     } else if (flags & F_NUMBERED) {
-                        if (discount_clue(state, x, y, sscratch)) {
+                        if (discount_clue(sc, state, x, y, sscratch)) {
                             didstuff = true;
                             goto reduction_success;
                         }
@@ -1351,7 +1553,7 @@ reduction_success:
                 if (!could_place_light(flags, lights)) continue;
 
                 n = 0;
-                list_lights(state, x, y, true, &lld);
+                solver_lights(sc, x, y, true, &lld);
                 FOREACHLIT(&lld, { if (GRID(state,lights,lx,ly) == 0) n++; });
                 if (n > bestn) {
                     bestn = n; bestx = x; besty = y;
@@ -1361,29 +1563,32 @@ reduction_success:
         assert(bestn > 0);
 	assert(bestx >= 0 && besty >= 0);
 
-        /* Now we've chosen a plausible (x,y), try to solve it once as 'lit'
-         * and once as 'impossible'; we need to make one copy to do this. */
+        /* Now we've chosen a plausible (x,y), try to solve it once as
+         * 'impossible' and once as 'lit', undoing the first attempt
+         * before making the second. */
 
-        scopy = dup_game(state);
+        mark = sc->ntrail;
 #ifdef SOLVER_DIAGNOSTICS
         debug(("Recursing #1: trying (%d,%d) as IMPOSSIBLE\n", bestx, besty));
 #endif
-        GRID(state,flags,bestx,besty) |= F_IMPOSSIBLE;
-        self_soluble = solve_sub(state, solve_flags,  depth+1, maxdepth);
+        solver_set_flags(sc, state, bestx, besty, F_IMPOSSIBLE);
+        self_soluble = solve_sub(sc, state, solve_flags,  depth+1, maxdepth);
 
         if (!(solve_flags & F_SOLVE_FORCEUNIQUE) && self_soluble > 0) {
             /* we didn't care about finding all solutions, and we just
              * found one; return with it immediately. */
-            free_game(scopy);
             ret = self_soluble;
             goto done;
         }
+        if (self_soluble > 0)
+            solver_keep(sc, state, depth);
+        solver_undo(sc, state, mark);
 
 #ifdef SOLVER_DIAGNOSTICS
         debug(("Recursing #2: trying (%d,%d) as LIGHT\n", bestx, besty));
 #endif
-        set_light(scopy, bestx, besty, true);
-        copy_soluble = solve_sub(scopy, solve_flags, depth+1, maxdepth);
+        solver_place_light(sc, state, bestx, besty);
+        copy_soluble = solve_sub(sc, state, solve_flags, depth+1, maxdepth);
 
         /* If we wanted a unique solution but we hit our recursion limit
          * (on either branch) then we have to assume we didn't find possible
@@ -1391,23 +1596,22 @@ reduction_success:
         if ((solve_flags & F_SOLVE_FORCEUNIQUE) &&
             ((copy_soluble < 0) || (self_soluble < 0))) {
             ret = -1;
-        /* Make sure that whether or not it was self or copy (or both) that
-         * were soluble, that we return a solved state in self. */
+        /* Make sure that whether it was the first or second attempt (or
+         * both) that was soluble, we return a solved state. Nobody
+         * looks at the state if we return no solutions. */
         } else if (copy_soluble <= 0) {
-            /* copy wasn't soluble; keep self state and return that result. */
+            /* second attempt wasn't soluble; go back to the first. */
             ret = self_soluble;
+            if (ret > 0)
+                solver_restore(sc, state, mark, depth);
         } else if (self_soluble <= 0) {
-            /* copy solved and we didn't, so copy in copy's (now solved)
-             * flags and light state. */
-            memcpy(state->lights, scopy->lights,
-                   scopy->w * scopy->h * sizeof(int));
-            memcpy(state->flags, scopy->flags,
-                   scopy->w * scopy->h * sizeof(unsigned int));
+            /* second attempt solved and the first didn't, so we're
+             * already in the right state. */
             ret = copy_soluble;
         } else {
             ret = copy_soluble + self_soluble;
+            solver_restore(sc, state, mark, depth);
         }
-        free_game(scopy);
         goto done;
     }
 done:
@@ -1428,6 +1632,7 @@ done:
  * game_state will be in a solved state, but you won't know which one. */
 static int dosolve(game_state *state, int solve_flags, int *maxdepth)
 {
+    struct solver_ctx *sc;
     int x, y, nsol;
 
     for (x = 0; x < state->w; x++) {
@@ -1435,7 +1640,9 @@ static int dosolve(game_state *state, int solve_flags, int *maxdepth)
             GRID(state,flags,x,y) &= ~F_NUMBERUSED;
         }
     }
-    nsol = solve_sub(state, solve_flags, 0, maxdepth);
+    sc = new_solver_ctx(state);
+    nsol = solve_sub(sc, state, solve_flags, 0, maxdepth);
+    free_solver_ctx(sc);
     return nsol;
 }
 
@@ -8,122 +8,65 @@
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
+#include <limits.h>
 #include <math.h>
 
 #include "puzzles.h"
-#include "tree234.h"
 #include "grid.h"
 #include "loopgen.h"
 
 
-/* We're going to store lists of current candidate faces for colouring black
- * or white.
- * Each face gets a 'score', which tells us how adding that face right
- * now would affect the curliness of the solution loop.  We're trying to
- * maximise that quantity so will bias our random selection of faces to
- * colour those with high scores */
-struct face_score {
-    int white_score;
-    int black_score;
-    unsigned long random;
-    /* No need to store a grid_face* here.  The 'face_scores' array will
-     * be a list of 'face_score' objects, one for each face of the grid, so
-     * the position (index) within the 'face_scores' array will determine
-     * which face corresponds to a particular face_score.
-     * Having a single 'face_scores' array for all faces simplifies memory
-     * management, and probably improves performance, because we don't have to 
-     * malloc/free each individual face_score, and we don't have to maintain
-     * a mapping from grid_face* pointers to face_score* pointers.
-     */
-};
-
-static int generic_sort_cmpfn(void *v1, void *v2, size_t offset)
-{
-    struct face_score *f1 = v1;
-    struct face_score *f2 = v2;
-    int r;
-
-    r = *(int *)((char *)f2 + offset) - *(int *)((char *)f1 + offset);
-    if (r) {
-        return r;
-    }
-
-    if (f1->random < f2->random)
-        return -1;
-    else if (f1->random > f2->random)
-        return 1;
-
-    /*
-     * It's _just_ possible that two faces might have been given
-     * the same random value. In that situation, fall back to
-     * comparing based on the positions within the face_scores list.
-     * This introduces a tiny directional bias, but not a significant one.
-     */
-    return f1 - f2;
-}
+/* Within this file we walk the grid using its index lists (see grid.h),
+ * in which the infinite face is -1. */
+#define FACE_INDEX_COLOUR(fi) ( (fi) < 0 ? FACE_BLACK : board[fi] )
 
-static int white_sort_cmpfn(void *v1, void *v2)
-{
-    return generic_sort_cmpfn(v1, v2, offsetof(struct face_score,white_score));
-}
+/* The face on the other side of edge e from face fi. */
+#define OTHER_FACE(g, e, fi) \
+    ( (g)->edge_faces[2*(e)] == (fi) ? (g)->edge_faces[2*(e)+1] : \
+      (g)->edge_faces[2*(e)] )
 
-static int black_sort_cmpfn(void *v1, void *v2)
-{
-    return generic_sort_cmpfn(v1, v2, offsetof(struct face_score,black_score));
-}
+/*
+ * What generate_loop knows about the grid and the colouring so far,
+ * beyond the board itself.
+ */
+struct loopgen_state {
+    grid *g;
+    char *board;
+
+    /* The faces around face i, as found by face_ring(), are
+     * ring[ring_start[i]] to ring[ring_start[i+1]-1]. */
+    int *ring_start, *ring;
+
+    /* How many edge-neighbours of each face are currently white, and
+     * how many black (counting the infinite face as black). Kept up to
+     * date by set_face_colour(). */
+    int *white_nbrs, *black_nbrs;
+};
 
-/* 'board' is an array of enum face_colour, indicating which faces are
- * currently black/white/grey.  'colour' is FACE_WHITE or FACE_BLACK.
- * Returns whether it's legal to colour the given face with this colour. */
-static bool can_colour_face(grid *g, char* board, int face_index,
-                            enum face_colour colour)
+/*
+ * Write into 'ring' the sequence of faces met on walking once round
+ * face 'face_index', just outside its boundary, and return its length.
+ * This includes all the faces touching it, either along an edge or just
+ * at a corner. Adjacent repeats of the same face are only listed once,
+ * treating the list as cyclic.
+ *
+ * 'ring' must have room for the sum of the orders of the face's dots.
+ */
+static int face_ring(grid *g, int face_index, int *ring)
 {
-    int i, j;
-    grid_face *test_face = g->faces + face_index;
-    grid_face *starting_face, *current_face;
-    grid_dot *starting_dot;
-    int transitions;
-    bool current_state, s; /* equal or not-equal to 'colour' */
-    bool found_same_coloured_neighbour = false;
-    assert(board[face_index] != colour);
+    int i, j, n, order, fstart, dstart, dorder;
+    int starting_face, current_face;
+    int starting_dot;
 
-    /* Can only consider a face for colouring if it's adjacent to a face
-     * with the same colour. */
-    for (i = 0; i < test_face->order; i++) {
-        grid_edge *e = test_face->edges[i];
-        grid_face *f = (e->face1 == test_face) ? e->face2 : e->face1;
-        if (FACE_COLOUR(f) == colour) {
-            found_same_coloured_neighbour = true;
-            break;
-        }
-    }
-    if (!found_same_coloured_neighbour)
-        return false;
-
-    /* Need to avoid creating a loop of faces of this colour around some
-     * differently-coloured faces.
-     * Also need to avoid meeting a same-coloured face at a corner, with
-     * other-coloured faces in between.  Here's a simple test that (I believe)
-     * takes care of both these conditions:
-     *
-     * Take the circular path formed by this face's edges, and inflate it
-     * slightly outwards.  Imagine walking around this path and consider
-     * the faces that you visit in sequence.  This will include all faces
-     * touching the given face, either along an edge or just at a corner.
-     * Count the number of 'colour'/not-'colour' transitions you encounter, as
-     * you walk along the complete loop.  This will obviously turn out to be
-     * an even number.
-     * If 0, we're either in the middle of an "island" of this colour (should
-     * be impossible as we're not supposed to create black or white loops),
-     * or we're about to start a new island - also not allowed.
-     * If 4 or greater, there are too many separate coloured regions touching
-     * this face, and colouring it would create a loop or a corner-violation.
-     * The only allowed case is when the count is exactly 2. */
+    fstart = g->face_start[face_index];
+    order = g->face_start[face_index+1] - fstart;
 
     /* i points to a dot around the test face.
      * j points to a face around the i^th dot.
      * The current face will always be:
      *     test_face->dots[i]->faces[j]
+     * (which, in terms of indices, is dot_faces[dstart+j], where dstart
+     * is dot_start[] of the dot at face_dots[fstart+i]).
      * We assume dots go clockwise around the test face,
      * and faces go clockwise around dots. */
 
@@ -149,94 +92,307 @@ static bool can_colour_face(grid *g, char* board, int face_index,
      */
 
     i = j = 0;
-    current_face = test_face->dots[0]->faces[0];
-    if (current_face == test_face) {
+    dstart = g->dot_start[g->face_dots[fstart]];
+    dorder = g->dot_start[g->face_dots[fstart]+1] - dstart;
+    current_face = g->dot_faces[dstart];
+    if (current_face == face_index) {
         j = 1;
-        current_face = test_face->dots[0]->faces[1];
+        current_face = g->dot_faces[dstart+1];
     }
-    transitions = 0;
-    current_state = (FACE_COLOUR(current_face) == colour);
-    starting_dot = NULL;
-    starting_face = NULL;
+    n = 0;
+    starting_dot = -1;
+    starting_face = -1;
     while (true) {
         /* Advance to next face.
          * Need to loop here because it might take several goes to
          * find it. */
         while (true) {
             j++;
-            if (j == test_face->dots[i]->order)
+            if (j == dorder)
                 j = 0;
 
-            if (test_face->dots[i]->faces[j] == test_face) {
+            if (g->dot_faces[dstart+j] == face_index) {
                 /* Advance to next dot round test_face, then
                  * find current_face around new dot
                  * and advance to the next face clockwise */
                 i++;
-                if (i == test_face->order)
+                if (i == order)
                     i = 0;
-                for (j = 0; j < test_face->dots[i]->order; j++) {
-                    if (test_face->dots[i]->faces[j] == current_face)
+                dstart = g->dot_start[g->face_dots[fstart+i]];
+                dorder = g->dot_start[g->face_dots[fstart+i]+1] - dstart;
+                for (j = 0; j < dorder; j++) {
+                    if (g->dot_faces[dstart+j] == current_face)
                         break;
                 }
                 /* Must actually find current_face around new dot,
                  * or else something's wrong with the grid. */
-                assert(j != test_face->dots[i]->order);
+                assert(j != dorder);
                 /* Found, so advance to next face and try again */
             } else {
                 break;
             }
         }
         /* (i,j) are now advanced to next face */
-        current_face = test_face->dots[i]->faces[j];
-        s = (FACE_COLOUR(current_face) == colour);
-	if (!starting_dot) {
-	    starting_dot = test_face->dots[i];
-	    starting_face = current_face;
-	    current_state = s;
-	} else {
-	    if (s != current_state) {
-		++transitions;
-		current_state = s;
-		if (transitions > 2)
-		    break;
-	    }
-	    if (test_face->dots[i] == starting_dot &&
-		current_face == starting_face)
-		break;
+        current_face = g->dot_faces[dstart+j];
+        if (starting_dot < 0) {
+            starting_dot = g->face_dots[fstart+i];
+            starting_face = current_face;
+        } else if (g->face_dots[fstart+i] == starting_dot &&
+                   current_face == starting_face) {
+            break;
         }
+        if (n == 0 || ring[n-1] != current_face)
+            ring[n++] = current_face;
     }
+    if (n > 1 && ring[n-1] == ring[0])
+        n--;
 
-    return (transitions == 2) ? true : false;
+    return n;
 }
 
-/* Count the number of neighbours of 'face', having colour 'colour' */
-static int face_num_neighbours(grid *g, char *board, grid_face *face,
+/* Count the number of neighbours of face 'fi', having colour 'colour' */
+static int face_num_neighbours(struct loopgen_state *ls, int fi,
                                enum face_colour colour)
 {
-    int colour_count = 0;
+    assert(colour != FACE_GREY);
+    return colour == FACE_WHITE ? ls->white_nbrs[fi] : ls->black_nbrs[fi];
+}
+
+/* Colour face 'fi', keeping the neighbour counts up to date. */
+static void set_face_colour(struct loopgen_state *ls, int fi,
+                            enum face_colour colour)
+{
+    grid *g = ls->g;
+    int old = ls->board[fi];
+    int k;
+
+    for (k = g->face_start[fi]; k < g->face_start[fi+1]; k++) {
+        int f = OTHER_FACE(g, g->face_edges[k], fi);
+        if (f < 0)
+            continue;
+        if (old == FACE_WHITE)
+            ls->white_nbrs[f]--;
+        else if (old == FACE_BLACK)
+            ls->black_nbrs[f]--;
+        if (colour == FACE_WHITE)
+            ls->white_nbrs[f]++;
+        else if (colour == FACE_BLACK)
+            ls->black_nbrs[f]++;
+    }
+    ls->board[fi] = colour;
+}
+
+/* 'board' is an array of enum face_colour, indicating which faces are
+ * currently black/white/grey.  'colour' is FACE_WHITE or FACE_BLACK.
+ * Returns whether it's legal to colour the given face with this colour. */
+static bool can_colour_face(struct loopgen_state *ls, int face_index,
+                            enum face_colour colour)
+{
+    char *board = ls->board;
+    const int *ring = ls->ring + ls->ring_start[face_index];
+    int n = ls->ring_start[face_index+1] - ls->ring_start[face_index];
+    int i, transitions;
+    bool current_state, s; /* equal or not-equal to 'colour' */
+    assert(board[face_index] != colour);
+
+    /* Can only consider a face for colouring if it's adjacent to a face
+     * with the same colour. */
+    if (face_num_neighbours(ls, face_index, colour) == 0)
+        return false;
+
+    /* Need to avoid creating a loop of faces of this colour around some
+     * differently-coloured faces.
+     * Also need to avoid meeting a same-coloured face at a corner, with
+     * other-coloured faces in between.  Here's a simple test that (I believe)
+     * takes care of both these conditions:
+     *
+     * Take the circular path formed by this face's edges, and inflate it
+     * slightly outwards.  Imagine walking around this path and consider
+     * the faces that you visit in sequence.  This will include all faces
+     * touching the given face, either along an edge or just at a corner.
+     * Count the number of 'colour'/not-'colour' transitions you encounter, as
+     * you walk along the complete loop.  This will obviously turn out to be
+     * an even number.
+     * If 0, we're either in the middle of an "island" of this colour (should
+     * be impossible as we're not supposed to create black or white loops),
+     * or we're about to start a new island - also not allowed.
+     * If 4 or greater, there are too many separate coloured regions touching
+     * this face, and colouring it would create a loop or a corner-violation.
+     * The only allowed case is when the count is exactly 2.
+     *
+     * The faces on that path don't change, so face_ring() has listed them
+     * for us in advance. */
+
+    transitions = 0;
+    current_state = (FACE_INDEX_COLOUR(ring[n-1]) == colour);
+    for (i = 0; i < n; i++) {
+        s = (FACE_INDEX_COLOUR(ring[i]) == colour);
+        if (s != current_state) {
+            if (++transitions > 2)
+                return false;
+            current_state = s;
+        }
+    }
+
+    return (transitions == 2) ? true : false;
+}
+
+/*
+ * A set of candidate faces for colouring one colour, ordered as
+ * described in generate_loop(): by score, highest first, then by a
+ * random number fixed for each face. Our score is minus the number of
+ * the face's edge-neighbours which already have that colour, so it can
+ * only take a few values, and we keep a bucket for each one (bucket k
+ * holding faces with k such neighbours). Each bucket is a bitmap
+ * indexed by the faces' positions in the random ordering, with a
+ * summary bitmap above it recording which words are non-empty, so
+ * adding, removing or rescoring a face is a constant amount of work,
+ * and finding the best face is quick.
+ */
+#define QBITS ((int)(sizeof(unsigned long) * CHAR_BIT))
+
+struct face_queue {
+    int nbuckets, nwords, nsummary;
+    unsigned long *bits;      /* nbuckets * nwords */
+    unsigned long *summary;   /* nbuckets * nsummary */
+    int *bucket_count;        /* number of faces in each bucket */
+    int *bucket;              /* bucket of each face, or -1 if absent */
+    int count;                /* total number of faces */
+};
+
+static void face_queue_init(struct face_queue *q, int num_faces,
+                            int nbuckets)
+{
     int i;
-    grid_face *f;
-    grid_edge *e;
-    for (i = 0; i < face->order; i++) {
-        e = face->edges[i];
-        f = (e->face1 == face) ? e->face2 : e->face1;
-        if (FACE_COLOUR(f) == colour)
-            ++colour_count;
+
+    q->nbuckets = nbuckets;
+    q->nwords = (num_faces + QBITS - 1) / QBITS;
+    q->nsummary = (q->nwords + QBITS - 1) / QBITS;
+    q->bits = snewn(nbuckets * q->nwords, unsigned long);
+    memset(q->bits, 0, nbuckets * q->nwords * sizeof(unsigned long));
+    q->summary = snewn(nbuckets * q->nsummary, unsigned long);
+    memset(q->summary, 0, nbuckets * q->nsummary * sizeof(unsigned long));
+    q->bucket_count = snewn(nbuckets, int);
+    for (i = 0; i < nbuckets; i++)
+        q->bucket_count[i] = 0;
+    q->bucket = snewn(num_faces, int);
+    for (i = 0; i < num_faces; i++)
+        q->bucket[i] = -1;
+    q->count = 0;
+}
+
+static void face_queue_free(struct face_queue *q)
+{
+    sfree(q->bits);
+    sfree(q->summary);
+    sfree(q->bucket_count);
+    sfree(q->bucket);
+}
+
+/* Move the face of rank r (see generate_loop) into bucket b, or out of
+ * the queue altogether if b is -1. */
+static void face_queue_set(struct face_queue *q, int fi, int r, int b)
+{
+    int w = r / QBITS;
+    unsigned long bit = 1UL << (r % QBITS);
+    int old = q->bucket[fi];
+
+    if (old == b)
+        return;
+    if (old >= 0) {
+        unsigned long *word = q->bits + old * q->nwords + w;
+        *word &= ~bit;
+        if (!*word)
+            q->summary[old * q->nsummary + w / QBITS] &=
+                ~(1UL << (w % QBITS));
+        q->bucket_count[old]--;
+        q->count--;
+    }
+    if (b >= 0) {
+        assert(b < q->nbuckets);
+        q->bits[b * q->nwords + w] |= bit;
+        q->summary[b * q->nsummary + w / QBITS] |= 1UL << (w % QBITS);
+        q->bucket_count[b]++;
+        q->count++;
     }
-    return colour_count;
+    q->bucket[fi] = b;
 }
 
-/* The 'score' of a face reflects its current desirability for selection
- * as the next face to colour white or black.  We want to encourage moving
- * into grey areas and increasing loopiness, so we give scores according to
- * how many of the face's neighbours are currently coloured the same as the
- * proposed colour. */
-static int face_score(grid *g, char *board, grid_face *face,
-                      enum face_colour colour)
+static int lowest_bit(unsigned long x)
 {
-    /* Simple formula: score = 0 - num. same-coloured neighbours,
-     * so a higher score means fewer same-coloured neighbours. */
-    return -face_num_neighbours(g, board, face, colour);
+    int i = 0;
+    assert(x);
+    while (!(x & 0xFF)) {
+        x >>= 8;
+        i += 8;
+    }
+    while (!(x & 1)) {
+        x >>= 1;
+        i++;
+    }
+    return i;
+}
+
+/* Return the lowest rank at least r in bucket b, or -1 if none. */
+static int face_queue_next(const struct face_queue *q, int b, int r)
+{
+    const unsigned long *bits = q->bits + b * q->nwords;
+    const unsigned long *summary = q->summary + b * q->nsummary;
+    unsigned long x;
+    int w = r / QBITS, s;
+
+    if (w >= q->nwords)
+        return -1;
+    x = bits[w] & (~0UL << (r % QBITS));
+    if (x)
+        return w * QBITS + lowest_bit(x);
+
+    w++;
+    s = w / QBITS;
+    if (s >= q->nsummary)
+        return -1;
+    x = summary[s] & (~0UL << (w % QBITS));
+    while (!x) {
+        if (++s >= q->nsummary)
+            return -1;
+        x = summary[s];
+    }
+    w = s * QBITS + lowest_bit(x);
+    return w * QBITS + lowest_bit(bits[w]);
+}
+
+/* Put face fi into the queue for 'colour' if it can be coloured that
+ * colour, with its current score, or take it out if not. */
+static void update_candidate(struct loopgen_state *ls, struct face_queue *q,
+                             const int *rank, int fi,
+                             enum face_colour colour)
+{
+    face_queue_set(q, fi, rank[fi],
+                   can_colour_face(ls, fi, colour) ?
+                   face_num_neighbours(ls, fi, colour) : -1);
+}
+
+struct face_random {
+    unsigned long random;
+    int index;
+};
+
+static int face_random_cmp(const void *av, const void *bv, void *ctx)
+{
+    const struct face_random *a = av, *b = bv;
+
+    if (a->random < b->random)
+        return -1;
+    else if (a->random > b->random)
+        return 1;
+
+    /*
+     * It's _just_ possible that two faces might have been given
+     * the same random value. In that situation, fall back to
+     * comparing their indices. This introduces a tiny directional
+     * bias, but not a significant one.
+     */
+    return a->index < b->index ? -1 : a->index > b->index ? 1 : 0;
 }
 
 /*
@@ -300,73 +456,102 @@ void generate_loop(grid *g, char *board, random_state *rs,
 {
     int i, j;
     int num_faces = g->num_faces;
-    struct face_score *face_scores; /* Array of face_score objects */
-    struct face_score *fs; /* Points somewhere in the above list */
-    struct grid_face *cur_face;
-    tree234 *lightable_faces_sorted;
-    tree234 *darkable_faces_sorted;
+    struct loopgen_state ls[1];
+    struct face_random *fr;
+    int *rank, *face_at_rank;
+    struct face_queue lightable_faces, darkable_faces;
+    int max_order, ring_size;
+    int cur_face;
     int *face_list;
     bool do_random_pass;
 
     /* Make a board */
     memset(board, FACE_GREY, num_faces);
-    
-    /* Create and initialise the list of face_scores */
-    face_scores = snewn(num_faces, struct face_score);
+
+    ls->g = g;
+    ls->board = board;
+
+    /* List the faces around each face, and count the edges each face
+     * has on the infinite face, which is implicitly coloured black. */
+    ring_size = 0;
+    max_order = 0;
     for (i = 0; i < num_faces; i++) {
-        face_scores[i].random = random_bits(rs, 31);
-        face_scores[i].black_score = face_scores[i].white_score = 0;
+        int order = g->face_start[i+1] - g->face_start[i];
+        max_order = max(max_order, order);
+        for (j = g->face_start[i]; j < g->face_start[i+1]; j++) {
+            int d = g->face_dots[j];
+            ring_size += g->dot_start[d+1] - g->dot_start[d];
+        }
+    }
+    ls->ring_start = snewn(num_faces + 1, int);
+    ls->ring = snewn(ring_size, int);
+    ls->white_nbrs = snewn(num_faces, int);
+    ls->black_nbrs = snewn(num_faces, int);
+    ls->ring_start[0] = 0;
+    for (i = 0; i < num_faces; i++) {
+        ls->ring_start[i+1] = ls->ring_start[i] +
+            face_ring(g, i, ls->ring + ls->ring_start[i]);
+        ls->white_nbrs[i] = ls->black_nbrs[i] = 0;
+        for (j = g->face_start[i]; j < g->face_start[i+1]; j++)
+            if (OTHER_FACE(g, g->face_edges[j], i) < 0)
+                ls->black_nbrs[i]++;
     }
-    
-    /* Colour a random, finite face white.  The infinite face is implicitly
-     * coloured black.  Together, they will seed the random growth process
-     * for the black and white areas. */
-    i = random_upto(rs, num_faces);
-    board[i] = FACE_WHITE;
 
     /* We need a way of favouring faces that will increase our loopiness.
      * We do this by maintaining a list of all candidate faces sorted by
      * their score and choose randomly from that with appropriate skew.
      * In order to avoid consistently biasing towards particular faces, we
      * need the sort order _within_ each group of scores to be completely
-     * random.  But it would be abusing the hospitality of the tree234 data
-     * structure if our comparison function were nondeterministic :-).  So with
-     * each face we associate a random number that does not change during a
-     * particular run of the generator, and use that as a secondary sort key.
+     * random.  So with each face we associate a random number that does
+     * not change during a particular run of the generator, and use that
+     * as a secondary sort key; the face queues work with each face's
+     * rank in that order.
      * Yes, this means we will be biased towards particular random faces in
      * any one run but that doesn't actually matter. */
+    fr = snewn(num_faces, struct face_random);
+    for (i = 0; i < num_faces; i++) {
+        fr[i].random = random_bits(rs, 31);
+        fr[i].index = i;
+    }
+    arraysort(fr, num_faces, face_random_cmp, NULL);
+    rank = snewn(num_faces, int);
+    face_at_rank = snewn(num_faces, int);
+    for (i = 0; i < num_faces; i++) {
+        rank[fr[i].index] = i;
+        face_at_rank[i] = fr[i].index;
+    }
+    sfree(fr);
 
-    lightable_faces_sorted = newtree234(white_sort_cmpfn);
-    darkable_faces_sorted = newtree234(black_sort_cmpfn);
+    /* Colour a random, finite face white.  The infinite face is implicitly
+     * coloured black.  Together, they will seed the random growth process
+     * for the black and white areas. */
+    i = random_upto(rs, num_faces);
+    set_face_colour(ls, i, FACE_WHITE);
+
+    face_queue_init(&lightable_faces, num_faces, max_order + 1);
+    face_queue_init(&darkable_faces, num_faces, max_order + 1);
 
     /* Initialise the lists of lightable and darkable faces.  This is
      * slightly different from the code inside the while-loop, because we need
      * to check every face of the board (the grid structure does not keep a
      * list of the infinite face's neighbours). */
     for (i = 0; i < num_faces; i++) {
-        grid_face *f = g->faces + i;
-        struct face_score *fs = face_scores + i;
         if (board[i] != FACE_GREY) continue;
         /* We need the full colourability check here, it's not enough simply
          * to check neighbourhood.  On some grids, a neighbour of the infinite
          * face is not necessarily darkable. */
-        if (can_colour_face(g, board, i, FACE_BLACK)) {
-            fs->black_score = face_score(g, board, f, FACE_BLACK);
-            add234(darkable_faces_sorted, fs);
-        }
-        if (can_colour_face(g, board, i, FACE_WHITE)) {
-            fs->white_score = face_score(g, board, f, FACE_WHITE);
-            add234(lightable_faces_sorted, fs);
-        }
+        update_candidate(ls, &darkable_faces, rank, i, FACE_BLACK);
+        update_candidate(ls, &lightable_faces, rank, i, FACE_WHITE);
     }
 
     /* Colour faces one at a time until no more faces are colourable. */
     while (true)
     {
         enum face_colour colour;
-        tree234 *faces_to_pick;
-        int c_lightable = count234(lightable_faces_sorted);
-        int c_darkable = count234(darkable_faces_sorted);
+        struct face_queue *faces_to_pick;
+        int b, r;
+        int c_lightable = lightable_faces.count;
+        int c_darkable = darkable_faces.count;
         if (c_lightable == 0 && c_darkable == 0) {
             /* No more faces we can use at all. */
             break;
@@ -378,106 +563,83 @@ void generate_loop(grid *g, char *board, random_state *rs,
         colour = random_upto(rs, 2) ? FACE_WHITE : FACE_BLACK;
 
         if (colour == FACE_WHITE)
-            faces_to_pick = lightable_faces_sorted;
+            faces_to_pick = &lightable_faces;
         else
-            faces_to_pick = darkable_faces_sorted;
+            faces_to_pick = &darkable_faces;
         if (bias) {
             /*
              * Go through all the candidate faces and pick the one the
              * bias function likes best, breaking ties using the
-             * ordering in our tree234 (which is why we replace only
+             * ordering of our queue (which is why we replace only
              * if score > bestscore, not >=).
              */
-            int j, k;
-            struct face_score *best = NULL;
+            int k, best = -1;
             int score, bestscore = 0;
 
-            for (j = 0;
-                 (fs = (struct face_score *)index234(faces_to_pick, j))!=NULL;
-                 j++) {
-
-                assert(fs);
-                k = fs - face_scores;
-                assert(board[k] == FACE_GREY);
-                board[k] = colour;
-                score = bias(biasctx, board, k);
-                board[k] = FACE_GREY;
-                bias(biasctx, board, k); /* let bias know we put it back */
-
-                if (!best || score > bestscore) {
-                    bestscore = score;
-                    best = fs;
+            for (b = 0; b < faces_to_pick->nbuckets; b++) {
+                if (!faces_to_pick->bucket_count[b])
+                    continue;
+                for (r = face_queue_next(faces_to_pick, b, 0); r >= 0;
+                     r = face_queue_next(faces_to_pick, b, r+1)) {
+                    k = face_at_rank[r];
+                    assert(board[k] == FACE_GREY);
+                    board[k] = colour;
+                    score = bias(biasctx, board, k);
+                    board[k] = FACE_GREY;
+                    bias(biasctx, board, k); /* let bias know we put it back */
+
+                    if (best < 0 || score > bestscore) {
+                        bestscore = score;
+                        best = k;
+                    }
                 }
             }
-            fs = best;
+            i = best;
         } else {
-            fs = (struct face_score *)index234(faces_to_pick, 0);
+            for (b = 0; !faces_to_pick->bucket_count[b]; b++);
+            i = face_at_rank[face_queue_next(faces_to_pick, b, 0)];
         }
-        assert(fs);
-        i = fs - face_scores;
+        assert(i >= 0);
         assert(board[i] == FACE_GREY);
-        board[i] = colour;
+        set_face_colour(ls, i, colour);
         if (bias)
             bias(biasctx, board, i); /* notify bias function of the change */
 
         /* Remove this newly-coloured face from the lists.  These lists should
          * only contain grey faces. */
-        del234(lightable_faces_sorted, fs);
-        del234(darkable_faces_sorted, fs);
+        face_queue_set(&lightable_faces, i, rank[i], -1);
+        face_queue_set(&darkable_faces, i, rank[i], -1);
 
         /* Remember which face we've just coloured */
-        cur_face = g->faces + i;
+        cur_face = i;
 
         /* The face we've just coloured potentially affects the colourability
          * and the scores of any neighbouring faces (touching at a corner or
          * edge).  So the search needs to be conducted around all faces
-         * touching the one we've just lit.  Iterate over its corners, then
-         * over each corner's faces.  For each such face, we remove it from
-         * the lists, recalculate any scores, then add it back to the lists
-         * (depending on whether it is lightable, darkable or both). */
-        for (i = 0; i < cur_face->order; i++) {
-            grid_dot *d = cur_face->dots[i];
-            for (j = 0; j < d->order; j++) {
-                grid_face *f = d->faces[j];
-                int fi; /* face index of f */
-
-                if (f == NULL)
-                    continue;
-                if (f == cur_face)
-                    continue;
-                
-                /* If the face is already coloured, it won't be on our
-                 * lightable/darkable lists anyway, so we can skip it without 
-                 * bothering with the removal step. */
-                if (FACE_COLOUR(f) != FACE_GREY) continue; 
-
-                /* Find the face index and face_score* corresponding to f */
-                fi = f - g->faces;                
-                fs = face_scores + fi;
-
-                /* Remove from lightable list if it's in there.  We do this,
-                 * even if it is still lightable, because the score might
-                 * be different, and we need to remove-then-add to maintain
-                 * correct sort order. */
-                del234(lightable_faces_sorted, fs);
-                if (can_colour_face(g, board, fi, FACE_WHITE)) {
-                    fs->white_score = face_score(g, board, f, FACE_WHITE);
-                    add234(lightable_faces_sorted, fs);
-                }
-                /* Do the same for darkable list. */
-                del234(darkable_faces_sorted, fs);
-                if (can_colour_face(g, board, fi, FACE_BLACK)) {
-                    fs->black_score = face_score(g, board, f, FACE_BLACK);
-                    add234(darkable_faces_sorted, fs);
-                }
-            }
+         * touching the one we've just lit, which are exactly the ones in
+         * its ring.  For each such face, we recalculate its colourability
+         * and scores, and move it to the right place in the lists. */
+        for (j = ls->ring_start[cur_face]; j < ls->ring_start[cur_face+1];
+             j++) {
+            int fi = ls->ring[j];
+
+            if (fi < 0)
+                continue;
+
+            /* If the face is already coloured, it won't be on our
+             * lightable/darkable lists anyway, so we can skip it. */
+            if (board[fi] != FACE_GREY) continue;
+
+            update_candidate(ls, &lightable_faces, rank, fi, FACE_WHITE);
+            update_candidate(ls, &darkable_faces, rank, fi, FACE_BLACK);
         }
     }
 
     /* Clean up */
-    freetree234(lightable_faces_sorted);
-    freetree234(darkable_faces_sorted);
-    sfree(face_scores);
+    face_queue_free(&lightable_faces);
+    face_queue_free(&darkable_faces);
+    sfree(rank);
+    sfree(face_at_rank);
 
     /* The next step requires a shuffled list of all faces */
     face_list = snewn(num_faces, int);
@@ -512,16 +674,15 @@ void generate_loop(grid *g, char *board, random_state *rs,
             int j = face_list[i];
             enum face_colour opp =
                 (board[j] == FACE_WHITE) ? FACE_BLACK : FACE_WHITE;
-            if (can_colour_face(g, board, j, opp)) {
-                grid_face *face = g->faces +j;
+            if (can_colour_face(ls, j, opp)) {
                 if (do_random_pass) {
                     /* final random pass */
                     if (!random_upto(rs, 10))
-                        board[j] = opp;
+                        set_face_colour(ls, j, opp);
                 } else {
                     /* normal pass - flip when neighbour count is 1 */
-                    if (face_num_neighbours(g, board, face, opp) == 1) {
-                        board[j] = opp;
+                    if (face_num_neighbours(ls, j, opp) == 1) {
+                        set_face_colour(ls, j, opp);
                         flipped = true;
                     }
                 }
@@ -533,4 +694,8 @@ void generate_loop(grid *g, char *board, random_state *rs,
     }
 
     sfree(face_list);
+    sfree(ls->ring_start);
+    sfree(ls->ring);
+    sfree(ls->white_nbrs);
+    sfree(ls->black_nbrs);
 }
@@ -163,6 +163,17 @@ typedef struct solver_state {
 
     /* Hard level information */
     int *linedsf;
+    int *linenext;      /* circular list of the lines in each linedsf class */
+
+    /* To-do lists for the deduction functions: the faces, dots and
+     * lines which something has changed near since the function last
+     * looked at them, so that the rest need not be examined again.
+     * The ones for a difficulty level we aren't using are NULL.
+     * linedsf_deductions keeps one only for lines: see the comment
+     * there. */
+    tdq *trivial_faces, *trivial_dots;
+    tdq *dline_faces, *dline_dots;
+    tdq *linedsf_lines;
 } solver_state;
 
 /*
@@ -304,9 +315,10 @@ static const struct {
  * type and size requested in params.  Does nothing if the grid is already
  * generated. */
 static grid *loopy_generate_grid(const game_params *params,
-                                 const char *grid_desc)
+                                 const char *grid_desc, grid_cache *gc)
 {
-    return grid_new(grid_types[params->type], params->w, params->h, grid_desc);
+    return grid_new(grid_types[params->type], params->w, params->h,
+                    grid_desc, gc);
 }
 
 /* ----------------------------------------------------------------------
@@ -369,6 +381,51 @@ static void free_game(game_state *state)
     }
 }
 
+/*
+ * Set up the to-do lists with everything on them. We don't try to
+ * carry the to-do lists over when copying a solver state, since
+ * that's only done at the start of a solve.
+ */
+static void new_solver_todo(solver_state *sstate)
+{
+    int num_dots = sstate->state->game_grid->num_dots;
+    int num_faces = sstate->state->game_grid->num_faces;
+    int num_edges = sstate->state->game_grid->num_edges;
+
+    sstate->trivial_faces = tdq_new(num_faces);
+    sstate->trivial_dots = tdq_new(num_dots);
+    tdq_fill(sstate->trivial_faces);
+    tdq_fill(sstate->trivial_dots);
+
+    if (sstate->dlines) {
+        sstate->dline_faces = tdq_new(num_faces);
+        sstate->dline_dots = tdq_new(num_dots);
+        tdq_fill(sstate->dline_faces);
+        tdq_fill(sstate->dline_dots);
+    } else {
+        sstate->dline_faces = sstate->dline_dots = NULL;
+    }
+
+    if (sstate->linedsf) {
+        sstate->linedsf_lines = tdq_new(num_edges);
+        tdq_fill(sstate->linedsf_lines);
+    } else {
+        sstate->linedsf_lines = NULL;
+    }
+}
+
+static void free_solver_todo(solver_state *sstate)
+{
+    tdq_free(sstate->trivial_faces);
+    tdq_free(sstate->trivial_dots);
+    if (sstate->dline_faces) {
+        tdq_free(sstate->dline_faces);
+        tdq_free(sstate->dline_dots);
+    }
+    if (sstate->linedsf_lines)
+        tdq_free(sstate->linedsf_lines);
+}
+
 static solver_state *new_solver_state(const game_state *state, int diff) {
     int i;
     int num_dots = state->game_grid->num_dots;
@@ -411,10 +468,16 @@ static solver_state *new_solver_state(const game_state *state, int diff) {
 
     if (diff < DIFF_HARD) {
         ret->linedsf = NULL;
+        ret->linenext = NULL;
     } else {
         ret->linedsf = snew_dsf(state->game_grid->num_edges);
+        ret->linenext = snewn(num_edges, int);
+        for (i = 0; i < num_edges; i++)
+            ret->linenext[i] = i;
     }
 
+    new_solver_todo(ret);
+
     return ret;
 }
 
@@ -433,6 +496,9 @@ static void free_solver_state(solver_state *sstate) {
         /* OK, because sfree(NULL) is a no-op */
         sfree(sstate->dlines);
         sfree(sstate->linedsf);
+        sfree(sstate->linenext);
+
+        free_solver_todo(sstate);
 
         sfree(sstate);
     }
@@ -484,10 +550,16 @@ static solver_state *dup_solver_state(const solver_state *sstate) {
         ret->linedsf = snewn(num_edges, int);
         memcpy(ret->linedsf, sstate->linedsf,
                num_edges * sizeof(int));
+        ret->linenext = snewn(num_edges, int);
+        memcpy(ret->linenext, sstate->linenext,
+               num_edges * sizeof(int));
     } else {
         ret->linedsf = NULL;
+        ret->linenext = NULL;
     }
 
+    new_solver_todo(ret);
+
     return ret;
 }
 
@@ -763,7 +835,8 @@ static char *extract_grid_desc(const char **desc)
 
 /* We require that the params pass the test in validate_params and that the
  * description fills the entire game area */
-static const char *validate_desc(const game_params *params, const char *desc)
+static const char *validate_desc_cached(const game_params *params,
+                                        const char *desc, grid_cache *gc)
 {
     int count = 0;
     grid *g;
@@ -773,10 +846,11 @@ static const char *validate_desc(const game_params *params, const char *desc)
     /* It's pretty inefficient to do this just for validation. All we need to
      * know is the precise number of faces. */
     grid_desc = extract_grid_desc(&desc);
-    ret = grid_validate_desc(grid_types[params->type], params->w, params->h, grid_desc);
+    ret = grid_validate_desc(grid_types[params->type], params->w, params->h,
+                             grid_desc, gc);
     if (ret) return ret;
 
-    g = loopy_generate_grid(params, grid_desc);
+    g = loopy_generate_grid(params, grid_desc, gc);
     if (grid_desc) sfree(grid_desc);
 
     for (; *desc; ++desc) {
@@ -801,6 +875,11 @@ static const char *validate_desc(const game_params *params, const char *desc)
     return NULL;
 }
 
+static const char *validate_desc(const game_params *params, const char *desc)
+{
+    return validate_desc_cached(params, desc, NULL);
+}
+
 /* Sums the lengths of the numbers in range [0,n) */
 /* See equivalent function in solo.c for justification of this. */
 static int len_0_to_n(int n)
@@ -1108,6 +1187,39 @@ static void check_caches(const solver_state* sstate)
  * Solver utility functions
  */
 
+/* Put a dot, and all the faces around it, back on the to-do lists of
+ * all the deduction functions. */
+static void solver_touch_dot(solver_state *sstate, int di)
+{
+    grid *g = sstate->state->game_grid;
+    int i;
+
+    tdq_add(sstate->trivial_dots, di);
+    if (sstate->dline_dots)
+        tdq_add(sstate->dline_dots, di);
+
+    for (i = g->dot_start[di]; i < g->dot_start[di+1]; i++) {
+        int fi = g->dot_faces[i];
+
+        if (fi < 0)
+            continue;
+        tdq_add(sstate->trivial_faces, fi);
+        if (sstate->dline_faces)
+            tdq_add(sstate->dline_faces, fi);
+    }
+}
+
+/* Something has changed about the line with index i. */
+static void solver_touch_line(solver_state *sstate, int i)
+{
+    grid *g = sstate->state->game_grid;
+
+    solver_touch_dot(sstate, g->edge_dots[2*i]);
+    solver_touch_dot(sstate, g->edge_dots[2*i+1]);
+    if (sstate->linedsf_lines)
+        tdq_add(sstate->linedsf_lines, i);
+}
+
 /* Sets the line (with index i) to the new state 'line_new', and updates
  * the cached counts of any affected faces and dots.
  * Returns true if this actually changed the line's state. */
@@ -1120,7 +1232,7 @@ static bool solver_set_line(solver_state *sstate, int i,
 {
     game_state *state = sstate->state;
     grid *g;
-    grid_edge *e;
+    int d1, d2, f1, f2;
 
     assert(line_new != LINE_UNKNOWN);
 
@@ -1138,29 +1250,34 @@ static bool solver_set_line(solver_state *sstate, int i,
 #endif
 
     g = state->game_grid;
-    e = g->edges + i;
+    d1 = g->edge_dots[2*i];
+    d2 = g->edge_dots[2*i+1];
+    f1 = g->edge_faces[2*i];
+    f2 = g->edge_faces[2*i+1];
 
     /* Update the cache for both dots and both faces affected by this. */
     if (line_new == LINE_YES) {
-        sstate->dot_yes_count[e->dot1 - g->dots]++;
-        sstate->dot_yes_count[e->dot2 - g->dots]++;
-        if (e->face1) {
-            sstate->face_yes_count[e->face1 - g->faces]++;
+        sstate->dot_yes_count[d1]++;
+        sstate->dot_yes_count[d2]++;
+        if (f1 >= 0) {
+            sstate->face_yes_count[f1]++;
         }
-        if (e->face2) {
-            sstate->face_yes_count[e->face2 - g->faces]++;
+        if (f2 >= 0) {
+            sstate->face_yes_count[f2]++;
         }
     } else {
-        sstate->dot_no_count[e->dot1 - g->dots]++;
-        sstate->dot_no_count[e->dot2 - g->dots]++;
-        if (e->face1) {
-            sstate->face_no_count[e->face1 - g->faces]++;
+        sstate->dot_no_count[d1]++;
+        sstate->dot_no_count[d2]++;
+        if (f1 >= 0) {
+            sstate->face_no_count[f1]++;
         }
-        if (e->face2) {
-            sstate->face_no_count[e->face2 - g->faces]++;
+        if (f2 >= 0) {
+            sstate->face_no_count[f2]++;
         }
     }
 
+    solver_touch_line(sstate, i);
+
     check_caches(sstate);
     return true;
 }
@@ -1228,6 +1345,21 @@ static bool merge_lines(solver_state *sstate, int i, int j, bool inverse
                 inverse ? "inverse " : "", reason);
     }
 #endif
+
+    if (i != j) {
+        /* Join the two classes' lists of lines into one, and have
+         * another look at everything near any of them. */
+        int k = sstate->linenext[i];
+        sstate->linenext[i] = sstate->linenext[j];
+        sstate->linenext[j] = k;
+
+        k = i;
+        do {
+            solver_touch_line(sstate, k);
+            k = sstate->linenext[k];
+        } while (k != i);
+    }
+
     return (i != j);
 }
 
@@ -1242,12 +1374,10 @@ static int dot_order(const game_state* state, int dot, char line_type)
 {
     int n = 0;
     grid *g = state->game_grid;
-    grid_dot *d = g->dots + dot;
     int i;
 
-    for (i = 0; i < d->order; i++) {
-        grid_edge *e = d->edges[i];
-        if (state->lines[e - g->edges] == line_type)
+    for (i = g->dot_start[dot]; i < g->dot_start[dot+1]; i++) {
+        if (state->lines[g->dot_edges[i]] == line_type)
             ++n;
     }
     return n;
@@ -1259,12 +1389,10 @@ static int face_order(const game_state* state, int face, char line_type)
 {
     int n = 0;
     grid *g = state->game_grid;
-    grid_face *f = g->faces + face;
     int i;
 
-    for (i = 0; i < f->order; i++) {
-        grid_edge *e = f->edges[i];
-        if (state->lines[e - g->edges] == line_type)
+    for (i = g->face_start[face]; i < g->face_start[face+1]; i++) {
+        if (state->lines[g->face_edges[i]] == line_type)
             ++n;
     }
     return n;
@@ -1278,17 +1406,15 @@ static bool dot_setall(solver_state *sstate, int dot,
     bool retval = false, r;
     game_state *state = sstate->state;
     grid *g;
-    grid_dot *d;
     int i;
 
     if (old_type == new_type)
         return false;
 
     g = state->game_grid;
-    d = g->dots + dot;
 
-    for (i = 0; i < d->order; i++) {
-        int line_index = d->edges[i] - g->edges;
+    for (i = g->dot_start[dot]; i < g->dot_start[dot+1]; i++) {
+        int line_index = g->dot_edges[i];
         if (state->lines[line_index] == old_type) {
             r = solver_set_line(sstate, line_index, new_type);
             assert(r);
@@ -1305,17 +1431,15 @@ static bool face_setall(solver_state *sstate, int face,
     bool retval = false, r;
     game_state *state = sstate->state;
     grid *g;
-    grid_face *f;
     int i;
 
     if (old_type == new_type)
         return false;
 
     g = state->game_grid;
-    f = g->faces + face;
 
-    for (i = 0; i < f->order; i++) {
-        int line_index = f->edges[i] - g->edges;
+    for (i = g->face_start[face]; i < g->face_start[face+1]; i++) {
+        int line_index = g->face_edges[i];
         if (state->lines[line_index] == old_type) {
             r = solver_set_line(sstate, line_index, new_type);
             assert(r);
@@ -1421,11 +1545,13 @@ static char *new_game_desc(const game_params *params, random_state *rs,
     /* solution and description both use run-length encoding in obvious ways */
     char *retval, *game_desc, *grid_desc;
     grid *g;
+    grid_cache *gc = grid_cache_new();
     game_state *state = snew(game_state);
     game_state *state_new;
 
-    grid_desc = grid_new_desc(grid_types[params->type], params->w, params->h, rs);
-    state->game_grid = g = loopy_generate_grid(params, grid_desc);
+    grid_desc = grid_new_desc(grid_types[params->type], params->w, params->h,
+                              rs, gc);
+    state->game_grid = g = loopy_generate_grid(params, grid_desc, gc);
 
     state->clues = snewn(g->num_faces, signed char);
     state->lines = snewn(g->num_edges, char);
@@ -1474,7 +1600,8 @@ static char *new_game_desc(const game_params *params, random_state *rs,
         retval = game_desc;
     }
 
-    assert(!validate_desc(params, retval));
+    assert(!validate_desc_cached(params, retval, gc));
+    grid_cache_free(gc);
 
     return retval;
 }
@@ -1492,7 +1619,7 @@ static game_state *new_game(midend *me, const game_params *params,
     int num_faces, num_edges;
 
     grid_desc = extract_grid_desc(&desc);
-    state->game_grid = g = loopy_generate_grid(params, grid_desc);
+    state->game_grid = g = loopy_generate_grid(params, grid_desc, NULL);
     if (grid_desc) sfree(grid_desc);
 
     dp = desc;
@@ -1873,6 +2000,30 @@ static bool set_atmostone(char *dline_array, int index)
     return SET_BIT(dline_array[index], 1);
 }
 
+/* Versions of the above for use by the solver proper, which also put
+ * the dline's dot back on the to-do lists if anything changed. */
+static void solver_touch_dline(solver_state *sstate, int index)
+{
+    grid *g = sstate->state->game_grid;
+
+    /* See dline_index_from_dot for the encoding */
+    solver_touch_dot(sstate, g->edge_dots[(index & ~1) + !(index & 1)]);
+}
+static bool solver_set_atleastone(solver_state *sstate, int index)
+{
+    if (!set_atleastone(sstate->dlines, index))
+        return false;
+    solver_touch_dline(sstate, index);
+    return true;
+}
+static bool solver_set_atmostone(solver_state *sstate, int index)
+{
+    if (!set_atmostone(sstate->dlines, index))
+        return false;
+    solver_touch_dline(sstate, index);
+    return true;
+}
+
 static void array_setall(char *array, char from, char to, int len)
 {
     char *p = array, *p_old = p;
@@ -1916,7 +2067,7 @@ static bool dline_set_opp_atleastone(solver_state *sstate,
             continue;
         /* Found opposite UNKNOWNS and they're next to each other */
         opp_dline_index = dline_index_from_dot(g, d, opp);
-        return set_atleastone(sstate->dlines, opp_dline_index);
+        return solver_set_atleastone(sstate, opp_dline_index);
     }
     return false;
 }
@@ -2071,24 +2222,13 @@ static int parity_deductions(solver_state *sstate,
  * solvers which progress more quickly.
  */
 
-/* PROPOSED NEW DESIGN:
- * We have a work queue consisting of 'events' notifying us that something has
- * happened that a particular solver mode might be interested in.  For example
- * the hard mode solver might do something that helps the normal mode solver at
- * dot [x,y] in which case it will enqueue an event recording this fact.  Then
- * we pull events off the work queue, and hand each in turn to the solver that
- * is interested in them.  If a solver reports that it failed we pass the same
- * event on to progressively more advanced solvers and the loop detector.  Once
- * we've exhausted an event, or it has helped us progress, we drop it and
- * continue to the next one.  The events are sorted first in order of solver
- * complexity (easy first) then order of insertion (oldest first).
- * Once we run out of events we loop over each permitted solver in turn
- * (easiest first) until either a deduction is made (and an event therefore
- * emerges) or no further deductions can be made (in which case we've failed).
- *
- * QUESTIONS:
- *    * How do we 'loop over' a solver when both dots and squares are concerned.
- *      Answer: first all squares then all dots.
+/*
+ * None of them looks over the whole grid each time. Instead, each has
+ * its own to-do lists (see solver_state) of the faces and dots which
+ * have had a line, dline or linedsf class near them change since it
+ * last looked at them, and only examines those, taking them off the
+ * list as it goes. Deductions it makes then put their neighbourhood
+ * back on everybody's lists, its own included.
  */
 
 static int trivial_deductions(solver_state *sstate)
@@ -2099,8 +2239,8 @@ static int trivial_deductions(solver_state *sstate)
     int diff = DIFF_MAX;
 
     /* Per-face deductions */
-    for (i = 0; i < g->num_faces; i++) {
-        grid_face *f = g->faces + i;
+    while ((i = tdq_remove(sstate->trivial_faces)) >= 0) {
+        int fstart = g->face_start[i], order = g->face_start[i+1] - fstart;
 
         if (sstate->face_solved[i])
             continue;
@@ -2108,7 +2248,7 @@ static int trivial_deductions(solver_state *sstate)
         current_yes = sstate->face_yes_count[i];
         current_no  = sstate->face_no_count[i];
 
-        if (current_yes + current_no == f->order)  {
+        if (current_yes + current_no == order)  {
             sstate->face_solved[i] = true;
             continue;
         }
@@ -2134,19 +2274,19 @@ static int trivial_deductions(solver_state *sstate)
             continue;
         }
 
-        if (f->order - state->clues[i] < current_no) {
+        if (order - state->clues[i] < current_no) {
             sstate->solver_status = SOLVER_MISTAKE;
             return DIFF_EASY;
         }
-        if (f->order - state->clues[i] == current_no) {
+        if (order - state->clues[i] == current_no) {
             if (face_setall(sstate, i, LINE_UNKNOWN, LINE_YES))
                 diff = min(diff, DIFF_EASY);
             sstate->face_solved[i] = true;
             continue;
         }
 
-        if (f->order - state->clues[i] == current_no + 1 &&
-            f->order - current_yes - current_no > 2) {
+        if (order - state->clues[i] == current_no + 1 &&
+            order - current_yes - current_no > 2) {
             /*
              * One small refinement to the above: we also look for any
              * adjacent pair of LINE_UNKNOWNs around the face with
@@ -2157,23 +2297,23 @@ static int trivial_deductions(solver_state *sstate)
              */
             int j, k, e1, e2, e, d;
 
-            for (j = 0; j < f->order; j++) {
-                e1 = f->edges[j] - g->edges;
-                e2 = f->edges[j+1 < f->order ? j+1 : 0] - g->edges;
+            for (j = 0; j < order; j++) {
+                e1 = g->face_edges[fstart + j];
+                e2 = g->face_edges[fstart + (j+1 < order ? j+1 : 0)];
 
-                if (g->edges[e1].dot1 == g->edges[e2].dot1 ||
-                    g->edges[e1].dot1 == g->edges[e2].dot2) {
-                    d = g->edges[e1].dot1 - g->dots;
+                if (g->edge_dots[2*e1] == g->edge_dots[2*e2] ||
+                    g->edge_dots[2*e1] == g->edge_dots[2*e2+1]) {
+                    d = g->edge_dots[2*e1];
                 } else {
-                    assert(g->edges[e1].dot2 == g->edges[e2].dot1 ||
-                           g->edges[e1].dot2 == g->edges[e2].dot2);
-                    d = g->edges[e1].dot2 - g->dots;
+                    assert(g->edge_dots[2*e1+1] == g->edge_dots[2*e2] ||
+                           g->edge_dots[2*e1+1] == g->edge_dots[2*e2+1]);
+                    d = g->edge_dots[2*e1+1];
                 }
 
                 if (state->lines[e1] == LINE_UNKNOWN &&
                     state->lines[e2] == LINE_UNKNOWN) {
-                    for (k = 0; k < g->dots[d].order; k++) {
-                        int e = g->dots[d].edges[k] - g->edges;
+                    for (k = g->dot_start[d]; k < g->dot_start[d+1]; k++) {
+                        int e = g->dot_edges[k];
                         if (state->lines[e] == LINE_YES)
                             goto found;    /* multi-level break */
                     }
@@ -2186,8 +2326,8 @@ static int trivial_deductions(solver_state *sstate)
              * If we get here, we've found such a pair of edges, and
              * they're e1 and e2.
              */
-            for (j = 0; j < f->order; j++) {
-                e = f->edges[j] - g->edges;
+            for (j = 0; j < order; j++) {
+                e = g->face_edges[fstart + j];
                 if (state->lines[e] == LINE_UNKNOWN && e != e1 && e != e2) {
                     bool r = solver_set_line(sstate, e, LINE_YES);
                     assert(r);
@@ -2200,8 +2340,7 @@ static int trivial_deductions(solver_state *sstate)
     check_caches(sstate);
 
     /* Per-dot deductions */
-    for (i = 0; i < g->num_dots; i++) {
-        grid_dot *d = g->dots + i;
+    while ((i = tdq_remove(sstate->trivial_dots)) >= 0) {
         int yes, no, unknown;
 
         if (sstate->dot_solved[i])
@@ -2209,7 +2348,7 @@ static int trivial_deductions(solver_state *sstate)
 
         yes = sstate->dot_yes_count[i];
         no = sstate->dot_no_count[i];
-        unknown = d->order - yes - no;
+        unknown = g->dot_start[i+1] - g->dot_start[i] - yes - no;
 
         if (yes == 0) {
             if (unknown == 0) {
@@ -2295,7 +2434,7 @@ static int dline_deductions(solver_state *sstate)
      * could get quite expensive if there are many large faces. */
 #define MAX_FACE_SIZE 12
 
-    for (i = 0; i < g->num_faces; i++) {
+    while ((i = tdq_remove(sstate->dline_faces)) >= 0) {
         int maxs[MAX_FACE_SIZE][MAX_FACE_SIZE];
         int mins[MAX_FACE_SIZE][MAX_FACE_SIZE];
         grid_face *f = g->faces + i;
@@ -2413,13 +2552,13 @@ static int dline_deductions(solver_state *sstate)
                 /* minimum YESs in the complement of this dline */
                 if (mins[k][j] > clue - 2) {
                     /* Adding 2 YESs would break the clue */
-                    if (set_atmostone(dlines, dline_index))
+                    if (solver_set_atmostone(sstate, dline_index))
                         diff = min(diff, DIFF_NORMAL);
                 }
                 /* maximum YESs in the complement of this dline */
                 if (maxs[k][j] < clue) {
                     /* Adding 2 NOs would mean not enough YESs */
-                    if (set_atleastone(dlines, dline_index))
+                    if (solver_set_atleastone(sstate, dline_index))
                         diff = min(diff, DIFF_NORMAL);
                 }
             }
@@ -2431,7 +2570,7 @@ static int dline_deductions(solver_state *sstate)
 
     /* ------ Dot deductions ------ */
 
-    for (i = 0; i < g->num_dots; i++) {
+    while ((i = tdq_remove(sstate->dline_dots)) >= 0) {
         grid_dot *d = g->dots + i;
         int N = d->order;
         int yes, no, unknown;
@@ -2457,11 +2596,11 @@ static int dline_deductions(solver_state *sstate)
 
             /* Infer dline state from line state */
             if (line1 == LINE_NO || line2 == LINE_NO) {
-                if (set_atmostone(dlines, dline_index))
+                if (solver_set_atmostone(sstate, dline_index))
                     diff = min(diff, DIFF_NORMAL);
             }
             if (line1 == LINE_YES || line2 == LINE_YES) {
-                if (set_atleastone(dlines, dline_index))
+                if (solver_set_atleastone(sstate, dline_index))
                     diff = min(diff, DIFF_NORMAL);
             }
             /* Infer line state from dline state */
@@ -2507,10 +2646,10 @@ static int dline_deductions(solver_state *sstate)
                 }
             }
             if (yes == 1) {
-                if (set_atmostone(dlines, dline_index))
+                if (solver_set_atmostone(sstate, dline_index))
                     diff = min(diff, DIFF_NORMAL);
                 if (unknown == 2) {
-                    if (set_atleastone(dlines, dline_index))
+                    if (solver_set_atleastone(sstate, dline_index))
                         diff = min(diff, DIFF_NORMAL);
                 }
             }
@@ -2536,7 +2675,7 @@ static int dline_deductions(solver_state *sstate)
                         if (j == N-1 && opp == 0)
                             continue;
                         opp_dline_index = dline_index_from_dot(g, d, opp);
-                        if (set_atmostone(dlines, opp_dline_index))
+                        if (solver_set_atmostone(sstate, opp_dline_index))
                             diff = min(diff, DIFF_NORMAL);
                     }
                     if (yes == 0 && is_atmostone(dlines, dline_index)) {
@@ -2580,6 +2719,16 @@ static int linedsf_deductions(solver_state *sstate)
     int diff = DIFF_MAX;
     int diff_tmp;
 
+    /*
+     * Unlike the other deduction functions, this one looks at every
+     * face and every dot each time, rather than only those on a to-do
+     * list. The order matters here: a list would take a face or dot
+     * again within this pass as soon as a deduction touched it, and
+     * that alone is enough to leave some Hard puzzles unsolved which
+     * the full sweep does solve. Only the lines, whose pass just
+     * copies known states across each linedsf class, use a list.
+     */
+
     /* ------ Face deductions ------ */
 
     /* A fully-general linedsf deduction seems overly complicated
@@ -2650,9 +2799,9 @@ static int linedsf_deductions(solver_state *sstate)
             can2 = edsf_canonify(sstate->linedsf, line2_index, &inv2);
             if (can1 == can2 && inv1 != inv2) {
                 /* These are opposites, so set dline atmostone/atleastone */
-                if (set_atmostone(dlines, dline_index))
+                if (solver_set_atmostone(sstate, dline_index))
                     diff = min(diff, DIFF_NORMAL);
-                if (set_atleastone(dlines, dline_index))
+                if (solver_set_atleastone(sstate, dline_index))
                     diff = min(diff, DIFF_NORMAL);
                 continue;
             }
@@ -2676,26 +2825,36 @@ static int linedsf_deductions(solver_state *sstate)
 
     /* ------ Edge dsf deductions ------ */
 
-    /* If the state of a line is known, deduce the state of its canonical line
-     * too, and vice versa. */
-    for (i = 0; i < g->num_edges; i++) {
-        int can;
+    /* If the state of a line is known, deduce the state of every other
+     * line in its class too. */
+    while ((i = tdq_remove(sstate->linedsf_lines)) >= 0) {
+        int can, j;
         bool inv;
         enum line_state s;
         can = edsf_canonify(sstate->linedsf, i, &inv);
-        if (can == i)
-            continue;
         s = sstate->state->lines[can];
-        if (s != LINE_UNKNOWN) {
-            if (solver_set_line(sstate, i, inv ? OPP(s) : s))
-                diff = min(diff, DIFF_EASY);
-        } else {
+        if (s == LINE_UNKNOWN) {
             s = sstate->state->lines[i];
-            if (s != LINE_UNKNOWN) {
-                if (solver_set_line(sstate, can, inv ? OPP(s) : s))
-                    diff = min(diff, DIFF_EASY);
-            }
+            if (s == LINE_UNKNOWN)
+                continue;
+            if (inv)
+                s = OPP(s);
         }
+        /* s is now the state of the canonical line */
+        j = i;
+        do {
+            enum line_state sj;
+            edsf_canonify(sstate->linedsf, j, &inv);
+            sj = inv ? OPP(s) : s;
+            if (sstate->state->lines[j] == LINE_UNKNOWN) {
+                solver_set_line(sstate, j, sj);
+                diff = min(diff, DIFF_EASY);
+            } else if (sstate->state->lines[j] != sj) {
+                sstate->solver_status = SOLVER_MISTAKE;
+                return DIFF_EASY;
+            }
+            j = sstate->linenext[j];
+        } while (j != i);
     }
 
     return diff;
@@ -2765,9 +2924,8 @@ static int loop_deductions(solver_state *sstate)
      * loop it would create is a solution.
      */
     for (i = 0; i < g->num_edges; i++) {
-        grid_edge *e = g->edges + i;
-        int d1 = e->dot1 - g->dots;
-        int d2 = e->dot2 - g->dots;
+        int d1 = g->edge_dots[2*i];
+        int d2 = g->edge_dots[2*i+1];
         int eqclass, val;
         if (state->lines[i] != LINE_UNKNOWN)
             continue;
@@ -2803,14 +2961,14 @@ static int loop_deductions(solver_state *sstate)
              * side of this edge.
              */
             sm1_nearby = 0;
-            if (e->face1) {
-                int f = e->face1 - g->faces;
+            if (g->edge_faces[2*i] >= 0) {
+                int f = g->edge_faces[2*i];
                 int c = state->clues[f];
                 if (c >= 0 && sstate->face_yes_count[f] == c - 1)
                     sm1_nearby++;
             }
-            if (e->face2) {
-                int f = e->face2 - g->faces;
+            if (g->edge_faces[2*i+1] >= 0) {
+                int f = g->edge_faces[2*i+1];
                 int c = state->clues[f];
                 if (c >= 0 && sstate->face_yes_count[f] == c - 1)
                     sm1_nearby++;
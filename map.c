@@ -14,6 +14,7 @@
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
+#include <limits.h>
 #include <math.h>
 
 #include "puzzles.h"
@@ -678,14 +679,23 @@ static int graph_vertex_start(int *graph, int n, int ngraph, int i)
  * FIXME: it would be nice if we could convert this recursion into
  * pseudo-recursion using some sort of explicit stack array, for
  * the sake of the Palm port and its limited stack.
+ *
+ * Usually the search needs hardly any backtracking, but now and then
+ * an early choice leads into a dead end which takes an enormous time
+ * to back out of. So the search is limited to *budget calls, and
+ * fails if it runs out; fourcolour() then starts again.
  */
 
 static bool fourcolour_recurse(int *graph, int n, int ngraph,
-                               int *colouring, int *scratch, random_state *rs)
+                               int *colouring, int *scratch, random_state *rs,
+                               long *budget)
 {
     int nfree, nvert, start, i, j, k, c, ci;
     int cs[FOUR];
 
+    if ((*budget)-- <= 0)
+        return false;                  /* give up and restart */
+
     /*
      * Find the smallest number of free colours in any uncoloured
      * vertex, and count the number of such vertices.
@@ -751,7 +761,8 @@ static bool fourcolour_recurse(int *graph, int n, int ngraph,
 	/*
 	 * Recurse.
 	 */
-	if (fourcolour_recurse(graph, n, ngraph, colouring, scratch, rs))
+	if (fourcolour_recurse(graph, n, ngraph, colouring, scratch, rs,
+                               budget))
 	    return true;	       /* got one! */
 
 	/*
@@ -783,7 +794,7 @@ static void fourcolour(int *graph, int n, int ngraph, int *colouring,
 {
     int *scratch;
     int i;
-    bool retd;
+    long budget, left;
 
     /*
      * For each vertex and each colour, we store the number of
@@ -800,8 +811,20 @@ static void fourcolour(int *graph, int n, int ngraph, int *colouring,
     for (i = 0; i < n; i++)
 	colouring[i] = -1;
 
-    retd = fourcolour_recurse(graph, n, ngraph, colouring, scratch, rs);
-    assert(retd);                 /* by the Four Colour Theorem :-) */
+    /*
+     * Search with a limited budget, doubling it after each failure
+     * (which leaves colouring and scratch as they were) so that we
+     * are bound to finish eventually.
+     */
+    budget = 100 * (long)n + 100;
+    while (true) {
+        left = budget;
+        if (fourcolour_recurse(graph, n, ngraph, colouring, scratch, rs,
+                               &left))
+            break;
+        assert(left < 0);         /* by the Four Colour Theorem :-) */
+        budget *= 2;
+    }
 
     sfree(scratch);
 }
@@ -817,18 +840,46 @@ struct solver_scratch {
     int n;
     int ngraph;
 
+    /*
+     * The graph again, in two forms more convenient for the solver:
+     * the neighbours of region i are nbrs[nbr_start[i]] up to
+     * nbrs[nbr_start[i+1]-1], and adjacency is a bit matrix of n
+     * rows of adjwords words each.
+     */
+    int *nbr_start, *nbrs;
+    unsigned long *adj;
+    int adjwords;
+
     int *bfsqueue;
     int *bfscolour;
 #ifdef SOLVER_DIAGNOSTICS
     int *bfsprev;
 #endif
 
+    /*
+     * Rather than copying everything for each recursive guess, we
+     * record every change made below depth 0 on a trail, as pairs of
+     * (region, old possible[] value), or (~region, old colouring[]
+     * value), so that they can be unwound again afterwards.
+     */
+    int *trail;
+    int ntrail;
+
+    /* The first solution found by a recursive search. */
+    int *solution;
+
     int depth;
 };
 
+#define ADJWORD_BITS ((int)(sizeof(unsigned long) * CHAR_BIT))
+#define ADJACENT(sc, i, j) \
+    (((sc)->adj[(i) * (sc)->adjwords + (j) / ADJWORD_BITS] >> \
+      ((j) % ADJWORD_BITS)) & 1)
+
 static struct solver_scratch *new_scratch(int *graph, int n, int ngraph)
 {
     struct solver_scratch *sc;
+    int i;
 
     sc = snew(struct solver_scratch);
     sc->graph = graph;
@@ -841,6 +892,39 @@ static struct solver_scratch *new_scratch(int *graph, int n, int ngraph)
 #ifdef SOLVER_DIAGNOSTICS
     sc->bfsprev = snewn(n, int);
 #endif
+    for (i = 0; i < n; i++) {
+        sc->bfscolour[i] = -1;
+#ifdef SOLVER_DIAGNOSTICS
+        sc->bfsprev[i] = -1;
+#endif
+    }
+
+    /*
+     * The graph is a sorted list of i*n+j, so the neighbours of each
+     * region are already contiguous.
+     */
+    sc->nbr_start = snewn(n+1, int);
+    sc->nbrs = snewn(ngraph, int);
+    sc->adjwords = (n + ADJWORD_BITS - 1) / ADJWORD_BITS;
+    sc->adj = snewn(n * sc->adjwords, unsigned long);
+    memset(sc->adj, 0, n * sc->adjwords * sizeof(unsigned long));
+    sc->nbr_start[0] = 0;
+    for (i = 0; i < ngraph; i++) {
+        int j1 = graph[i] / n, j2 = graph[i] % n;
+        sc->nbrs[i] = j2;
+        sc->adj[j1 * sc->adjwords + j2 / ADJWORD_BITS] |=
+            1UL << (j2 % ADJWORD_BITS);
+    }
+    for (i = 0; i < n; i++)
+        sc->nbr_start[i+1] = graph_vertex_start(graph, n, ngraph, i+1);
+
+    /*
+     * Along any one line of recursion, each region can be coloured
+     * once and have its possible[] entry reduced at most FOUR times.
+     */
+    sc->trail = snewn(2 * (FIVE * n), int);
+    sc->ntrail = 0;
+    sc->solution = snewn(n, int);
 
     return sc;
 }
@@ -853,9 +937,56 @@ static void free_scratch(struct solver_scratch *sc)
 #ifdef SOLVER_DIAGNOSTICS
     sfree(sc->bfsprev);
 #endif
+    sfree(sc->nbr_start);
+    sfree(sc->nbrs);
+    sfree(sc->adj);
+    sfree(sc->trail);
+    sfree(sc->solution);
     sfree(sc);
 }
 
+/*
+ * All changes to possible[] and colouring[] go through these, so that
+ * they can be put on the trail.
+ */
+static void set_possible(struct solver_scratch *sc, int k, int p)
+{
+    if (sc->possible[k] == p)
+        return;
+    if (sc->depth > 0) {
+        assert(sc->ntrail + 2 <= 2 * (FIVE * sc->n));
+        sc->trail[sc->ntrail++] = k;
+        sc->trail[sc->ntrail++] = sc->possible[k];
+    }
+    sc->possible[k] = p;
+}
+
+static void set_colouring(struct solver_scratch *sc, int *colouring,
+                          int k, int c)
+{
+    if (sc->depth > 0) {
+        assert(sc->ntrail + 2 <= 2 * (FIVE * sc->n));
+        sc->trail[sc->ntrail++] = ~k;
+        sc->trail[sc->ntrail++] = colouring[k];
+    }
+    colouring[k] = c;
+}
+
+/*
+ * Unwind the trail back to an earlier length.
+ */
+static void undo_changes(struct solver_scratch *sc, int *colouring, int mark)
+{
+    while (sc->ntrail > mark) {
+        int old = sc->trail[--sc->ntrail];
+        int k = sc->trail[--sc->ntrail];
+        if (k < 0)
+            colouring[~k] = old;
+        else
+            sc->possible[k] = old;
+    }
+}
+
 /*
  * Count the bits in a word. Only needs to cope with FOUR bits.
  */
@@ -878,7 +1009,6 @@ static bool place_colour(struct solver_scratch *sc,
 #endif
                          )
 {
-    int *graph = sc->graph, n = sc->n, ngraph = sc->ngraph;
     int j, k;
 
     if (!(sc->possible[index] & (1 << colour))) {
@@ -890,8 +1020,8 @@ static bool place_colour(struct solver_scratch *sc,
 	return false;		       /* can't do it */
     }
 
-    sc->possible[index] = 1 << colour;
-    colouring[index] = colour;
+    set_possible(sc, index, 1 << colour);
+    set_colouring(sc, colouring, index, colour);
 
 #ifdef SOLVER_DIAGNOSTICS
     if (verbose)
@@ -902,15 +1032,14 @@ static bool place_colour(struct solver_scratch *sc,
     /*
      * Rule out this colour from all the region's neighbours.
      */
-    for (j = graph_vertex_start(graph, n, ngraph, index);
-	 j < ngraph && graph[j] < n*(index+1); j++) {
-	k = graph[j] - index*n;
+    for (j = sc->nbr_start[index]; j < sc->nbr_start[index+1]; j++) {
+	k = sc->nbrs[j];
 #ifdef SOLVER_DIAGNOSTICS
         if (verbose && (sc->possible[k] & (1 << colour)))
             printf("%*s  ruling out %c in region %d\n", 2*sc->depth, "",
                    colnames[colour], k);
 #endif
-	sc->possible[k] &= ~(1 << colour);
+	set_possible(sc, k, sc->possible[k] & ~(1 << colour));
     }
 
     return true;
@@ -950,6 +1079,7 @@ static int map_solver(struct solver_scratch *sc,
          */
         for (i = 0; i < n; i++)
             sc->possible[i] = (1 << FOUR) - 1;
+        sc->ntrail = 0;
 
         /*
          * Place clues.
@@ -980,6 +1110,8 @@ static int map_solver(struct solver_scratch *sc,
         if (difficulty < DIFF_EASY)
             break;                     /* can't do anything at all! */
 
+        SOLVER_TIER("easy: single colours");
+
 	/*
 	 * Simplest possible deduction: find a region with only one
 	 * possible colour.
@@ -1017,6 +1149,7 @@ static int map_solver(struct solver_scratch *sc,
                  * friendly error code.
                  */
                 assert(ret);
+                SOLVER_RULE("region has one colour");
 		done_something = true;
 	    }
 	}
@@ -1027,6 +1160,8 @@ static int map_solver(struct solver_scratch *sc,
         if (difficulty < DIFF_NORMAL)
             break;                     /* can't do anything harder */
 
+        SOLVER_TIER("normal: colour pairs");
+
         /*
          * Failing that, go up one level. Look for pairs of regions
          * which (a) both have the same pair of possible colours,
@@ -1074,11 +1209,9 @@ static int map_solver(struct solver_scratch *sc,
              * Go through the neighbours of j1 and see if any are
              * shared with j2.
              */
-            for (j = graph_vertex_start(graph, n, ngraph, j1);
-                 j < ngraph && graph[j] < n*(j1+1); j++) {
-                k = graph[j] - j1*n;
-                if (graph_adjacent(graph, n, ngraph, k, j2) &&
-                    (sc->possible[k] & v)) {
+            for (j = sc->nbr_start[j1]; j < sc->nbr_start[j1+1]; j++) {
+                k = sc->nbrs[j];
+                if (ADJACENT(sc, k, j2) && (sc->possible[k] & v)) {
 #ifdef SOLVER_DIAGNOSTICS
                     if (verbose) {
                         char buf[80];
@@ -1091,7 +1224,8 @@ static int map_solver(struct solver_scratch *sc,
                                "", colourset(buf, sc->possible[k] & v), k);
                     }
 #endif
-                    sc->possible[k] &= ~v;
+                    set_possible(sc, k, sc->possible[k] & ~v);
+                    SOLVER_RULE("neighbours of a colour pair");
                     done_something = true;
                 }
             }
@@ -1103,6 +1237,8 @@ static int map_solver(struct solver_scratch *sc,
         if (difficulty < DIFF_HARD)
             break;                     /* can't do anything harder */
 
+        SOLVER_TIER("hard: forcing chains");
+
         /*
          * Right; now we get creative. Now we're going to look for
          * `forcing chains'. A forcing chain is a path through the
@@ -1162,12 +1298,7 @@ static int map_solver(struct solver_scratch *sc,
 
                     origc = 1 << c;
 
-                    for (j = 0; j < n; j++) {
-                        sc->bfscolour[j] = -1;
-#ifdef SOLVER_DIAGNOSTICS
-                        sc->bfsprev[j] = -1;
-#endif
-                    }
+                    /* bfscolour[] (and bfsprev[]) are all -1 here. */
                     head = tail = 0;
                     sc->bfsqueue[tail++] = i;
                     sc->bfscolour[i] = sc->possible[i] &~ origc;
@@ -1179,9 +1310,9 @@ static int map_solver(struct solver_scratch *sc,
                         /*
                          * Try neighbours of j.
                          */
-                        for (gi = graph_vertex_start(graph, n, ngraph, j);
-                             gi < ngraph && graph[gi] < n*(j+1); gi++) {
-                            k = graph[gi] - j*n;
+                        for (gi = sc->nbr_start[j]; gi < sc->nbr_start[j+1];
+                             gi++) {
+                            k = sc->nbrs[gi];
 
                             /*
                              * To continue with the bfs in vertex
@@ -1211,8 +1342,7 @@ static int map_solver(struct solver_scratch *sc,
                              * possibility, and currc is equal to
                              * the original colour we ruled out.
                              */
-                            if (currc == origc &&
-                                graph_adjacent(graph, n, ngraph, k, i) &&
+                            if (currc == origc && ADJACENT(sc, k, i) &&
                                 (sc->possible[k] & currc)) {
 #ifdef SOLVER_DIAGNOSTICS
                                 if (verbose) {
@@ -1232,13 +1362,22 @@ static int map_solver(struct solver_scratch *sc,
                                            colourset(buf, origc), k);
                                 }
 #endif
-                                sc->possible[k] &= ~origc;
+                                set_possible(sc, k, sc->possible[k] & ~origc);
+                                SOLVER_RULE("forcing chain");
                                 done_something = true;
                             }
                         }
                     }
 
                     assert(tail <= n);
+
+                    /* Put bfscolour[] back the way we found it. */
+                    for (j = 0; j < tail; j++) {
+                        sc->bfscolour[sc->bfsqueue[j]] = -1;
+#ifdef SOLVER_DIAGNOSTICS
+                        sc->bfsprev[sc->bfsqueue[j]] = -1;
+#endif
+                    }
                 }
         }
 
@@ -1257,6 +1396,13 @@ static int map_solver(struct solver_scratch *sc,
         if (verbose)
             printf("%*sone solution found\n", 2*sc->depth, "");
 #endif
+        /*
+         * Inside a recursive guess, this is about to be unwound, so
+         * keep a copy. (A later solution can only overwrite it on the
+         * way to reporting the puzzle ambiguous.)
+         */
+        if (sc->depth > 0)
+            memcpy(sc->solution, colouring, n * sizeof(int));
         return 1;                      /* success! */
     }
 
@@ -1274,31 +1420,41 @@ static int map_solver(struct solver_scratch *sc,
 
     /*
      * Now we've got to do something recursive. So first hunt for a
-     * currently-most-constrained region.
+     * currently-most-constrained region: the one with fewest
+     * possible colours, and of those, the one with the most
+     * undecided neighbours, whose choice will constrain the most.
      */
     {
-        int best, bestc;
-        struct solver_scratch *rsc;
-        int *subcolouring, *origcolouring;
+        int best, bestc, bestdeg, possible, mark;
         int ret, subret;
         bool we_already_got_one;
 
         best = -1;
         bestc = FIVE;
+        bestdeg = -1;
 
         for (i = 0; i < n; i++) if (colouring[i] < 0) {
             int p = sc->possible[i];
             enum { compile_time_assertion = 1 / (FOUR <= 4) };
-            int c;
+            int c, deg, j;
 
             /* Count the set bits. */
             c = (p & 5) + ((p >> 1) & 5);
             c = (c & 3) + ((c >> 2) & 3);
             assert(c > 1);             /* or colouring[i] would be >= 0 */
 
-            if (c < bestc) {
+            if (c > bestc)
+                continue;
+
+            deg = 0;
+            for (j = sc->nbr_start[i]; j < sc->nbr_start[i+1]; j++)
+                if (colouring[sc->nbrs[j]] < 0)
+                    deg++;
+
+            if (c < bestc || deg > bestdeg) {
                 best = i;
                 bestc = c;
+                bestdeg = deg;
             }
         }
 
@@ -1310,31 +1466,32 @@ static int map_solver(struct solver_scratch *sc,
 #endif
 
         /*
-         * Now iterate over the possible colours for this region.
+         * Now iterate over the possible colours for this region,
+         * undoing the effects of each guess before trying the next.
          */
-        rsc = new_scratch(graph, n, ngraph);
-        rsc->depth = sc->depth + 1;
-        origcolouring = snewn(n, int);
-        memcpy(origcolouring, colouring, n * sizeof(int));
-        subcolouring = snewn(n, int);
+        possible = sc->possible[best];
+        mark = sc->ntrail;
         we_already_got_one = false;
         ret = 0;
 
         for (i = 0; i < FOUR; i++) {
-            if (!(sc->possible[best] & (1 << i)))
+            if (!(possible & (1 << i)))
                 continue;
 
-            memcpy(rsc->possible, sc->possible, n);
-            memcpy(subcolouring, origcolouring, n * sizeof(int));
-
-            place_colour(rsc, subcolouring, best, i
+            SOLVER_TIER("recursive: guessing");
+            SOLVER_RULE("guess");
+            sc->depth++;
+            place_colour(sc, colouring, best, i
 #ifdef SOLVER_DIAGNOSTICS
                          , "trying"
 #endif
                          );
 
-            subret = map_solver(rsc, graph, n, ngraph,
-                                subcolouring, difficulty);
+            subret = map_solver(sc, graph, n, ngraph,
+                                colouring, difficulty);
+
+            undo_changes(sc, colouring, mark);
+            sc->depth--;
 
 #ifdef SOLVER_DIAGNOSTICS
             if (verbose) {
@@ -1357,10 +1514,9 @@ static int map_solver(struct solver_scratch *sc,
 
             /*
              * If this possibility turned up one valid solution and
-             * it's the first we've seen, copy it into the output.
+             * it's the first we've seen, it's in sc->solution.
              */
             if (subret == 1) {
-                memcpy(colouring, subcolouring, n * sizeof(int));
                 we_already_got_one = true;
                 ret = 1;
             }
@@ -1371,9 +1527,11 @@ static int map_solver(struct solver_scratch *sc,
              */
         }
 
-        sfree(origcolouring);
-        sfree(subcolouring);
-        free_scratch(rsc);
+        /*
+         * At the top level, copy the solution into the output.
+         */
+        if (ret == 1 && sc->depth == 0)
+            memcpy(colouring, sc->solution, n * sizeof(int));
 
 #ifdef SOLVER_DIAGNOSTICS
         if (verbose && sc->depth == 0) {
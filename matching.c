@@ -74,39 +74,38 @@ size_t matching_scratch_size(int nl, int nr)
     return n * sizeof(int);
 }
 
-int matching_with_scratch(void *scratchv,
-                          int nl, int nr, int **adjlists, int *adjsizes,
-                          random_state *rs, int *outl, int *outr)
+static struct scratch *setup_scratch(void *scratchv, int nl, int nr)
 {
     struct scratch *s = (struct scratch *)scratchv;
-    int L, R, i, j;
+    int *p = scratchv;
+    int nmin = (nl < nr ? nl : nr);
 
     /*
      * Set up the various array pointers in the scratch space.
      */
-    {
-        int *p = scratchv;
-        int nmin = (nl < nr ? nl : nr);
-
-        p += (sizeof(struct scratch) + sizeof(int)-1)/sizeof(int);
-        s->LtoR = p; p += nl;
-        s->RtoL = p; p += nr;
-        s->Llayer = p; p += nl;
-        s->Rlayer = p; p += nr;
-        s->Lqueue = p; p += nl;
-        s->Rqueue = p; p += nr;
-        s->augpath = p; p += 2*nmin;
-        s->dfsstate = p; p += nmin;
-        s->Lorder = p; p += nl;
-    }
+    p += (sizeof(struct scratch) + sizeof(int)-1)/sizeof(int);
+    s->LtoR = p; p += nl;
+    s->RtoL = p; p += nr;
+    s->Llayer = p; p += nl;
+    s->Rlayer = p; p += nr;
+    s->Lqueue = p; p += nl;
+    s->Rqueue = p; p += nr;
+    s->augpath = p; p += 2*nmin;
+    s->dfsstate = p; p += nmin;
+    s->Lorder = p; p += nl;
+
+    return s;
+}
 
-    /*
-     * Set up the initial matching, which is empty.
-     */
-    for (L = 0; L < nl; L++)
-        s->LtoR[L] = -1;
-    for (R = 0; R < nr; R++)
-        s->RtoL[R] = -1;
+/*
+ * The main algorithm, which grows whatever matching is in s->LtoR and
+ * s->RtoL into a maximal one, and reports it.
+ */
+static int matching_augment(struct scratch *s,
+                            int nl, int nr, int **adjlists, int *adjsizes,
+                            random_state *rs, int *outl, int *outr)
+{
+    int L, R, i, j;
 
     while (1) {
         /*
@@ -299,6 +298,55 @@ int matching_with_scratch(void *scratchv,
     return j;
 }
 
+int matching_with_scratch(void *scratchv,
+                          int nl, int nr, int **adjlists, int *adjsizes,
+                          random_state *rs, int *outl, int *outr)
+{
+    struct scratch *s = setup_scratch(scratchv, nl, nr);
+    int L, R;
+
+    /*
+     * Set up the initial matching, which is empty.
+     */
+    for (L = 0; L < nl; L++)
+        s->LtoR[L] = -1;
+    for (R = 0; R < nr; R++)
+        s->RtoL[R] = -1;
+
+    return matching_augment(s, nl, nr, adjlists, adjsizes, rs, outl, outr);
+}
+
+int matching_update_with_scratch(void *scratchv,
+                                 int nl, int nr, int **adjlists,
+                                 int *adjsizes, random_state *rs,
+                                 int *outl, int *outr)
+{
+    struct scratch *s = setup_scratch(scratchv, nl, nr);
+    int L, R, j;
+
+    /*
+     * Start from the caller's matching, minus any pairs that are no
+     * longer joined by an edge.
+     */
+    for (R = 0; R < nr; R++)
+        s->RtoL[R] = -1;
+    for (L = 0; L < nl; L++) {
+        s->LtoR[L] = -1;
+        R = outl[L];
+        if (R < 0)
+            continue;
+        assert(R < nr && outr[R] == L);
+        for (j = 0; j < adjsizes[L]; j++)
+            if (adjlists[L][j] == R) {
+                s->LtoR[L] = R;
+                s->RtoL[R] = L;
+                break;
+            }
+    }
+
+    return matching_augment(s, nl, nr, adjlists, adjsizes, rs, outl, outr);
+}
+
 int matching(int nl, int nr, int **adjlists, int *adjsizes,
              random_state *rs, int *outl, int *outr)
 {
@@ -398,12 +446,15 @@ void deallocate(void)
     sfree(scratch);
 }
 
-void find_and_check_matching(void)
+/*
+ * Check that outl and outr hold a valid matching of size 'count', and
+ * that it's maximal, using the witness left in the scratch space by
+ * the call that found it.
+ */
+void check_matching(void)
 {
     int i, j, k;
 
-    count = matching_with_scratch(scratch, nl, nr, adjlists, adjsizes,
-                                  rs, outl, outr);
     matching_witness(scratch, nl, nr, witness);
 
     for (i = j = 0; i < nl; i++) {
@@ -449,6 +500,13 @@ void find_and_check_matching(void)
     }
 }
 
+void find_and_check_matching(void)
+{
+    count = matching_with_scratch(scratch, nl, nr, adjlists, adjsizes,
+                                  rs, outl, outr);
+    check_matching();
+}
+
 struct nodename {
     const char *name;
     int index;
@@ -681,6 +739,53 @@ void test_subsets(void)
     }
 }
 
+void test_incremental(void)
+{
+    int L, R, i, nruns;
+    bool *edge;
+    static const char seed[] = "another fixed seed for the incremental test";
+
+    /*
+     * Keep a matching up to date on a random sparse graph while
+     * toggling a few edges at a time, checking every time that
+     * matching_update_with_scratch has left a maximal matching.
+     */
+    rs = random_new(seed, strlen(seed));
+    allocate(40, 30, 40*30);
+    edge = snewn(nl*nr, bool);
+    for (i = 0; i < nl*nr; i++)
+        edge[i] = random_upto(rs, 10) == 0;
+    for (L = 0; L < nl; L++)
+        outl[L] = -1;
+    for (R = 0; R < nr; R++)
+        outr[R] = -1;
+
+    for (nruns = 0; nruns < 10000; nruns++) {
+        for (i = 1 + random_upto(rs, 3); i > 0; i--) {
+            int e = random_upto(rs, nl*nr);
+            edge[e] = !edge[e];
+        }
+
+        for (L = 0; L < nl; L++) {
+            adjlists[L] = adjdata + L*nr;
+            adjsizes[L] = 0;
+            for (R = 0; R < nr; R++)
+                if (edge[L*nr+R])
+                    adjlists[L][adjsizes[L]++] = R;
+        }
+
+        count = matching_update_with_scratch(scratch, nl, nr, adjlists,
+                                             adjsizes, rs, outl, outr);
+        check_matching();
+    }
+
+    printf("incremental matching: %d updates checked\n", nruns);
+
+    sfree(edge);
+    deallocate();
+    random_free(rs);
+}
+
 int main(int argc, char **argv)
 {
     static const char stdin_identifier[] = "<standard input>";
@@ -745,6 +850,7 @@ int main(int argc, char **argv)
         }
 
         test_subsets();
+        test_incremental();
     }
 
     return 0;
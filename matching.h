@@ -54,6 +54,28 @@ int matching_with_scratch(void *scratch,
                           int nl, int nr, int **adjlists, int *adjsizes,
                           random_state *rs, int *outl, int *outr);
 
+/*
+ * Incremental version of the above, for keeping a matching up to
+ * date while the graph changes a little at a time.
+ *
+ * On entry, 'outl' and 'outr' (neither of which may be NULL) must
+ * hold a matching in the same form as the output of
+ * matching_with_scratch, typically the output of a previous call on
+ * a similar graph. Any pair in it that is no longer an edge of the
+ * graph is dropped, and the rest is then extended along augmenting
+ * paths until it is maximal again. That takes at most one search
+ * phase per pair lost or gained, so if the graph has only changed
+ * slightly it is much quicker than starting from nothing. The result
+ * is written back to 'outl' and 'outr'.
+ *
+ * 'scratch' is as for matching_with_scratch, and needn't be
+ * preserved from the call that produced the original matching.
+ */
+int matching_update_with_scratch(void *scratch,
+                                 int nl, int nr, int **adjlists,
+                                 int *adjsizes, random_state *rs,
+                                 int *outl, int *outr);
+
 /*
  * The above function expects its 'scratch' parameter to have already
  * been set up. This function tells you how much space is needed for a
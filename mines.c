@@ -293,50 +293,133 @@ static int bitcount16(int inword)
 }
 
 /*
- * We use a tree234 to store a large number of small localised
- * sets, each with a mine count. We also keep some of those sets
- * linked together into a to-do list.
+ * We store a large number of small localised sets, each with a mine
+ * count. We also keep some of those sets linked together into a
+ * to-do list.
+ *
+ * Every set lies within the grid, so rather than a general search
+ * structure we index the sets by the top left corner of their
+ * bounding rectangle in a w*h table, each entry of which is a short
+ * list of the sets at that position sorted by mask. Walking the table
+ * in order therefore visits the sets in (y, x, mask) order.
+ *
+ * The set structures themselves are allocated in slabs and recycled
+ * through a free list, so that a setstore can be emptied and reused
+ * for another run of the solver without going back to malloc.
  */
 struct set {
     short x, y, mask, mines;
     bool todo;
     struct set *prev, *next;
+    struct set *pnext;		       /* next at this position, or free */
 };
 
-static int setcmp(void *av, void *bv)
-{
-    struct set *a = (struct set *)av;
-    struct set *b = (struct set *)bv;
+#define SETSLAB 256
 
-    if (a->y < b->y)
-	return -1;
-    else if (a->y > b->y)
-	return +1;
-    else if (a->x < b->x)
-	return -1;
-    else if (a->x > b->x)
-	return +1;
-    else if (a->mask < b->mask)
-	return -1;
-    else if (a->mask > b->mask)
-	return +1;
-    else
-	return 0;
-}
+struct setslab {
+    struct setslab *next;
+    struct set sets[SETSLAB];
+};
 
 struct setstore {
-    tree234 *sets;
+    int w, h;
+    struct set **pos;
+    int nsets;
     struct set *todo_head, *todo_tail;
+    struct setslab *slabs;
+    struct set *freelist;
+    struct set **overlap;	       /* result buffer for ss_overlap */
+    int overlapsize;
 };
 
-static struct setstore *ss_new(void)
+static struct setstore *ss_new(int w, int h)
 {
     struct setstore *ss = snew(struct setstore);
-    ss->sets = newtree234(setcmp);
+    int i;
+
+    ss->w = w;
+    ss->h = h;
+    ss->pos = snewn(w*h, struct set *);
+    for (i = 0; i < w*h; i++)
+        ss->pos[i] = NULL;
+    ss->nsets = 0;
     ss->todo_head = ss->todo_tail = NULL;
+    ss->slabs = NULL;
+    ss->freelist = NULL;
+    ss->overlapsize = 32;
+    ss->overlap = snewn(ss->overlapsize, struct set *);
     return ss;
 }
 
+/*
+ * Empty a setstore, keeping its memory for reuse.
+ */
+static void ss_clear(struct setstore *ss)
+{
+    int i;
+
+    for (i = 0; i < ss->w * ss->h; i++) {
+        while (ss->pos[i]) {
+            struct set *s = ss->pos[i];
+            ss->pos[i] = s->pnext;
+            s->pnext = ss->freelist;
+            ss->freelist = s;
+        }
+    }
+    ss->nsets = 0;
+    ss->todo_head = ss->todo_tail = NULL;
+}
+
+static void ss_free(struct setstore *ss)
+{
+    while (ss->slabs) {
+        struct setslab *slab = ss->slabs;
+        ss->slabs = slab->next;
+        sfree(slab);
+    }
+    sfree(ss->pos);
+    sfree(ss->overlap);
+    sfree(ss);
+}
+
+static struct set *ss_newset(struct setstore *ss)
+{
+    struct set *s;
+
+    if (!ss->freelist) {
+        struct setslab *slab = snew(struct setslab);
+        int i;
+
+        slab->next = ss->slabs;
+        ss->slabs = slab;
+        for (i = 0; i < SETSLAB; i++) {
+            slab->sets[i].pnext = ss->freelist;
+            ss->freelist = &slab->sets[i];
+        }
+    }
+
+    s = ss->freelist;
+    ss->freelist = s->pnext;
+    return s;
+}
+
+/*
+ * Return the index'th set in (y, x, mask) order.
+ */
+static struct set *ss_index(struct setstore *ss, int index)
+{
+    int i;
+
+    for (i = 0; i < ss->w * ss->h; i++) {
+        struct set *s;
+        for (s = ss->pos[i]; s; s = s->pnext)
+            if (index-- == 0)
+                return s;
+    }
+
+    return NULL;
+}
+
 /*
  * Take two input sets, in the form (x,y,mask). Munge the first by
  * taking either its intersection with the second or its difference
@@ -409,7 +492,7 @@ static void ss_add_todo(struct setstore *ss, struct set *s)
 
 static void ss_add(struct setstore *ss, int x, int y, int mask, int mines)
 {
-    struct set *s;
+    struct set *s, **link;
 
     assert(mask != 0);
 
@@ -422,25 +505,34 @@ static void ss_add(struct setstore *ss, int x, int y, int mask, int mines)
     while (!(mask & (1|2|4)))
 	mask >>= 3, y++;
 
+    assert(x >= 0 && x < ss->w && y >= 0 && y < ss->h);
+
     /*
-     * Create a set structure and add it to the tree.
+     * Find where this set belongs in the list for its position. If
+     * it already exists, there's nothing to do.
      */
-    s = snew(struct set);
+    link = &ss->pos[y * ss->w + x];
+    while (*link && (*link)->mask < mask)
+        link = &(*link)->pnext;
+    if (*link && (*link)->mask == mask)
+        return;
+
+    /*
+     * Create a set structure and add it to the store.
+     */
+    s = ss_newset(ss);
     s->x = x;
     s->y = y;
     s->mask = mask;
     s->mines = mines;
     s->todo = false;
-    if (add234(ss->sets, s) != s) {
-	/*
-	 * This set already existed! Free it and return.
-	 */
-	sfree(s);
-	return;
-    }
+    s->prev = s->next = NULL;
+    s->pnext = *link;
+    *link = s;
+    ss->nsets++;
 
     /*
-     * We've added a new set to the tree, so put it on the todo
+     * We've added a new set to the store, so put it on the todo
      * list.
      */
     ss_add_todo(ss, s);
@@ -448,7 +540,7 @@ static void ss_add(struct setstore *ss, int x, int y, int mask, int mines)
 
 static void ss_remove(struct setstore *ss, struct set *s)
 {
-    struct set *next = s->next, *prev = s->prev;
+    struct set *next = s->next, *prev = s->prev, **link;
 
 #ifdef SOLVER_DIAGNOSTICS
     printf("removing set %d,%d %03x\n", s->x, s->y, s->mask);
@@ -469,67 +561,59 @@ static void ss_remove(struct setstore *ss, struct set *s)
     s->todo = false;
 
     /*
-     * Remove s from the tree.
+     * Remove s from the list for its position.
      */
-    del234(ss->sets, s);
+    link = &ss->pos[s->y * ss->w + s->x];
+    while (*link != s)
+        link = &(*link)->pnext;
+    *link = s->pnext;
+    ss->nsets--;
 
     /*
-     * Destroy the actual set structure.
+     * Return the set structure to the free list.
      */
-    sfree(s);
+    s->pnext = ss->freelist;
+    ss->freelist = s;
 }
 
 /*
- * Return a dynamically allocated list of all the sets which
- * overlap a provided input set.
+ * Return a NULL-terminated list of all the sets which overlap a
+ * provided input set. The list is stored in the setstore, and is
+ * only valid until the next call to ss_overlap.
  */
 static struct set **ss_overlap(struct setstore *ss, int x, int y, int mask)
 {
-    struct set **ret = NULL;
-    int nret = 0, retsize = 0;
+    int nret = 0;
     int xx, yy;
 
-    for (xx = x-3; xx < x+3; xx++)
-	for (yy = y-3; yy < y+3; yy++) {
-	    struct set stmp, *s;
-	    int pos;
-
-	    /*
-	     * Find the first set with these top left coordinates.
-	     */
-	    stmp.x = xx;
-	    stmp.y = yy;
-	    stmp.mask = 0;
+    for (xx = max(x-3, 0); xx < x+3 && xx < ss->w; xx++)
+	for (yy = max(y-3, 0); yy < y+3 && yy < ss->h; yy++) {
+	    struct set *s;
 
-	    if (findrelpos234(ss->sets, &stmp, NULL, REL234_GE, &pos)) {
-		while ((s = index234(ss->sets, pos)) != NULL &&
-		       s->x == xx && s->y == yy) {
+	    for (s = ss->pos[yy * ss->w + xx]; s; s = s->pnext) {
+		/*
+		 * This set potentially overlaps the input one.
+		 * Compute the intersection to see if they really
+		 * overlap, and add it to the list if so.
+		 */
+		if (setmunge(x, y, mask, s->x, s->y, s->mask, false)) {
 		    /*
-		     * This set potentially overlaps the input one.
-		     * Compute the intersection to see if they
-		     * really overlap, and add it to the list if
-		     * so.
+		     * There's an overlap. (Leave room for the
+		     * terminating NULL.)
 		     */
-		    if (setmunge(x, y, mask, s->x, s->y, s->mask, false)) {
-			/*
-			 * There's an overlap.
-			 */
-			if (nret >= retsize) {
-			    retsize = nret + 32;
-			    ret = sresize(ret, retsize, struct set *);
-			}
-			ret[nret++] = s;
+		    if (nret + 1 >= ss->overlapsize) {
+			ss->overlapsize = nret * 2 + 32;
+			ss->overlap = sresize(ss->overlap, ss->overlapsize,
+					      struct set *);
 		    }
-
-		    pos++;
+		    ss->overlap[nret++] = s;
 		}
 	    }
 	}
 
-    ret = sresize(ret, nret+1, struct set *);
-    ret[nret] = NULL;
+    ss->overlap[nret] = NULL;
 
-    return ret;
+    return ss->overlap;
 }
 
 /*
@@ -628,6 +712,10 @@ struct perturbations {
  * unknown), plus a function which you can call to open new squares
  * once you're confident of them. It fills in as much more of the
  * grid as it can.
+ *
+ * The caller also supplies an empty setstore for the solver's
+ * working, which is emptied again on return, so that repeated runs
+ * over the same grid size can share one.
  * 
  * Return value is:
  * 
@@ -643,9 +731,8 @@ typedef struct perturbations *(*perturb_cb) (void *, signed char *, int, int, in
 static int minesolve(int w, int h, int n, signed char *grid,
 		     open_cb open,
                      perturb_cb perturb,
-		     void *ctx, random_state *rs)
+		     void *ctx, random_state *rs, struct setstore *ss)
 {
-    struct setstore *ss = ss_new();
     struct set **list;
     struct squaretodo astd, *std = &astd;
     int x, y, i, j;
@@ -764,7 +851,6 @@ static int minesolve(int w, int h, int n, signed char *grid,
 		    ss_remove(ss, s);
 		}
 
-		sfree(list);
 	    }
 
 	    /*
@@ -870,8 +956,6 @@ static int minesolve(int w, int h, int n, signed char *grid,
 		}
 	    }
 
-	    sfree(list);
-
 	    /*
 	     * In this situation we have definitely done
 	     * _something_, even if it's only reducing the size of
@@ -966,7 +1050,7 @@ static int minesolve(int w, int h, int n, signed char *grid,
 	     * a bit slow for large n, so I artificially cap this
 	     * recursion at n=10 to avoid too much pain.
 	     */
-	    nsets = count234(ss->sets);
+	    nsets = ss->nsets;
 	    if (nsets <= lenof(setused)) {
 		/*
 		 * Doing this with actual recursive function calls
@@ -1010,8 +1094,9 @@ static int minesolve(int w, int h, int n, signed char *grid,
 		 *    give up.
 		 */
 		struct set *sets[lenof(setused)];
-		for (i = 0; i < nsets; i++)
-		    sets[i] = index234(ss->sets, i);
+		for (i = 0, j = 0; i < ss->w * ss->h; i++)
+		    for (s = ss->pos[i]; s; s = s->pnext)
+			sets[j++] = s;
 
 		cursor = 0;
 		while (1) {
@@ -1150,7 +1235,7 @@ static int minesolve(int w, int h, int n, signed char *grid,
 	{
 	    struct set *s;
 
-	    for (i = 0; (s = index234(ss->sets, i)) != NULL; i++)
+	    for (i = 0; (s = ss_index(ss, i)) != NULL; i++)
 		printf("remaining set: %d,%d %03x %d\n", s->x, s->y, s->mask, s->mines);
 	}
 #endif
@@ -1174,13 +1259,13 @@ static int minesolve(int w, int h, int n, signed char *grid,
 	     * 
 	     * If we have no sets at all, we must give up.
 	     */
-	    if (count234(ss->sets) == 0) {
+	    if (ss->nsets == 0) {
 #ifdef SOLVER_DIAGNOSTICS
 		printf("perturbing on entire unknown set\n");
 #endif
 		ret = perturb(ctx, grid, 0, 0, 0);
 	    } else {
-		s = index234(ss->sets, random_upto(rs, count234(ss->sets)));
+		s = ss_index(ss, random_upto(rs, ss->nsets));
 #ifdef SOLVER_DIAGNOSTICS
 		printf("perturbing on set %d,%d %03x\n", s->x, s->y, s->mask);
 #endif
@@ -1219,7 +1304,6 @@ static int minesolve(int w, int h, int n, signed char *grid,
 			ss_add_todo(ss, list[j]);
 		    }
 
-		    sfree(list);
 		}
 
 		/*
@@ -1251,7 +1335,7 @@ static int minesolve(int w, int h, int n, signed char *grid,
 		{
 		    struct set *s;
 
-		    for (i = 0; (s = index234(ss->sets, i)) != NULL; i++)
+		    for (i = 0; (s = ss_index(ss, i)) != NULL; i++)
 			printf("remaining set: %d,%d %03x %d\n", s->x, s->y, s->mask, s->mines);
 		}
 #endif
@@ -1282,16 +1366,11 @@ static int minesolve(int w, int h, int n, signed char *grid,
 	    }
 
     /*
-     * Free the set list and square-todo list.
+     * Empty the set store, ready for the caller to reuse it, and
+     * free the square-todo list.
      */
-    {
-	struct set *s;
-	while ((s = delpos234(ss->sets, 0)) != NULL)
-	    sfree(s);
-	freetree234(ss->sets);
-	sfree(ss);
-	sfree(std->next);
-    }
+    ss_clear(ss);
+    sfree(std->next);
 
     return nperturbs;
 }
@@ -1728,6 +1807,7 @@ static bool *minegen(int w, int h, int n, int x, int y, bool unique,
     bool *ret = snewn(w*h, bool);
     bool success;
     int ntries = 0;
+    struct setstore *ss = (unique ? ss_new(w, h) : NULL);
 
     do {
 	success = false;
@@ -1814,7 +1894,8 @@ static bool *minegen(int w, int h, int n, int x, int y, bool unique,
 		assert(solvegrid[y*w+x] == 0); /* by deliberate arrangement */
 
 		solveret =
-		    minesolve(w, h, n, solvegrid, mineopen, mineperturb, ctx, rs);
+		    minesolve(w, h, n, solvegrid, mineopen, mineperturb,
+                              ctx, rs, ss);
 		if (solveret < 0 || (prevret >= 0 && solveret >= prevret)) {
 		    success = false;
 		    break;
@@ -1831,6 +1912,9 @@ static bool *minegen(int w, int h, int n, int x, int y, bool unique,
 
     } while (!success);
 
+    if (ss)
+        ss_free(ss);
+
     return ret;
 }
 
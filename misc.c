@@ -440,4 +440,38 @@ char *button2label(int button)
     return NULL;
 }
 
+game_state *execute_move_sequence(
+    const game_state *from, const char *move,
+    game_state *(*execute)(const game_state *, const char *),
+    void (*free_state)(game_state *))
+{
+    game_state *ret = NULL;
+    char *buf;
+
+    assert(move[0] == 'S' && move[1] == ';');
+    buf = snewn(strlen(move), char);
+
+    move++;
+    while (*move == ';') {
+        game_state *next;
+        int len;
+
+        move++;
+        len = strcspn(move, ";");
+        memcpy(buf, move, len);
+        buf[len] = '\0';
+        move += len;
+
+        next = execute(ret ? ret : from, buf);
+        if (ret)
+            free_state(ret);
+        ret = next;
+        if (!ret)
+            break;
+    }
+
+    sfree(buf);
+    return ret;
+}
+
 /* vim: set shiftwidth=4 tabstop=8: */
@@ -20,6 +20,7 @@
 #include <string.h>
 
 #include "puzzles.h"
+#include "bitrow.h"
 
 #define DEFAULT_SIZE 10
 #define MAX_TILES 10000
@@ -108,6 +109,16 @@ struct solution_cell {
     bool needed;
 };
 
+/*
+ * The marked and blank squares of a solution in progress, kept as
+ * bitrows (see bitrow.h) alongside the solution_cell array so that
+ * the solver can count them around a clue a row at a time.
+ */
+struct solution_bits {
+    bitword *marked;
+    bitword *blank;
+};
+
 struct desc_cell {
     char clue;
     bool shown;
@@ -331,28 +342,15 @@ static void populate_cell(const game_params *params, const bool *image,
 }
 
 static void count_around(const game_params *params,
-                         struct solution_cell *sol, int x, int y,
+                         const struct solution_bits *bits, int x, int y,
                          int *marked, int *blank, int *total)
 {
-    int i, j;
-    struct solution_cell *curr = NULL;
-    (*total) = 0;
-    (*blank) = 0;
-    (*marked) = 0;
+    int w = params->width, h = params->height;
 
-    for (i = -1; i < 2; i++) {
-        for (j = -1; j < 2; j++) {
-            curr = get_coords(params, sol, x + i, y + j);
-            if (curr) {
-                (*total)++;
-                if ((curr->cell & STATE_BLANK) != 0) {
-                    (*blank)++;
-                } else if ((curr->cell & STATE_MARKED) != 0) {
-                    (*marked)++;
-                }
-            }
-        }
-    }
+    (*total) = (min(x + 1, w - 1) - max(x - 1, 0) + 1) *
+        (min(y + 1, h - 1) - max(y - 1, 0) + 1);
+    (*blank) = bitrow_count_around(bits->blank, w, h, x, y);
+    (*marked) = bitrow_count_around(bits->marked, w, h, x, y);
 }
 
 static void count_around_state(const game_state *state, int x, int y,
@@ -402,9 +400,12 @@ static void count_clues_around(const game_params *params,
 }
 
 static void mark_around(const game_params *params,
-                        struct solution_cell *sol, int x, int y, int mark)
+                        struct solution_cell *sol,
+                        struct solution_bits *bits, int x, int y, int mark)
 {
     int i, j, marked = 0;
+    int rw = bitrow_words(params->width);
+    bitword *markbits = (mark == STATE_MARKED ? bits->marked : bits->blank);
     struct solution_cell *curr;
 
     for (i = -1; i < 2; i++) {
@@ -413,6 +414,7 @@ static void mark_around(const game_params *params,
             if (curr) {
                 if (curr->cell == STATE_UNMARKED) {
                     curr->cell = mark;
+                    bitrow_set(markbits + (y + j) * rw, x + i);
                     marked++;
                 }
             }
@@ -422,7 +424,7 @@ static void mark_around(const game_params *params,
 
 static char solve_cell(const game_params *params, struct desc_cell *desc,
                        struct board_cell *board, struct solution_cell *sol,
-                       int x, int y)
+                       struct solution_bits *bits, int x, int y)
 {
     struct desc_cell curr;
 
@@ -442,13 +444,13 @@ static char solve_cell(const game_params *params, struct desc_cell *desc,
     if (sol[(y * params->width) + x].solved) {
         return 0;
     }
-    count_around(params, sol, x, y, &marked, &blank, &total);
+    count_around(params, bits, x, y, &marked, &blank, &total);
     if (curr.full && curr.shown) {
         sol[(y * params->width) + x].solved = true;
         if (marked + blank < total) {
             sol[(y * params->width) + x].needed = true;
         }
-        mark_around(params, sol, x, y, STATE_MARKED);
+        mark_around(params, sol, bits, x, y, STATE_MARKED);
         return 1;
     }
     if (curr.empty && curr.shown) {
@@ -456,7 +458,7 @@ static char solve_cell(const game_params *params, struct desc_cell *desc,
         if (marked + blank < total) {
             sol[(y * params->width) + x].needed = true;
         }
-        mark_around(params, sol, x, y, STATE_BLANK);
+        mark_around(params, sol, bits, x, y, STATE_BLANK);
         return 1;
     }
     if (curr.shown) {
@@ -466,13 +468,13 @@ static char solve_cell(const game_params *params, struct desc_cell *desc,
                 if (total != marked + blank) {
                     sol[(y * params->width) + x].needed = true;
                 }
-                mark_around(params, sol, x, y, STATE_BLANK);
+                mark_around(params, sol, bits, x, y, STATE_BLANK);
             } else if (curr.clue == (total - blank)) {
                 sol[(y * params->width) + x].solved = true;
                 if (total != marked + blank) {
                     sol[(y * params->width) + x].needed = true;
                 }
-                mark_around(params, sol, x, y, STATE_MARKED);
+                mark_around(params, sol, bits, x, y, STATE_MARKED);
             } else if (total == marked + blank) {
                 return -1;
             } else {
@@ -500,8 +502,11 @@ static bool solve_check(const game_params *params, struct desc_cell *desc,
     int solved = 0, curr = 0, shown = 0;
     needed_list_item *head = NULL, *curr_needed, **needed_array;
     struct desc_cell *curr_desc;
+    struct solution_bits bits;
 
     memset(sol, 0, board_size * sizeof(*sol));
+    bits.marked = bitrow_new(params->height, params->width);
+    bits.blank = bitrow_new(params->height, params->width);
     for (y = 0; y < params->height; y++) {
         for (x = 0; x < params->width; x++) {
             curr_desc = get_coords(params, desc, x, y);
@@ -530,8 +535,8 @@ static bool solve_check(const game_params *params, struct desc_cell *desc,
     while (solved < shown && made_progress && !error) {
         made_progress = false;
         for (i = 0; i < shown; i++) {
-            curr = solve_cell(params, desc, NULL, sol, needed_array[i]->x,
-                              needed_array[i]->y);
+            curr = solve_cell(params, desc, NULL, sol, &bits,
+                              needed_array[i]->x, needed_array[i]->y);
             if (curr < 0) {
                 error = true;
 #ifdef DEBUG_PRINTS
@@ -552,6 +557,8 @@ static bool solve_check(const game_params *params, struct desc_cell *desc,
         sfree(curr_needed);
     }
     sfree(needed_array);
+    sfree(bits.marked);
+    sfree(bits.blank);
     solved = 0;
     /* verifying all the board is solved */
     if (made_progress) {
@@ -581,14 +588,17 @@ static bool solve_game_actual(const game_params *params,
     struct solution_cell *sol = snewn(board_size, struct solution_cell);
     bool made_progress = true, error = false;
     int solved = 0, iter = 0, curr = 0;
+    struct solution_bits bits;
 
     memset(sol, 0, params->height * params->width * sizeof(*sol));
+    bits.marked = bitrow_new(params->height, params->width);
+    bits.blank = bitrow_new(params->height, params->width);
     solved = 0;
     while (solved < params->height * params->width && made_progress
            && !error) {
         for (y = 0; y < params->height; y++) {
             for (x = 0; x < params->width; x++) {
-                curr = solve_cell(params, NULL, desc, sol, x, y);
+                curr = solve_cell(params, NULL, desc, sol, &bits, x, y);
                 if (curr < 0) {
                     error = true;
 #ifdef DEBUG_PRINTS
@@ -604,6 +614,8 @@ static bool solve_game_actual(const game_params *params,
         }
         iter++;
     }
+    sfree(bits.marked);
+    sfree(bits.blank);
     if (sol_return) {
         *sol_return = sol;
     } else {
@@ -444,27 +444,75 @@ static int todo_get(struct todo *todo) {
     return ret;
 }
 
-/*
- * Return values: -1 means puzzle was proved inconsistent, 0 means we
- * failed to narrow down to a unique solution, +1 means we solved it
- * fully.
- */
-static int net_solver(int w, int h, unsigned char *tiles,
-		      unsigned char *barriers, bool wrapping)
-{
+struct solver_scratch {
+    int w, h;
+    bool wrapping;
+    int area;
     unsigned char *tilestate;
     unsigned char *edgestate;
     int *deadends;
     int *equivalence;
     struct todo *todo;
-    int i, j, x, y;
-    int area;
-    bool done_something;
+};
+
+/*
+ * Fill in the possible orientations of tile i, given its shape.
+ */
+static void solver_set_tile(struct solver_scratch *sc, int i, int tile)
+{
+    unsigned char *ts = sc->tilestate + i * 4;
+    int j;
+
+    ts[0] = tile & 0xF;
+    for (j = 1; j < 4; j++) {
+	if (ts[j - 1] == 255 || A(ts[j - 1]) == ts[0])
+	    ts[j] = 255;
+	else
+	    ts[j] = A(ts[j - 1]);
+    }
+}
+
+/*
+ * Mark as closed any edge of tile i which is on the edge of a
+ * non-wrapping grid or has a barrier on it.
+ */
+static void solver_close_edges(struct solver_scratch *sc, int i,
+                               const unsigned char *barriers)
+{
+    int w = sc->w, h = sc->h, x = i % w, y = i / w;
+    int d;
+
+    for (d = 1; d <= 8; d += d) {
+	int x2, y2;
+
+	OFFSETWH(x2, y2, x, y, d, w, h);
+	if ((!sc->wrapping && ((d == R && x == w-1) || (d == U && y == 0) ||
+			       (d == L && x == 0) || (d == D && y == h-1))) ||
+	    /*
+	     * In principle the barrier list should already contain
+	     * each barrier from each side, but let's not take chances
+	     * with our internal consistency.
+	     */
+	    (barriers && (barriers[i] & d))) {
+	    sc->edgestate[i * 5 + d] = 2;
+	    sc->edgestate[(y2*w+x2) * 5 + F(d)] = 2;
+	}
+    }
+}
+
+static struct solver_scratch *new_scratch(int w, int h,
+                                          const unsigned char *tiles,
+                                          const unsigned char *barriers,
+                                          bool wrapping)
+{
+    struct solver_scratch *sc = snew(struct solver_scratch);
+    int i;
+
+    sc->w = w;
+    sc->h = h;
+    sc->wrapping = wrapping;
+    sc->todo = todo_new(w * h);
 
-    /*
-     * Set up the solver's data structures.
-     */
-    
     /*
      * tilestate stores the possible orientations of each tile.
      * There are up to four of these, so we'll index the array in
@@ -478,19 +526,12 @@ static int net_solver(int w, int h, unsigned char *tiles,
      * grid generated _by_ this program, but it's worth keeping the
      * solver as general as possible.)
      */
-    tilestate = snewn(w * h * 4, unsigned char);
-    area = 0;
+    sc->tilestate = snewn(w * h * 4, unsigned char);
+    sc->area = 0;
     for (i = 0; i < w*h; i++) {
-	tilestate[i * 4] = tiles[i] & 0xF;
-	for (j = 1; j < 4; j++) {
-	    if (tilestate[i * 4 + j - 1] == 255 ||
-		A(tilestate[i * 4 + j - 1]) == tilestate[i * 4])
-		tilestate[i * 4 + j] = 255;
-	    else
-		tilestate[i * 4 + j] = A(tilestate[i * 4 + j - 1]);
-	}
+	solver_set_tile(sc, i, tiles[i]);
 	if (tiles[i] != 0)
-	    area++;
+	    sc->area++;
     }
 
     /*
@@ -505,8 +546,8 @@ static int net_solver(int w, int h, unsigned char *tiles,
      * obvious four, so that I can index edgestate[(y*w+x) * 5 + d]
      * where d is 1,2,4,8 and they never overlap.
      */
-    edgestate = snewn((w * h - 1) * 5 + 9, unsigned char);
-    memset(edgestate, 0, (w * h - 1) * 5 + 9);
+    sc->edgestate = snewn((w * h - 1) * 5 + 9, unsigned char);
+    memset(sc->edgestate, 0, (w * h - 1) * 5 + 9);
 
     /*
      * deadends tracks which edges have dead ends on them. It is
@@ -516,9 +557,9 @@ static int net_solver(int w, int h, unsigned char *tiles,
      * (no dead end known) or less than that (can reach _at most_
      * this many other tiles by heading this way out of this tile).
      */
-    deadends = snewn((w * h - 1) * 5 + 9, int);
+    sc->deadends = snewn((w * h - 1) * 5 + 9, int);
     for (i = 0; i < (w * h - 1) * 5 + 9; i++)
-	deadends[i] = area+1;
+	sc->deadends[i] = sc->area+1;
 
     /*
      * equivalence tracks which sets of tiles are known to be
@@ -540,44 +581,15 @@ static int net_solver(int w, int h, unsigned char *tiles,
      * classes) by finding the representative of each tile and
      * setting equivalence[one]=the_other.
      */
-    equivalence = snew_dsf(w * h);
+    sc->equivalence = snew_dsf(w * h);
 
     /*
      * On a non-wrapping grid, we instantly know that all the edges
-     * round the edge are closed.
+     * round the edge are closed. If we have barriers available, we
+     * can mark those edges as closed too.
      */
-    if (!wrapping) {
-	for (i = 0; i < w; i++) {
-	    edgestate[i * 5 + 2] = edgestate[((h-1) * w + i) * 5 + 8] = 2;
-	}
-	for (i = 0; i < h; i++) {
-	    edgestate[(i * w + w-1) * 5 + 1] = edgestate[(i * w) * 5 + 4] = 2;
-	}
-    }
-
-    /*
-     * If we have barriers available, we can mark those edges as
-     * closed too.
-     */
-    if (barriers) {
-	for (y = 0; y < h; y++) for (x = 0; x < w; x++) {
-	    int d;
-	    for (d = 1; d <= 8; d += d) {
-		if (barriers[y*w+x] & d) {
-		    int x2, y2;
-		    /*
-		     * In principle the barrier list should already
-		     * contain each barrier from each side, but
-		     * let's not take chances with our internal
-		     * consistency.
-		     */
-		    OFFSETWH(x2, y2, x, y, d, w, h);
-		    edgestate[(y*w+x) * 5 + d] = 2;
-		    edgestate[(y2*w+x2) * 5 + F(d)] = 2;
-		}
-	    }
-	}
-    }
+    for (i = 0; i < w*h; i++)
+	solver_close_edges(sc, i, barriers);
 
     /*
      * Since most deductions made by this solver are local (the
@@ -585,14 +597,46 @@ static int net_solver(int w, int h, unsigned char *tiles,
      * together on one side of the grid can theoretically permit a
      * fresh deduction on the other), we can address the scaling
      * problem inherent in iterating repeatedly over the entire
-     * grid by instead working with a to-do list.
+     * grid by instead working with a to-do list. To begin with,
+     * everything is on it.
      */
-    todo = todo_new(w * h);
+    for (i = 0; i < w*h; i++)
+	todo_add(sc->todo, i);
 
-    /*
-     * Main deductive loop.
-     */
-    done_something = true;	       /* prevent instant termination! */
+    return sc;
+}
+
+static void free_scratch(struct solver_scratch *sc)
+{
+    todo_free(sc->todo);
+    sfree(sc->tilestate);
+    sfree(sc->edgestate);
+    sfree(sc->deadends);
+    sfree(sc->equivalence);
+    sfree(sc);
+}
+
+/*
+ * Run the solver's main deductive loop until it runs out of things
+ * to do, starting from whatever is on the to-do list, and mark all
+ * completely determined tiles as locked.
+ *
+ * Return values: -1 means puzzle was proved inconsistent, 0 means we
+ * failed to narrow down to a unique solution, +1 means we solved it
+ * fully.
+ */
+static int solver_run(struct solver_scratch *sc, unsigned char *tiles)
+{
+    int w = sc->w, h = sc->h, area = sc->area;
+    unsigned char *tilestate = sc->tilestate;
+    unsigned char *edgestate = sc->edgestate;
+    int *deadends = sc->deadends;
+    int *equivalence = sc->equivalence;
+    struct todo *todo = sc->todo;
+    int i, j, x, y;
+    bool done_something;
+
+    done_something = false;
     while (1) {
 	int index;
 
@@ -603,21 +647,29 @@ static int net_solver(int w, int h, unsigned char *tiles,
 	if (index == -1) {
 	    /*
 	     * If we have run out of immediate things to do, we
-	     * have no choice but to scan the whole grid for
-	     * longer-range things we've missed. Hence, I now add
-	     * every square on the grid back on to the to-do list.
-	     * I also set `done_something' to false at this point;
-	     * if we later come back here and find it still false,
-	     * we will know we've scanned the entire grid without
-	     * finding anything new to do, and we can terminate.
+	     * have no choice but to scan the grid for longer-range
+	     * things we've missed. Hence, I now add every tile
+	     * which isn't yet fully determined back on to the to-do
+	     * list. (A determined tile has had all its edges marked,
+	     * so the loop-avoidance check that makes the rescan
+	     * necessary can't tell it anything new; any change to
+	     * its dead-end counts, or to its own orientations, puts
+	     * it back on the list anyway.)
+	     * I also set `done_something' to false at this point; if
+	     * we later come back here and find it still false, we
+	     * will know we've scanned everything without finding
+	     * anything new to do, and we can terminate.
 	     */
 	    if (!done_something)
 		break;
 	    for (i = 0; i < w*h; i++)
-		todo_add(todo, i);
+		if (tilestate[i * 4 + 1] != 255)
+		    todo_add(todo, i);
 	    done_something = false;
 
 	    index = todo_get(todo);
+	    if (index == -1)
+		break;
 	}
 
 	y = index / w;
@@ -738,6 +790,13 @@ static int net_solver(int w, int h, unsigned char *tiles,
 		 */
 		while (j < 4)
 		    tilestate[(y*w+x) * 4 + j++] = 255;
+
+		/*
+		 * The dead-end counts we're about to hand on were
+		 * worked out with the old orientations included, so
+		 * come back for another look with the new ones.
+		 */
+		todo_add(todo, y*w+x);
 	    }
 
 	    /*
@@ -818,16 +877,78 @@ static int net_solver(int w, int h, unsigned char *tiles,
 	}
     }
 
+    return j;
+}
+
+static int net_solver(int w, int h, unsigned char *tiles,
+		      unsigned char *barriers, bool wrapping)
+{
+    struct solver_scratch *sc = new_scratch(w, h, tiles, barriers, wrapping);
+    int ret = solver_run(sc, tiles);
+    free_scratch(sc);
+    return ret;
+}
+
+/*
+ * Pick up a solve where it left off, after the generator has
+ * perturbed some of the tiles in a grid previously given to
+ * solver_run (and which has no barriers). Everything the solver knew
+ * about tiles which were undetermined, or whose shape has been
+ * changed, is thrown away, along with the edges and dead-end counts
+ * on their borders; the rest is kept, so that only the perturbed
+ * regions need solving again.
+ *
+ * The deductions kept aren't guaranteed still to be true of the new
+ * grid, since a change in one place can in principle have knock-on
+ * effects anywhere. So the result is only a cheap estimate: callers
+ * must confirm a claimed unique solution with a fresh solve.
+ */
+static int solver_resume(struct solver_scratch *sc, unsigned char *tiles)
+{
+    int w = sc->w, h = sc->h;
+    bool *dirty = snewn(w * h, bool);
+    int i, d;
+
+    for (i = 0; i < w*h; i++)
+	dirty[i] = (sc->tilestate[i * 4 + 1] != 255 ||
+		    sc->tilestate[i * 4] != (tiles[i] & 0xF));
+
+    for (i = 0; i < w*h; i++) {
+	int x = i % w, y = i / w;
+
+	if (!dirty[i])
+	    continue;
+
+	solver_set_tile(sc, i, tiles[i]);
+	for (d = 1; d <= 8; d += d) {
+	    int x2, y2, i2;
+
+	    OFFSETWH(x2, y2, x, y, d, w, h);
+	    i2 = y2*w+x2;
+	    sc->edgestate[i * 5 + d] = sc->edgestate[i2 * 5 + F(d)] = 0;
+	    sc->deadends[i * 5 + d] = sc->deadends[i2 * 5 + F(d)] =
+		sc->area+1;
+	    todo_add(sc->todo, i2);
+	}
+	solver_close_edges(sc, i, NULL);
+	todo_add(sc->todo, i);
+    }
+
     /*
-     * Free up working space.
+     * The equivalence classes can't be split, so rebuild them from
+     * the edges still known to be open.
      */
-    todo_free(todo);
-    sfree(tilestate);
-    sfree(edgestate);
-    sfree(deadends);
-    sfree(equivalence);
+    dsf_init(sc->equivalence, w * h);
+    for (i = 0; i < w*h; i++)
+	for (d = 1; d <= 2; d += d)
+	    if (sc->edgestate[i * 5 + d] == 1) {
+		int x2, y2;
+		OFFSETWH(x2, y2, i % w, i / w, d, w, h);
+		dsf_merge(sc->equivalence, i, y2*w+x2);
+	    }
 
-    return j;
+    sfree(dirty);
+    return solver_run(sc, tiles);
 }
 
 /* ----------------------------------------------------------------------
@@ -1323,13 +1444,26 @@ static char *new_game_desc(const game_params *params, random_state *rs,
     freetree234(possibilities);
 
     if (params->unique) {
+	struct solver_scratch *sc = NULL;
 	int prevn = -1;
 
 	/*
-	 * Run the solver to check unique solubility.
+	 * Run the solver to check unique solubility. After the first
+	 * time round, we only need to resume it on the areas we've
+	 * perturbed; but we check any apparent success with a fresh
+	 * run before believing it.
 	 */
-	while (net_solver(w, h, tiles, NULL, params->wrapping) != 1) {
-	    int n = 0;
+	while (1) {
+	    int n = 0, ret = (sc ? solver_resume(sc, tiles) : -1);
+
+	    if (ret != 0) {
+		if (sc)
+		    free_scratch(sc);
+		sc = new_scratch(w, h, tiles, NULL, params->wrapping);
+		ret = solver_run(sc, tiles);
+	    }
+	    if (ret == 1)
+		break;
 
 	    /*
 	     * We expect (in most cases) that most of the grid will
@@ -1362,11 +1496,14 @@ static char *new_game_desc(const game_params *params, random_state *rs,
 	     * it from the last time we ran the solver, give up and
 	     * regenerate the entire grid.
 	     */
-	    if (prevn != -1 && prevn <= n)
+	    if (prevn != -1 && prevn <= n) {
+		free_scratch(sc);
 		goto begin_generation; /* (sorry) */
+	    }
 
 	    prevn = n;
 	}
+	free_scratch(sc);
 
 	/*
 	 * The solver will have left a lot of LOCKED bits lying
@@ -3270,3 +3407,98 @@ const struct game thegame = {
     false, game_timing_state,
     0,				       /* flags */
 };
+
+#ifdef STANDALONE_BENCHMARK
+
+/*
+ * Time the generation of large grids, which is dominated by the
+ * loop of solving and perturbing that makes them uniquely soluble.
+ *
+ *   netbench [-e seed] [-n count] [params...]
+ *
+ * With no params, times a selection of big wrapping grids.
+ */
+
+#include <time.h>
+
+void get_random_seed(void **randseed, int *randseedsize)
+{
+    time_t *tp = snew(time_t);
+    time(tp);
+    *randseed = (void *)tp;
+    *randseedsize = sizeof(time_t);
+}
+
+static void bench(const char *id, random_state *rs, int count)
+{
+    game_params *p = default_params();
+    const char *err;
+    clock_t start;
+    double secs;
+    int i;
+
+    decode_params(p, id);
+    err = validate_params(p, true);
+    if (err) {
+        fprintf(stderr, "netbench: %s: %s\n", id, err);
+        exit(1);
+    }
+
+    start = clock();
+    for (i = 0; i < count; i++) {
+        char *aux = NULL;
+        char *desc = new_game_desc(p, rs, &aux, false);
+        sfree(desc);
+        sfree(aux);
+    }
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%-12s %d grids in %.3fs (%.3fs each)\n",
+           id, count, secs, secs / count);
+    free_params(p);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const defaults[] = {
+        "100x100w", "120x120w", "150x150w",
+    };
+    const char **ids = snewn(argc + lenof(defaults), const char *);
+    time_t seed = time(NULL);
+    random_state *rs;
+    int count = 5, nids = 0, i;
+
+    while (--argc > 0) {
+        const char *p = *++argv;
+        if (argc > 1 && (!strcmp(p, "-e") || !strcmp(p, "--seed"))) {
+            seed = atoi(*++argv);
+            argc--;
+        } else if (argc > 1 && !strcmp(p, "-n")) {
+            count = atoi(*++argv);
+            argc--;
+        } else if (*p == '-') {
+            fprintf(stderr, "netbench: unrecognised option `%s'\n", p);
+            return 1;
+        } else {
+            ids[nids++] = p;
+        }
+    }
+    if (count < 1) {
+        fprintf(stderr, "netbench: count must be positive\n");
+        return 1;
+    }
+    if (!nids)
+        for (i = 0; i < lenof(defaults); i++)
+            ids[nids++] = defaults[i];
+
+    printf("seed %ld\n", (long)seed);
+    rs = random_new((void *)&seed, sizeof(time_t));
+    for (i = 0; i < nids; i++)
+        bench(ids[i], rs, count);
+
+    random_free(rs);
+    sfree(ids);
+    return 0;
+}
+
+#endif
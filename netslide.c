@@ -12,6 +12,7 @@
 
 #include "puzzles.h"
 #include "tree234.h"
+#include "permsolve.h"
 
 #define MATMUL(xr,yr,m,x,y) do { \
     float rx, ry, xx = (x), yy = (y), *mat = (m); \
@@ -879,15 +880,112 @@ static void free_game(game_state *state)
     sfree(state);
 }
 
+/*
+ * The moves, as numbered for the solver: each row can be slid with
+ * dir +1 or -1, then each column likewise. (The moves of the centre
+ * row and column are in the list too, but do nothing.)
+ */
+#define NMOVES(w, h) (2 * ((w) + (h)))
+
+static void move_desc(int w, int h, int m, char *buf)
+{
+    if (m < 2*h)
+        sprintf(buf, "R%d,%d", m / 2, m % 2 ? -1 : +1);
+    else
+        sprintf(buf, "C%d,%d", (m - 2*h) / 2, m % 2 ? -1 : +1);
+}
+
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *aux, const char **error)
 {
-    if (!aux) {
+    int w = currstate->width, h = currstate->height, n = w*h;
+    int nmoves = NMOVES(w, h);
+    int *perm, *order, *start, *target, *moves, len, i, m, x, y;
+    permsolver *ps;
+    char *ret, *p;
+
+    if (!aux || aux[0] != 'S' || strlen(aux) != n + 1) {
 	*error = "Solution not known for this puzzle";
 	return NULL;
     }
 
-    return dupstr(aux);
+    /*
+     * Sliding a row with dir d moves the tile in column x to column
+     * x-d (see slide_row_int), and likewise for columns.
+     */
+    perm = snewn(nmoves * n, int);
+    for (m = 0; m < nmoves; m++)
+        for (y = 0; y < h; y++)
+            for (x = 0; x < w; x++) {
+                int d = m % 2 ? -1 : +1;
+
+                if (m < 2*h && m / 2 == y && y != currstate->cy)
+                    perm[m*n + y*w + x] = y*w + (x - d + w) % w;
+                else if (m >= 2*h && (m - 2*h) / 2 == x &&
+                         x != currstate->cx)
+                    perm[m*n + y*w + x] = ((y - d + h) % h) * w + x;
+                else
+                    perm[m*n + y*w + x] = y*w + x;
+            }
+
+    /*
+     * The tiles to aim for are the ones in the original solution;
+     * tiles of the same shape are interchangeable.
+     */
+    start = snewn(n, int);
+    target = snewn(n, int);
+    for (i = 0; i < n; i++) {
+        char c = aux[i+1];
+
+        start[i] = currstate->tiles[i] & 0xF;
+        target[i] = (c >= '0' && c <= '9' ? c - '0' :
+                     c >= 'A' && c <= 'F' ? c - 'A' + 10 :
+                     c >= 'a' && c <= 'f' ? c - 'a' + 10 : 0);
+    }
+
+    /*
+     * Fill in the rows from the top, leaving the last two to be
+     * done a column at a time, as in Sixteen.
+     */
+    order = snewn(n, int);
+    i = 0;
+    for (y = 0; y < h-2; y++)
+        for (x = 0; x < w; x++)
+            order[i++] = y*w + x;
+    for (x = 0; x < w; x++)
+        for (y = max(h-2, 0); y < h; y++)
+            order[i++] = y*w + x;
+
+    ps = permsolver_new(n, nmoves, perm, NULL, 1);
+    len = permsolver_solve(ps, start, target, order, &moves);
+    permsolver_free(ps);
+    sfree(perm);
+    sfree(order);
+    sfree(start);
+    sfree(target);
+
+    /*
+     * If we can't find the moves (or there aren't any to find), fall
+     * back to simply replacing the grid with the solved one.
+     */
+    if (len <= 0) {
+        if (len == 0)
+            sfree(moves);
+        return dupstr(aux);
+    }
+
+    ret = snewn(2 + 40 * len, char);
+    p = ret;
+    *p++ = 'S';
+    for (i = 0; i < len; i++) {
+        *p++ = ';';
+        move_desc(w, h, moves[i], p);
+        p += strlen(p);
+    }
+    *p = '\0';
+    sfree(moves);
+
+    return ret;
 }
 
 static bool game_can_format_as_text_now(const game_params *params)
@@ -1129,6 +1227,14 @@ static game_state *execute_move(const game_state *from, const char *move)
     int c, d;
     bool col;
 
+    if (move[0] == 'S' && move[1] == ';') {
+        /* A solution from solve_game(), as a sequence of moves. */
+        ret = execute_move_sequence(from, move, execute_move, free_game);
+        if (ret)
+            ret->used_solve = true;
+        return ret;
+    }
+
     if ((move[0] == 'C' || move[0] == 'R') &&
 	sscanf(move+1, "%d,%d", &c, &d) == 2 &&
 	c >= 0 && c < (move[0] == 'C' ? from->width : from->height)) {
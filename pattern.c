@@ -361,112 +361,147 @@ static int compute_rowdata(int *ret, unsigned char *start, int len, int step)
 bool verbose = false;
 #endif
 
-static bool do_recurse(unsigned char *known, unsigned char *deduced,
-                       unsigned char *row,
-		       unsigned char *minpos_done, unsigned char *maxpos_done,
-		       unsigned char *minpos_ok, unsigned char *maxpos_ok,
-		       int *data, int len,
-                       int freespace, int ndone, int lowest)
-{
-    int i, j, k;
-
-
-    /* This algorithm basically tries all possible ways the given rows of
-     * black blocks can be laid out in the row/column being examined.
-     * Special care is taken to avoid checking the tail of a row/column
-     * if the same conditions have already been checked during this recursion
-     * The algorithm also takes care to cut its losses as soon as an
-     * invalid (partial) solution is detected.
-     */
-    if (data[ndone]) {
-	if (lowest >= minpos_done[ndone] && lowest <= maxpos_done[ndone]) {
-	    if (lowest >= minpos_ok[ndone] && lowest <= maxpos_ok[ndone]) {
-		for (i=0; i<lowest; i++)
-		    deduced[i] |= row[i];
-	    }
-	    return lowest >= minpos_ok[ndone] && lowest <= maxpos_ok[ndone];
-	} else {
-	    if (lowest < minpos_done[ndone]) minpos_done[ndone] = lowest;
-	    if (lowest > maxpos_done[ndone]) maxpos_done[ndone] = lowest;
-	}
-	for (i=0; i<=freespace; i++) {
-	    j = lowest;
-	    for (k=0; k<i; k++) {
-		if (known[j] == BLOCK) goto next_iter;
-	        row[j++] = DOT;
-	    }
-	    for (k=0; k<data[ndone]; k++) {
-		if (known[j] == DOT) goto next_iter;
-	        row[j++] = BLOCK;
-	    }
-	    if (j < len) {
-		if (known[j] == BLOCK) goto next_iter;
-	        row[j++] = DOT;
-	    }
-	    if (do_recurse(known, deduced, row, minpos_done, maxpos_done,
-	                   minpos_ok, maxpos_ok, data, len, freespace-i, ndone+1, j)) {
-	        if (lowest < minpos_ok[ndone]) minpos_ok[ndone] = lowest;
-	        if (lowest + i > maxpos_ok[ndone]) maxpos_ok[ndone] = lowest + i;
-	        if (lowest + i > maxpos_done[ndone]) maxpos_done[ndone] = lowest + i;
-	    }
-	    next_iter:
-	    j++;
-	}
-	return lowest >= minpos_ok[ndone] && lowest <= maxpos_ok[ndone];
-    } else {
-	for (i=lowest; i<len; i++) {
-	    if (known[i] == BLOCK) return false;
-	    row[i] = DOT;
-	    }
-	for (i=0; i<len; i++)
-	    deduced[i] |= row[i];
-	return true;
-    }
-}
-
+/*
+ * Number of ints of workspace needed by do_row() for a line of
+ * length up to max. A line of length len can have at most (len+1)/2
+ * runs in it.
+ */
+#define WORKSPACE_SIZE(max) (5*((max)+1) + 2*((max)+1)*(((max)+1)/2+1))
 
-static bool do_row(unsigned char *known, unsigned char *deduced,
-                   unsigned char *row,
-                   unsigned char *minpos_done, unsigned char *maxpos_done,
-                   unsigned char *minpos_ok, unsigned char *maxpos_ok,
-                   unsigned char *start, int len, int step, int *data,
-                   unsigned int *changed
+/*
+ * The line solver. For each cell in the line we want to know whether
+ * there is any arrangement of the runs, consistent with what's
+ * already known, in which that cell is BLOCK, and likewise any in
+ * which it is DOT. A cell which can only be one of those is deduced.
+ *
+ * Rather than enumerating arrangements (which is exponential in the
+ * worst case), we do this by dynamic programming in O(len * runs)
+ * at most.
+ * fwd(i,k) is true if cells [0,i) can hold exactly the first k runs,
+ * leaving run k free to start at position i. bwd(i,k) is true if
+ * cells [i,len) can hold runs k onwards. A run placed starting at
+ * position s occupies cells s..s+data[k]-1, plus the DOT which must
+ * separate it from whatever follows (unless it ends at the end of
+ * the line).
+ *
+ * Any cell changed by this function causes the crossing line to be
+ * added to 'todo', at index todo_offset + (position in this line).
+ */
+static bool do_row(int *workspace, unsigned char *start, int len, int step,
+                   int *data, tdq *todo, int todo_offset
 #ifdef STANDALONE_SOLVER
                    , const char *rowcol, int index, int cluewid
 #endif
                    )
 {
-    int rowlen, i, freespace;
+    int *known, *deduced, *space, *first, *need, *fwd, *bwd;
+    int rowlen, n1, i, k, reach;
     bool done_any;
 
-    freespace = len+1;
-    for (rowlen = 0; data[rowlen]; rowlen++) {
-	minpos_done[rowlen] = minpos_ok[rowlen] = len - 1;
-	maxpos_done[rowlen] = maxpos_ok[rowlen] = 0;
-	freespace -= data[rowlen]+1;
-    }
+    for (rowlen = 0; data[rowlen]; rowlen++);
+    n1 = rowlen + 1;
+
+    known = workspace;
+    deduced = known + len;
+    space = deduced + len;             /* no. of non-DOT cells from i on */
+    first = space + len + 1;
+    need = first + n1;
+    fwd = need + n1;
+    bwd = fwd + (len+1) * n1;
+
+#define FWD(i, k) fwd[(i)*n1+(k)]
+#define BWD(i, k) bwd[(i)*n1+(k)]
+    /* Can run k start at position s? */
+#define FITS(s, k) ((s) + data[k] <= len && space[s] >= data[k] &&     \
+                    ((s) + data[k] == len || known[(s) + data[k]] != BLOCK))
+    /* Where does the next run become free to start, if run k starts at s? */
+#define AFTER(s, k) min((s) + data[k] + 1, len)
 
     for (i = 0; i < len; i++) {
 	known[i] = start[i*step];
 	deduced[i] = 0;
     }
-    for (i = len - 1; i >= 0 && known[i] == DOT; i--)
-        freespace--;
+    space[len] = 0;
+    for (i = len; i-- > 0 ;)
+        space[i] = (known[i] == DOT ? 0 : space[i+1] + 1);
 
-    if (rowlen == 0) {
-        memset(deduced, DOT, len);
-    } else if (rowlen == 1 && data[0] == len) {
-        memset(deduced, BLOCK, len);
-    } else {
-        do_recurse(known, deduced, row, minpos_done, maxpos_done, minpos_ok,
-                   maxpos_ok, data, len, freespace, 0, 0);
+    /*
+     * Run k can't start before first[k], since all the runs before it
+     * have to fit in first, and the runs from k onwards need at least
+     * need[k] cells. So fwd(i,k) and bwd(i,k) can only be true for i
+     * in [first[k], len-need[k]], and we confine our attention to
+     * that band, whose width is the slack in the line.
+     */
+    first[0] = 0;
+    for (k = 0; k < rowlen; k++)
+        first[k+1] = first[k] + data[k] + 1;
+    need[rowlen] = 0;
+    for (k = rowlen; k-- > 0 ;)
+        need[k] = need[k+1] + data[k] + (k+1 < rowlen ? 1 : 0);
+
+    memset(fwd, 0, (len+1) * n1 * sizeof(int));
+    memset(bwd, 0, (len+1) * n1 * sizeof(int));
+
+    FWD(0, 0) = true;
+    for (k = 0; k <= rowlen; k++)
+        for (i = first[k]; i <= len - need[k]; i++) {
+            if (!FWD(i, k))
+                continue;
+            if (i < len && known[i] != BLOCK)
+                FWD(i+1, k) = true;
+            if (k < rowlen && FITS(i, k))
+                FWD(AFTER(i, k), k+1) = true;
+        }
+
+    /*
+     * If the line has no valid arrangement at all, deduce nothing.
+     */
+    if (!FWD(len, rowlen))
+        return false;
+
+    BWD(len, rowlen) = true;
+    for (k = rowlen+1; k-- > 0 ;)
+        for (i = min(len - need[k], len - 1); i >= first[k]; i--)
+            BWD(i, k) = ((known[i] != BLOCK && BWD(i+1, k)) ||
+                         (k < rowlen && FITS(i, k) &&
+                          BWD(AFTER(i, k), k+1)));
+
+    /*
+     * Now a cell can be a DOT if some valid arrangement can reach it
+     * from the left and finish from the right with the cell left
+     * empty, either between runs or as the separator after one. For
+     * BLOCKs, we keep track of the furthest point covered by any
+     * valid placement of run k starting at or before i.
+     */
+    for (k = 0; k <= rowlen; k++) {
+        reach = 0;
+        for (i = first[k]; i < len && (i <= len - need[k] || i < reach);
+             i++) {
+            if (i <= len - need[k] && FWD(i, k)) {
+                if (known[i] != BLOCK && BWD(i+1, k))
+                    deduced[i] |= DOT;
+                if (k < rowlen && FITS(i, k) && BWD(AFTER(i, k), k+1)) {
+                    if (reach < i + data[k])
+                        reach = i + data[k];
+                    if (i + data[k] < len)
+                        deduced[i + data[k]] |= DOT;
+                }
+            }
+            if (i < reach)
+                deduced[i] |= BLOCK;
+        }
     }
 
+#undef FWD
+#undef BWD
+#undef FITS
+#undef AFTER
+
     done_any = false;
     for (i=0; i<len; i++)
 	if (deduced[i] && deduced[i] != STILL_UNKNOWN && !known[i]) {
 	    start[i*step] = deduced[i];
-	    if (changed) changed[i]++;
+	    if (todo) tdq_add(todo, todo_offset + i);
 	    done_any = true;
 	}
 #ifdef STANDALONE_SOLVER
@@ -493,11 +528,32 @@ static bool do_row(unsigned char *known, unsigned char *deduced,
     return done_any;
 }
 
+/*
+ * Fetch the clue data for line k into rowdata, terminated by a zero.
+ * Lines 0..h-1 are the rows, and h..h+w-1 the columns.
+ */
+static void get_rowdata(const game_state *state, unsigned char *grid,
+                        int w, int h, int k, int *rowdata)
+{
+    int rowlen;
+
+    if (state && state->common->rowdata) {
+        int idx = (k < h ? w + k : k - h);
+        rowlen = state->common->rowlen[idx];
+        memcpy(rowdata, state->common->rowdata + state->common->rowsize*idx,
+               rowlen * sizeof(int));
+    } else if (k < h) {
+        rowlen = compute_rowdata(rowdata, grid+k*w, w, 1);
+    } else {
+        rowlen = compute_rowdata(rowdata, grid+(k-h), h, w);
+    }
+    rowdata[rowlen] = 0;
+}
+
 static bool solve_puzzle(const game_state *state, unsigned char *grid,
                          int w, int h,
-                         unsigned char *matrix, unsigned char *workspace,
-                         unsigned int *changed_h, unsigned int *changed_w,
-                         int *rowdata
+                         unsigned char *matrix, int *workspace,
+                         tdq *todo, int *rowdata
 #ifdef STANDALONE_SOLVER
                          , int cluewid
 #else
@@ -505,14 +561,11 @@ static bool solve_puzzle(const game_state *state, unsigned char *grid,
 #endif
                          )
 {
-    int i, j, max;
+    int i, j, k, len, freespace, nknown;
     bool ok;
-    int max_h, max_w;
 
     assert((state!=NULL && state->common->rowdata!=NULL) ^ (grid!=NULL));
 
-    max = max(w, h);
-
     memset(matrix, 0, w*h);
     if (state) {
         for (i=0; i<w*h; i++) {
@@ -521,122 +574,53 @@ static bool solve_puzzle(const game_state *state, unsigned char *grid,
         }
     }
 
-    /* For each column, compute how many squares can be deduced
-     * from just the row-data and initial clues.
-     * Later, changed_* will hold how many squares were changed
-     * in every row/column in the previous iteration
-     * Changed_* is used to choose the next rows / cols to re-examine
+    /*
+     * Seed the to-do queue with every row and column in which
+     * something can be deduced from just the row data and initial
+     * clues: lines with no runs at all, lines in which some run is
+     * longer than the free space, and lines with a known square in.
+     * Any other line can't yield anything until one of its squares
+     * is filled in by a crossing line, at which point do_row() will
+     * queue it.
      */
-    for (i=0; i<h; i++) {
-	int freespace, rowlen;
-	if (state && state->common->rowdata) {
-            memcpy(rowdata, state->common->rowdata + state->common->rowsize*(w+i), max*sizeof(int));
-	    rowlen = state->common->rowlen[w+i];
-	} else {
-	    rowlen = compute_rowdata(rowdata, grid+i*w, w, 1);
-	}
-        rowdata[rowlen] = 0;
-        if (rowlen == 0) {
-            changed_h[i] = w;
-        } else {
-            for (j=0, freespace=w+1; rowdata[j]; j++)
-                freespace -= rowdata[j] + 1;
-            for (j=0, changed_h[i]=0; rowdata[j]; j++)
-                if (rowdata[j] > freespace)
-                    changed_h[i] += rowdata[j] - freespace;
-        }
-        for (j = 0; j < w; j++)
-            if (matrix[i*w+j])
-                changed_h[i]++;
-    }
-    for (i=0,max_h=0; i<h; i++)
-	if (changed_h[i] > max_h)
-	    max_h = changed_h[i];
-    for (i=0; i<w; i++) {
-	int freespace, rowlen;
-	if (state && state->common->rowdata) {
-	    memcpy(rowdata, state->common->rowdata + state->common->rowsize*i, max*sizeof(int));
-	    rowlen = state->common->rowlen[i];
-	} else {
-            rowlen = compute_rowdata(rowdata, grid+i, h, w);
-	}
-        rowdata[rowlen] = 0;
-        if (rowlen == 0) {
-            changed_w[i] = h;
-        } else {
-            for (j=0, freespace=h+1; rowdata[j]; j++)
-                freespace -= rowdata[j] + 1;
-            for (j=0, changed_w[i]=0; rowdata[j]; j++)
-                if (rowdata[j] > freespace)
-                    changed_w[i] += rowdata[j] - freespace;
-        }
-        for (j = 0; j < h; j++)
-            if (matrix[j*w+i])
-                changed_w[i]++;
+    for (k = 0; k < w+h; k++) {
+        get_rowdata(state, grid, w, h, k, rowdata);
+        len = (k < h ? w : h);
+        for (j=0, freespace=len+1; rowdata[j]; j++)
+            freespace -= rowdata[j] + 1;
+        for (j=0, nknown=0; j < len; j++)
+            if (k < h ? matrix[k*w+j] : matrix[j*w+(k-h)])
+                nknown++;
+        if (rowdata[0] == 0 || nknown > 0)
+            tdq_add(todo, k);
+        for (j=0; rowdata[j]; j++)
+            if (rowdata[j] > freespace)
+                tdq_add(todo, k);
     }
-    for (i=0,max_w=0; i<w; i++)
-	if (changed_w[i] > max_w)
-	    max_w = changed_w[i];
 
-    /* Solve the puzzle.
+    /*
+     * Solve the puzzle.
      * Process rows/columns individually. Deductions involving more than one
      * row and/or column at a time are not supported.
-     * Take care to only process rows/columns which have been changed since they
-     * were previously processed.
-     * Also, prioritize rows/columns which have had the most changes since their
-     * previous processing, as they promise the greatest benefit.
-     * Extremely rectangular grids (e.g. 10x20, 15x40, etc.) are not treated specially.
+     * Only lines crossing a square changed since they were last
+     * processed are revisited, via the to-do queue.
      */
-    do {
-	for (; max_h && max_h >= max_w; max_h--) {
-	    for (i=0; i<h; i++) {
-		if (changed_h[i] >= max_h) {
-		    if (state && state->common->rowdata) {
-			memcpy(rowdata, state->common->rowdata + state->common->rowsize*(w+i), max*sizeof(int));
-			rowdata[state->common->rowlen[w+i]] = 0;
-		    } else {
-			rowdata[compute_rowdata(rowdata, grid+i*w, w, 1)] = 0;
-		    }
-		    do_row(workspace, workspace+max, workspace+2*max,
-			   workspace+3*max, workspace+4*max,
-			   workspace+5*max, workspace+6*max,
-			   matrix+i*w, w, 1, rowdata, changed_w
+    while ((k = tdq_remove(todo)) >= 0) {
+        get_rowdata(state, grid, w, h, k, rowdata);
+        if (k < h) {
+            do_row(workspace, matrix+k*w, w, 1, rowdata, todo, h
 #ifdef STANDALONE_SOLVER
-			   , "row", i+1, cluewid
+                   , "row", k+1, cluewid
 #endif
-			   );
-		    changed_h[i] = 0;
-		}
-	    }
-	    for (i=0,max_w=0; i<w; i++)
-		if (changed_w[i] > max_w)
-		    max_w = changed_w[i];
-	}
-	for (; max_w && max_w >= max_h; max_w--) {
-	    for (i=0; i<w; i++) {
-		if (changed_w[i] >= max_w) {
-		    if (state && state->common->rowdata) {
-			memcpy(rowdata, state->common->rowdata + state->common->rowsize*i, max*sizeof(int));
-			rowdata[state->common->rowlen[i]] = 0;
-		    } else {
-			rowdata[compute_rowdata(rowdata, grid+i, h, w)] = 0;
-		    }
-		    do_row(workspace, workspace+max, workspace+2*max,
-			   workspace+3*max, workspace+4*max,
-			   workspace+5*max, workspace+6*max,
-			   matrix+i, h, w, rowdata, changed_h
+                   );
+        } else {
+            do_row(workspace, matrix+(k-h), h, w, rowdata, todo, 0
 #ifdef STANDALONE_SOLVER
-			   , "col", i+1, cluewid
+                   , "col", k-h+1, cluewid
 #endif
-			   );
-		    changed_w[i] = 0;
-		}
-	    }
-	    for (i=0,max_h=0; i<h; i++)
-		if (changed_h[i] > max_h)
-		    max_h = changed_h[i];
-	}
-    } while (max_h>0 || max_w>0);
+                   );
+        }
+    }
 
     ok = true;
     for (i=0; i<h; i++) {
@@ -654,18 +638,17 @@ static unsigned char *generate_soluble(random_state *rs, int w, int h)
 {
     int i, j, ntries, max;
     bool ok;
-    unsigned char *grid, *matrix, *workspace;
-    unsigned int *changed_h, *changed_w;
-    int *rowdata;
+    unsigned char *grid, *matrix;
+    int *workspace, *rowdata;
+    tdq *todo;
 
     max = max(w, h);
 
     grid = snewn(w*h, unsigned char);
     /* Allocate this here, to avoid having to reallocate it again for every geneerated grid */
     matrix = snewn(w*h, unsigned char);
-    workspace = snewn(max*7, unsigned char);
-    changed_h = snewn(max+1, unsigned int);
-    changed_w = snewn(max+1, unsigned int);
+    workspace = snewn(WORKSPACE_SIZE(max), int);
+    todo = tdq_new(w+h);
     rowdata = snewn(max+1, int);
 
     ntries = 0;
@@ -704,13 +687,12 @@ static unsigned char *generate_soluble(random_state *rs, int w, int h)
             continue;
 
 	ok = solve_puzzle(NULL, grid, w, h, matrix, workspace,
-			  changed_h, changed_w, rowdata, 0);
+			  todo, rowdata, 0);
     } while (!ok);
 
     sfree(matrix);
     sfree(workspace);
-    sfree(changed_h);
-    sfree(changed_w);
+    tdq_free(todo);
     sfree(rowdata);
     return grid;
 }
@@ -759,20 +741,17 @@ static char *new_game_desc(const game_params *params, random_state *rs,
 
     {
         unsigned char *matrix = snewn(params->w*params->h, unsigned char);
-        unsigned char *workspace = snewn(max*7, unsigned char);
-        unsigned int *changed_h = snewn(max+1, unsigned int);
-        unsigned int *changed_w = snewn(max+1, unsigned int);
+        int *workspace = snewn(WORKSPACE_SIZE(max), int);
+        tdq *todo = tdq_new(params->w + params->h);
         int *rowdata = snewn(max+1, int);
         for (i = 0; i < params->w * params->h; i++) {
             state->common->immutable[index[i]] = false;
             if (!solve_puzzle(state, grid, params->w, params->h,
-                              matrix, workspace, changed_h, changed_w,
-                              rowdata, 0))
+                              matrix, workspace, todo, rowdata, 0))
                 state->common->immutable[index[i]] = true;
         }
         sfree(workspace);
-        sfree(changed_h);
-        sfree(changed_w);
+        tdq_free(todo);
         sfree(rowdata);
         sfree(matrix);
     }
@@ -1060,9 +1039,8 @@ static char *solve_game(const game_state *state, const game_state *currstate,
     char *ret;
     int max;
     bool ok;
-    unsigned char *workspace;
-    unsigned int *changed_h, *changed_w;
-    int *rowdata;
+    int *workspace, *rowdata;
+    tdq *todo;
 
     /*
      * If we already have the solved state in ai, copy it out.
@@ -1072,17 +1050,15 @@ static char *solve_game(const game_state *state, const game_state *currstate,
 
     max = max(w, h);
     matrix = snewn(w*h, unsigned char);
-    workspace = snewn(max*7, unsigned char);
-    changed_h = snewn(max+1, unsigned int);
-    changed_w = snewn(max+1, unsigned int);
+    workspace = snewn(WORKSPACE_SIZE(max), int);
+    todo = tdq_new(w+h);
     rowdata = snewn(max+1, int);
 
     ok = solve_puzzle(state, NULL, w, h, matrix, workspace,
-		      changed_h, changed_w, rowdata, 0);
+		      todo, rowdata, 0);
 
     sfree(workspace);
-    sfree(changed_h);
-    sfree(changed_w);
+    tdq_free(todo);
     sfree(rowdata);
 
     if (!ok) {
@@ -2086,15 +2062,14 @@ int main(int argc, char **argv)
 
     {
 	int w = p->w, h = p->h, i, j, max, cluewid = 0;
-	unsigned char *matrix, *workspace;
-	unsigned int *changed_h, *changed_w;
-	int *rowdata;
+	unsigned char *matrix;
+	int *workspace, *rowdata;
+	tdq *todo;
 
 	matrix = snewn(w*h, unsigned char);
 	max = max(w, h);
-	workspace = snewn(max*7, unsigned char);
-	changed_h = snewn(max+1, unsigned int);
-	changed_w = snewn(max+1, unsigned int);
+	workspace = snewn(WORKSPACE_SIZE(max), int);
+	todo = tdq_new(w+h);
 	rowdata = snewn(max+1, int);
 
 	if (verbose) {
@@ -2116,7 +2091,7 @@ int main(int argc, char **argv)
 	}
 
 	solve_puzzle(s, NULL, w, h, matrix, workspace,
-		     changed_h, changed_w, rowdata, cluewid);
+		     todo, rowdata, cluewid);
 
 	for (i = 0; i < h; i++) {
 	    for (j = 0; j < w; j++) {
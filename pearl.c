@@ -349,6 +349,8 @@ static int pearl_solve(int w, int h, char *clues, char *result,
     while (1) {
 	bool done_something = false;
 
+	SOLVER_TIER("easy: edges and squares");
+
 #ifdef SOLVER_DIAGNOSTICS
 	for (y = 0; y < H; y++) {
 	    for (x = 0; x < W; x++)
@@ -383,6 +385,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 				       ex/2, ey/2, (ex+1)/2, (ey+1)/2,
 				       b, x, y);
 #endif
+				SOLVER_RULE("edge rules out square state");
 				done_something = true;
 				break;
 			    }
@@ -437,6 +440,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 
 		    if (!(edgeor & d) && workspace[ey*W+ex] == 3) {
 			workspace[ey*W+ex] = 2;
+			SOLVER_RULE("square disconnects edge");
 			done_something = true;
 #ifdef SOLVER_DIAGNOSTICS
 			printf("possible states of square (%d,%d) force edge"
@@ -445,6 +449,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 #endif
 		    } else if ((edgeand & d) && workspace[ey*W+ex] == 3) {
 			workspace[ey*W+ex] = 1;
+			SOLVER_RULE("square connects edge");
 			done_something = true;
 #ifdef SOLVER_DIAGNOSTICS
 			printf("possible states of square (%d,%d) force edge"
@@ -464,6 +469,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 	 * squares, and a straight clue must connect to at least
 	 * one corner square).
 	 */
+	SOLVER_TIER("easy: clues");
 	for (y = 0; y < h; y++)
 	    for (x = 0; x < w; x++)
 		switch (clues[y*w+x]) {
@@ -483,6 +489,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 			     */
 			    if (workspace[fy*W+fx] != (1<<type)) {
 				workspace[fy*W+fx] = (1<<type);
+				SOLVER_RULE("corner clue fixes straight");
 				done_something = true;
 #ifdef SOLVER_DIAGNOSTICS
 				printf("corner clue at (%d,%d) forces square "
@@ -501,6 +508,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 			     */
 			    if (!(workspace[fy*W+fx] & (1<<type))) {
 				workspace[ey*W+ex] = 2;
+				SOLVER_RULE("corner clue disconnects edge");
 				done_something = true;
 #ifdef SOLVER_DIAGNOSTICS
 				printf("corner clue at (%d,%d), plus square "
@@ -535,6 +543,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 			    !(workspace[gy*W+gx] & ((1<<(  d |A(d))) |
 						    (1<<(  d |C(d)))))) {
 			    workspace[(2*y+1)*W+(2*x+1)] &= ~(1<<type);
+			    SOLVER_RULE("straight clue rules out way");
 			    done_something = true;
 #ifdef SOLVER_DIAGNOSTICS
 			    printf("straight clue at (%d,%d) cannot corner at "
@@ -561,6 +570,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 			if (!(workspace[fy*W+fx] &~ (bLR|bUD)) &&
 			    (workspace[gy*W+gx] &~ (bLU|bLD|bRU|bRD))) {
 			    workspace[gy*W+gx] &= (bLU|bLD|bRU|bRD);
+			    SOLVER_RULE("straight clue needs corner");
 			    done_something = true;
 #ifdef SOLVER_DIAGNOSTICS
 			    printf("straight clue at (%d,%d) connecting to "
@@ -579,6 +589,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 	/*
 	 * Now detect shortcut loops.
 	 */
+	SOLVER_TIER("easy: loops");
 
 	{
 	    int nonblanks, loopclass;
@@ -699,6 +710,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 
             /* Further deductions are considered 'tricky'. */
             if (difficulty == DIFF_EASY) goto done_deductions;
+            SOLVER_TIER("tricky: shortcut loops");
 
 	    /*
 	     * Now go through the workspace again and mark any edge
@@ -743,6 +755,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 				     * Yes! Mark this edge disconnected.
 				     */
 				    workspace[y*W+x] = 2;
+				    SOLVER_RULE("shortcut loop edge");
 				    done_something = true;
 #ifdef SOLVER_DIAGNOSTICS
 				    printf("edge (%d,%d)-(%d,%d) would create"
@@ -804,6 +817,7 @@ static int pearl_solve(int w, int h, char *clues, char *result,
 					 * state invalid.
 					 */
 					workspace[y*W+x] &= ~(1<<b);
+					SOLVER_RULE("shortcut loop square");
 					done_something = true;
 #ifdef SOLVER_DIAGNOSTICS
 					printf("square (%d,%d) would create a "
@@ -1048,9 +1062,10 @@ static int pearl_loopgen_bias(void *vctx, char *board, int face)
     return ctx->score;
 }
 
-static void pearl_loopgen(int w, int h, char *lines, random_state *rs)
+/* g is the square grid of (w-1) x (h-1) faces which the loop runs along. */
+static void pearl_loopgen(grid *g, int w, int h, char *lines,
+                          random_state *rs)
 {
-    grid *g = grid_new(GRID_SQUARE, w-1, h-1, NULL);
     char *board = snewn(g->num_faces, char);
     int i, s = g->tilesize;
     struct pearl_loopgen_bias_ctx biasctx;
@@ -1130,7 +1145,6 @@ static void pearl_loopgen(int w, int h, char *lines, random_state *rs)
         }
     }
 
-    grid_free(g);
     sfree(board);
 
 #if defined LOOPGEN_DIAGNOSTICS && !defined GENERATION_DIAGNOSTICS
@@ -1157,6 +1171,9 @@ static int new_clues(const game_params *params, random_state *rs,
 {
     int w = params->w, h = params->h, diff = params->difficulty;
     int ngen = 0, x, y, d, ret, i;
+    /* Every attempt draws its loop on the same grid, so make it once.
+     * (It has to be 'struct grid' here, because 'grid' is taken.) */
+    struct grid *g = grid_new(GRID_SQUARE, w-1, h-1, NULL, NULL);
 
 
     /*
@@ -1168,7 +1185,7 @@ static int new_clues(const game_params *params, random_state *rs,
 
     while (1) {
         ngen++;
-	pearl_loopgen(w, h, grid, rs);
+	pearl_loopgen(g, w, h, grid, rs);
 
 #ifdef GENERATION_DIAGNOSTICS
 	printf("grid array:\n");
@@ -1347,6 +1364,7 @@ static int new_clues(const game_params *params, random_state *rs,
 
     debug(("%d %dx%d loops before finished puzzle.\n", ngen, w, h));
 
+    grid_free(g);
     return ngen;
 }
 
@@ -0,0 +1,1510 @@
+/*
+ * permsolve.c: general solver for permutation puzzles. See
+ * permsolve.h for the interface.
+ *
+ * We go about it in one of two ways. If the position is close to
+ * the target, a bidirectional breadth-first search over whole
+ * positions finds a shortest solution directly.
+ *
+ * Otherwise we fill in the squares one at a time, in the order given
+ * by the caller. At each stage we look for a sequence of 'macro
+ * operators' - compound moves, worked out in advance - which brings
+ * a suitable piece into the next square without disturbing any
+ * square already filled in. The only thing that search has to keep
+ * track of is the one piece, so it's just a shortest-path search
+ * over (square, orientation) pairs. Once few enough squares are left
+ * that we can afford to, we finish off with a breadth-first search
+ * over all their arrangements, which deals with any parity
+ * constraints the single-piece stages can't see.
+ *
+ * The macro operators are the basic moves; their commutators
+ * a b a^-1 b^-1, which in most puzzles of this kind affect only a
+ * few squares; and, for those of the commutators which affect few
+ * enough squares, their conjugates and commutators with the basic
+ * moves again, which gives us a supply of small changes we can make
+ * deep inside an otherwise finished grid.
+ *
+ * When the moves affect large blocks of squares, the squares left at
+ * the end can be too cramped for any of those. For that case there
+ * are three more things to try: 3-cycles made as commutators of
+ * macros which overlap in just one square; copies of the smallest
+ * macros moved into the squares that are left, by conjugating them
+ * with whatever moves take them there; and giving back the last few
+ * squares filled in, to make room for a larger search.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "puzzles.h"
+#include "tree234.h"
+#include "permsolve.h"
+
+#define MAXPERIOD 64           /* don't bother with moves of higher order */
+#define SMALLSUPP 12           /* macros small enough to build on */
+#define MAXMACROS 50000
+#define MANYMACROS 2000        /* stop adding levels of macros after this */
+#define SMALLPAIRS 500         /* smallest macros to try pairing up */
+
+#define BIDIR_BUDGET 200000    /* values stored by the bidirectional search */
+#define ENDGAME_STATES 20000   /* positions stored by the endgame search */
+#define WIDEN_STATES 100000    /* positions to spend widening the endgame */
+#define SETUPSUPP 4            /* macros small enough to move anywhere */
+#define SETUPSTATES 4000000    /* placements the setup search can track */
+
+struct macro {
+    int len, *seq;                     /* the basic moves making it up */
+    int nsupp;                         /* number of squares it affects */
+    int *from, *to, *twist;            /* what it does to them */
+    bool odd;                          /* it's an odd permutation */
+};
+
+struct permsolver {
+    int n, nmoves, norient;
+    int *perm, *twist;                 /* twist is NULL if norient == 1 */
+    int *inverse;                      /* inverse of each move, or -1 */
+    int *period;                       /* order of each move, or 0 */
+    int nmacros;
+    struct macro **macros;
+};
+
+#define ROTATE(ps, v, t) ((v) - (v) % (ps)->norient + \
+                          ((v) % (ps)->norient + (t)) % (ps)->norient)
+
+/*
+ * Apply basic move m to the position 'in', writing the result to
+ * 'out'.
+ */
+static void move_apply(const permsolver *ps, int m, const int *in, int *out)
+{
+    const int *perm = ps->perm + m * ps->n;
+    int c;
+
+    if (ps->twist) {
+        const int *twist = ps->twist + m * ps->n;
+        for (c = 0; c < ps->n; c++)
+            out[perm[c]] = ROTATE(ps, in[c], twist[c]);
+    } else {
+        for (c = 0; c < ps->n; c++)
+            out[perm[c]] = in[c];
+    }
+}
+
+/*
+ * Work out the overall effect of a sequence of basic moves: the
+ * piece starting in square c ends up in square dest[c], with its
+ * orientation changed by rot[c].
+ */
+static void seq_action(const permsolver *ps, const int *seq, int len,
+                       int *dest, int *rot)
+{
+    int n = ps->n, i, c;
+
+    for (c = 0; c < n; c++) {
+        dest[c] = c;
+        rot[c] = 0;
+    }
+    for (i = 0; i < len; i++) {
+        const int *perm = ps->perm + seq[i] * n;
+        const int *twist = ps->twist ? ps->twist + seq[i] * n : NULL;
+
+        for (c = 0; c < n; c++) {
+            if (twist)
+                rot[c] = (rot[c] + twist[dest[c]]) % ps->norient;
+            dest[c] = perm[dest[c]];
+        }
+    }
+}
+
+static void macro_free(struct macro *m)
+{
+    sfree(m->seq);
+    sfree(m->from);
+    sfree(m->to);
+    sfree(m->twist);
+    sfree(m);
+}
+
+static struct macro *macro_alloc(int len, int nsupp)
+{
+    struct macro *m = snew(struct macro);
+
+    m->len = len;
+    m->seq = snewn(len, int);
+    m->nsupp = nsupp;
+    m->from = snewn(nsupp, int);
+    m->to = snewn(nsupp, int);
+    m->twist = snewn(nsupp, int);
+    return m;
+}
+
+/*
+ * Work out whether a macro permutes the squares it affects oddly,
+ * from the number of cycles it splits them into.
+ */
+static void macro_set_parity(struct macro *m)
+{
+    int i, j, k, cycles = 0;
+    bool *seen = snewn(m->nsupp, bool);
+
+    for (i = 0; i < m->nsupp; i++)
+        seen[i] = false;
+    for (i = 0; i < m->nsupp; i++) {
+        if (seen[i])
+            continue;
+        cycles++;
+        for (k = i; !seen[k]; ) {
+            seen[k] = true;
+            /* find the entry for the square this one goes to */
+            for (j = 0; j < m->nsupp && m->from[j] != m->to[k]; j++);
+            if (j == m->nsupp)
+                break;
+            k = j;
+        }
+    }
+    m->odd = (m->nsupp - cycles) & 1;
+    sfree(seen);
+}
+
+/*
+ * Make a macro out of a sequence of basic moves, or return NULL if
+ * the sequence does nothing at all.
+ */
+static struct macro *macro_new(const permsolver *ps, const int *seq, int len,
+                               int *dest, int *rot)
+{
+    struct macro *m;
+    int c, k;
+
+    seq_action(ps, seq, len, dest, rot);
+    for (c = k = 0; c < ps->n; c++)
+        if (dest[c] != c || rot[c])
+            k++;
+    if (!k)
+        return NULL;
+
+    m = macro_alloc(len, k);
+    memcpy(m->seq, seq, len * sizeof(int));
+    for (c = k = 0; c < ps->n; c++)
+        if (dest[c] != c || rot[c]) {
+            m->from[k] = c;
+            m->to[k] = dest[c];
+            m->twist[k] = rot[c];
+            k++;
+        }
+    macro_set_parity(m);
+    return m;
+}
+
+/*
+ * Make the conjugate s X s^-1 of a macro by a basic move. This
+ * affects the squares that s^-1 takes X's to, so we can work it out
+ * without going over the whole grid.
+ */
+static struct macro *macro_conjugate(const permsolver *ps,
+                                     const struct macro *x, int s)
+{
+    int n = ps->n, si = ps->inverse[s], i, j;
+    const int *sperm = ps->perm + si * n;
+    struct macro *m = macro_alloc(x->len + 2, x->nsupp);
+
+    m->seq[0] = s;
+    memcpy(m->seq + 1, x->seq, x->len * sizeof(int));
+    m->seq[x->len + 1] = si;
+
+    for (i = 0; i < x->nsupp; i++) {
+        int f = sperm[x->from[i]], t = sperm[x->to[i]], tw = x->twist[i];
+
+        if (ps->twist)
+            tw = (tw + ps->twist[s * n + f] +
+                  ps->twist[si * n + x->to[i]]) % ps->norient;
+
+        /* Insertion sort by source square. */
+        for (j = i; j > 0 && m->from[j-1] > f; j--) {
+            m->from[j] = m->from[j-1];
+            m->to[j] = m->to[j-1];
+            m->twist[j] = m->twist[j-1];
+        }
+        m->from[j] = f;
+        m->to[j] = t;
+        m->twist[j] = tw;
+    }
+    m->odd = x->odd;
+
+    return m;
+}
+
+static int macro_cmp(void *av, void *bv)
+{
+    const struct macro *a = (const struct macro *)av;
+    const struct macro *b = (const struct macro *)bv;
+    int i;
+
+    if (a->nsupp != b->nsupp)
+        return a->nsupp < b->nsupp ? -1 : +1;
+    for (i = 0; i < a->nsupp; i++) {
+        if (a->from[i] != b->from[i])
+            return a->from[i] < b->from[i] ? -1 : +1;
+        if (a->to[i] != b->to[i])
+            return a->to[i] < b->to[i] ? -1 : +1;
+        if (a->twist[i] != b->twist[i])
+            return a->twist[i] < b->twist[i] ? -1 : +1;
+    }
+    return 0;
+}
+
+/*
+ * Add a macro to the table, unless it's NULL or does the same thing
+ * as one we've already got.
+ */
+static bool macro_add(permsolver *ps, tree234 *seen, struct macro *m)
+{
+    if (!m)
+        return false;
+    if (ps->nmacros >= MAXMACROS || add234(seen, m) != m) {
+        macro_free(m);
+        return false;
+    }
+    ps->macros[ps->nmacros++] = m;
+    return true;
+}
+
+/*
+ * Count the squares affected by both of two macros.
+ */
+static int macro_overlap(const struct macro *a, const struct macro *b,
+                         unsigned char *mark)
+{
+    int i, ret = 0;
+
+    for (i = 0; i < a->nsupp; i++)
+        mark[a->from[i]] = 1;
+    for (i = 0; i < b->nsupp; i++)
+        if (mark[b->from[i]])
+            ret++;
+    for (i = 0; i < a->nsupp; i++)
+        mark[a->from[i]] = 0;
+    return ret;
+}
+
+/*
+ * Append the inverse of a sequence of moves to 'out'.
+ */
+static int seq_invert(const permsolver *ps, const int *seq, int len,
+                      int *out)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        out[i] = ps->inverse[seq[len-1-i]];
+    return len;
+}
+
+static int macro_supp_cmp(const void *av, const void *bv, void *ctx)
+{
+    struct macro **macros = (struct macro **)ctx;
+    const struct macro *a = macros[*(const int *)av];
+    const struct macro *b = macros[*(const int *)bv];
+
+    if (a->nsupp != b->nsupp)
+        return a->nsupp < b->nsupp ? -1 : +1;
+    if (a->len != b->len)
+        return a->len < b->len ? -1 : +1;
+    return 0;
+}
+
+static void build_macros(permsolver *ps)
+{
+    int n = ps->n, nbase, start, end, i, j, len;
+    int *dest = snewn(n, int), *rot = snewn(n, int), *seq;
+    unsigned char *mark = snewn(n, unsigned char);
+    struct macro **base;
+    tree234 *seen = newtree234(macro_cmp);
+
+    memset(mark, 0, n);
+    ps->macros = snewn(MAXMACROS, struct macro *);
+    ps->nmacros = 0;
+
+    /*
+     * The basic moves, kept in their own list indexed by move so
+     * that we can check what they overlap.
+     */
+    base = snewn(ps->nmoves, struct macro *);
+    for (i = 0; i < ps->nmoves; i++) {
+        base[i] = macro_new(ps, &i, 1, dest, rot);
+        if (!macro_add(ps, seen, base[i]))
+            base[i] = NULL;            /* no-op, or same as another move */
+    }
+    nbase = ps->nmacros;
+
+    /*
+     * Commutators of pairs of moves. Moves which don't overlap
+     * commute, so their commutator is the identity.
+     */
+    seq = snewn(4, int);
+    for (i = 0; i < ps->nmoves; i++) {
+        if (!base[i] || ps->inverse[i] < 0)
+            continue;
+        for (j = 0; j < ps->nmoves; j++) {
+            if (!base[j] || ps->inverse[j] < 0 || j == i ||
+                j == ps->inverse[i] || !macro_overlap(base[i], base[j], mark))
+                continue;
+            seq[0] = i;
+            seq[1] = j;
+            seq[2] = ps->inverse[i];
+            seq[3] = ps->inverse[j];
+            macro_add(ps, seen, macro_new(ps, seq, 4, dest, rot));
+        }
+    }
+    /*
+     * Conjugates of the small commutators by the basic moves, and
+     * their commutators with the basic moves again; then the same
+     * for the small macros that gives us, and so on, level by level,
+     * so that the small changes spread out across the whole grid.
+     * We stop once we have plenty.
+     */
+    for (start = nbase, end = ps->nmacros;
+         start < end && ps->nmacros < MANYMACROS;
+         start = end, end = ps->nmacros) {
+        for (i = start; i < end; i++) {
+            struct macro *x = ps->macros[i];
+
+            if (x->nsupp > SMALLSUPP)
+                continue;
+            for (j = 0; j < ps->nmoves; j++) {
+                struct macro *m;
+
+                if (!base[j] || ps->inverse[j] < 0 ||
+                    !macro_overlap(x, base[j], mark))
+                    continue;
+
+                macro_add(ps, seen, macro_conjugate(ps, x, j));
+
+                seq = sresize(seq, 2 * x->len + 2, int);
+                memcpy(seq, x->seq, x->len * sizeof(int));
+                len = x->len;
+                seq[len++] = j;
+                len += seq_invert(ps, x->seq, x->len, seq + len);
+                seq[len++] = ps->inverse[j];
+                m = macro_new(ps, seq, len, dest, rot);
+                if (m && m->nsupp > SMALLSUPP) {
+                    macro_free(m);
+                    m = NULL;
+                }
+                macro_add(ps, seen, m);
+            }
+        }
+    }
+
+    /*
+     * With bigger blocks, none of that might have come up with
+     * anything affecting as few as SETUPSUPP squares, which is what
+     * we want once the squares left to fill in get cramped (see
+     * add_local_macros). But if two permutations have only one
+     * square in common, their commutator is a 3-cycle; so look for
+     * pairs like that among the smallest macros we've got.
+     */
+    for (i = 0; i < ps->nmacros; i++)
+        if (ps->macros[i]->nsupp <= SETUPSUPP)
+            break;
+    for (j = 0; j < ps->nmoves; j++)
+        if (ps->inverse[j] < 0)
+            break;
+    if (i == ps->nmacros && j == ps->nmoves) {
+        int *small = snewn(ps->nmacros, int), nsmall = 0;
+
+        for (i = 0; i < ps->nmacros; i++)
+            if (ps->macros[i]->nsupp <= SMALLSUPP)
+                small[nsmall++] = i;
+        arraysort(small, nsmall, macro_supp_cmp, ps->macros);
+        if (nsmall > SMALLPAIRS)
+            nsmall = SMALLPAIRS;
+
+        for (i = 0; i < nsmall; i++)
+            for (j = i+1; j < nsmall; j++) {
+                struct macro *x = ps->macros[small[i]];
+                struct macro *y = ps->macros[small[j]];
+                struct macro *m;
+
+                if (macro_overlap(x, y, mark) != 1)
+                    continue;
+                seq = sresize(seq, 2 * (x->len + y->len), int);
+                memcpy(seq, x->seq, x->len * sizeof(int));
+                len = x->len;
+                memcpy(seq + len, y->seq, y->len * sizeof(int));
+                len += y->len;
+                len += seq_invert(ps, x->seq, x->len, seq + len);
+                len += seq_invert(ps, y->seq, y->len, seq + len);
+                m = macro_new(ps, seq, len, dest, rot);
+                if (m && m->nsupp > SETUPSUPP) {
+                    macro_free(m);
+                    m = NULL;
+                }
+                macro_add(ps, seen, m);
+            }
+
+        sfree(small);
+    }
+
+    freetree234(seen);
+    sfree(base);
+    sfree(seq);
+    sfree(mark);
+    sfree(dest);
+    sfree(rot);
+}
+
+permsolver *permsolver_new(int n, int nmoves, const int *perm,
+                           const int *twist, int norient)
+{
+    permsolver *ps = snew(permsolver);
+    int *dest = snewn(n, int), *rot = snewn(n, int), *seq;
+    int i, j, c;
+
+    ps->n = n;
+    ps->nmoves = nmoves;
+    ps->norient = norient;
+    ps->perm = snewn(n * nmoves, int);
+    memcpy(ps->perm, perm, n * nmoves * sizeof(int));
+    if (twist && norient > 1) {
+        ps->twist = snewn(n * nmoves, int);
+        for (i = 0; i < n * nmoves; i++)
+            ps->twist[i] = ((twist[i] % norient) + norient) % norient;
+    } else {
+        ps->twist = NULL;
+        ps->norient = 1;
+    }
+
+    /*
+     * Find each move's inverse among the other moves (if it has one),
+     * and its order (if that's small enough to be interesting).
+     */
+    ps->inverse = snewn(nmoves, int);
+    ps->period = snewn(nmoves, int);
+    seq = snewn(MAXPERIOD, int);
+    for (i = 0; i < nmoves; i++) {
+        ps->inverse[i] = -1;
+        for (j = 0; j < nmoves && ps->inverse[i] < 0; j++) {
+            seq[0] = i;
+            seq[1] = j;
+            seq_action(ps, seq, 2, dest, rot);
+            for (c = 0; c < n; c++)
+                if (dest[c] != c || rot[c])
+                    break;
+            if (c == n)
+                ps->inverse[i] = j;
+        }
+
+        ps->period[i] = 0;
+        for (j = 1; j <= MAXPERIOD && !ps->period[i]; j++) {
+            seq[j-1] = i;
+            seq_action(ps, seq, j, dest, rot);
+            for (c = 0; c < n; c++)
+                if (dest[c] != c || rot[c])
+                    break;
+            if (c == n)
+                ps->period[i] = j;
+        }
+    }
+    sfree(seq);
+    sfree(dest);
+    sfree(rot);
+
+    build_macros(ps);
+
+    return ps;
+}
+
+void permsolver_free(permsolver *ps)
+{
+    int i;
+
+    for (i = 0; i < ps->nmacros; i++)
+        macro_free(ps->macros[i]);
+    sfree(ps->macros);
+    sfree(ps->perm);
+    sfree(ps->twist);
+    sfree(ps->inverse);
+    sfree(ps->period);
+    sfree(ps);
+}
+
+/* ----------------------------------------------------------------------
+ * Output: a list of basic moves, with obvious redundancy removed as
+ * it's added.
+ */
+
+struct moveseq {
+    int len, size, *moves;
+};
+
+static void moveseq_push(const permsolver *ps, struct moveseq *ms, int m)
+{
+    int run, p = ps->period[m];
+
+    if (ms->len > 0 && ms->moves[ms->len-1] == ps->inverse[m]) {
+        ms->len--;                     /* cancels with the previous move */
+        return;
+    }
+
+    if (ms->len >= ms->size) {
+        ms->size = ms->size * 3 / 2 + 16;
+        ms->moves = sresize(ms->moves, ms->size, int);
+    }
+    ms->moves[ms->len++] = m;
+
+    /*
+     * If this makes a run of more than half the move's order, it's
+     * shorter to go the other way.
+     */
+    for (run = 0; run < ms->len && ms->moves[ms->len-1-run] == m; run++);
+    if (p && (run == p || (2 * run > p && ps->inverse[m] >= 0))) {
+        int i;
+
+        ms->len -= run;
+        for (i = run; i < p; i++)
+            moveseq_push(ps, ms, ps->inverse[m]);
+    }
+}
+
+static void moveseq_add_macro(const permsolver *ps, struct moveseq *ms,
+                              const struct macro *mac)
+{
+    int i;
+
+    for (i = 0; i < mac->len; i++)
+        moveseq_push(ps, ms, mac->seq[i]);
+}
+
+static void macro_apply(const permsolver *ps, const struct macro *m,
+                        int *pos, int *tmp)
+{
+    int i;
+
+    for (i = 0; i < m->nsupp; i++)
+        tmp[i] = pos[m->from[i]];
+    for (i = 0; i < m->nsupp; i++)
+        pos[m->to[i]] = ROTATE(ps, tmp[i], m->twist[i]);
+}
+
+/* ----------------------------------------------------------------------
+ * Sets of positions, for the breadth-first searches.
+ */
+
+
+struct posnode {
+    int len, *vals;
+    int index;
+    int parent, via;                   /* node we came from, and how */
+};
+
+struct posset {
+    tree234 *tree;
+    int nnodes, size;
+    struct posnode **nodes;
+};
+
+static int posnode_cmp(void *av, void *bv)
+{
+    const struct posnode *a = (const struct posnode *)av;
+    const struct posnode *b = (const struct posnode *)bv;
+    int i;
+
+    assert(a->len == b->len);
+    for (i = 0; i < a->len; i++)
+        if (a->vals[i] != b->vals[i])
+            return a->vals[i] < b->vals[i] ? -1 : +1;
+    return 0;
+}
+
+static void posset_init(struct posset *set)
+{
+    set->tree = newtree234(posnode_cmp);
+    set->nnodes = set->size = 0;
+    set->nodes = NULL;
+}
+
+static void posset_cleanup(struct posset *set)
+{
+    int i;
+
+    for (i = 0; i < set->nnodes; i++) {
+        sfree(set->nodes[i]->vals);
+        sfree(set->nodes[i]);
+    }
+    sfree(set->nodes);
+    freetree234(set->tree);
+}
+
+/*
+ * Returns the index of the node holding the position 'vals', or -1.
+ */
+static int posset_find(struct posset *set, const int *vals, int len)
+{
+    struct posnode key, *node;
+
+    key.len = len;
+    key.vals = (int *)vals;
+    node = find234(set->tree, &key, NULL);
+    return node ? node->index : -1;
+}
+
+/*
+ * Add a position to the set, copying 'vals'. Returns its index, or
+ * -1 if it was already there.
+ */
+static int posset_add(struct posset *set, const int *vals, int len,
+                      int parent, int via)
+{
+    struct posnode *node;
+
+    if (posset_find(set, vals, len) >= 0)
+        return -1;
+
+    node = snew(struct posnode);
+    node->len = len;
+    node->vals = snewn(len, int);
+    memcpy(node->vals, vals, len * sizeof(int));
+    node->parent = parent;
+    node->via = via;
+    add234(set->tree, node);
+
+    if (set->nnodes >= set->size) {
+        set->size = set->size * 3 / 2 + 64;
+        set->nodes = sresize(set->nodes, set->size, struct posnode *);
+    }
+    node->index = set->nnodes;
+    set->nodes[set->nnodes++] = node;
+    return node->index;
+}
+
+/* ----------------------------------------------------------------------
+ * Bidirectional breadth-first search over whole positions, using
+ * the basic moves only. Gives up, returning false, once it's used
+ * up its budget.
+ */
+static bool solve_bidir(const permsolver *ps, const int *start,
+                        const int *target, struct moveseq *ms)
+{
+    struct posset sets[2];
+    int n = ps->n, maxnodes = BIDIR_BUDGET / n, i, side, m;
+    int done[2], meet[2] = { -1, -1 };
+    int *vals = snewn(n, int), *path = NULL;
+    int pathlen = 0;
+
+    for (m = 0; m < ps->nmoves; m++)
+        if (ps->inverse[m] < 0) {
+            sfree(vals);
+            return false;    /* can't search backwards from the target */
+        }
+
+    for (side = 0; side < 2; side++) {
+        posset_init(&sets[side]);
+        posset_add(&sets[side], side ? target : start, n, -1, -1);
+        done[side] = 0;
+    }
+    if (posset_find(&sets[1], start, n) >= 0) {
+        meet[0] = meet[1] = 0;
+        goto found;
+    }
+
+    while (sets[0].nnodes + sets[1].nnodes < maxnodes) {
+        int end;
+
+        /*
+         * Expand one whole layer, on whichever side currently has
+         * the smaller frontier.
+         */
+        side = (sets[0].nnodes - done[0] <= sets[1].nnodes - done[1] ? 0 : 1);
+        end = sets[side].nnodes;
+        if (done[side] == end)
+            break;                     /* that side is exhausted */
+
+        for (i = done[side]; i < end; i++) {
+            for (m = 0; m < ps->nmoves; m++) {
+                int k;
+
+                move_apply(ps, m, sets[side].nodes[i]->vals, vals);
+                k = posset_add(&sets[side], vals, n, i, m);
+                if (k < 0)
+                    continue;
+                meet[1-side] = posset_find(&sets[1-side], vals, n);
+                if (meet[1-side] >= 0) {
+                    meet[side] = k;
+                    goto found;
+                }
+            }
+        }
+        done[side] = end;
+    }
+
+    for (side = 0; side < 2; side++)
+        posset_cleanup(&sets[side]);
+    sfree(vals);
+    return false;
+
+  found:
+    /*
+     * Moves from the start to the meeting point come out backwards,
+     * so collect them first.
+     */
+    for (i = meet[0]; sets[0].nodes[i]->parent >= 0;
+         i = sets[0].nodes[i]->parent)
+        pathlen++;
+    path = snewn(pathlen + 1, int);
+    for (i = meet[0], m = pathlen; sets[0].nodes[i]->parent >= 0;
+         i = sets[0].nodes[i]->parent)
+        path[--m] = sets[0].nodes[i]->via;
+    for (m = 0; m < pathlen; m++)
+        moveseq_push(ps, ms, path[m]);
+
+    /*
+     * Each step back towards the target undoes a move that was made
+     * going away from it.
+     */
+    for (i = meet[1]; sets[1].nodes[i]->parent >= 0;
+         i = sets[1].nodes[i]->parent)
+        moveseq_push(ps, ms, ps->inverse[sets[1].nodes[i]->via]);
+
+    sfree(path);
+    for (side = 0; side < 2; side++)
+        posset_cleanup(&sets[side]);
+    sfree(vals);
+    return true;
+}
+
+/* ----------------------------------------------------------------------
+ * The stage-by-stage solver.
+ */
+
+struct stagectx {
+    const permsolver *ps;
+    int *pos, *tmp;
+    bool *fixed;
+    int nmacros, macrosize;            /* the solver's, then local ones */
+    struct macro **macros;
+    bool local;                        /* local macros have been added */
+    int *allowed, nallowed;            /* macros not touching fixed squares */
+};
+
+/*
+ * Sort macros into kinds that conjugating by basic moves can turn
+ * into one another. What's left unchanged is the lengths of the
+ * cycles the macro moves pieces round, and how far it turns a piece
+ * over one trip round its cycle.
+ */
+static int macro_kind(const permsolver *ps, const struct macro *m)
+{
+    int codes[SETUPSUPP], ncodes = 0, i, j, k, len, tw, code, ret;
+    bool seen[SETUPSUPP];
+
+    assert(m->nsupp <= SETUPSUPP);
+    for (i = 0; i < m->nsupp; i++)
+        seen[i] = false;
+    for (i = 0; i < m->nsupp; i++) {
+        if (seen[i])
+            continue;
+        len = tw = 0;
+        for (k = i; !seen[k]; ) {
+            seen[k] = true;
+            len++;
+            tw += m->twist[k];
+            for (j = 0; j < m->nsupp && m->from[j] != m->to[k]; j++);
+            if (j == m->nsupp)
+                break;
+            k = j;
+        }
+        code = len * ps->norient + tw % ps->norient;
+
+        /* Insertion sort, so that the order of the cycles doesn't matter. */
+        for (j = ncodes++; j > 0 && codes[j-1] > code; j--)
+            codes[j] = codes[j-1];
+        codes[j] = code;
+    }
+
+    for (i = ret = 0; i < ncodes; i++)
+        ret = ret * (SETUPSUPP + 1) * ps->norient + codes[i];
+    return ret;
+}
+
+/*
+ * Encode a list of k squares as a number base n, optionally sorting
+ * them first so that their order doesn't matter.
+ */
+static int encode_squares(const int *sq, int k, int n, bool sort)
+{
+    int tmp[SETUPSUPP], i, j, ret;
+
+    for (i = 0; i < k; i++) {
+        for (j = i; sort && j > 0 && tmp[j-1] > sq[i]; j--)
+            tmp[j] = tmp[j-1];
+        tmp[j] = sq[i];
+    }
+    for (i = k, ret = 0; i-- > 0 ;)
+        ret = ret * n + tmp[i];
+    return ret;
+}
+
+struct kindctx {
+    struct macro **macros;
+    int *kinds;
+};
+
+static int macro_kind_cmp(const void *av, const void *bv, void *ctx)
+{
+    const struct kindctx *kc = (const struct kindctx *)ctx;
+    int a = *(const int *)av, b = *(const int *)bv;
+
+    if (kc->kinds[a] != kc->kinds[b])
+        return kc->kinds[a] < kc->kinds[b] ? -1 : +1;
+    if (kc->macros[a]->len != kc->macros[b]->len)
+        return kc->macros[a]->len < kc->macros[b]->len ? -1 : +1;
+    return 0;
+}
+
+/*
+ * Once the squares still to be filled in are too cramped for any of
+ * the basic moves, the macros built up from them might not be able
+ * to reach in either. So we make some which can. We take each macro
+ * affecting only a few squares, find the ways the basic moves can
+ * bring those squares anywhere among the unfixed ones, and conjugate
+ * the macro by each of them, so that afterwards the setup moves are
+ * undone and only the squares we've got to have changed.
+ *
+ * Most of the small macros are conjugates of one another already, so
+ * we only search from the shortest of each kind that none of the
+ * previous searches has come across.
+ */
+static void add_local_macros(struct stagectx *sc)
+{
+    const permsolver *ps = sc->ps;
+    int n = ps->n, maxk, nstates, *cands, ncands = 0, i, k, m, s, t;
+    int *parent, *via, *queue, *seq = NULL, sq[SETUPSUPP];
+    int *dest = snewn(n, int), *rot = snewn(n, int);
+    bool *covered;
+    struct kindctx kc;
+    tree234 *seen;
+
+    sc->local = true;
+    for (m = 0; m < ps->nmoves; m++)
+        if (ps->inverse[m] < 0)
+            return;                    /* can't undo the setup moves */
+
+    for (maxk = 0, nstates = 1;
+         maxk < SETUPSUPP && nstates <= SETUPSTATES / n; maxk++)
+        nstates *= n;
+
+    kc.macros = ps->macros;
+    kc.kinds = snewn(ps->nmacros, int);
+    cands = snewn(ps->nmacros, int);
+    for (i = 0; i < ps->nmacros; i++)
+        if (ps->macros[i]->nsupp <= maxk) {
+            kc.kinds[i] = macro_kind(ps, ps->macros[i]);
+            cands[ncands++] = i;
+        }
+    arraysort(cands, ncands, macro_kind_cmp, &kc);
+
+    parent = snewn(nstates, int);
+    via = snewn(nstates, int);
+    queue = snewn(nstates, int);
+    covered = snewn(nstates, bool);
+    seen = newtree234(macro_cmp);
+
+    for (i = 0; i < ncands; i++) {
+        const struct macro *x = ps->macros[cands[i]];
+        int head, tail;
+
+        if (i == 0 || kc.kinds[cands[i]] != kc.kinds[cands[i-1]])
+            memset(covered, 0, nstates * sizeof(bool));
+        if (covered[encode_squares(x->from, x->nsupp, n, false)])
+            continue;
+
+        /*
+         * Breadth-first search over where the basic moves can take
+         * the squares x affects.
+         */
+        for (s = 0; s < nstates; s++)
+            parent[s] = -2;
+        s = encode_squares(x->from, x->nsupp, n, false);
+        parent[s] = -1;
+        queue[0] = s;
+        head = 0;
+        tail = 1;
+
+        while (head < tail) {
+            struct macro *mac;
+            int len = 0;
+            bool ok = true;
+
+            s = queue[head++];
+            for (k = 0, t = s; k < x->nsupp; k++, t /= n) {
+                sq[k] = t % n;
+                if (sc->fixed[sq[k]])
+                    ok = false;
+            }
+            covered[encode_squares(sq, x->nsupp, n, true)] = true;
+
+            for (m = 0; m < ps->nmoves; m++) {
+                int to[SETUPSUPP];
+
+                for (k = 0; k < x->nsupp; k++)
+                    to[k] = ps->perm[m * n + sq[k]];
+                t = encode_squares(to, x->nsupp, n, false);
+                if (parent[t] == -2) {
+                    parent[t] = s;
+                    via[t] = m;
+                    queue[tail++] = t;
+                }
+            }
+
+            if (!ok)
+                continue;
+
+            /*
+             * If U is the sequence of moves which took the squares
+             * here, then U^-1 X U does to where they've got to what
+             * X did to them.
+             */
+            for (t = s; parent[t] >= 0; t = parent[t])
+                len++;
+            seq = sresize(seq, 2 * len + x->len, int);
+            for (t = s, k = len; parent[t] >= 0; t = parent[t])
+                seq[len + x->len + --k] = via[t];
+            seq_invert(ps, seq + len + x->len, len, seq);
+            memcpy(seq + len, x->seq, x->len * sizeof(int));
+
+            mac = macro_new(ps, seq, 2 * len + x->len, dest, rot);
+            if (!mac || add234(seen, mac) != mac) {
+                if (mac)
+                    macro_free(mac);
+                continue;
+            }
+            if (sc->nmacros >= sc->macrosize) {
+                sc->macrosize = sc->macrosize * 3 / 2 + 64;
+                sc->macros = sresize(sc->macros, sc->macrosize,
+                                     struct macro *);
+                sc->allowed = sresize(sc->allowed, sc->macrosize, int);
+            }
+            sc->allowed[sc->nallowed++] = sc->nmacros;
+            sc->macros[sc->nmacros++] = mac;
+        }
+    }
+
+    freetree234(seen);
+    sfree(covered);
+    sfree(queue);
+    sfree(via);
+    sfree(parent);
+    sfree(seq);
+    sfree(cands);
+    sfree(kc.kinds);
+    sfree(dest);
+    sfree(rot);
+}
+
+/*
+ * Bring a piece matching 'want' into square 'sq', using the allowed
+ * macros (or only the even ones), and not using the pieces in any
+ * squares marked in 'avoid'. Returns false if there's no way to;
+ * otherwise sets *source to the square the piece came from.
+ */
+static bool solve_square(struct stagectx *sc, int sq, int want,
+                         bool evenonly, const bool *avoid, int *source,
+                         struct moveseq *ms)
+{
+    const permsolver *ps = sc->ps;
+    int n = ps->n, no = ps->norient, nv = n * no;
+    int *dist = snewn(nv, int), *prevnode = snewn(nv, int);
+    int *prevmac = snewn(nv, int);
+    bool *done = snewn(nv, bool);
+    int *adjstart = snewn(n + 1, int), *adjmac, *adjk, nedges;
+    int *path, npath, goal = sq * no + want % no;
+    int i, k, c, u;
+    bool ret;
+
+    /*
+     * Gather the squares each allowed macro moves things out of, so
+     * that we can look up the ways out of each square.
+     */
+    for (c = 0; c <= n; c++)
+        adjstart[c] = 0;
+    for (i = 0; i < sc->nallowed; i++) {
+        const struct macro *m = sc->macros[sc->allowed[i]];
+        if (evenonly && m->odd)
+            continue;
+        for (k = 0; k < m->nsupp; k++)
+            adjstart[m->from[k] + 1]++;
+    }
+    for (c = 0; c < n; c++)
+        adjstart[c+1] += adjstart[c];
+    nedges = adjstart[n];
+    adjmac = snewn(nedges, int);
+    adjk = snewn(nedges, int);
+    for (i = 0; i < sc->nallowed; i++) {
+        const struct macro *m = sc->macros[sc->allowed[i]];
+        if (evenonly && m->odd)
+            continue;
+        for (k = 0; k < m->nsupp; k++) {
+            int e = adjstart[m->from[k]]++;
+            adjmac[e] = sc->allowed[i];
+            adjk[e] = k;
+        }
+    }
+    for (c = n; c > 0; c--)
+        adjstart[c] = adjstart[c-1];
+    adjstart[0] = 0;
+
+    /*
+     * Dijkstra, from every piece that would do, with each macro
+     * costing the number of basic moves in it.
+     */
+    for (u = 0; u < nv; u++) {
+        dist[u] = -1;
+        done[u] = false;
+    }
+    for (c = 0; c < n; c++)
+        if (!sc->fixed[c] && !avoid[c] && sc->pos[c] / no == want / no) {
+            u = c * no + sc->pos[c] % no;
+            dist[u] = 0;
+            prevnode[u] = -1;
+        }
+
+    while (1) {
+        int best = -1;
+
+        for (u = 0; u < nv; u++)
+            if (!done[u] && dist[u] >= 0 && (best < 0 || dist[u] < dist[best]))
+                best = u;
+        if (best < 0 || best == goal)
+            break;
+        done[best] = true;
+
+        c = best / no;
+        for (i = adjstart[c]; i < adjstart[c+1]; i++) {
+            const struct macro *m = sc->macros[adjmac[i]];
+            int v = m->to[adjk[i]] * no + (best % no + m->twist[adjk[i]]) % no;
+            int d = dist[best] + m->len;
+
+            if (!done[v] && (dist[v] < 0 || d < dist[v])) {
+                dist[v] = d;
+                prevnode[v] = best;
+                prevmac[v] = adjmac[i];
+            }
+        }
+    }
+
+    ret = (dist[goal] >= 0);
+    if (ret) {
+        npath = 0;
+        for (u = goal; prevnode[u] >= 0; u = prevnode[u])
+            npath++;
+        *source = u / no;
+        path = snewn(npath + 1, int);
+        for (u = goal, i = npath; prevnode[u] >= 0; u = prevnode[u])
+            path[--i] = prevmac[u];
+        for (i = 0; i < npath; i++) {
+            macro_apply(ps, sc->macros[path[i]], sc->pos, sc->tmp);
+            moveseq_add_macro(ps, ms, sc->macros[path[i]]);
+        }
+        assert(sc->pos[sq] == want);
+        sfree(path);
+    }
+
+    sfree(adjmac);
+    sfree(adjk);
+    sfree(adjstart);
+    sfree(done);
+    sfree(prevmac);
+    sfree(prevnode);
+    sfree(dist);
+    return ret;
+}
+
+/*
+ * Finish off by breadth-first search over the arrangements of the
+ * remaining squares, using the allowed macros, giving up after
+ * looking at 'maxstates' of them. If 'used' isn't NULL, adds on the
+ * number we did look at.
+ */
+static bool solve_endgame(struct stagectx *sc, const int *squares, int k,
+                          const int *target, int maxstates, int *used,
+                          struct moveseq *ms)
+{
+    const permsolver *ps = sc->ps;
+    struct posset set;
+    int *vals = snewn(k, int), *goal = snewn(k, int), *idx;
+    int *full = snewn(ps->n, int), *path;
+    int i, j, a, found = -1, npath;
+
+    idx = snewn(ps->n, int);
+    for (i = 0; i < ps->n; i++)
+        idx[i] = -1;
+    for (i = 0; i < k; i++) {
+        idx[squares[i]] = i;
+        vals[i] = sc->pos[squares[i]];
+        goal[i] = target[squares[i]];
+    }
+
+    posset_init(&set);
+    posset_add(&set, vals, k, -1, -1);
+    if (!memcmp(vals, goal, k * sizeof(int)))
+        found = 0;
+
+    for (i = 0; found < 0 && i < set.nnodes && set.nnodes < maxstates; i++) {
+        for (a = 0; a < sc->nallowed; a++) {
+            const struct macro *m = sc->macros[sc->allowed[a]];
+            int node;
+
+            memcpy(vals, set.nodes[i]->vals, k * sizeof(int));
+            for (j = 0; j < m->nsupp; j++)
+                full[j] = vals[idx[m->from[j]]];
+            for (j = 0; j < m->nsupp; j++)
+                vals[idx[m->to[j]]] = ROTATE(ps, full[j], m->twist[j]);
+
+            node = posset_add(&set, vals, k, i, sc->allowed[a]);
+            if (node >= 0 && !memcmp(vals, goal, k * sizeof(int))) {
+                found = node;
+                break;
+            }
+        }
+    }
+
+    if (found >= 0) {
+        npath = 0;
+        for (i = found; set.nodes[i]->parent >= 0; i = set.nodes[i]->parent)
+            npath++;
+        path = snewn(npath + 1, int);
+        for (i = found, j = npath; set.nodes[i]->parent >= 0;
+             i = set.nodes[i]->parent)
+            path[--j] = set.nodes[i]->via;
+        for (j = 0; j < npath; j++) {
+            macro_apply(ps, sc->macros[path[j]], sc->pos, sc->tmp);
+            moveseq_add_macro(ps, ms, sc->macros[path[j]]);
+        }
+        sfree(path);
+    }
+
+    if (used)
+        *used += set.nnodes;
+    posset_cleanup(&set);
+    sfree(idx);
+    sfree(full);
+    sfree(goal);
+    sfree(vals);
+    return found >= 0;
+}
+
+/*
+ * Work out which macros don't touch any fixed square.
+ */
+static void stage_allow(struct stagectx *sc)
+{
+    int i, k;
+
+    sc->nallowed = 0;
+    for (i = 0; i < sc->nmacros; i++) {
+        const struct macro *m = sc->macros[i];
+
+        for (k = 0; k < m->nsupp; k++)
+            if (sc->fixed[m->from[k]])
+                break;
+        if (k == m->nsupp)
+            sc->allowed[sc->nallowed++] = i;
+    }
+}
+
+/*
+ * Finish off the squares from order[i] on with the endgame search.
+ *
+ * If that fails, it may be that the squares left are too cramped
+ * for any of our macros to fit in, so we try again with some local
+ * ones (see add_local_macros). If that still fails, it can be
+ * because the remaining squares fall into several sets which the
+ * moves never mix, and what's left needs an odd permutation of more
+ * than one of them at once, which none of the small macros does. So
+ * then we give back the squares we filled in last, one at a time,
+ * until there's room for a macro which can do that, spending up to
+ * WIDEN_STATES positions on the searches in all.
+ */
+static bool solve_finish(struct stagectx *sc, const int *order, int i,
+                         const int *target, int maxstates,
+                         struct moveseq *ms)
+{
+    int n = sc->ps->n, spent = 0;
+
+    if (solve_endgame(sc, order + i, n - i, target, maxstates, NULL, ms))
+        return true;
+    if (!sc->local) {
+        add_local_macros(sc);
+        if (solve_endgame(sc, order + i, n - i, target, maxstates, NULL, ms))
+            return true;
+    }
+
+    while (i > 0 && spent < WIDEN_STATES) {
+        i--;
+        sc->fixed[order[i]] = false;
+        stage_allow(sc);
+        if (solve_endgame(sc, order + i, n - i, target,
+                          min(ENDGAME_STATES * 10, WIDEN_STATES - spent),
+                          &spent, ms))
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Upper bound on the number of arrangements of the pieces wanted in
+ * the given squares.
+ */
+static double arrangements(const permsolver *ps, const int *squares, int k,
+                           const int *target)
+{
+    double ret = 1.0;
+    int i, j, same;
+
+    for (i = 0; i < k; i++) {
+        /*
+         * Count the ways to choose where each piece goes, with
+         * identical pieces not counted twice.
+         */
+        for (j = same = 0; j <= i; j++)
+            if (target[squares[j]] / ps->norient ==
+                target[squares[i]] / ps->norient)
+                same++;
+        ret = ret * (i + 1) / same * ps->norient;
+    }
+    return ret;
+}
+
+/*
+ * Parity of the permutation that would put the pieces in the given
+ * squares where they belong, or -1 if that isn't well defined
+ * because some of them are interchangeable.
+ */
+static int arrangement_parity(const permsolver *ps, const int *pos,
+                              const int *squares, int k, const int *target)
+{
+    int *dest = snewn(k, int);
+    bool *seen = snewn(k, bool);
+    int i, j, parity = 0;
+
+    for (i = 0; i < k; i++) {
+        dest[i] = -1;
+        for (j = 0; j < k; j++)
+            if (pos[squares[i]] / ps->norient ==
+                target[squares[j]] / ps->norient) {
+                if (dest[i] >= 0)
+                    goto ambiguous;
+                dest[i] = j;
+            }
+        if (dest[i] < 0)
+            goto ambiguous;
+        seen[i] = false;
+    }
+
+    for (i = 0; i < k; i++) {
+        if (seen[i])
+            continue;
+        for (j = i; !seen[j]; j = dest[j]) {
+            seen[j] = true;
+            parity ^= 1;
+        }
+        parity ^= 1;                   /* a cycle of length c is c-1 swaps */
+    }
+
+    sfree(dest);
+    sfree(seen);
+    return parity;
+
+  ambiguous:
+    sfree(dest);
+    sfree(seen);
+    return -1;
+}
+
+int permsolver_solve(const permsolver *ps, const int *start,
+                     const int *target, const int *order, int **moves)
+{
+    struct stagectx sc;
+    struct moveseq ms, saved;
+    int n = ps->n, i, j, *defaultorder = NULL, *next, *savedpos;
+    bool ok = true, *avoid;
+
+    ms.len = ms.size = 0;
+    ms.moves = NULL;
+
+    if (!memcmp(start, target, n * sizeof(int)))
+        goto done;
+
+    if (solve_bidir(ps, start, target, &ms))
+        goto done;
+
+    if (!order) {
+        defaultorder = snewn(n, int);
+        for (i = 0; i < n; i++)
+            defaultorder[i] = i;
+        order = defaultorder;
+    }
+
+    sc.ps = ps;
+    sc.pos = snewn(n, int);
+    memcpy(sc.pos, start, n * sizeof(int));
+    sc.tmp = snewn(n, int);
+    sc.fixed = snewn(n, bool);
+    for (i = 0; i < n; i++)
+        sc.fixed[i] = false;
+    sc.nmacros = sc.macrosize = ps->nmacros;
+    sc.macros = snewn(sc.macrosize, struct macro *);
+    memcpy(sc.macros, ps->macros, ps->nmacros * sizeof(struct macro *));
+    sc.local = false;
+    sc.allowed = snewn(sc.macrosize, int);
+    sc.nallowed = ps->nmacros;
+    for (i = 0; i < ps->nmacros; i++)
+        sc.allowed[i] = i;
+    next = snewn(sc.macrosize, int);
+    savedpos = snewn(n, int);
+    avoid = snewn(n, bool);
+    saved.len = saved.size = 0;
+    saved.moves = NULL;
+
+    for (i = 0; i < n; i++) {
+        int sq = order[i], nnext = 0, oddnow = -1, oddnext = -1, *tmp;
+        int source;
+        bool evenonly = false, checkparity, placed = false;
+
+        if (arrangements(ps, order + i, n - i, target) <= ENDGAME_STATES) {
+            ok = solve_finish(&sc, order, i, target, ENDGAME_STATES, &ms);
+            break;
+        }
+
+        /*
+         * Once this square is done, we can't use anything which
+         * disturbs it. Find out what that leaves us with, and the
+         * shortest odd macros now and then.
+         */
+        for (j = 0; j < sc.nallowed; j++) {
+            const struct macro *m = sc.macros[sc.allowed[j]];
+            int s;
+
+            if (m->odd && (oddnow < 0 || m->len < sc.macros[oddnow]->len))
+                oddnow = sc.allowed[j];
+            for (s = 0; s < m->nsupp; s++)
+                if (m->from[s] == sq)
+                    break;
+            if (s == m->nsupp) {
+                next[nnext++] = sc.allowed[j];
+                if (m->odd)
+                    oddnext = sc.allowed[j];
+            }
+        }
+
+        /*
+         * If this is our last chance to make an odd permutation of
+         * the squares that are left, make sure we won't need to:
+         * sort out the parity now, and then don't change it while
+         * filling in this square.
+         */
+        if (oddnow >= 0 && oddnext < 0) {
+            int parity = arrangement_parity(ps, sc.pos, order + i, n - i,
+                                            target);
+            if (parity == 1) {
+                macro_apply(ps, sc.macros[oddnow], sc.pos, sc.tmp);
+                moveseq_add_macro(ps, &ms, sc.macros[oddnow]);
+            }
+            evenonly = (parity >= 0);
+        }
+
+        /*
+         * With no odd macros left after this, the parity of what's
+         * left can't change once its pieces are all different. If
+         * some are interchangeable, which of them goes in this
+         * square can decide that parity, so be prepared to try them
+         * in turn until one leaves it even.
+         */
+        checkparity = (oddnext < 0 &&
+                       arrangement_parity(ps, sc.pos, order + i, n - i,
+                                          target) < 0);
+        if (checkparity) {
+            memcpy(savedpos, sc.pos, n * sizeof(int));
+            if (saved.size < ms.len) {
+                saved.size = ms.size;
+                saved.moves = sresize(saved.moves, saved.size, int);
+            }
+            saved.len = ms.len;
+            memcpy(saved.moves, ms.moves, ms.len * sizeof(int));
+        }
+        for (j = 0; j < n; j++)
+            avoid[j] = false;
+        while (1) {
+            if (sc.pos[sq] == target[sq] && !avoid[sq])
+                source = sq;
+            else if (!solve_square(&sc, sq, target[sq], evenonly, avoid,
+                                   &source, &ms))
+                break;
+            if (!checkparity ||
+                arrangement_parity(ps, sc.pos, order + i + 1, n - i - 1,
+                                   target) != 1) {
+                placed = true;
+                break;
+            }
+            memcpy(sc.pos, savedpos, n * sizeof(int));
+            ms.len = saved.len;
+            memcpy(ms.moves, saved.moves, ms.len * sizeof(int));
+            avoid[source] = true;
+        }
+
+        if (!placed && !sc.local) {
+            /*
+             * Nothing we've got can get at this square without
+             * disturbing the ones already done. Make some macros
+             * that can, and have another go.
+             */
+            add_local_macros(&sc);
+            next = sresize(next, sc.macrosize, int);
+            i--;
+            continue;
+        }
+
+        if (!placed) {
+            /*
+             * We've run out of macros that can get at this square
+             * on its own, but the remaining squares might still be
+             * few enough to search through as a whole.
+             */
+            ok = solve_finish(&sc, order, i, target, ENDGAME_STATES * 10, &ms);
+            break;
+        }
+
+        sc.fixed[sq] = true;
+        tmp = sc.allowed;
+        sc.allowed = next;
+        next = tmp;
+        sc.nallowed = nnext;
+    }
+
+    if (ok)
+        assert(!memcmp(sc.pos, target, n * sizeof(int)));
+
+    sfree(sc.pos);
+    sfree(sc.tmp);
+    sfree(sc.fixed);
+    for (i = ps->nmacros; i < sc.nmacros; i++)
+        macro_free(sc.macros[i]);
+    sfree(sc.macros);
+    sfree(sc.allowed);
+    sfree(next);
+    sfree(savedpos);
+    sfree(avoid);
+    sfree(saved.moves);
+    sfree(defaultorder);
+
+    if (!ok) {
+        sfree(ms.moves);
+        return -1;
+    }
+
+  done:
+    *moves = ms.moves ? ms.moves : snewn(1, int);
+    return ms.len;
+}
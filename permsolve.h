@@ -0,0 +1,47 @@
+/*
+ * permsolve.h: general solver for puzzles whose moves permute the
+ * squares of a grid (and possibly rotate what's in them), such as
+ * Sixteen, Twiddle and Netslide.
+ */
+
+#ifndef PUZZLES_PERMSOLVE_H
+#define PUZZLES_PERMSOLVE_H
+
+/*
+ * The puzzle is described as a set of n squares, each holding a
+ * value. A value v stands for a piece with label v / norient in
+ * orientation v % norient; norient is 1 if orientation doesn't
+ * matter. Pieces with the same label are interchangeable.
+ *
+ * Each of the 'nmoves' moves is given by two arrays of n integers,
+ * at perm[i*n] and twist[i*n]: move i takes the piece in square c
+ * to square perm[i*n+c], adding twist[i*n+c] to its orientation.
+ * 'twist' may be NULL if no move changes orientations.
+ *
+ * Creating the solver works out a table of compound moves ('macro
+ * operators') from the basic ones, so it's worth keeping hold of if
+ * several positions of the same puzzle are to be solved.
+ */
+typedef struct permsolver permsolver;
+
+permsolver *permsolver_new(int n, int nmoves, const int *perm,
+                           const int *twist, int norient);
+void permsolver_free(permsolver *ps);
+
+/*
+ * Find a sequence of moves taking the position 'start' to the
+ * position 'target', both arrays of n values.
+ *
+ * 'order', if not NULL, lists all n squares in the order they should
+ * be filled in; it's best if the squares in the last part of the
+ * list are close together. NULL means in numerical order.
+ *
+ * Returns the number of moves, and sets *moves to a dynamically
+ * allocated array of move indices; or returns -1 if no solution was
+ * found within the solver's resource limits, which can happen if
+ * the target isn't reachable at all.
+ */
+int permsolver_solve(const permsolver *ps, const int *start,
+                     const int *target, const int *order, int **moves);
+
+#endif /* PUZZLES_PERMSOLVE_H */
@@ -402,6 +402,16 @@ int c2pos(int w, int h, int cx, int cy);
 int c2diff(int w, int h, int cx, int cy, int button);
 void pos2c(int w, int h, int pos, int *cx, int *cy);
 
+/* Applies a solution of the form "S;move;move;...", as made by the
+ * solve_game of a puzzle which solves by way of ordinary moves, by
+ * passing each move in turn to 'execute' (normally the puzzle's own
+ * execute_move). Returns the final state, or NULL if any move fails;
+ * intermediate states are disposed of with 'free_state'. */
+game_state *execute_move_sequence(
+    const game_state *from, const char *move,
+    game_state *(*execute)(const game_state *, const char *),
+    void (*free_state)(game_state *));
+
 /* Draws text with an 'outline' formed by offsetting the text
  * by one pixel; useful for highlighting. Outline is omitted if -1. */
 void draw_text_outline(drawing *dr, int x, int y, int fonttype,
@@ -440,6 +450,26 @@ void edsf_merge(int *dsf, int v1, int v2, bool inverse);
 void dsf_merge(int *dsf, int v1, int v2);
 void dsf_init(int *dsf, int len);
 
+/*
+ * A variant disjoint set forest for solvers which need to try things
+ * out and then back off again, without taking a copy of the whole
+ * dsf each time. dsf_checkpoint returns a marker; dsf_rollback
+ * undoes every merge done since that marker was taken (and any
+ * later markers then become invalid).
+ *
+ * Unlike the ordinary dsf, the canonical element of a class isn't
+ * necessarily its smallest, and there's no 'inverse' flag.
+ */
+typedef struct udsf udsf;
+udsf *udsf_new(int size);
+void udsf_free(udsf *u);
+void udsf_init(udsf *u);
+int udsf_canonify(udsf *u, int val);
+int udsf_size(udsf *u, int val);
+void udsf_merge(udsf *u, int v1, int v2);
+int dsf_checkpoint(udsf *u);
+void dsf_rollback(udsf *u, int checkpoint);
+
 /*
  * tdq.c
  */
@@ -557,6 +587,11 @@ void free_combi(combi_ctx *combi);
  */
 /* divides w*h rectangle into pieces of size k. Returns w*h dsf. */
 int *divvy_rectangle(int w, int h, int k, random_state *rs);
+/* The same, but when it gets stuck it patches up the division locally
+ * instead of starting again, which is much faster for large k. It gives
+ * a different division for the same random_state, so a puzzle switching
+ * to it would change the games its existing seeds generate. */
+int *divvy_rectangle_repairing(int w, int h, int k, random_state *rs);
 
 /*
  * findloop.c
@@ -619,6 +654,23 @@ void arraysort_fn(void *array, size_t nmemb, size_t size,
 #define arraysort(array, nmemb, cmp, ctx) \
     arraysort_fn(array, nmemb, sizeof(*(array)), cmp, ctx)
 
+/*
+ * Hooks for solverbench.c, which a solver can use to report its
+ * working. SOLVER_TIER(name) says that the solver is starting on a
+ * new tier of deductions, so that time spent from then on is counted
+ * against that tier; SOLVER_RULE(name) counts one deduction made by
+ * the named rule. Both compile to nothing outside the benchmark.
+ */
+#ifdef STANDALONE_SOLVERBENCH
+void solverbench_tier(const char *name);
+void solverbench_rule(const char *name);
+#define SOLVER_TIER(name) solverbench_tier(name)
+#define SOLVER_RULE(name) solverbench_rule(name)
+#else
+#define SOLVER_TIER(name) ((void)0)
+#define SOLVER_RULE(name) ((void)0)
+#endif
+
 /*
  * Data structure containing the function calls and data specific
  * to a particular game. This is enclosed in a data structure so
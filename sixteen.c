@@ -12,6 +12,7 @@
 #include <math.h>
 
 #include "puzzles.h"
+#include "permsolve.h"
 
 #define PREFERRED_TILE_SIZE 48
 #define TILE_SIZE (ds->tilesize)
@@ -503,10 +504,85 @@ static void free_game(game_state *state)
     sfree(state);
 }
 
+/*
+ * The moves, as numbered for the solver: each row can be shifted
+ * right or left, then each column down or up.
+ */
+#define NMOVES(w, h) (2 * ((w) + (h)))
+
+static void move_desc(int w, int h, int m, char *buf)
+{
+    if (m < 2*h)
+        sprintf(buf, "R%d,%d", m / 2, m % 2 ? -1 : +1);
+    else
+        sprintf(buf, "C%d,%d", (m - 2*h) / 2, m % 2 ? -1 : +1);
+}
+
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *aux, const char **error)
 {
-    return dupstr("S");
+    int w = currstate->w, h = currstate->h, n = w*h, nmoves = NMOVES(w, h);
+    int *perm, *order, *target, *moves, len, i, m, x, y;
+    permsolver *ps;
+    char *ret, *p;
+
+    perm = snewn(nmoves * n, int);
+    for (m = 0; m < nmoves; m++)
+        for (y = 0; y < h; y++)
+            for (x = 0; x < w; x++) {
+                int d = m % 2 ? -1 : +1;
+
+                if (m < 2*h && m / 2 == y)
+                    perm[m*n + y*w + x] = y*w + (x + d + w) % w;
+                else if (m >= 2*h && (m - 2*h) / 2 == x)
+                    perm[m*n + y*w + x] = ((y + d + h) % h) * w + x;
+                else
+                    perm[m*n + y*w + x] = y*w + x;
+            }
+
+    /*
+     * Fill in the rows from the top, leaving the last two to be
+     * done a column at a time, so that what's left at the end is
+     * a compact block.
+     */
+    order = snewn(n, int);
+    target = snewn(n, int);
+    for (i = 0; i < n; i++)
+        target[i] = i+1;
+    i = 0;
+    for (y = 0; y < h-2; y++)
+        for (x = 0; x < w; x++)
+            order[i++] = y*w + x;
+    for (x = 0; x < w; x++)
+        for (y = h-2; y < h; y++)
+            order[i++] = y*w + x;
+
+    ps = permsolver_new(n, nmoves, perm, NULL, 1);
+    len = permsolver_solve(ps, currstate->tiles, target, order, &moves);
+    permsolver_free(ps);
+    sfree(perm);
+    sfree(order);
+    sfree(target);
+
+    /*
+     * If we can't find the moves, fall back to simply replacing the
+     * grid with a solved one (see execute_move).
+     */
+    if (len < 0)
+        return dupstr("S");
+
+    ret = snewn(2 + 40 * len, char);
+    p = ret;
+    *p++ = 'S';
+    for (i = 0; i < len; i++) {
+        *p++ = ';';
+        move_desc(w, h, moves[i], p);
+        p += strlen(p);
+    }
+    *p = '\0';
+    sfree(moves);
+
+    return ret;
 }
 
 static bool game_can_format_as_text_now(const game_params *params)
@@ -726,6 +802,14 @@ static game_state *execute_move(const game_state *from, const char *move)
     int tx, ty, n;
     game_state *ret;
 
+    if (move[0] == 'S' && move[1] == ';') {
+        /* A solution from solve_game(), as a sequence of moves. */
+        ret = execute_move_sequence(from, move, execute_move, free_game);
+        if (ret)
+            ret->used_solve = true;
+        return ret;
+    }
+
     if (!strcmp(move, "S")) {
 	int i;
 
@@ -0,0 +1,352 @@
+/*
+ * solverbench.c: time a puzzle's solver over a corpus of game IDs.
+ *
+ * This is linked against one puzzle at a time, giving a program
+ * called <puzzle>bench for each puzzle with a standalone solver:
+ *
+ *   <puzzle>bench [-e seed] [-n count] [-f file] [params | id]...
+ *
+ * A full game ID is solved as it stands. Bare params stand for
+ * 'count' freshly generated grids with those params. '-f' reads a
+ * corpus of game IDs from a file, one per line (a file of '-' means
+ * standard input).
+ *
+ * Results are reported for each distinct set of params, which for
+ * most puzzles includes the difficulty level. If the solver reports
+ * its working through SOLVER_TIER and SOLVER_RULE (see puzzles.h),
+ * we also give the time spent in each tier of deductions, the rate
+ * of deductions in it, and how often each of its rules fired.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "puzzles.h"
+
+#define MAXTIERS 16
+#define MAXRULES 64
+
+struct tier {
+    const char *name;
+    clock_t time;
+    long deductions;
+};
+
+struct rule {
+    const char *name;
+    int tier;
+    long count;
+};
+
+struct group {
+    char *params;
+    int nsolved, nfailed;
+    clock_t time;
+    struct tier tiers[MAXTIERS];
+    int ntiers;
+    struct rule rules[MAXRULES];
+    int nrules;
+};
+
+static struct group *groups;
+static int ngroups, groupsize;
+
+/* The group being timed, and its tier in progress. */
+static struct group *curr;
+static int currtier = -1;
+static clock_t tierstart;
+
+void get_random_seed(void **randseed, int *randseedsize)
+{
+    time_t *tp = snew(time_t);
+    time(tp);
+    *randseed = (void *)tp;
+    *randseedsize = sizeof(time_t);
+}
+
+static int find_tier(struct group *g, const char *name)
+{
+    int i;
+
+    for (i = 0; i < g->ntiers; i++)
+        if (g->tiers[i].name == name || !strcmp(g->tiers[i].name, name))
+            return i;
+
+    if (g->ntiers == MAXTIERS) {
+        fprintf(stderr, "solverbench: too many solver tiers\n");
+        exit(1);
+    }
+    g->tiers[i].name = name;
+    g->tiers[i].time = 0;
+    g->tiers[i].deductions = 0;
+    return g->ntiers++;
+}
+
+void solverbench_tier(const char *name)
+{
+    clock_t now = clock();
+
+    if (!curr)
+        return;
+    if (currtier >= 0)
+        curr->tiers[currtier].time += now - tierstart;
+    currtier = name ? find_tier(curr, name) : -1;
+    tierstart = now;
+}
+
+void solverbench_rule(const char *name)
+{
+    struct rule *r;
+    int i;
+
+    if (!curr || currtier < 0)
+        return;
+
+    curr->tiers[currtier].deductions++;
+    for (i = 0; i < curr->nrules; i++) {
+        r = &curr->rules[i];
+        if (r->tier == currtier &&
+            (r->name == name || !strcmp(r->name, name))) {
+            r->count++;
+            return;
+        }
+    }
+
+    if (curr->nrules == MAXRULES) {
+        fprintf(stderr, "solverbench: too many solver rules\n");
+        exit(1);
+    }
+    r = &curr->rules[curr->nrules++];
+    r->name = name;
+    r->tier = currtier;
+    r->count = 1;
+}
+
+static struct group *find_group(const game_params *p)
+{
+    char *params = thegame.encode_params(p, true);
+    int i;
+
+    for (i = 0; i < ngroups; i++)
+        if (!strcmp(groups[i].params, params)) {
+            sfree(params);
+            return &groups[i];
+        }
+
+    if (ngroups == groupsize) {
+        groupsize = groupsize * 3 / 2 + 8;
+        groups = sresize(groups, groupsize, struct group);
+    }
+    groups[ngroups].params = params;
+    groups[ngroups].nsolved = groups[ngroups].nfailed = 0;
+    groups[ngroups].time = 0;
+    groups[ngroups].ntiers = groups[ngroups].nrules = 0;
+    return &groups[ngroups++];
+}
+
+static void bench_one(const game_params *p, const char *desc)
+{
+    const char *err = thegame.validate_desc(p, desc);
+    game_state *state;
+    clock_t start;
+    char *move;
+
+    if (err) {
+        fprintf(stderr, "solverbench: %s: %s\n", desc, err);
+        exit(1);
+    }
+
+    curr = find_group(p);
+    state = thegame.new_game(NULL, p, desc);
+
+    /*
+     * Any time the solver doesn't attribute to a tier of its own is
+     * put down to an 'other' tier.
+     */
+    start = clock();
+    solverbench_tier("other");
+    move = thegame.solve(state, state, NULL, &err);
+    solverbench_tier(NULL);
+    curr->time += clock() - start;
+
+    if (move) {
+        curr->nsolved++;
+        sfree(move);
+    } else {
+        curr->nfailed++;
+    }
+
+    thegame.free_game(state);
+    curr = NULL;
+}
+
+/*
+ * Benchmark a command-line argument or a line of a corpus: either
+ * a game ID, or params for which to generate 'count' grids.
+ */
+static void bench_id(const char *id, random_state *rs, int count)
+{
+    game_params *p = thegame.default_params();
+    char *params = dupstr(id);
+    char *desc = strchr(params, ':');
+    const char *err;
+    int i;
+
+    if (desc)
+        *desc++ = '\0';
+    thegame.decode_params(p, params);
+    err = thegame.validate_params(p, true);
+    if (err) {
+        fprintf(stderr, "solverbench: %s: %s\n", params, err);
+        exit(1);
+    }
+
+    if (desc) {
+        bench_one(p, desc);
+    } else {
+        for (i = 0; i < count; i++) {
+            char *aux = NULL;
+            char *gendesc = thegame.new_desc(p, rs, &aux, false);
+            bench_one(p, gendesc);
+            sfree(gendesc);
+            sfree(aux);
+        }
+    }
+
+    sfree(params);
+    thegame.free_params(p);
+}
+
+static void bench_file(const char *filename, random_state *rs, int count)
+{
+    FILE *fp = strcmp(filename, "-") ? fopen(filename, "r") : stdin;
+    char *line;
+
+    if (!fp) {
+        fprintf(stderr, "solverbench: %s: unable to open\n", filename);
+        exit(1);
+    }
+
+    while ((line = fgetline(fp)) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (*line && *line != '#')
+            bench_id(line, rs, count);
+        sfree(line);
+    }
+
+    if (fp != stdin)
+        fclose(fp);
+}
+
+static int rulecmp(const void *av, const void *bv, void *ctx)
+{
+    const struct rule *a = (const struct rule *)av;
+    const struct rule *b = (const struct rule *)bv;
+
+    if (a->tier != b->tier)
+        return a->tier < b->tier ? -1 : +1;
+    if (a->count != b->count)
+        return a->count > b->count ? -1 : +1;
+    return 0;
+}
+
+static double secs(clock_t t)
+{
+    return (double)t / CLOCKS_PER_SEC;
+}
+
+static void report(struct group *g)
+{
+    int n = g->nsolved + g->nfailed;
+    int i, j;
+
+    printf("%s %s: %d solved, %d not, in %.3fs (%.3fms each)\n",
+           thegame.name, g->params, g->nsolved, g->nfailed,
+           secs(g->time), 1000 * secs(g->time) / n);
+
+    /*
+     * If the solver didn't report any working, the only tier is our
+     * own 'other', which tells us nothing new.
+     */
+    if (g->ntiers < 2 && g->nrules == 0)
+        return;
+
+    arraysort(g->rules, g->nrules, rulecmp, NULL);
+    for (i = 0; i < g->ntiers; i++) {
+        struct tier *t = &g->tiers[i];
+
+        printf("  %-24s %8.3fs %5.1f%%", t->name, secs(t->time),
+               g->time ? 100.0 * t->time / g->time : 0.0);
+        if (t->deductions)
+            printf(" %10ld deductions (%.0f/s)", t->deductions,
+                   t->time ? t->deductions / secs(t->time) : 0.0);
+        printf("\n");
+
+        for (j = 0; j < g->nrules; j++)
+            if (g->rules[j].tier == i)
+                printf("    %-30s %10ld %5.1f%%\n", g->rules[j].name,
+                       g->rules[j].count,
+                       100.0 * g->rules[j].count / t->deductions);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *quis = argv[0];
+    const char **ids = snewn(argc, const char *);
+    bool *isfile = snewn(argc, bool);
+    time_t seed = time(NULL);
+    random_state *rs;
+    int count = 10, nids = 0, i;
+
+    while (--argc > 0) {
+        const char *p = *++argv;
+        if (argc > 1 && (!strcmp(p, "-e") || !strcmp(p, "--seed"))) {
+            seed = atoi(*++argv);
+            argc--;
+        } else if (argc > 1 && !strcmp(p, "-n")) {
+            count = atoi(*++argv);
+            argc--;
+        } else if (argc > 1 && !strcmp(p, "-f")) {
+            isfile[nids] = true;
+            ids[nids++] = *++argv;
+            argc--;
+        } else if (*p == '-') {
+            fprintf(stderr, "solverbench: unrecognised option `%s'\n", p);
+            return 1;
+        } else {
+            isfile[nids] = false;
+            ids[nids++] = p;
+        }
+    }
+    if (count < 1) {
+        fprintf(stderr, "solverbench: count must be positive\n");
+        return 1;
+    }
+    if (!nids) {
+        fprintf(stderr, "usage: %s [-e seed] [-n count] [-f file] "
+                "[params | id]...\n", quis);
+        return 1;
+    }
+
+    rs = random_new((void *)&seed, sizeof(time_t));
+    for (i = 0; i < nids; i++) {
+        if (isfile[i])
+            bench_file(ids[i], rs, count);
+        else
+            bench_id(ids[i], rs, count);
+    }
+
+    for (i = 0; i < ngroups; i++) {
+        report(&groups[i]);
+        sfree(groups[i].params);
+    }
+    sfree(groups);
+    sfree(ids);
+    sfree(isfile);
+    random_free(rs);
+
+    return 0;
+}
@@ -254,6 +254,21 @@ struct solver_ctx {
     int *clues;
     long *iscratch;
     int *dscratch;
+
+    /*
+     * For solver_hard: for each subset of the digits 1..w, as a
+     * bitmap with digit d in bit d-1, the number of digits in it
+     * and the largest of them (0 for the empty set). Also space
+     * for a bitmap of visible-building counts per subset, going
+     * each way.
+     *
+     * lastavail[c*w] onwards records the possible digits in each
+     * square of clue c's row, as bitmaps in the same form, the last
+     * time solver_hard found nothing to deduce from that clue.
+     */
+    int *setsize, *setmax;
+    unsigned *fwd, *bwd;
+    unsigned *lastavail;
 };
 
 static int solver_easy(struct latin_solver *solver, void *vctx)
@@ -442,8 +457,9 @@ static int solver_hard(struct latin_solver *solver, void *vctx)
 {
     struct solver_ctx *ctx = (struct solver_ctx *)vctx;
     int w = ctx->w;
-    int c, i, j, n, best, clue, start, step, ret;
-    long bitmap;
+    int c, i, j, clue, start, step, ret;
+    int set, full;
+    unsigned avail[9];
 #ifdef STANDALONE_SOLVER
     char prefix[256];
 #endif
@@ -457,75 +473,70 @@ static int solver_hard(struct latin_solver *solver, void *vctx)
 	    continue;
 	CSTARTSTEP(start, step, c, w);
 
-	for (i = 0; i < w; i++)
+	/*
+	 * We want to know, for each square of the row and each
+	 * digit, whether any permutation consistent with the cube
+	 * and the clue puts that digit there. Rather than trying
+	 * every permutation, we notice that once the first k squares
+	 * are filled, all that matters for the rest is _which_ k
+	 * digits were used (since the tallest building visible so far
+	 * is the largest of them) and how many buildings are visible.
+	 *
+	 * So fwd[set] is a bitmap of the visible counts possible with
+	 * the digits in 'set' filling the first squares of the row,
+	 * and bwd[set] a bitmap of the visible counts from which the
+	 * rest of the row can be filled to make the count exactly
+	 * 'clue'. A digit can go in square k if it takes some
+	 * reachable fwd state to a bwd one.
+	 */
+	full = (1 << w) - 1;
+	for (i = 0; i < w; i++) {
+	    int pos = start + step * i;
+	    avail[i] = 0;
+	    for (j = 1; j <= w; j++)
+		if (solver->cube[pos*w+j-1])
+		    avail[i] |= 1 << (j-1);
 	    ctx->iscratch[i] = 0;
+	}
 
 	/*
-	 * Instead of a tedious physical recursion, I iterate in the
-	 * scratch array through all possibilities. At any given
-	 * moment, i indexes the element of the box that will next
-	 * be incremented.
+	 * If this clue's row is just as it was the last time we
+	 * analysed it and found nothing, don't bother again.
 	 */
-	i = 0;
-	ctx->dscratch[i] = 0;
-	best = n = 0;
-	bitmap = 0;
-
-	while (1) {
-	    if (i < w) {
-		/*
-		 * Find the next valid value for cell i.
-		 */
-		int limit = (n == clue ? best : w);
-		int pos = start + step * i;
-		for (j = ctx->dscratch[i] + 1; j <= limit; j++) {
-		    if (bitmap & (1L << j))
-			continue;      /* used this one already */
-		    if (!solver->cube[pos*w+j-1])
-			continue;      /* ruled out already */
-
-		    /* Found one. */
-		    break;
-		}
+	if (!memcmp(avail, ctx->lastavail + c*w, w * sizeof(unsigned)))
+	    continue;
 
-		if (j > limit) {
-		    /* No valid values left; drop back. */
-		    i--;
-		    if (i < 0)
-			break;	       /* overall iteration is finished */
-		    bitmap &= ~(1L << ctx->dscratch[i]);
-		    if (ctx->dscratch[i] == best) {
-			n--;
-			best = 0;
-			for (j = 0; j < i; j++)
-			    if (best < ctx->dscratch[j])
-				best = ctx->dscratch[j];
-		    }
-		} else {
-		    /* Got a valid value; store it and move on. */
-		    bitmap |= 1L << j;
-		    ctx->dscratch[i++] = j;
-		    if (j > best) {
-			best = j;
-			n++;
+	for (set = 0; set <= full; set++)
+	    ctx->fwd[set] = 0;
+	ctx->fwd[0] = 1;
+	for (set = 0; set < full; set++) {
+	    unsigned counts = ctx->fwd[set], next;
+	    if (!counts)
+		continue;
+	    next = avail[ctx->setsize[set]] & ~set;
+	    for (j = 1; next; j++, next >>= 1)
+		if (next & 1)
+		    ctx->fwd[set | (1 << (j-1))] |=
+			(j > ctx->setmax[set] ? counts << 1 : counts);
+	}
+
+	ctx->bwd[full] = 1 << clue;
+	for (set = full; set-- > 0 ;) {
+	    unsigned counts = 0, next;
+	    ctx->bwd[set] = 0;
+	    if (!ctx->fwd[set])
+		continue;
+	    next = avail[ctx->setsize[set]] & ~set;
+	    for (j = 1; next; j++, next >>= 1)
+		if (next & 1) {
+		    unsigned after = ctx->bwd[set | (1 << (j-1))];
+		    unsigned before = (j > ctx->setmax[set] ? after >> 1 : after);
+		    if (ctx->fwd[set] & before) {
+			counts |= before;
+			ctx->iscratch[ctx->setsize[set]] |= 1L << j;
 		    }
-		    ctx->dscratch[i] = 0;
 		}
-	    } else {
-		if (n == clue) {
-		    for (j = 0; j < w; j++)
-			ctx->iscratch[j] |= 1L << ctx->dscratch[j];
-		}
-		i--;
-		bitmap &= ~(1L << ctx->dscratch[i]);
-		if (ctx->dscratch[i] == best) {
-		    n--;
-		    best = 0;
-		    for (j = 0; j < i; j++)
-			if (best < ctx->dscratch[j])
-			    best = ctx->dscratch[j];
-		}
-	    }
+	    ctx->bwd[set] = counts;
 	}
 
 #ifdef STANDALONE_SOLVER
@@ -566,6 +577,8 @@ static int solver_hard(struct latin_solver *solver, void *vctx)
 	    if (ret)
 		return ret;
 	}
+
+	memcpy(ctx->lastavail + c*w, avail, w * sizeof(unsigned));
     }
 
     return 0;
@@ -608,7 +621,7 @@ static bool towers_valid(struct latin_solver *solver, void *vctx)
 
 static int solver(int w, int *clues, digit *soln, int maxdiff)
 {
-    int ret;
+    int i, ret;
     struct solver_ctx ctx;
 
     ctx.w = w;
@@ -617,6 +630,19 @@ static int solver(int w, int *clues, digit *soln, int maxdiff)
     ctx.started = false;
     ctx.iscratch = snewn(w, long);
     ctx.dscratch = snewn(w+1, int);
+    ctx.setsize = snewn(1 << w, int);
+    ctx.setmax = snewn(1 << w, int);
+    ctx.fwd = snewn(1 << w, unsigned);
+    ctx.bwd = snewn(1 << w, unsigned);
+    ctx.lastavail = snewn(4*w*w, unsigned);
+    for (i = 0; i < 4*w*w; i++)
+	ctx.lastavail[i] = 0;
+    ctx.setsize[0] = ctx.setmax[0] = 0;
+    for (i = 1; i < (1 << w); i++) {
+	ctx.setsize[i] = ctx.setsize[i & (i-1)] + 1;
+	ctx.setmax[i] = (i & (i-1) ? ctx.setmax[i & (i-1)] :
+			 ctx.setmax[i >> 1] + 1);
+    }
 
     ret = latin_solver(soln, w, maxdiff,
 		       DIFF_EASY, DIFF_HARD, DIFF_EXTREME,
@@ -625,6 +651,11 @@ static int solver(int w, int *clues, digit *soln, int maxdiff)
 
     sfree(ctx.iscratch);
     sfree(ctx.dscratch);
+    sfree(ctx.setsize);
+    sfree(ctx.setmax);
+    sfree(ctx.fwd);
+    sfree(ctx.bwd);
+    sfree(ctx.lastavail);
 
     return ret;
 }
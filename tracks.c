@@ -903,12 +903,48 @@ static game_state *new_game(midend *me, const game_params *params, const char *d
     return state;
 }
 
+/*
+ * Bits in solver_scratch's linedirty[], one for each of the solver
+ * passes that works along rows and columns. A pass need only look at
+ * a row or column again if something in it has changed since the
+ * last time that pass looked at it.
+ */
+#define DIRTY_COUNT       1
+#define DIRTY_SINGLE      2
+#define DIRTY_LOOSE       4
+#define DIRTY_NEIGHBOURS  8
+#define DIRTY_NEIGHBOURS2 16
+#define DIRTY_ALL         31
+
 struct solver_scratch {
-    int *dsf;
+    int w, h;
+
+    /* Connected components of the track laid so far. E_TRACK edges
+     * are never removed during a solve, so this only ever merges. */
+    int *loopdsf;
+
+    /* Squares which solve_update_flags needs to look at. */
+    tdq *todo;
+
+    /* DIRTY_* flags for each column (indices 0..w-1) and row
+     * (w..w+h-1), indexed the same way as the clue numbers. */
+    unsigned char *linedirty;
+
+    /* Workspace for solve_check_bridge_parity. */
+    struct findloopstate *fls;
+    int *parent, *root, *queue;
+    unsigned char *parity;
 };
 
-static int solve_set_sflag(game_state *state, int x, int y,
-                           unsigned int f, const char *why)
+static void solve_square_changed(struct solver_scratch *sc, int x, int y)
+{
+    tdq_add(sc->todo, y*sc->w + x);
+    sc->linedirty[x] = DIRTY_ALL;
+    sc->linedirty[sc->w + y] = DIRTY_ALL;
+}
+
+static int solve_set_sflag(game_state *state, struct solver_scratch *sc,
+                           int x, int y, unsigned int f, const char *why)
 {
     int w = state->p.w, i = y*w + x;
 
@@ -921,13 +957,16 @@ static int solve_set_sflag(game_state *state, int x, int y,
         state->impossible = true;
     }
     state->sflags[i] |= f;
+    solve_square_changed(sc, x, y);
     return 1;
 }
 
-static int solve_set_eflag(game_state *state, int x, int y, int d,
+static int solve_set_eflag(game_state *state, struct solver_scratch *sc,
+                           int x, int y, int d,
                            unsigned int f, const char *why)
 {
-    int sf = S_E_FLAGS(state, x, y, d);
+    int sf = S_E_FLAGS(state, x, y, d), ax, ay;
+    unsigned ad;
 
     if (sf & f)
         return 0;
@@ -939,58 +978,70 @@ static int solve_set_eflag(game_state *state, int x, int y, int d,
         state->impossible = true;
     }
     S_E_SET(state, x, y, d, f);
+    solve_square_changed(sc, x, y);
+    if (S_E_ADJ(state, x, y, d, &ax, &ay, &ad)) {
+        solve_square_changed(sc, ax, ay);
+        if (f == E_TRACK)
+            dsf_merge(sc->loopdsf, y*sc->w + x, ay*sc->w + ax);
+    }
     return 1;
 }
 
-static int solve_update_flags(game_state *state)
+static int solve_update_flags(game_state *state, struct solver_scratch *sc)
 {
-    int x, y, i, w = state->p.w, h = state->p.h, did = 0;
+    int x, y, i, j, w = state->p.w, did = 0;
 
-    for (x = 0; x < w; x++) {
-        for (y = 0; y < h; y++) {
-            /* If a square is NOTRACK, all four edges must be. */
-            if (state->sflags[y*w + x] & S_NOTRACK) {
-                for (i = 0; i < 4; i++) {
-                    unsigned int d = 1<<i;
-                    did += solve_set_eflag(state, x, y, d, E_NOTRACK, "edges around NOTRACK");
-                }
+    /*
+     * These deductions only look at one square and its own edges, so
+     * we need only revisit squares that something has changed. Each
+     * change we make here queues the affected squares again, so this
+     * runs until none of the rules has anything more to say.
+     */
+    while ((j = tdq_remove(sc->todo)) >= 0) {
+        x = j % w;
+        y = j / w;
+        /* If a square is NOTRACK, all four edges must be. */
+        if (state->sflags[y*w + x] & S_NOTRACK) {
+            for (i = 0; i < 4; i++) {
+                unsigned int d = 1<<i;
+                did += solve_set_eflag(state, sc, x, y, d, E_NOTRACK, "edges around NOTRACK");
             }
+        }
 
-            /* If 3 or more edges around a square are NOTRACK, the square is. */
-            if (S_E_COUNT(state, x, y, E_NOTRACK) >= 3) {
-                did += solve_set_sflag(state, x, y, S_NOTRACK, "square has >2 NOTRACK edges");
-            }
+        /* If 3 or more edges around a square are NOTRACK, the square is. */
+        if (S_E_COUNT(state, x, y, E_NOTRACK) >= 3) {
+            did += solve_set_sflag(state, sc, x, y, S_NOTRACK, "square has >2 NOTRACK edges");
+        }
 
-            /* If any edge around a square is TRACK, the square is. */
-            if (S_E_COUNT(state, x, y, E_TRACK) > 0) {
-                did += solve_set_sflag(state, x, y, S_TRACK, "square has TRACK edge");
-            }
+        /* If any edge around a square is TRACK, the square is. */
+        if (S_E_COUNT(state, x, y, E_TRACK) > 0) {
+            did += solve_set_sflag(state, sc, x, y, S_TRACK, "square has TRACK edge");
+        }
 
-            /* If a square is TRACK and 2 edges are NOTRACK,
-               the other two edges must be TRACK. */
-            if ((state->sflags[y*w + x] & S_TRACK) &&
-                    (S_E_COUNT(state, x, y, E_NOTRACK) == 2) &&
-                    (S_E_COUNT(state, x, y, E_TRACK) < 2)) {
-                for (i = 0; i < 4; i++) {
-                    unsigned int d = 1<<i;
-                    if (!(S_E_FLAGS(state, x, y, d) & (E_TRACK|E_NOTRACK))) {
-                        did += solve_set_eflag(state, x, y, d, E_TRACK,
-                                               "TRACK square/2 NOTRACK edges");
-                    }
+        /* If a square is TRACK and 2 edges are NOTRACK,
+           the other two edges must be TRACK. */
+        if ((state->sflags[y*w + x] & S_TRACK) &&
+                (S_E_COUNT(state, x, y, E_NOTRACK) == 2) &&
+                (S_E_COUNT(state, x, y, E_TRACK) < 2)) {
+            for (i = 0; i < 4; i++) {
+                unsigned int d = 1<<i;
+                if (!(S_E_FLAGS(state, x, y, d) & (E_TRACK|E_NOTRACK))) {
+                    did += solve_set_eflag(state, sc, x, y, d, E_TRACK,
+                                           "TRACK square/2 NOTRACK edges");
                 }
             }
+        }
 
-            /* If a square is TRACK and 2 edges are TRACK, the other two
-               must be NOTRACK. */
-            if ((state->sflags[y*w + x] & S_TRACK) &&
-                    (S_E_COUNT(state, x, y, E_TRACK) == 2) &&
-                    (S_E_COUNT(state, x, y, E_NOTRACK) < 2)) {
-                for (i = 0; i < 4; i++) {
-                    unsigned int d = 1<<i;
-                    if (!(S_E_FLAGS(state, x, y, d) & (E_TRACK|E_NOTRACK))) {
-                        did += solve_set_eflag(state, x, y, d, E_NOTRACK,
-                                               "TRACK square/2 TRACK edges");
-                    }
+        /* If a square is TRACK and 2 edges are TRACK, the other two
+           must be NOTRACK. */
+        if ((state->sflags[y*w + x] & S_TRACK) &&
+                (S_E_COUNT(state, x, y, E_TRACK) == 2) &&
+                (S_E_COUNT(state, x, y, E_NOTRACK) < 2)) {
+            for (i = 0; i < 4; i++) {
+                unsigned int d = 1<<i;
+                if (!(S_E_FLAGS(state, x, y, d) & (E_TRACK|E_NOTRACK))) {
+                    did += solve_set_eflag(state, sc, x, y, d, E_NOTRACK,
+                                           "TRACK square/2 TRACK edges");
                 }
             }
         }
@@ -1016,7 +1067,8 @@ static int solve_count_row(game_state *state, int row, unsigned int f)
     return c;
 }
 
-static int solve_count_clues_sub(game_state *state, int si, int id, int n,
+static int solve_count_clues_sub(game_state *state, struct solver_scratch *sc,
+                                 int si, int id, int n,
                                  int target, const char *what)
 {
     int ctrack = 0, cnotrack = 0, did = 0, j, i, w = state->p.w;
@@ -1031,35 +1083,53 @@ static int solve_count_clues_sub(game_state *state, int si, int id, int n,
         /* everything that's not S_TRACK must be S_NOTRACK. */
         for (j = 0, i = si; j < n; j++, i += id) {
             if (!(state->sflags[i] & S_TRACK))
-                did += solve_set_sflag(state, i%w, i/w, S_NOTRACK, what);
+                did += solve_set_sflag(state, sc, i%w, i/w, S_NOTRACK, what);
         }
     }
     if (cnotrack == (n-target)) {
         /* everything that's not S_NOTRACK must be S_TRACK. */
         for (j = 0, i = si; j < n; j++, i += id) {
             if (!(state->sflags[i] & S_NOTRACK))
-                did += solve_set_sflag(state, i%w, i/w, S_TRACK, what);
+                did += solve_set_sflag(state, sc, i%w, i/w, S_TRACK, what);
         }
     }
     return did;
 }
 
-static int solve_count_clues(game_state *state)
+/*
+ * Test and clear one of the DIRTY_* flags for a row or column (given
+ * by its clue index), to decide whether a pass needs to look at it.
+ */
+static bool solve_line_dirty(struct solver_scratch *sc, int line,
+                             unsigned char flag)
+{
+    if (!(sc->linedirty[line] & flag))
+        return false;
+    sc->linedirty[line] &= ~flag;
+    return true;
+}
+
+static int solve_count_clues(game_state *state, struct solver_scratch *sc)
 {
     int w = state->p.w, h = state->p.h, x, y, target, did = 0;
 
     for (x = 0; x < w; x++) {
+        if (!solve_line_dirty(sc, x, DIRTY_COUNT))
+            continue;
         target = state->numbers->numbers[x];
-        did += solve_count_clues_sub(state, x, w, h, target, "col count");
+        did += solve_count_clues_sub(state, sc, x, w, h, target, "col count");
     }
     for (y = 0; y < h; y++) {
+        if (!solve_line_dirty(sc, w+y, DIRTY_COUNT))
+            continue;
         target = state->numbers->numbers[w+y];
-        did += solve_count_clues_sub(state, y*w, 1, w, target, "row count");
+        did += solve_count_clues_sub(state, sc, y*w, 1, w, target, "row count");
     }
     return did;
 }
 
-static int solve_check_single_sub(game_state *state, int si, int id, int n,
+static int solve_check_single_sub(game_state *state, struct solver_scratch *sc,
+                                  int si, int id, int n,
                                   int target, unsigned int perpf,
                                   const char *what)
 {
@@ -1100,29 +1170,34 @@ static int solve_check_single_sub(game_state *state, int si, int id, int n,
         y = i/w;
         if (abs(ox-x) > 1 || abs(oy-y) > 1) {
             if (!(state->sflags[i] & S_TRACK))
-                did += solve_set_sflag(state, x, y, S_NOTRACK, what);
+                did += solve_set_sflag(state, sc, x, y, S_NOTRACK, what);
         }
     }
 
     return did;
 }
 
-static int solve_check_single(game_state *state)
+static int solve_check_single(game_state *state, struct solver_scratch *sc)
 {
     int w = state->p.w, h = state->p.h, x, y, target, did = 0;
 
     for (x = 0; x < w; x++) {
+        if (!solve_line_dirty(sc, x, DIRTY_SINGLE))
+            continue;
         target = state->numbers->numbers[x];
-        did += solve_check_single_sub(state, x, w, h, target, R|L, "single on col");
+        did += solve_check_single_sub(state, sc, x, w, h, target, R|L, "single on col");
     }
     for (y = 0; y < h; y++) {
+        if (!solve_line_dirty(sc, w+y, DIRTY_SINGLE))
+            continue;
         target = state->numbers->numbers[w+y];
-        did += solve_check_single_sub(state, y*w, 1, w, target, U|D, "single on row");
+        did += solve_check_single_sub(state, sc, y*w, 1, w, target, U|D, "single on row");
     }
     return did;
 }
 
-static int solve_check_loose_sub(game_state *state, int si, int id, int n,
+static int solve_check_loose_sub(game_state *state, struct solver_scratch *sc,
+                                 int si, int id, int n,
                                  int target, unsigned int perpf,
                                  const char *what)
 {
@@ -1165,7 +1240,7 @@ static int solve_check_loose_sub(game_state *state, int si, int id, int n,
                         !(S_E_DIRS(state, i%w, i/w, E_TRACK) & (1<<k))) {
                     /* set as NOTRACK the edge parallel to the row/column that's
                        not already set. */
-                    did += solve_set_eflag(state, i%w, i/w, 1<<k, E_NOTRACK, what);
+                    did += solve_set_eflag(state, sc, i%w, i/w, 1<<k, E_NOTRACK, what);
                 }
             }
         }
@@ -1178,7 +1253,7 @@ static int solve_check_loose_sub(game_state *state, int si, int id, int n,
                 continue; /* skip non-loose ends */
             for (k = 0; k < 4; k++) {
                 if (parf & (1<<k))
-                    did += solve_set_eflag(state, i%w, i/w, 1<<k, E_TRACK, what);
+                    did += solve_set_eflag(state, sc, i%w, i/w, 1<<k, E_TRACK, what);
             }
         }
     }
@@ -1186,17 +1261,21 @@ static int solve_check_loose_sub(game_state *state, int si, int id, int n,
     return did;
 }
 
-static int solve_check_loose_ends(game_state *state)
+static int solve_check_loose_ends(game_state *state, struct solver_scratch *sc)
 {
     int w = state->p.w, h = state->p.h, x, y, target, did = 0;
 
     for (x = 0; x < w; x++) {
+        if (!solve_line_dirty(sc, x, DIRTY_LOOSE))
+            continue;
         target = state->numbers->numbers[x];
-        did += solve_check_loose_sub(state, x, w, h, target, R|L, "loose on col");
+        did += solve_check_loose_sub(state, sc, x, w, h, target, R|L, "loose on col");
     }
     for (y = 0; y < h; y++) {
+        if (!solve_line_dirty(sc, w+y, DIRTY_LOOSE))
+            continue;
         target = state->numbers->numbers[w+y];
-        did += solve_check_loose_sub(state, y*w, 1, w, target, U|D, "loose on row");
+        did += solve_check_loose_sub(state, sc, y*w, 1, w, target, U|D, "loose on row");
     }
     return did;
 }
@@ -1219,7 +1298,8 @@ static void solve_check_neighbours_count(
     *oneempty = (to_empty == 1);
 }
 
-static int solve_check_neighbours_try(game_state *state, int x, int y,
+static int solve_check_neighbours_try(game_state *state,
+                                      struct solver_scratch *sc, int x, int y,
                                       int X, int Y, bool onefill,
                                       bool oneempty, unsigned dir,
                                       const char *what)
@@ -1255,6 +1335,7 @@ static int solve_check_neighbours_try(game_state *state, int x, int y,
     if (onefill) {
         /* But at most one of them can be filled, so it can't be p. */
         state->sflags[p] |= S_NOTRACK;
+        solve_square_changed(sc, x, y);
         solverdebug(("square (%d,%d) -> NOTRACK: otherwise, that and (%d,%d) "
                      "would make too many TRACK in %s", x, y, X, Y, what));
         did++;
@@ -1263,6 +1344,7 @@ static int solve_check_neighbours_try(game_state *state, int x, int y,
         /* Alternatively, at least one of them _must_ be filled, so P
          * must be. */
         state->sflags[P] |= S_TRACK;
+        solve_square_changed(sc, X, Y);
         solverdebug(("square (%d,%d) -> TRACK: otherwise, that and (%d,%d) "
                      "would make too many NOTRACK in %s", X, Y, x, y, what));
         did++;
@@ -1270,25 +1352,31 @@ static int solve_check_neighbours_try(game_state *state, int x, int y,
     return did;
 }
 
-static int solve_check_neighbours(game_state *state, bool both_ways)
+static int solve_check_neighbours(game_state *state, struct solver_scratch *sc,
+                                  bool both_ways)
 {
     int w = state->p.w, h = state->p.h, x, y, did = 0;
+    unsigned char flag = both_ways ? DIRTY_NEIGHBOURS2 : DIRTY_NEIGHBOURS;
     bool onefill, oneempty;
 
     for (x = 0; x < w; x++) {
+        if (!solve_line_dirty(sc, x, flag))
+            continue;
         solve_check_neighbours_count(state, x, w, h, x, &onefill, &oneempty);
         if (!both_ways)
             oneempty = false; /* disable the harder version of the deduction */
         if (!onefill && !oneempty)
             continue;
         for (y = 0; y+1 < h; y++) {
-            did += solve_check_neighbours_try(state, x, y, x, y+1,
+            did += solve_check_neighbours_try(state, sc, x, y, x, y+1,
                                               onefill, oneempty, D, "column");
-            did += solve_check_neighbours_try(state, x, y+1, x, y,
+            did += solve_check_neighbours_try(state, sc, x, y+1, x, y,
                                               onefill, oneempty, U, "column");
         }
     }
     for (y = 0; y < h; y++) {
+        if (!solve_line_dirty(sc, w+y, flag))
+            continue;
         solve_check_neighbours_count(state, y*w, 1, w, w+y,
                                      &onefill, &oneempty);
         if (!both_ways)
@@ -1296,16 +1384,17 @@ static int solve_check_neighbours(game_state *state, bool both_ways)
         if (!onefill && !oneempty)
             continue;
         for (x = 0; x+1 < w; x++) {
-            did += solve_check_neighbours_try(state, x, y, x+1, y,
+            did += solve_check_neighbours_try(state, sc, x, y, x+1, y,
                                               onefill, oneempty, R, "row");
-            did += solve_check_neighbours_try(state, x+1, y, x, y,
+            did += solve_check_neighbours_try(state, sc, x+1, y, x, y,
                                               onefill, oneempty, L, "row");
         }
     }
     return did;
 }
 
-static int solve_check_loop_sub(game_state *state, int x, int y, int dir,
+static int solve_check_loop_sub(game_state *state, struct solver_scratch *sc,
+                                int x, int y, int dir,
                                 int *dsf, int startc, int endc)
 {
     int w = state->p.w, h = state->p.h, i = y*w+x, j, k;
@@ -1321,7 +1410,7 @@ static int solve_check_loop_sub(game_state *state, int x, int y, int dir,
         !(S_E_DIRS(state, x, y, E_NOTRACK) & dir)) {
         int ic = dsf_canonify(dsf, i), jc = dsf_canonify(dsf, j);
         if (ic == jc) {
-            return solve_set_eflag(state, x, y, dir, E_NOTRACK, "would close loop");
+            return solve_set_eflag(state, sc, x, y, dir, E_NOTRACK, "would close loop");
         }
         if ((ic == startc && jc == endc) || (ic == endc && jc == startc)) {
             solverdebug(("Adding link at (%d,%d) would join start to end", x, y));
@@ -1332,7 +1421,7 @@ static int solve_check_loop_sub(game_state *state, int x, int y, int dir,
             for (k = 0; k < w*h; k++) {
                 if (state->sflags[k] & S_TRACK &&
                         dsf_canonify(dsf, k) != startc && dsf_canonify(dsf, k) != endc) {
-                    return solve_set_eflag(state, x, y, dir, E_NOTRACK,
+                    return solve_set_eflag(state, sc, x, y, dir, E_NOTRACK,
                                            "joins start to end but misses tracks");
                 }
             }
@@ -1347,7 +1436,7 @@ static int solve_check_loop_sub(game_state *state, int x, int y, int dir,
                 if (ntracks < target) satisfied = false;
             }
             if (!satisfied) {
-                return solve_set_eflag(state, x, y, dir, E_NOTRACK,
+                return solve_set_eflag(state, sc, x, y, dir, E_NOTRACK,
                                        "joins start to end with incomplete clues");
             }
         }
@@ -1355,38 +1444,13 @@ static int solve_check_loop_sub(game_state *state, int x, int y, int dir,
     return 0;
 }
 
-static int solve_check_loop(game_state *state)
+static int solve_check_loop(game_state *state, struct solver_scratch *sc)
 {
-    int w = state->p.w, h = state->p.h, x, y, i, j, did = 0;
-    int *dsf, startc, endc;
-
-    /* TODO eventually we should pull this out into a solver struct and keep it
-       updated as we connect squares. For now we recreate it every time we try
-       this particular solver step. */
-    dsf = snewn(w*h, int);
-    dsf_init(dsf, w*h);
-
-    /* Work out the connectedness of the current loop set. */
-    for (x = 0; x < w; x++) {
-        for (y = 0; y < h; y++) {
-            i = y*w + x;
-            if (x < (w-1) && S_E_DIRS(state, x, y, E_TRACK) & R) {
-                /* connection to the right... */
-                j = y*w + (x+1);
-                assert(i < w*h && j < w*h);
-                dsf_merge(dsf, i, j);
-            }
-            if (y < (h-1) && S_E_DIRS(state, x, y, E_TRACK) & D) {
-                /* connection down... */
-                j = (y+1)*w + x;
-                assert(i < w*h && j < w*h);
-                dsf_merge(dsf, i, j);
-            }
-            /* NB no need to check up and left because they'll have been checked
-               by the other side. */
-        }
-    }
+    int w = state->p.w, h = state->p.h, x, y, did = 0;
+    int *dsf = sc->loopdsf, startc, endc;
 
+    /* sc->loopdsf already knows the connectedness of the current
+       loop set, because solve_set_eflag keeps it up to date. */
     startc = dsf_canonify(dsf, state->numbers->row_s*w);
     endc = dsf_canonify(dsf, (h-1)*w+state->numbers->col_s);
 
@@ -1396,24 +1460,23 @@ static int solve_check_loop(game_state *state)
     for (x = 0; x < w; x++) {
         for (y = 0; y < h; y++) {
             if (x < (w-1))
-              did += solve_check_loop_sub(state, x, y, R, dsf, startc, endc);
+              did += solve_check_loop_sub(state, sc, x, y, R, dsf, startc, endc);
             if (y < (h-1))
-              did += solve_check_loop_sub(state, x, y, D, dsf, startc, endc);
+              did += solve_check_loop_sub(state, sc, x, y, D, dsf, startc, endc);
         }
     }
 
-    sfree(dsf);
-
     return did;
 }
 
-static void solve_discount_edge(game_state *state, int x, int y, int d)
+static void solve_discount_edge(game_state *state, struct solver_scratch *sc,
+                                int x, int y, int d)
 {
     if (S_E_DIRS(state, x, y, E_TRACK) & d) {
         assert(state->sflags[y*state->p.w + x] & S_CLUE);
         return; /* (only) clue squares can have outer edges set. */
     }
-    solve_set_eflag(state, x, y, d, E_NOTRACK, "outer edge");
+    solve_set_eflag(state, sc, x, y, d, E_NOTRACK, "outer edge");
 }
 
 static int solve_bridge_sub(game_state *state, int x, int y, int d,
@@ -1447,51 +1510,32 @@ static int solve_bridge_sub(game_state *state, int x, int y, int d,
      * middle - but that doesn't matter, because the same parity
      * constraint applies just as well with more than one disjoint
      * loop.
+     *
+     * We don't have to find that component from scratch for each
+     * bridge, because a bridge is an edge of every spanning tree of
+     * the graph, so the component is either the subtree below the
+     * bridge in the spanning forest solve_check_bridge_parity has
+     * built, or the rest of that tree. And the number of times the
+     * track crosses a component's boundary has the same parity as
+     * the total number of TRACK edges around all its squares (since
+     * any track edge within the component is counted twice), which
+     * solve_check_bridge_parity has already added up for each
+     * subtree.
      */
-    int w = state->p.w, h = state->p.h, wh = w*h;
-    int X = x + DX(d), Y = y + DY(d);
-    int xi, yi, di;
+    int w = state->p.w;
+    int i = y*w + x, j = (y + DY(d))*w + (x + DX(d));
+    int child, parity;
 
     assert(d == D || d == R);
 
-    if (!sc->dsf)
-        sc->dsf = snew_dsf(wh);
-    dsf_init(sc->dsf, wh);
+    child = (sc->parent[j] == i ? j : i);
+    assert(sc->parent[child] == i + j - child);
 
-    for (xi = 0; xi < w; xi++) {
-        for (yi = 0; yi < h; yi++) {
-            /* We expect to have been called with X,Y either to the
-             * right of x,y or below it, not the other way round. If
-             * that were not true, the tests in this loop to exclude
-             * the bridge edge would have to be twice as annoying. */
+    parity = sc->parity[child];
+    if (child != i) /* x,y is in the rest of the tree */
+        parity ^= sc->parity[sc->root[child]];
 
-            if (yi+1 < h && !S_E_FLAGS(state, xi, yi, D) &&
-                !(xi == x && yi == y && xi == X && yi+1 == Y))
-                dsf_merge(sc->dsf, yi*w+xi, (yi+1)*w+xi);
-
-            if (xi+1 < w && !S_E_FLAGS(state, xi, yi, R) &&
-                !(xi == x && yi == y && xi+1 == X && yi == Y))
-                dsf_merge(sc->dsf, yi*w+xi, yi*w+(xi+1));
-        }
-    }
-
-    int component = dsf_canonify(sc->dsf, y*w+x);
-    int parity = 0;
-    for (xi = 0; xi < w; xi++) {
-        for (yi = 0; yi < h; yi++) {
-            if (dsf_canonify(sc->dsf, yi*w+xi) != component)
-                continue;
-            for (di = 1; di < 16; di *= 2) {
-                int Xi = xi + DX(di), Yi = yi + DY(di);
-                if ((Xi < 0 || Xi >= w || Yi < 0 || Yi >= h ||
-                     dsf_canonify(sc->dsf, Yi*w+Xi) != component) &&
-                    (S_E_DIRS(state, xi, yi, E_TRACK) & di))
-                    parity ^= 1;
-            }
-        }
-    }
-
-    solve_set_eflag(state, x, y, d, parity ? E_TRACK : E_NOTRACK, "parity");
+    solve_set_eflag(state, sc, x, y, d, parity ? E_TRACK : E_NOTRACK, "parity");
     return 1;
 }
 
@@ -1526,25 +1570,62 @@ static int solve_check_bridge_parity(game_state *state,
                                      struct solver_scratch *sc)
 {
     int w = state->p.w, h = state->p.h, wh = w*h;
-    struct findloopstate *fls;
     struct solve_bridge_neighbour_ctx ctx[1];
-    int x, y, did = 0;
+    int x, y, i, j, v, head, tail, did = 0;
+
+    if (!sc->fls) {
+        sc->fls = findloop_new_state(wh);
+        sc->parent = snewn(wh, int);
+        sc->root = snewn(wh, int);
+        sc->queue = snewn(wh, int);
+        sc->parity = snewn(wh, unsigned char);
+    }
 
     ctx->state = state;
-    fls = findloop_new_state(wh);
-    findloop_run(fls, wh, solve_bridge_neighbour, ctx);
+    findloop_run(sc->fls, wh, solve_bridge_neighbour, ctx);
+
+    /*
+     * Find a breadth-first spanning forest of the same graph, and
+     * for each square, the parity of the number of TRACK edges
+     * around all the squares of the subtree rooted there.
+     */
+    for (i = 0; i < wh; i++)
+        sc->parent[i] = -2;            /* not yet visited */
+    head = tail = 0;
+    for (i = 0; i < wh; i++) {
+        if (sc->parent[i] != -2)
+            continue;
+        sc->parent[i] = -1;
+        sc->root[i] = i;
+        sc->queue[tail++] = i;
+        while (head < tail) {
+            v = sc->queue[head++];
+            sc->parity[v] = S_E_COUNT(state, v % w, v / w, E_TRACK) & 1;
+            for (j = solve_bridge_neighbour(v, ctx); j >= 0;
+                 j = solve_bridge_neighbour(-1, ctx)) {
+                if (sc->parent[j] != -2)
+                    continue;
+                sc->parent[j] = v;
+                sc->root[j] = i;
+                sc->queue[tail++] = j;
+            }
+        }
+    }
+    while (tail-- > 0) {
+        v = sc->queue[tail];
+        if (sc->parent[v] >= 0)
+            sc->parity[sc->parent[v]] ^= sc->parity[v];
+    }
 
     for (x = 0; x < w; x++) {
         for (y = 0; y < h; y++) {
-            if (y+1 < h && !findloop_is_loop_edge(fls, y*w+x, (y+1)*w+x))
+            if (y+1 < h && !findloop_is_loop_edge(sc->fls, y*w+x, (y+1)*w+x))
                 did += solve_bridge_sub(state, x, y, D, sc);
-            if (x+1 < w && !findloop_is_loop_edge(fls, y*w+x, y*w+(x+1)))
+            if (x+1 < w && !findloop_is_loop_edge(sc->fls, y*w+x, y*w+(x+1)))
                 did += solve_bridge_sub(state, x, y, R, sc);
         }
     }
 
-    findloop_free_state(fls);
-
     return did;
 }
 
@@ -1554,48 +1635,83 @@ static int tracks_solve(game_state *state, int diff, int *max_diff_out)
     struct solver_scratch sc[1];
     int max_diff = DIFF_EASY;
 
-    sc->dsf = NULL;
+    sc->w = w;
+    sc->h = h;
+    sc->loopdsf = snew_dsf(w*h);
+    sc->todo = tdq_new(w*h);
+    tdq_fill(sc->todo);
+    sc->linedirty = snewn(w+h, unsigned char);
+    memset(sc->linedirty, DIRTY_ALL, w+h);
+    sc->fls = NULL;
+    sc->parent = sc->root = sc->queue = NULL;
+    sc->parity = NULL;
+
+    /* Work out the connectedness of the track we've been given. */
+    for (x = 0; x < w; x++) {
+        for (y = 0; y < h; y++) {
+            if (x < (w-1) && S_E_DIRS(state, x, y, E_TRACK) & R)
+                dsf_merge(sc->loopdsf, y*w+x, y*w+(x+1));
+            if (y < (h-1) && S_E_DIRS(state, x, y, E_TRACK) & D)
+                dsf_merge(sc->loopdsf, y*w+x, (y+1)*w+x);
+        }
+    }
 
     debug(("solve..."));
     state->impossible = false;
 
     /* Set all the outer border edges as no-track. */
     for (x = 0; x < w; x++) {
-        solve_discount_edge(state, x, 0, U);
-        solve_discount_edge(state, x, h-1, D);
+        solve_discount_edge(state, sc, x, 0, U);
+        solve_discount_edge(state, sc, x, h-1, D);
     }
     for (y = 0; y < h; y++) {
-        solve_discount_edge(state, 0, y, L);
-        solve_discount_edge(state, w-1, y, R);
+        solve_discount_edge(state, sc, 0, y, L);
+        solve_discount_edge(state, sc, w-1, y, R);
     }
 
     while (!state->impossible) {
 
 /* Can't use do ... while (0) because we need a 'continue' in this macro */
-#define TRY(curr_diff, funcall)                         \
+#define TRY(curr_diff, rule, funcall)                   \
         if (diff >= (curr_diff) && (funcall)) {         \
+            SOLVER_RULE(rule);                          \
             if (max_diff < curr_diff)                   \
                 max_diff = curr_diff;                   \
             continue;                                   \
         } else ((void)0)
 
-        TRY(DIFF_EASY, solve_update_flags(state));
-        TRY(DIFF_EASY, solve_count_clues(state));
-        TRY(DIFF_EASY, solve_check_loop(state));
+        SOLVER_TIER("easy: flags, counts and loops");
+        TRY(DIFF_EASY, "square and edge flags",
+            solve_update_flags(state, sc));
+        TRY(DIFF_EASY, "clue count", solve_count_clues(state, sc));
+        TRY(DIFF_EASY, "loop avoidance", solve_check_loop(state, sc));
 
-        TRY(DIFF_TRICKY, solve_check_single(state));
-        TRY(DIFF_TRICKY, solve_check_loose_ends(state));
-        TRY(DIFF_TRICKY, solve_check_neighbours(state, false));
+        SOLVER_TIER("tricky: single tracks and loose ends");
+        TRY(DIFF_TRICKY, "single track in line",
+            solve_check_single(state, sc));
+        TRY(DIFF_TRICKY, "loose ends", solve_check_loose_ends(state, sc));
+        TRY(DIFF_TRICKY, "neighbours",
+            solve_check_neighbours(state, sc, false));
 
-        TRY(DIFF_HARD, solve_check_neighbours(state, true));
-        TRY(DIFF_HARD, solve_check_bridge_parity(state, sc));
+        SOLVER_TIER("hard: neighbours and parity");
+        TRY(DIFF_HARD, "neighbours both ways",
+            solve_check_neighbours(state, sc, true));
+        TRY(DIFF_HARD, "bridge parity", solve_check_bridge_parity(state, sc));
 
 #undef TRY
 
         break;
     }
 
-    sfree(sc->dsf);
+    sfree(sc->loopdsf);
+    tdq_free(sc->todo);
+    sfree(sc->linedirty);
+    if (sc->fls)
+        findloop_free_state(sc->fls);
+    sfree(sc->parent);
+    sfree(sc->root);
+    sfree(sc->queue);
+    sfree(sc->parity);
 
     if (max_diff_out)
         *max_diff_out = max_diff;
@@ -13,6 +13,7 @@
 #include <math.h>
 
 #include "puzzles.h"
+#include "permsolve.h"
 
 #define PREFERRED_TILE_SIZE 48
 #define TILE_SIZE (ds->tilesize)
@@ -536,7 +537,80 @@ static int compare_int(const void *av, const void *bv)
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *aux, const char **error)
 {
-    return dupstr("S");
+    int w = currstate->w, h = currstate->h, n = currstate->n, wh = w*h;
+    int rw = w - n + 1, rh = h - n + 1, nmoves = 2 * rw * rh;
+    int *perm, *twist, *grid, *order, *target, *moves, len, i, m, x, y;
+    permsolver *ps;
+    char *ret, *p;
+
+    /*
+     * Find out what each move does by making it on a grid in which
+     * every square is numbered differently. Moves are numbered by
+     * rotation centre, clockwise before anticlockwise.
+     */
+    perm = snewn(nmoves * wh, int);
+    twist = snewn(nmoves * wh, int);
+    grid = snewn(wh, int);
+    for (m = 0; m < nmoves; m++) {
+        for (i = 0; i < wh; i++)
+            grid[i] = i * 4;
+        do_rotate(grid, w, h, n, currstate->orientable,
+                  (m/2) % rw, (m/2) / rw, m % 2 ? -1 : +1);
+        for (i = 0; i < wh; i++) {
+            perm[m*wh + grid[i] / 4] = i;
+            twist[m*wh + grid[i] / 4] = grid[i] & 3;
+        }
+    }
+
+    /*
+     * Fill in the rows from the top, and then the last few a column
+     * at a time, so that what's left at the end is a compact block.
+     */
+    order = snewn(wh, int);
+    i = 0;
+    for (y = 0; y < h-n; y++)
+        for (x = 0; x < w; x++)
+            order[i++] = y*w + x;
+    for (x = 0; x < w; x++)
+        for (y = max(h-n, 0); y < h; y++)
+            order[i++] = y*w + x;
+
+    target = snewn(wh, int);
+    memcpy(target, currstate->grid, wh * sizeof(int));
+    qsort(target, wh, sizeof(int), compare_int);
+    for (i = 0; i < wh; i++)
+        target[i] &= ~3;
+
+    ps = permsolver_new(wh, nmoves, perm, currstate->orientable ? twist : NULL,
+                        4);
+    len = permsolver_solve(ps, currstate->grid, target, order, &moves);
+    permsolver_free(ps);
+    sfree(perm);
+    sfree(twist);
+    sfree(grid);
+    sfree(order);
+    sfree(target);
+
+    /*
+     * The solver copes with all the presets, but with orientable
+     * 3x3 or larger blocks the orientations left at the end can
+     * need more searching than it allows itself. If it can't find
+     * the moves, fall back to simply replacing the grid with a
+     * solved one (see execute_move).
+     */
+    if (len < 0)
+        return dupstr("S");
+
+    ret = snewn(2 + 40 * len, char);
+    p = ret;
+    *p++ = 'S';
+    for (i = 0; i < len; i++)
+        p += sprintf(p, ";M%d,%d,%d", (moves[i]/2) % rw, (moves[i]/2) / rw,
+                     moves[i] % 2 ? -1 : +1);
+    *p = '\0';
+    sfree(moves);
+
+    return ret;
 }
 
 static bool game_can_format_as_text_now(const game_params *params)
@@ -743,6 +817,14 @@ static game_state *execute_move(const game_state *from, const char *move)
     int w = from->w, h = from->h, n = from->n, wh = w*h;
     int x, y, dir;
 
+    if (move[0] == 'S' && move[1] == ';') {
+        /* A solution from solve_game(), as a sequence of moves. */
+        ret = execute_move_sequence(from, move, execute_move, free_game);
+        if (ret)
+            ret->used_solve = true;
+        return ret;
+    }
+
     if (!strcmp(move, "S")) {
 	int i;
 	ret = dup_game(from);
@@ -50,6 +50,7 @@
 #include <math.h>
 
 #include "puzzles.h"
+#include "bitrow.h"
 
 #ifdef STANDALONE_SOLVER
 bool solver_verbose = false;
@@ -475,12 +476,25 @@ struct unruly_scratch {
     int *ones_cols;
     int *zeros_rows;
     int *zeros_cols;
+
+    /*
+     * The same squares again as bitrows (see bitrow.h): once by rows,
+     * h2 rows of w2 bits each, and once by columns, w2 rows of h2
+     * bits each.
+     */
+    bitword *ones_rowbits;
+    bitword *ones_colbits;
+    bitword *zeros_rowbits;
+    bitword *zeros_colbits;
+
+    bitword *targets;          /* working space, one row of w2 bits */
 };
 
 static void unruly_solver_update_remaining(const game_state *state,
                                            struct unruly_scratch *scratch)
 {
     int w2 = state->w2, h2 = state->h2;
+    int rw = bitrow_words(w2), cw = bitrow_words(h2);
     int x, y;
 
     /* Reset all scratch data */
@@ -488,15 +502,23 @@ static void unruly_solver_update_remaining(const game_state *state,
     memset(scratch->ones_cols, 0, w2 * sizeof(int));
     memset(scratch->zeros_rows, 0, h2 * sizeof(int));
     memset(scratch->zeros_cols, 0, w2 * sizeof(int));
+    bitrow_zero(scratch->ones_rowbits, h2, w2);
+    bitrow_zero(scratch->ones_colbits, w2, h2);
+    bitrow_zero(scratch->zeros_rowbits, h2, w2);
+    bitrow_zero(scratch->zeros_colbits, w2, h2);
 
     for (x = 0; x < w2; x++)
         for (y = 0; y < h2; y++) {
             if (state->grid[y * w2 + x] == N_ONE) {
                 scratch->ones_rows[y]++;
                 scratch->ones_cols[x]++;
+                bitrow_set(scratch->ones_rowbits + y * rw, x);
+                bitrow_set(scratch->ones_colbits + x * cw, y);
             } else if (state->grid[y * w2 + x] == N_ZERO) {
                 scratch->zeros_rows[y]++;
                 scratch->zeros_cols[x]++;
+                bitrow_set(scratch->zeros_rowbits + y * rw, x);
+                bitrow_set(scratch->zeros_colbits + x * cw, y);
             }
         }
 }
@@ -511,6 +533,11 @@ static struct unruly_scratch *unruly_new_scratch(const game_state *state)
     ret->ones_cols = snewn(w2, int);
     ret->zeros_rows = snewn(h2, int);
     ret->zeros_cols = snewn(w2, int);
+    ret->ones_rowbits = bitrow_new(h2, w2);
+    ret->ones_colbits = bitrow_new(w2, h2);
+    ret->zeros_rowbits = bitrow_new(h2, w2);
+    ret->zeros_colbits = bitrow_new(w2, h2);
+    ret->targets = bitrow_new(1, w2);
 
     unruly_solver_update_remaining(state, ret);
 
@@ -523,75 +550,109 @@ static void unruly_free_scratch(struct unruly_scratch *scratch)
     sfree(scratch->ones_cols);
     sfree(scratch->zeros_rows);
     sfree(scratch->zeros_cols);
+    sfree(scratch->ones_rowbits);
+    sfree(scratch->ones_colbits);
+    sfree(scratch->zeros_rowbits);
+    sfree(scratch->zeros_colbits);
+    sfree(scratch->targets);
 
     sfree(scratch);
 }
 
-static int unruly_solver_check_threes(game_state *state, int *rowcount,
-                                      int *colcount, bool horizontal,
-                                      char check, char block)
+/* Fill in an empty square, keeping the scratch data up to date. */
+static void unruly_solver_place(game_state *state,
+                                struct unruly_scratch *scratch,
+                                int i, char c)
 {
     int w2 = state->w2, h2 = state->h2;
+    int x = i % w2, y = i / w2;
+
+    assert(state->grid[i] == EMPTY);
+    state->grid[i] = c;
+    if (c == N_ONE) {
+        scratch->ones_rows[y]++;
+        scratch->ones_cols[x]++;
+        bitrow_set(scratch->ones_rowbits + y * bitrow_words(w2), x);
+        bitrow_set(scratch->ones_colbits + x * bitrow_words(h2), y);
+    } else {
+        scratch->zeros_rows[y]++;
+        scratch->zeros_cols[x]++;
+        bitrow_set(scratch->zeros_rowbits + y * bitrow_words(w2), x);
+        bitrow_set(scratch->zeros_colbits + x * bitrow_words(h2), y);
+    }
+}
 
-    int dx = horizontal ? 1 : 0, dy = 1 - dx;
-    int sx = dx, sy = dy;
-    int ex = w2 - dx, ey = h2 - dy;
+static int unruly_solver_check_threes(game_state *state,
+                                      struct unruly_scratch *scratch,
+                                      bool horizontal,
+                                      char check, char block)
+{
+    int w2 = state->w2, h2 = state->h2;
+    int rw = bitrow_words(w2);
+    const bitword *checkbits = (check == N_ONE ? scratch->ones_rowbits :
+                                scratch->zeros_rowbits);
+    const bitword *blockbits = (block == N_ONE ? scratch->ones_rowbits :
+                                scratch->zeros_rowbits);
+    bitword *targets = scratch->targets;
 
-    int x, y;
+    int x, y, i;
     int ret = 0;
 
-    /* Check for any three squares which almost form three in a row */
-    for (y = sy; y < ey; y++) {
-        for (x = sx; x < ex; x++) {
-            int i1 = (y-dy) * w2 + (x-dx);
-            int i2 = y * w2 + x;
-            int i3 = (y+dy) * w2 + (x+dx);
+    /*
+     * Check for any three squares which almost form three in a row,
+     * a whole row of the grid at a time. Filling in 'block' can't
+     * make or break any other such line, since those only depend on
+     * squares holding 'check' and on the empty square to be filled.
+     * So we can find all of a row's targets before filling any.
+     */
+    for (y = 0; y < h2; y++) {
+        const bitword *checkrow = checkbits + y * rw;
+        const bitword *blockrow = blockbits + y * rw;
 
-            if (state->grid[i1] == check && state->grid[i2] == check
-                && state->grid[i3] == EMPTY) {
-                ret++;
-#ifdef STANDALONE_SOLVER
-                if (solver_verbose) {
-                    printf("Solver: %i,%i and %i,%i confirm %c at %i,%i\n",
-                           i1 % w2, i1 / w2, i2 % w2, i2 / w2,
-                           (block == N_ONE ? '1' : '0'), i3 % w2,
-                           i3 / w2);
-                }
-#endif
-                state->grid[i3] = block;
-                rowcount[i3 / w2]++;
-                colcount[i3 % w2]++;
-            }
-            if (state->grid[i1] == check && state->grid[i2] == EMPTY
-                && state->grid[i3] == check) {
-                ret++;
+        if (horizontal) {
+            bitrow_threes(targets, checkrow, w2);
+        } else {
+            const bitword *across[4];
+            across[0] = (y >= 2 ? checkrow - 2 * rw : NULL);
+            across[1] = (y >= 1 ? checkrow - rw : NULL);
+            across[2] = (y+1 < h2 ? checkrow + rw : NULL);
+            across[3] = (y+2 < h2 ? checkrow + 2 * rw : NULL);
+            bitrow_threes_across(targets, across, w2);
+        }
+        for (i = 0; i < rw; i++)
+            targets[i] &= ~(checkrow[i] | blockrow[i]);
+
+        for (x = bitrow_next(targets, w2, 0); x >= 0;
+             x = bitrow_next(targets, w2, x+1)) {
+            int i3 = y * w2 + x;
+            ret++;
 #ifdef STANDALONE_SOLVER
-                if (solver_verbose) {
-                    printf("Solver: %i,%i and %i,%i confirm %c at %i,%i\n",
-                           i1 % w2, i1 / w2, i3 % w2, i3 / w2,
-                           (block == N_ONE ? '1' : '0'), i2 % w2,
-                           i2 / w2);
+            if (solver_verbose) {
+                int d = (horizontal ? 1 : w2);
+                int p = (horizontal ? x : y), len = (horizontal ? w2 : h2);
+                int i1, i2;
+
+                /* Report the first pair the target could be found from */
+                if (p >= 2 && state->grid[i3 - 2*d] == check
+                    && state->grid[i3 - d] == check) {
+                    i1 = i3 - 2*d;
+                    i2 = i3 - d;
+                } else if (p >= 1 && p+1 < len
+                           && state->grid[i3 - d] == check
+                           && state->grid[i3 + d] == check) {
+                    i1 = i3 - d;
+                    i2 = i3 + d;
+                } else {
+                    i1 = i3 + d;
+                    i2 = i3 + 2*d;
                 }
-#endif
-                state->grid[i2] = block;
-                rowcount[i2 / w2]++;
-                colcount[i2 % w2]++;
+                printf("Solver: %i,%i and %i,%i confirm %c at %i,%i\n",
+                       i1 % w2, i1 / w2, i2 % w2, i2 / w2,
+                       (block == N_ONE ? '1' : '0'), i3 % w2,
+                       i3 / w2);
             }
-            if (state->grid[i1] == EMPTY && state->grid[i2] == check
-                && state->grid[i3] == check) {
-                ret++;
-#ifdef STANDALONE_SOLVER
-                if (solver_verbose) {
-                    printf("Solver: %i,%i and %i,%i confirm %c at %i,%i\n",
-                           i2 % w2, i2 / w2, i3 % w2, i3 / w2,
-                           (block == N_ONE ? '1' : '0'), i1 % w2,
-                           i1 / w2);
-                }
 #endif
-                state->grid[i1] = block;
-                rowcount[i1 / w2]++;
-                colcount[i1 % w2]++;
-            }
+            unruly_solver_place(state, scratch, i3, block);
         }
     }
 
@@ -603,19 +664,10 @@ static int unruly_solver_check_all_threes(game_state *state,
 {
     int ret = 0;
 
-    ret +=
-        unruly_solver_check_threes(state, scratch->zeros_rows,
-                                   scratch->zeros_cols, true, N_ONE, N_ZERO);
-    ret +=
-        unruly_solver_check_threes(state, scratch->ones_rows,
-                                   scratch->ones_cols, true, N_ZERO, N_ONE);
-    ret +=
-        unruly_solver_check_threes(state, scratch->zeros_rows,
-                                   scratch->zeros_cols, false, N_ONE,
-                                   N_ZERO);
-    ret +=
-        unruly_solver_check_threes(state, scratch->ones_rows,
-                                   scratch->ones_cols, false, N_ZERO, N_ONE);
+    ret += unruly_solver_check_threes(state, scratch, true, N_ONE, N_ZERO);
+    ret += unruly_solver_check_threes(state, scratch, true, N_ZERO, N_ONE);
+    ret += unruly_solver_check_threes(state, scratch, false, N_ONE, N_ZERO);
+    ret += unruly_solver_check_threes(state, scratch, false, N_ZERO, N_ONE);
 
     return ret;
 }
@@ -631,8 +683,13 @@ static int unruly_solver_check_uniques(game_state *state, int *rowcount,
     int nr = (horizontal ? h2 : w2);
     int nc = (horizontal ? w2 : h2);
     int max = nc / 2;
+    int nw = bitrow_words(nc);
+    const bitword *checkbits =
+        (check == N_ONE ?
+         (horizontal ? scratch->ones_rowbits : scratch->ones_colbits) :
+         (horizontal ? scratch->zeros_rowbits : scratch->zeros_colbits));
 
-    int r, r2, c;
+    int r, r2;
     int ret = 0;
 
     /*
@@ -642,23 +699,19 @@ static int unruly_solver_check_uniques(game_state *state, int *rowcount,
      * that it's different.
      */
     for (r = 0; r < nr; r++) {
+        const bitword *row = checkbits + r * nw;
         if (rowcount[r] != max)
             continue;
         for (r2 = 0; r2 < nr; r2++) {
-            int nmatch = 0, nonmatch = -1;
+            const bitword *row2 = checkbits + r2 * nw;
+            int nonmatch;
             if (rowcount[r2] != max-1)
                 continue;
-            for (c = 0; c < nc; c++) {
-                if (state->grid[r*rmult + c*cmult] == check) {
-                    if (state->grid[r2*rmult + c*cmult] == check)
-                        nmatch++;
-                    else
-                        nonmatch = c;
-                }
-            }
-            if (nmatch == max-1) {
-                int i1 = r2 * rmult + nonmatch * cmult;
+            if (bitrow_count_and(row, row2, nc) == max-1) {
+                int i1;
+                nonmatch = bitrow_highest_andnot(row, row2, nc);
                 assert(nonmatch != -1);
+                i1 = r2 * rmult + nonmatch * cmult;
                 if (state->grid[i1] == block)
                     continue;
                 assert(state->grid[i1] == EMPTY);
@@ -670,14 +723,7 @@ static int unruly_solver_check_uniques(game_state *state, int *rowcount,
                            i1 / w2);
                 }
 #endif
-                state->grid[i1] = block;
-                if (block == N_ONE) {
-                    scratch->ones_rows[i1 / w2]++;
-                    scratch->ones_cols[i1 % w2]++;
-                } else {
-                    scratch->zeros_rows[i1 / w2]++;
-                    scratch->zeros_cols[i1 % w2]++;
-                }
+                unruly_solver_place(state, scratch, i1, block);
                 ret++;
             }
         }
@@ -703,7 +749,7 @@ static int unruly_solver_check_all_uniques(game_state *state,
 }
 
 static int unruly_solver_fill_row(game_state *state, int i, bool horizontal,
-                                  int *rowcount, int *colcount, char fill)
+                                  struct unruly_scratch *scratch, char fill)
 {
     int ret = 0;
     int w2 = state->w2, h2 = state->h2;
@@ -728,9 +774,7 @@ static int unruly_solver_fill_row(game_state *state, int i, bool horizontal,
             }
 #endif
             ret++;
-            state->grid[p] = fill;
-            rowcount[(horizontal ? i : j)]++;
-            colcount[(horizontal ? j : i)]++;
+            unruly_solver_place(state, scratch, p, fill);
         }
     }
 
@@ -746,7 +790,8 @@ static int unruly_solver_fill_row(game_state *state, int i, bool horizontal,
 static int unruly_solver_check_complete_nums(game_state *state,
                                              int *complete, bool horizontal,
                                              int *rowcount, int *colcount,
-                                             char fill)
+                                             char fill,
+                                             struct unruly_scratch *scratch)
 {
     int w2 = state->w2, h2 = state->h2;
     int count = (horizontal ? h2 : w2); /* number of rows to check */
@@ -765,8 +810,8 @@ static int unruly_solver_check_complete_nums(game_state *state,
                        (fill != N_ZERO ? '0' : '1'));
             }
 #endif
-            ret += unruly_solver_fill_row(state, i, horizontal, rowcount,
-                                          colcount, fill);
+            ret += unruly_solver_fill_row(state, i, horizontal, scratch,
+                                          fill);
         }
     }
 
@@ -781,19 +826,19 @@ static int unruly_solver_check_all_complete_nums(game_state *state,
     ret +=
         unruly_solver_check_complete_nums(state, scratch->ones_rows, true,
                                           scratch->zeros_rows,
-                                          scratch->zeros_cols, N_ZERO);
+                                          scratch->zeros_cols, N_ZERO, scratch);
     ret +=
         unruly_solver_check_complete_nums(state, scratch->ones_cols, false,
                                           scratch->zeros_rows,
-                                          scratch->zeros_cols, N_ZERO);
+                                          scratch->zeros_cols, N_ZERO, scratch);
     ret +=
         unruly_solver_check_complete_nums(state, scratch->zeros_rows, true,
                                           scratch->ones_rows,
-                                          scratch->ones_cols, N_ONE);
+                                          scratch->ones_cols, N_ONE, scratch);
     ret +=
         unruly_solver_check_complete_nums(state, scratch->zeros_cols, false,
                                           scratch->ones_rows,
-                                          scratch->ones_cols, N_ONE);
+                                          scratch->ones_cols, N_ONE, scratch);
 
     return ret;
 }
@@ -801,7 +846,8 @@ static int unruly_solver_check_all_complete_nums(game_state *state,
 static int unruly_solver_check_near_complete(game_state *state,
                                              int *complete, bool horizontal,
                                              int *rowcount, int *colcount,
-                                             char fill)
+                                             char fill,
+                                             struct unruly_scratch *scratch)
 {
     int w2 = state->w2, h2 = state->h2;
     int w = w2/2, h = h2/2;
@@ -862,8 +908,8 @@ static int unruly_solver_check_near_complete(game_state *state,
                 }
 #endif
                 ret +=
-                    unruly_solver_fill_row(state, i, horizontal, rowcount,
-                                         colcount, fill);
+                    unruly_solver_fill_row(state, i, horizontal, scratch,
+                                           fill);
 
                 state->grid[i2] = EMPTY;
                 state->grid[i3] = EMPTY;
@@ -881,8 +927,8 @@ static int unruly_solver_check_near_complete(game_state *state,
                 }
 #endif
                 ret +=
-                    unruly_solver_fill_row(state, i, horizontal, rowcount,
-                                         colcount, fill);
+                    unruly_solver_fill_row(state, i, horizontal, scratch,
+                                           fill);
 
                 state->grid[i1] = EMPTY;
                 state->grid[i3] = EMPTY;
@@ -900,8 +946,8 @@ static int unruly_solver_check_near_complete(game_state *state,
                 }
 #endif
                 ret +=
-                    unruly_solver_fill_row(state, i, horizontal, rowcount,
-                                         colcount, fill);
+                    unruly_solver_fill_row(state, i, horizontal, scratch,
+                                           fill);
 
                 state->grid[i1] = EMPTY;
                 state->grid[i2] = EMPTY;
@@ -920,8 +966,8 @@ static int unruly_solver_check_near_complete(game_state *state,
                 }
 #endif
                 ret +=
-                    unruly_solver_fill_row(state, i, horizontal, rowcount,
-                                         colcount, fill);
+                    unruly_solver_fill_row(state, i, horizontal, scratch,
+                                           fill);
 
                 state->grid[i1] = EMPTY;
                 state->grid[i2] = EMPTY;
@@ -941,19 +987,19 @@ static int unruly_solver_check_all_near_complete(game_state *state,
     ret +=
         unruly_solver_check_near_complete(state, scratch->ones_rows, true,
                                         scratch->zeros_rows,
-                                        scratch->zeros_cols, N_ZERO);
+                                        scratch->zeros_cols, N_ZERO, scratch);
     ret +=
         unruly_solver_check_near_complete(state, scratch->ones_cols, false,
                                         scratch->zeros_rows,
-                                        scratch->zeros_cols, N_ZERO);
+                                        scratch->zeros_cols, N_ZERO, scratch);
     ret +=
         unruly_solver_check_near_complete(state, scratch->zeros_rows, true,
                                         scratch->ones_rows,
-                                        scratch->ones_cols, N_ONE);
+                                        scratch->ones_cols, N_ONE, scratch);
     ret +=
         unruly_solver_check_near_complete(state, scratch->zeros_cols, false,
                                         scratch->ones_rows,
-                                        scratch->ones_cols, N_ONE);
+                                        scratch->ones_cols, N_ONE, scratch);
 
     return ret;
 }
@@ -1258,15 +1304,8 @@ static bool unruly_fill_game(game_state *state, struct unruly_scratch *scratch,
         if (state->grid[i] != EMPTY)
             continue;
 
-        if (random_upto(rs, 2)) {
-            state->grid[i] = N_ONE;
-            scratch->ones_rows[i / w2]++;
-            scratch->ones_cols[i % w2]++;
-        } else {
-            state->grid[i] = N_ZERO;
-            scratch->zeros_rows[i / w2]++;
-            scratch->zeros_cols[i % w2]++;
-        }
+        unruly_solver_place(state, scratch, i,
+                            random_upto(rs, 2) ? N_ONE : N_ZERO);
 
         unruly_solve_game(state, scratch, DIFFCOUNT);
     }
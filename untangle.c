@@ -85,16 +85,32 @@ struct game_params {
 struct graph {
     int refcount;		       /* for deallocation */
     tree234 *edges;		       /* stores `edge' structures */
+
+    /*
+     * Edges incident on point i are incident[incstart[i]] up to
+     * incident[incstart[i+1]-1], as indices into the edges tree.
+     */
+    int *incstart, *incident;
+
+    /*
+     * Spatial index of the edges, for updating the crossing counts
+     * incrementally when points move. It's shared between all the
+     * game states using this graph, so it records the serial number
+     * of the state whose point positions it currently describes; a
+     * move made from any other state has to rebuild it first.
+     */
+    struct segindex *index;
+    unsigned long index_serial, last_serial;
 };
 
 struct game_state {
     game_params params;
     int w, h;			       /* extent of coordinate system only */
     point *pts;
-#ifdef SHOW_CROSSINGS
-    int *crosses;		       /* mark edges which are crossed */
-#endif
+    int *crosses;		       /* count crossings on each edge */
+    int ncrossings;		       /* total number of crossing pairs */
     struct graph *graph;
+    unsigned long serial;	       /* identifies this set of positions */
     bool completed, cheated, just_solved;
 };
 
@@ -408,6 +424,168 @@ static unsigned long squarert(unsigned long n) {
 #define MAXDEGREE 4
 #define COORDLIMIT(n) squarert((n) * POINTDENSITY)
 
+/*
+ * A uniform-grid spatial index over line segments, so that we can
+ * find the segments which might cross a given one without testing
+ * against every segment in the graph.
+ *
+ * The coordinate square [0,w) is divided into nb x nb buckets, and
+ * each segment is listed in every bucket overlapped by its bounding
+ * box. Coordinates are rounded down to integers before bucketing,
+ * and anything outside the square is clamped to the edge buckets;
+ * both of those maps are monotonic, so two segments which intersect
+ * at all are guaranteed to share at least the bucket containing the
+ * point of intersection.
+ */
+struct bucket {
+    int n, size;
+    int *ids;
+};
+
+struct segindex {
+    int nb;                            /* buckets per side */
+    long bw;                           /* width of a bucket */
+    struct bucket *buckets;
+    int nsegs;
+    int *range;          /* per segment: x0,y0,x1,y1 bucket range, or -1 */
+    int *stamp, query;                 /* for de-duplicating queries */
+};
+
+static struct segindex *segindex_new(int nsegs, long w)
+{
+    struct segindex *si = snew(struct segindex);
+    int i;
+
+    si->nb = max(1, (int)squarert(nsegs));
+    si->bw = max(1, (w + si->nb - 1) / si->nb);
+    si->nb = (w + si->bw - 1) / si->bw;
+    si->nb = max(si->nb, 1);
+    si->buckets = snewn(si->nb * si->nb, struct bucket);
+    for (i = 0; i < si->nb * si->nb; i++) {
+        si->buckets[i].n = si->buckets[i].size = 0;
+        si->buckets[i].ids = NULL;
+    }
+    si->nsegs = nsegs;
+    si->range = snewn(4 * nsegs, int);
+    si->stamp = snewn(nsegs, int);
+    for (i = 0; i < nsegs; i++) {
+        si->range[4*i] = -1;
+        si->stamp[i] = 0;
+    }
+    si->query = 0;
+
+    return si;
+}
+
+static void segindex_free(struct segindex *si)
+{
+    int i;
+
+    for (i = 0; i < si->nb * si->nb; i++)
+        sfree(si->buckets[i].ids);
+    sfree(si->buckets);
+    sfree(si->range);
+    sfree(si->stamp);
+    sfree(si);
+}
+
+static int segindex_bucket(const struct segindex *si, long x, long d)
+{
+    long v = (x >= 0 ? x / d : -((d - 1 - x) / d)) / si->bw;
+    return v < 0 ? 0 : v >= si->nb ? si->nb - 1 : (int)v;
+}
+
+static void segindex_range(const struct segindex *si, point a, point b,
+                           int *r)
+{
+    int ax = segindex_bucket(si, a.x, a.d), ay = segindex_bucket(si, a.y, a.d);
+    int bx = segindex_bucket(si, b.x, b.d), by = segindex_bucket(si, b.y, b.d);
+
+    r[0] = min(ax, bx);
+    r[1] = min(ay, by);
+    r[2] = max(ax, bx);
+    r[3] = max(ay, by);
+}
+
+static void segindex_add(struct segindex *si, int id, point a, point b)
+{
+    int *r = si->range + 4*id;
+    int x, y;
+
+    assert(r[0] < 0);
+    segindex_range(si, a, b, r);
+    for (y = r[1]; y <= r[3]; y++)
+        for (x = r[0]; x <= r[2]; x++) {
+            struct bucket *bk = &si->buckets[y * si->nb + x];
+            if (bk->n >= bk->size) {
+                bk->size = bk->n * 5 / 4 + 4;
+                bk->ids = sresize(bk->ids, bk->size, int);
+            }
+            bk->ids[bk->n++] = id;
+        }
+}
+
+static void segindex_remove(struct segindex *si, int id)
+{
+    int *r = si->range + 4*id;
+    int x, y, i;
+
+    if (r[0] < 0)
+        return;
+    for (y = r[1]; y <= r[3]; y++)
+        for (x = r[0]; x <= r[2]; x++) {
+            struct bucket *bk = &si->buckets[y * si->nb + x];
+            for (i = 0; i < bk->n; i++)
+                if (bk->ids[i] == id) {
+                    bk->ids[i] = bk->ids[--bk->n];
+                    break;
+                }
+        }
+    r[0] = -1;
+}
+
+static void segindex_clear(struct segindex *si)
+{
+    int i;
+
+    for (i = 0; i < si->nb * si->nb; i++)
+        si->buckets[i].n = 0;
+    for (i = 0; i < si->nsegs; i++)
+        si->range[4*i] = -1;
+}
+
+/*
+ * Write into 'out' the ids of every segment in the index which might
+ * intersect the segment a-b, each listed once, and return how many
+ * there were. 'out' must have room for every segment in the index.
+ */
+static int segindex_query(struct segindex *si, point a, point b, int *out)
+{
+    int r[4], x, y, i, n = 0;
+
+    if (++si->query == 0) {
+        /* Counter wrapped round; start the stamps again. */
+        for (i = 0; i < si->nsegs; i++)
+            si->stamp[i] = 0;
+        si->query = 1;
+    }
+
+    segindex_range(si, a, b, r);
+    for (y = r[1]; y <= r[3]; y++)
+        for (x = r[0]; x <= r[2]; x++) {
+            struct bucket *bk = &si->buckets[y * si->nb + x];
+            for (i = 0; i < bk->n; i++) {
+                int id = bk->ids[i];
+                if (si->stamp[id] != si->query) {
+                    si->stamp[id] = si->query;
+                    out[n++] = id;
+                }
+            }
+        }
+
+    return n;
+}
+
 static void addedge(tree234 *edges, int a, int b)
 {
     edge *e = snew(edge);
@@ -496,8 +674,10 @@ static char *new_game_desc(const game_params *params, random_state *rs,
     point *pts, *pts2;
     long *tmp;
     tree234 *edges, *vertices;
-    edge *e, *e2;
+    edge *e, *e2, *elist;
     vertex *v, *vs, *vlist;
+    struct segindex *ptindex, *eindex;
+    int nedges, maxedges, nc, c, *cands;
     char *ret;
 
     w = h = COORDLIMIT(n);
@@ -528,7 +708,19 @@ static char *new_game_desc(const game_params *params, random_state *rs,
      *  (a) does not increase any vertex's degree beyond MAXDEGREE
      *  (b) does not cross any existing edges
      *  (c) does not intersect any actual point.
+     *
+     * To check (b) and (c) quickly, we keep spatial indices of the
+     * edges added so far and of the points themselves (as
+     * zero-length segments).
      */
+    maxedges = n * MAXDEGREE / 2;
+    elist = snewn(maxedges, edge);
+    nedges = 0;
+    cands = snewn(max(n, maxedges), int);
+    eindex = segindex_new(maxedges, w);
+    ptindex = segindex_new(n, w);
+    for (i = 0; i < n; i++)
+        segindex_add(ptindex, i, pts[i], pts[i]);
     vs = snewn(n, vertex);
     vertices = newtree234(vertcmp);
     for (i = 0; i < n; i++) {
@@ -583,18 +775,24 @@ static char *new_game_desc(const game_params *params, random_state *rs,
 		 * Check to see whether this edge intersects any
 		 * existing edge or point.
 		 */
-		for (p = 0; p < n; p++)
+		nc = segindex_query(ptindex, pts[ki], pts[j], cands);
+		for (c = 0; c < nc; c++) {
+		    p = cands[c];
 		    if (p != ki && p != j && cross(pts[ki], pts[j],
 						   pts[p], pts[p]))
 			break;
-		if (p < n)
+		}
+		if (c < nc)
 		    continue;
-		for (p = 0; (e = index234(edges, p)) != NULL; p++)
+		nc = segindex_query(eindex, pts[ki], pts[j], cands);
+		for (c = 0; c < nc; c++) {
+		    e = &elist[cands[c]];
 		    if (e->a != ki && e->a != j &&
 			e->b != ki && e->b != j &&
 			cross(pts[ki], pts[j], pts[e->a], pts[e->b]))
 			break;
-		if (e)
+		}
+		if (c < nc)
 		    continue;
 
 		/*
@@ -602,6 +800,11 @@ static char *new_game_desc(const game_params *params, random_state *rs,
 		 * the two vertices involved, and break.
 		 */
 		addedge(edges, j, ki);
+		assert(nedges < maxedges);
+		elist[nedges].a = min(j, ki);
+		elist[nedges].b = max(j, ki);
+		segindex_add(eindex, nedges, pts[j], pts[ki]);
+		nedges++;
 		added = true;
 		del234(vertices, vs+j);
 		vs[j].param++;
@@ -619,6 +822,10 @@ static char *new_game_desc(const game_params *params, random_state *rs,
 	if (!added)
 	    break;		       /* we're done. */
     }
+    segindex_free(eindex);
+    segindex_free(ptindex);
+    sfree(cands);
+    sfree(elist);
 
     /*
      * That's our graph. Now shuffle the points, making sure that
@@ -757,49 +964,158 @@ static const char *validate_desc(const game_params *params, const char *desc)
     return NULL;
 }
 
+static void graph_rebuild_index(struct graph *graph, const game_state *state)
+{
+    edge *e;
+    int i;
+
+    segindex_clear(graph->index);
+    for (i = 0; (e = index234(graph->edges, i)) != NULL; i++)
+        segindex_add(graph->index, i, state->pts[e->a], state->pts[e->b]);
+    graph->index_serial = state->serial;
+}
+
+/*
+ * Count from scratch the edge crossings in a state, using the
+ * spatial index to avoid looking at pairs of edges which can't
+ * possibly cross.
+ */
 static void mark_crossings(game_state *state)
 {
-    bool ok = true;
-    int i, j;
+    struct graph *graph = state->graph;
+    int nedges = count234(graph->edges);
+    int *cands = snewn(nedges, int);
+    int i, j, nc;
     edge *e, *e2;
 
-#ifdef SHOW_CROSSINGS
-    for (i = 0; (e = index234(state->graph->edges, i)) != NULL; i++)
-	state->crosses[i] = false;
-#endif
+    graph_rebuild_index(graph, state);
 
-    /*
-     * Check correctness: for every pair of edges, see whether they
-     * cross.
-     */
-    for (i = 0; (e = index234(state->graph->edges, i)) != NULL; i++) {
-	for (j = i+1; (e2 = index234(state->graph->edges, j)) != NULL; j++) {
+    for (i = 0; i < nedges; i++)
+	state->crosses[i] = 0;
+    state->ncrossings = 0;
+
+    for (i = 0; (e = index234(graph->edges, i)) != NULL; i++) {
+        nc = segindex_query(graph->index, state->pts[e->a], state->pts[e->b],
+                            cands);
+	for (j = 0; j < nc; j++) {
+            if (cands[j] <= i)
+                continue;              /* count each pair only once */
+            e2 = index234(graph->edges, cands[j]);
 	    if (e2->a == e->a || e2->a == e->b ||
 		e2->b == e->a || e2->b == e->b)
 		continue;
 	    if (cross(state->pts[e2->a], state->pts[e2->b],
 		      state->pts[e->a], state->pts[e->b])) {
-		ok = false;
-#ifdef SHOW_CROSSINGS
-		state->crosses[i] = state->crosses[j] = true;
-#else
-		goto done;	       /* multi-level break - sorry */
-#endif
+                state->crosses[i]++;
+                state->crosses[cands[j]]++;
+                state->ncrossings++;
 	    }
 	}
     }
 
-    /*
-     * e == NULL if we've gone through all the edge pairs
-     * without finding a crossing.
-     */
-#ifndef SHOW_CROSSINGS
-    done:
-#endif
-    if (ok)
+    sfree(cands);
+
+    if (state->ncrossings == 0)
 	state->completed = true;
 }
 
+/*
+ * Count the crossings in which the marked edges take part, given the
+ * point positions in 'pts', and add 'delta' times each one to the
+ * crossing counts in 'state'. The graph's spatial index must already
+ * describe the positions in 'pts'.
+ */
+static void count_crossings(game_state *state, const point *pts,
+                            const bool *touched, const int *tlist, int nt,
+                            int *cands, int delta)
+{
+    struct graph *graph = state->graph;
+    int i, j, nc;
+    edge *e, *e2;
+
+    for (i = 0; i < nt; i++) {
+        e = index234(graph->edges, tlist[i]);
+        nc = segindex_query(graph->index, pts[e->a], pts[e->b], cands);
+        for (j = 0; j < nc; j++) {
+            /*
+             * A crossing between two touched edges will be found from
+             * both ends; count it only from the lower-numbered one.
+             */
+            if (touched[cands[j]] && cands[j] <= tlist[i])
+                continue;
+            e2 = index234(graph->edges, cands[j]);
+	    if (e2->a == e->a || e2->a == e->b ||
+		e2->b == e->a || e2->b == e->b)
+		continue;
+            if (cross(pts[e2->a], pts[e2->b], pts[e->a], pts[e->b])) {
+                state->crosses[tlist[i]] += delta;
+                state->crosses[cands[j]] += delta;
+                state->ncrossings += delta;
+            }
+        }
+    }
+}
+
+/*
+ * Bring the crossing counts in 'state' (copied from 'oldstate')
+ * up to date after some of its points have moved. Only the edges
+ * incident on a moved point can have changed their crossings, so we
+ * subtract all of those edges' crossings at the old positions, move
+ * them in the spatial index, and add back their crossings at the new
+ * positions.
+ */
+static void update_crossings(const game_state *oldstate, game_state *state)
+{
+    struct graph *graph = state->graph;
+    int n = state->params.n, nedges = count234(graph->edges);
+    bool *touched = snewn(nedges, bool);
+    int *tlist = snewn(nedges, int), *cands = snewn(nedges, int);
+    int i, k, nt = 0;
+    edge *e;
+
+    for (i = 0; i < nedges; i++)
+        touched[i] = false;
+    for (i = 0; i < n; i++) {
+        if (oldstate->pts[i].x == state->pts[i].x &&
+            oldstate->pts[i].y == state->pts[i].y &&
+            oldstate->pts[i].d == state->pts[i].d)
+            continue;
+        for (k = graph->incstart[i]; k < graph->incstart[i+1]; k++)
+            if (!touched[graph->incident[k]]) {
+                touched[graph->incident[k]] = true;
+                tlist[nt++] = graph->incident[k];
+            }
+    }
+
+    if (nt > nedges / 2) {
+        /*
+         * Most of the graph has moved (e.g. a Solve move), so it's
+         * no slower to start again.
+         */
+        mark_crossings(state);
+    } else if (nt > 0) {
+        if (graph->index_serial != oldstate->serial)
+            graph_rebuild_index(graph, oldstate);
+        count_crossings(state, oldstate->pts, touched, tlist, nt, cands, -1);
+
+        for (i = 0; i < nt; i++) {
+            e = index234(graph->edges, tlist[i]);
+            segindex_remove(graph->index, tlist[i]);
+            segindex_add(graph->index, tlist[i],
+                         state->pts[e->a], state->pts[e->b]);
+        }
+        graph->index_serial = state->serial;
+        count_crossings(state, state->pts, touched, tlist, nt, cands, +1);
+
+        if (state->ncrossings == 0)
+            state->completed = true;
+    }
+
+    sfree(touched);
+    sfree(tlist);
+    sfree(cands);
+}
+
 static game_state *new_game(midend *me, const game_params *params,
                             const char *desc)
 {
@@ -814,6 +1130,7 @@ static game_state *new_game(midend *me, const game_params *params,
     state->graph = snew(struct graph);
     state->graph->refcount = 1;
     state->graph->edges = newtree234(edgecmp);
+    state->graph->last_serial = state->serial = 1;
     state->completed = state->cheated = state->just_solved = false;
 
     while (*desc) {
@@ -832,10 +1149,37 @@ static game_state *new_game(midend *me, const game_params *params,
 	addedge(state->graph->edges, a, b);
     }
 
-#ifdef SHOW_CROSSINGS
+    /*
+     * Now the edge set is fixed, build the incidence lists.
+     */
+    {
+        struct graph *graph = state->graph;
+        int nedges = count234(graph->edges), i, *pos;
+        edge *e;
+
+        graph->incstart = snewn(n+1, int);
+        graph->incident = snewn(2*nedges, int);
+        for (i = 0; i <= n; i++)
+            graph->incstart[i] = 0;
+        for (i = 0; (e = index234(graph->edges, i)) != NULL; i++) {
+            graph->incstart[e->a+1]++;
+            graph->incstart[e->b+1]++;
+        }
+        for (i = 0; i < n; i++)
+            graph->incstart[i+1] += graph->incstart[i];
+        pos = snewn(n, int);
+        memcpy(pos, graph->incstart, n * sizeof(int));
+        for (i = 0; (e = index234(graph->edges, i)) != NULL; i++) {
+            graph->incident[pos[e->a]++] = i;
+            graph->incident[pos[e->b]++] = i;
+        }
+        sfree(pos);
+
+        graph->index = segindex_new(nedges, state->w);
+    }
+
     state->crosses = snewn(count234(state->graph->edges), int);
     mark_crossings(state);	       /* sets up `crosses' and `completed' */
-#endif
 
     return state;
 }
@@ -852,14 +1196,14 @@ static game_state *dup_game(const game_state *state)
     memcpy(ret->pts, state->pts, n * sizeof(point));
     ret->graph = state->graph;
     ret->graph->refcount++;
+    ret->serial = ++ret->graph->last_serial;
     ret->completed = state->completed;
     ret->cheated = state->cheated;
     ret->just_solved = state->just_solved;
-#ifdef SHOW_CROSSINGS
     ret->crosses = snewn(count234(ret->graph->edges), int);
     memcpy(ret->crosses, state->crosses,
 	   count234(ret->graph->edges) * sizeof(int));
-#endif
+    ret->ncrossings = state->ncrossings;
 
     return ret;
 }
@@ -871,8 +1215,12 @@ static void free_game(game_state *state)
 	while ((e = delpos234(state->graph->edges, 0)) != NULL)
 	    sfree(e);
 	freetree234(state->graph->edges);
+	sfree(state->graph->incstart);
+	sfree(state->graph->incident);
+	segindex_free(state->graph->index);
 	sfree(state->graph);
     }
+    sfree(state->crosses);
     sfree(state->pts);
     sfree(state);
 }
@@ -1181,7 +1529,7 @@ static game_state *execute_move(const game_state *state, const char *move)
 	}
     }
 
-    mark_crossings(ret);
+    update_crossings(state, ret);
 
     return ret;
 }